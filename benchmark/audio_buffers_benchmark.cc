@@ -22,9 +22,114 @@
 #include "lib/audio_buffers.h"
 #include "lib/timer.h"
 #include "libavutil/pixfmt.h"
+#include <cstring>
+#include <memory>
+#include <vector>
 
 
+using std::make_shared;
 using std::string;
+using std::to_string;
+using std::vector;
+
+
+/** The way that AudioBuffers used to store its data, for comparison */
+class VectorAudioBuffers
+{
+public:
+	VectorAudioBuffers(int channels, int frames)
+		: _data(channels, vector<float>(frames))
+	{}
+
+	int frames() const {
+		return _data[0].size();
+	}
+
+	void append(VectorAudioBuffers const& other)
+	{
+		auto const old_frames = frames();
+		for (size_t c = 0; c < _data.size(); ++c) {
+			_data[c].resize(old_frames + other.frames());
+			memcpy(_data[c].data() + old_frames, other._data[c].data(), other.frames() * sizeof(float));
+		}
+	}
+
+	void trim_start(int frames_to_trim)
+	{
+		for (auto& channel: _data) {
+			memmove(channel.data(), channel.data() + frames_to_trim, (channel.size() - frames_to_trim) * sizeof(float));
+			channel.resize(channel.size() - frames_to_trim);
+		}
+	}
+
+private:
+	vector<vector<float>> _data;
+};
+
+
+/** Mix, gain and append/trim as the player and encoders do with a film of some number of channels */
+static
+void
+channels_benchmark(int channels)
+{
+	auto constexpr TRIALS = 512;
+	auto constexpr FRAMES = 48000;
+	auto const name = to_string(channels) + " channels: ";
+
+	for (auto kernel: AudioBuffers::supported_kernels()) {
+		AudioBuffers::set_kernel(kernel);
+		AudioBuffers from(channels, FRAMES);
+		AudioBuffers to(channels, FRAMES);
+		{
+			PeriodTimer timer(name + "accumulate_channel (" + AudioBuffers::kernel_name(kernel) + ")");
+			for (int i = 0; i < TRIALS; ++i) {
+				for (int c = 0; c < channels; ++c) {
+					to.accumulate_channel(&from, c, (c + 1) % channels, 0.7);
+				}
+			}
+		}
+		{
+			PeriodTimer timer(name + "accumulate_frames (" + AudioBuffers::kernel_name(kernel) + ")");
+			for (int i = 0; i < TRIALS; ++i) {
+				to.accumulate_frames(&from, FRAMES, 0, 0);
+			}
+		}
+		{
+			PeriodTimer timer(name + "apply_gain (" + AudioBuffers::kernel_name(kernel) + ")");
+			for (int i = 0; i < TRIALS; ++i) {
+				to.apply_gain(-0.01);
+			}
+		}
+	}
+
+	AudioBuffers::set_kernel(AudioBuffers::supported_kernels().back());
+
+	/* Roughly what AudioMerger and FFmpegFileEncoder do: a buffer of about a second, with
+	 * blocks added to the end and taken off the start.
+	 */
+	auto constexpr BLOCK = 2000;
+	auto constexpr BLOCKS = 16384;
+
+	{
+		VectorAudioBuffers buffer(channels, FRAMES);
+		VectorAudioBuffers block(channels, BLOCK);
+		PeriodTimer timer(name + "append/trim_start (vector per channel)");
+		for (int i = 0; i < BLOCKS; ++i) {
+			buffer.append(block);
+			buffer.trim_start(BLOCK);
+		}
+	}
+
+	{
+		AudioBuffers buffer(channels, FRAMES);
+		auto block = make_shared<AudioBuffers>(channels, BLOCK);
+		PeriodTimer timer(name + "append/trim_start (AudioBuffers)");
+		for (int i = 0; i < BLOCKS; ++i) {
+			buffer.append(block);
+			buffer.trim_start(BLOCK);
+		}
+	}
+}
 
 
 void audio_buffers_benchmark();
@@ -52,5 +157,9 @@ audio_buffers_benchmark()
 			to.accumulate_channel(&from, 0, 3, 0.7);
 		}
 	}
+
+	for (auto channels: { 6, 16, 24 }) {
+		channels_benchmark(channels);
+	}
 }
 
@@ -22,8 +22,11 @@
 #include "lib/image.h"
 #include "lib/timer.h"
 #include "libavutil/pixfmt.h"
+#include <chrono>
+#include <iostream>
 
 
+using std::make_shared;
 using std::string;
 
 
@@ -64,5 +67,46 @@ image_benchmark()
 	make_part_black(AV_PIX_FMT_YUV420P, "AV_PIX_FMT_YUV420P");
 	make_part_black(AV_PIX_FMT_YUV422P10LE, "AV_PIX_FMT_YUV422P10LE");
 	make_part_black(AV_PIX_FMT_YUV444P10LE, "AV_PIX_FMT_YUV444P10LE");
+
+	/* What PlayerVideo::make_image does for a DCP encode: scale into the container, then burn in
+	 * a subtitle and fade, either as separate steps or with crop_scale_window_composite.
+	 */
+	auto compose = [](string name, dcp::Size in_size, dcp::Size inter_size, dcp::Size out_size) {
+		int constexpr FRAMES = 64;
+
+		auto in = make_shared<Image>(AV_PIX_FMT_YUV420P, in_size, Image::Alignment::PADDED);
+		in->make_black();
+		auto text = make_shared<Image>(AV_PIX_FMT_BGRA, dcp::Size{ out_size.width / 2, out_size.height / 8 }, Image::Alignment::PADDED);
+		text->make_transparent();
+		PositionImage const subtitle(text, Position<int>(out_size.width / 4, out_size.height * 3 / 4));
+
+		auto report = [name](string method, std::chrono::steady_clock::time_point start) {
+			std::chrono::duration<double> const time = std::chrono::steady_clock::now() - start;
+			std::cout << name << " " << method << ": " << (FRAMES / time.count()) << " frames/s\n";
+		};
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < FRAMES; ++i) {
+			auto out = in->crop_scale_window(
+				Crop(), inter_size, out_size, dcp::YUVToRGB::REC709, VideoRange::VIDEO, AV_PIX_FMT_RGB48LE, VideoRange::FULL, Image::Alignment::COMPACT, false
+				);
+			out->alpha_blend(subtitle.image, subtitle.position);
+			out->fade(0.5);
+		}
+		report("separate steps", start);
+
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < FRAMES; ++i) {
+			in->crop_scale_window_composite(
+				Crop(), inter_size, out_size, dcp::YUVToRGB::REC709, VideoRange::VIDEO, AV_PIX_FMT_RGB48LE, VideoRange::FULL, Image::Alignment::COMPACT, false,
+				subtitle, 0.5
+				);
+		}
+		report("composite", start);
+	};
+
+	compose("1080p to 2K flat", { 1920, 1080 }, { 1920, 1080 }, { 1998, 1080 });
+	compose("1080p to 2K scope", { 1920, 1080 }, { 1526, 858 }, { 2048, 858 });
+	compose("UHD to 4K flat", { 3840, 2160 }, { 3840, 2160 }, { 3996, 2160 });
 }
 
@@ -0,0 +1,270 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  benchmark/j2k_queue_benchmark.cc
+ *  @brief Compare the old mutex-and-list J2KEncoder queue with the MPMCQueue-based one.
+ *
+ *  Both queues are driven the same way as in J2KEncoder: one producer which waits
+ *  when there are more than (threads * 2 + 1) frames queued, and a pool of consumers
+ *  which each take a frame, do a little bit of "work" and then come back for more.
+ *  Every 64th frame is handed back with retry(), as a failed remote encode would be.
+ */
+
+
+#include "lib/mpmc_queue.h"
+#include "lib/timer.h"
+#include <dcp/scope_guard.h>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <vector>
+
+
+using std::shared_ptr;
+using std::make_shared;
+using std::string;
+using std::vector;
+
+
+/** Stand-in for DCPVideo: something a bit bigger than an int, with a shared_ptr to copy */
+struct Frame
+{
+	shared_ptr<int> data;
+	int index = 0;
+};
+
+
+int constexpr FRAMES = 1 << 20;
+
+
+/** The queue as it was in J2KEncoder before MPMCQueue */
+class LockedQueue
+{
+public:
+	explicit LockedQueue(int threads)
+		: _limit(threads * 2 + 1)
+	{}
+
+	void push(Frame frame)
+	{
+		boost::mutex::scoped_lock lock(_mutex);
+		while (static_cast<int>(_queue.size()) >= _limit) {
+			_full_condition.wait(lock);
+		}
+		_queue.push_back(frame);
+		_empty_condition.notify_all();
+	}
+
+	Frame pop()
+	{
+		boost::mutex::scoped_lock lock(_mutex);
+		while (_queue.empty()) {
+			_empty_condition.wait(lock);
+		}
+		auto frame = _queue.front();
+		_queue.pop_front();
+		_full_condition.notify_all();
+		return frame;
+	}
+
+	void retry(Frame frame)
+	{
+		boost::mutex::scoped_lock lock(_mutex);
+		_queue.push_front(frame);
+		_empty_condition.notify_all();
+	}
+
+private:
+	int const _limit;
+	boost::mutex _mutex;
+	std::list<Frame> _queue;
+	boost::condition _empty_condition;
+	boost::condition _full_condition;
+};
+
+
+/** The queue as it is now in J2KEncoder */
+class LockFreeQueue
+{
+public:
+	explicit LockFreeQueue(int threads)
+		: _limit(threads * 2 + 1)
+		, _queue(4096)
+	{}
+
+	void push(Frame frame)
+	{
+		while (_queue_size >= _limit) {
+			boost::mutex::scoped_lock lock(_mutex);
+			++_waiting_for_space;
+			dcp::ScopeGuard sg([this]() { --_waiting_for_space; });
+			if (_queue_size >= _limit) {
+				_full_condition.wait(lock);
+			}
+		}
+
+		++_queue_size;
+		_queue.try_push(frame);
+		wake(_waiting_for_frames, _empty_condition);
+	}
+
+	Frame pop()
+	{
+		boost::optional<Frame> frame;
+		while (!(frame = try_pop())) {
+			boost::mutex::scoped_lock lock(_mutex);
+			++_waiting_for_frames;
+			dcp::ScopeGuard sg([this]() { --_waiting_for_frames; });
+			if (_queue_size == 0) {
+				_empty_condition.wait(lock);
+			}
+		}
+
+		--_queue_size;
+		wake(_waiting_for_space, _full_condition);
+		return *frame;
+	}
+
+	void retry(Frame frame)
+	{
+		++_queue_size;
+		{
+			boost::mutex::scoped_lock lock(_retry_mutex);
+			_retry_queue.push_front(frame);
+			++_retry_queue_size;
+		}
+		wake(_waiting_for_frames, _empty_condition);
+	}
+
+private:
+	boost::optional<Frame> try_pop()
+	{
+		if (_retry_queue_size > 0) {
+			boost::mutex::scoped_lock lock(_retry_mutex);
+			if (!_retry_queue.empty()) {
+				auto frame = _retry_queue.front();
+				_retry_queue.pop_front();
+				--_retry_queue_size;
+				return frame;
+			}
+		}
+
+		boost::optional<Frame> frame;
+		_queue.try_pop(frame);
+		return frame;
+	}
+
+	void wake(std::atomic<int>& waiting, boost::condition& condition)
+	{
+		if (waiting > 0) {
+			boost::mutex::scoped_lock lock(_mutex);
+			condition.notify_all();
+		}
+	}
+
+	int const _limit;
+	MPMCQueue<Frame> _queue;
+	boost::mutex _retry_mutex;
+	std::list<Frame> _retry_queue;
+	std::atomic<int> _retry_queue_size{0};
+	std::atomic<int> _queue_size{0};
+	boost::mutex _mutex;
+	boost::condition _empty_condition;
+	boost::condition _full_condition;
+	std::atomic<int> _waiting_for_frames{0};
+	std::atomic<int> _waiting_for_space{0};
+};
+
+
+template <class Queue>
+void
+run(string name, int threads)
+{
+	Queue queue(threads);
+	std::atomic<int> done(0);
+	auto data = make_shared<int>(42);
+
+	auto consume = [&queue, &done]() {
+		while (true) {
+			auto frame = queue.pop();
+			if (frame.index < 0) {
+				break;
+			}
+			if (frame.index % 64 == 0 && frame.data) {
+				/* Pretend that this encode failed once */
+				frame.data.reset();
+				queue.retry(frame);
+				continue;
+			}
+			/* A token amount of work */
+			volatile int x = 0;
+			for (int i = 0; i < 64; ++i) {
+				x = x + i;
+			}
+			++done;
+		}
+	};
+
+	PeriodTimer timer(name + ", " + std::to_string(threads) + " threads");
+
+	vector<boost::thread> consumers;
+	for (int i = 0; i < threads; ++i) {
+		consumers.push_back(boost::thread(consume));
+	}
+
+	for (int i = 0; i < FRAMES; ++i) {
+		Frame frame;
+		frame.data = data;
+		frame.index = i;
+		queue.push(frame);
+	}
+
+	/* Poison pills to stop the consumers */
+	for (int i = 0; i < threads; ++i) {
+		Frame frame;
+		frame.index = -1;
+		queue.push(frame);
+	}
+
+	for (auto& consumer: consumers) {
+		consumer.join();
+	}
+
+	if (done != FRAMES) {
+		std::cerr << "Lost frames: " << (FRAMES - done) << "\n";
+	}
+}
+
+
+int
+main()
+{
+	for (auto threads: { 8, 32, 128 }) {
+		run<LockedQueue>("mutex + std::list", threads);
+		run<LockFreeQueue>("MPMCQueue", threads);
+	}
+
+	return 0;
+}
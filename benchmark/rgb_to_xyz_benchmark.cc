@@ -0,0 +1,109 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  benchmark/rgb_to_xyz_benchmark.cc
+ *  @brief Compare RGBToXYZ's kernels with dcp::rgb_to_xyz, for speed and to check that they give the same results.
+ */
+
+
+#include "lib/colour_conversion.h"
+#include "lib/image.h"
+#include "lib/rgb_to_xyz.h"
+#include "lib/timer.h"
+#include <dcp/openjpeg_image.h>
+#include <dcp/rgb_xyz.h>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+
+using std::make_shared;
+using std::string;
+using std::vector;
+
+
+int constexpr TRIALS = 32;
+
+
+int
+main()
+{
+	PresetColourConversion::setup_colour_conversion_presets();
+
+	/* An odd width so that the kernels' leftovers get tested too */
+	dcp::Size const size(3997, 2160);
+	auto image = make_shared<Image>(AV_PIX_FMT_RGB48LE, size, Image::Alignment::PADDED);
+
+	std::mt19937 random(42);
+	for (int y = 0; y < size.height; ++y) {
+		auto p = reinterpret_cast<uint16_t*>(image->data()[0] + y * image->stride()[0]);
+		for (int x = 0; x < size.width * 3; ++x) {
+			*p++ = random() & 0xffff;
+		}
+	}
+
+	auto const samples = static_cast<size_t>(size.width) * size.height * 3;
+	vector<uint16_t> reference(samples);
+	vector<uint16_t> ours(samples);
+
+	int failures = 0;
+
+	for (auto const& preset: PresetColourConversion::all()) {
+		std::cout << preset.name << "\n";
+
+		{
+			PeriodTimer timer("  dcp::rgb_to_xyz");
+			for (int i = 0; i < TRIALS; ++i) {
+				dcp::rgb_to_xyz(image->data()[0], reference.data(), size, image->stride()[0], preset.conversion);
+			}
+		}
+
+		auto const reference_image = dcp::rgb_to_xyz(image->data()[0], size, image->stride()[0], preset.conversion);
+
+		RGBToXYZ converter(preset.conversion);
+		for (auto kernel: RGBToXYZ::supported_kernels()) {
+			converter.set_kernel(kernel);
+
+			{
+				PeriodTimer timer("  RGBToXYZ " + RGBToXYZ::kernel_name(kernel));
+				for (int i = 0; i < TRIALS; ++i) {
+					converter.convert(image->data()[0], size, image->stride()[0], ours.data());
+				}
+			}
+
+			if (memcmp(reference.data(), ours.data(), samples * sizeof(uint16_t)) != 0) {
+				std::cerr << "  " << RGBToXYZ::kernel_name(kernel) << " does not match dcp::rgb_to_xyz\n";
+				++failures;
+			}
+
+			auto const our_image = converter.convert(image->data()[0], size, image->stride()[0]);
+			for (int c = 0; c < 3; ++c) {
+				if (memcmp(reference_image->data(c), our_image->data(c), size.width * size.height * sizeof(int)) != 0) {
+					std::cerr << "  " << RGBToXYZ::kernel_name(kernel) << " does not match dcp::rgb_to_xyz in component " << c << "\n";
+					++failures;
+				}
+			}
+		}
+	}
+
+	return failures == 0 ? 0 : 1;
+}
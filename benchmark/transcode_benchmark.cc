@@ -0,0 +1,384 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  benchmark/transcode_benchmark.cc
+ *  @brief Time making a DCP from a film of synthetic content, from decode to digest.
+ *
+ *  We write some test content into a temporary directory: H.264, ProRes HQ (4K, 5.1) and
+ *  ProRes LT files with tones on their audio, a PNG sequence and a subtitle to burn in.
+ *  Then we make a DCP from it twice: once encoding with local threads, and once sending
+ *  every frame to an EncodeServer running in this process.  For each run we print the
+ *  frame rate, the time spent in each stage (from StageTimes) and the peak RSS as JSON.
+ *  Since the server runs in this process its JPEG2000 encoding is counted in the j2k stage;
+ *  the time spent sending frames to it and waiting for them to come back is in the remote stage.
+ *
+ *  Usage: transcode_benchmark [--seconds N] [--keep]
+ *
+ *  N is the length of each piece of video content (default 5); --keep leaves the
+ *  temporary directory behind so that the DCPs can be inspected.
+ */
+
+
+#include "lib/audio_buffers.h"
+#include "lib/config.h"
+#include "lib/content_factory.h"
+#include "lib/cross.h"
+#include "lib/dcp_content_type.h"
+#include "lib/encode_server.h"
+#include "lib/encode_server_finder.h"
+#include "lib/ffmpeg_file_encoder.h"
+#include "lib/film.h"
+#include "lib/image.h"
+#include "lib/image_png.h"
+#include "lib/job_manager.h"
+#include "lib/make_dcp.h"
+#include "lib/player_video.h"
+#include "lib/ratio.h"
+#include "lib/raw_image_proxy.h"
+#include "lib/signal_manager.h"
+#include "lib/stage_times.h"
+#include "lib/state.h"
+#include "lib/text_content.h"
+#include "lib/transcode_job.h"
+#include "lib/util.h"
+#include <dcp/filesystem.h>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#ifndef DCPOMATIC_WINDOWS
+#include <sys/resource.h>
+#endif
+
+
+using std::cerr;
+using std::cout;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using std::weak_ptr;
+using boost::optional;
+using namespace dcpomatic;
+
+
+/** A test card which moves a little each frame, so that every frame needs encoding */
+static
+shared_ptr<Image>
+pattern(dcp::Size size, int frame)
+{
+	auto image = make_shared<Image>(AV_PIX_FMT_RGB24, size, Image::Alignment::PADDED);
+	for (int y = 0; y < size.height; ++y) {
+		auto p = image->data()[0] + y * image->stride()[0];
+		for (int x = 0; x < size.width; ++x) {
+			*p++ = (x + frame * 4) & 0xff;
+			*p++ = (y + frame * 2) & 0xff;
+			*p++ = ((x ^ y) + frame) & 0xff;
+		}
+	}
+	return image;
+}
+
+
+static
+void
+write_movie(boost::filesystem::path path, ExportFormat format, dcp::Size size, int rate, int channels, int seconds)
+{
+	int constexpr sample_rate = 48000;
+	FFmpegFileEncoder encoder(size, rate, sample_rate, channels, format, false, 23, path);
+
+	int const samples_per_frame = sample_rate / rate;
+	for (int frame = 0; frame < seconds * rate; ++frame) {
+		auto video = make_shared<PlayerVideo>(
+			make_shared<RawImageProxy>(pattern(size, frame)),
+			Crop(),
+			optional<double>(),
+			size,
+			size,
+			Eyes::BOTH,
+			Part::WHOLE,
+			optional<ColourConversion>(),
+			VideoRange::FULL,
+			weak_ptr<Content>(),
+			optional<ContentTime>(),
+			false
+			);
+		encoder.video(video, DCPTime::from_frames(frame, rate));
+
+		auto audio = make_shared<AudioBuffers>(channels, samples_per_frame);
+		for (int channel = 0; channel < channels; ++channel) {
+			/* A different tone on each channel */
+			auto const frequency = 220.0 * (channel + 1);
+			auto data = audio->data(channel);
+			for (int sample = 0; sample < samples_per_frame; ++sample) {
+				auto const t = static_cast<double>(frame * samples_per_frame + sample) / sample_rate;
+				data[sample] = 0.25 * sin(2 * M_PI * frequency * t);
+			}
+		}
+		encoder.audio(audio);
+	}
+
+	encoder.flush();
+}
+
+
+static
+void
+write_png_sequence(boost::filesystem::path dir, dcp::Size size, int frames)
+{
+	dcp::filesystem::create_directories(dir);
+	for (int frame = 0; frame < frames; ++frame) {
+		char name[64];
+		snprintf(name, sizeof(name), "%06d.png", frame);
+		image_as_png(pattern(size, frame)).write(dir / name);
+	}
+}
+
+
+static
+void
+write_subtitle(boost::filesystem::path path, int seconds)
+{
+	auto time = [](int seconds, int milliseconds) {
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d,%03d", seconds / 3600, (seconds / 60) % 60, seconds % 60, milliseconds);
+		return string(buffer);
+	};
+
+	std::ofstream file(path.string());
+	for (int i = 0; i < seconds; ++i) {
+		file << (i + 1) << "\n"
+		     << time(i, 0) << " --> " << time(i, 800) << "\n"
+		     << "Subtitle number " << (i + 1) << "\n\n";
+	}
+}
+
+
+/** Wait for all jobs to finish.
+ *  @return true if any of them failed.
+ */
+static
+bool
+wait_for_jobs()
+{
+	auto jm = JobManager::instance();
+	while (jm->work_to_do()) {
+		dcpomatic_sleep_milliseconds(100);
+	}
+	return jm->errors();
+}
+
+
+/** @return Peak resident set size of this process in kilobytes, if we know it */
+static
+optional<long>
+peak_rss_kb()
+{
+#ifdef DCPOMATIC_WINDOWS
+	return {};
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return {};
+	}
+#ifdef DCPOMATIC_OSX
+	/* macOS gives bytes, Linux kilobytes */
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+}
+
+
+static
+shared_ptr<Film>
+make_film(boost::filesystem::path dir, vector<boost::filesystem::path> const& content)
+{
+	auto film = make_shared<Film>(dir);
+	film->use_template({});
+	film->set_name(dir.filename().string());
+	film->set_dcp_content_type(DCPContentType::from_isdcf_name("TST"));
+	film->set_container(Ratio::from_id("185"));
+	film->set_video_frame_rate(24);
+	film->set_audio_channels(6);
+	film->write_metadata();
+
+	for (auto const& path: content) {
+		for (auto c: content_factory(path)) {
+			film->examine_and_add_content({c});
+			if (wait_for_jobs()) {
+				throw std::runtime_error("Could not examine " + path.string());
+			}
+			for (auto text: c->text) {
+				text->set_burn(true);
+			}
+		}
+	}
+
+	return film;
+}
+
+
+/** Make a DCP of film and print a JSON object describing how it went.
+ *  @param server Loopback server that is doing the encoding, if there is one.
+ */
+static
+void
+run(string name, shared_ptr<Film> film, EncodeServer const* server)
+{
+	StageTimes::enable();
+
+	auto const start = std::chrono::steady_clock::now();
+	make_dcp(film, TranscodeJob::ChangedBehaviour::IGNORE);
+	if (wait_for_jobs()) {
+		throw std::runtime_error("Could not make DCP for " + name);
+	}
+	auto const wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	auto const frames = film->length().frames_round(film->video_frame_rate());
+
+	std::ostringstream json;
+	json.setf(std::ios::fixed);
+	json.precision(3);
+	json << "{ \"name\": \"" << name << "\", \"frames\": " << frames << ", \"seconds\": " << wall
+	     << ", \"fps\": " << (frames / wall) << ", \"stages\": { ";
+	for (int i = 0; i < static_cast<int>(StageTimes::Stage::COUNT); ++i) {
+		auto const stage = static_cast<StageTimes::Stage>(i);
+		json << (i ? ", " : "") << "\"" << StageTimes::name(stage) << "\": " << StageTimes::seconds(stage);
+	}
+	json << " }";
+	if (server) {
+		json << ", \"server_frames\": " << server->frames_encoded();
+	}
+	if (auto rss = peak_rss_kb()) {
+		json << ", \"peak_rss_kb\": " << *rss;
+	}
+	json << " }";
+
+	cout << json.str();
+}
+
+
+static
+void
+help()
+{
+	cerr << "Syntax: transcode_benchmark [--seconds N] [--keep]\n";
+}
+
+
+int
+main(int argc, char* argv[])
+{
+	int seconds = 5;
+	bool keep = false;
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--seconds") && (i + 1) < argc) {
+			seconds = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--keep")) {
+			keep = true;
+		} else {
+			help();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (seconds < 1) {
+		help();
+		return EXIT_FAILURE;
+	}
+
+	auto const dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("dcpomatic-transcode-benchmark-%%%%-%%%%");
+	dcp::filesystem::create_directories(dir);
+
+	/* Keep our configuration away from the user's */
+	State::override_path = dir / "state";
+
+	dcpomatic_setup_path_encoding();
+	dcpomatic_setup();
+	signal_manager = new SignalManager();
+
+	auto const threads = std::max(1, static_cast<int>(boost::thread::hardware_concurrency()));
+
+	try {
+		cerr << "Writing test content to " << dir.string() << "\n";
+		auto const content_dir = dir / "content";
+		dcp::filesystem::create_directories(content_dir);
+		write_movie(content_dir / "h264.mp4", ExportFormat::H264_AAC, { 1920, 1080 }, 25, 2, seconds);
+		write_movie(content_dir / "prores_hq.mov", ExportFormat::PRORES_HQ, { 3840, 2160 }, 24, 6, seconds);
+		write_movie(content_dir / "prores_lt.mov", ExportFormat::PRORES_LT, { 1280, 720 }, 30, 2, seconds);
+		write_png_sequence(content_dir / "png", { 2048, 858 }, seconds * 24);
+		write_subtitle(content_dir / "subtitle.srt", seconds * 4);
+
+		vector<boost::filesystem::path> const content = {
+			content_dir / "h264.mp4",
+			content_dir / "prores_hq.mov",
+			content_dir / "prores_lt.mov",
+			content_dir / "png",
+			content_dir / "subtitle.srt"
+		};
+
+		/* Each run gets its own film so that the second can't re-use frames from the first */
+		cout << "{ \"threads\": " << threads << ", \"runs\": [ ";
+
+		cerr << "Encoding locally\n";
+		auto config = Config::instance();
+		config->set_master_encoding_threads(threads);
+		config->set_use_any_servers(false);
+		config->set_servers({});
+		config->set_only_servers_encode(false);
+		run("local", make_film(dir / "local", content), nullptr);
+
+		cout << ", ";
+
+		cerr << "Encoding on a loopback server\n";
+		EncodeServer server(false, threads);
+		boost::thread server_thread([&server]() { server.run(); });
+		config->set_servers({"localhost"});
+		config->set_only_servers_encode(true);
+		EncodeServerFinder::instance();
+		run("server", make_film(dir / "server", content), &server);
+		server.stop();
+		server_thread.join();
+		EncodeServerFinder::drop();
+
+		cout << " ] }\n";
+	} catch (std::exception& e) {
+		cerr << "Error: " << e.what() << "\n";
+		JobManager::drop();
+		return EXIT_FAILURE;
+	}
+
+	JobManager::drop();
+
+	if (!keep) {
+		boost::system::error_code ec;
+		boost::filesystem::remove_all(dir, ec);
+	}
+
+	return 0;
+}
@@ -27,6 +27,11 @@
 #include "player.h"
 #include "playlist.h"
 #include "config.h"
+#include "content.h"
+#include "util.h"
+#include <dcp/filesystem.h>
+#include <boost/thread.hpp>
+#include <algorithm>
 #include <iostream>
 
 #include "i18n.h"
@@ -46,13 +51,16 @@ using namespace boost::placeholders;
 #endif
 
 
+/** Shortest length of audio that we will give to each of several analysers which run at the same time */
+static int constexpr minimum_part_minutes = 5;
+
+
 /** @param whole_film true to analyse the whole film' audio (i.e. start from time 0 and use processors), false
  *  to analyse just the single piece of content in the playlist (i.e. start from Playlist::start() and do not
  *  use processors).
  */
 AnalyseAudioJob::AnalyseAudioJob(shared_ptr<const Film> film, shared_ptr<const Playlist> playlist, bool whole_film)
 	: Job(film)
-	, _analyser(film, playlist, whole_film, boost::bind(&Job::set_progress, this, _1, false))
 	, _playlist(playlist)
 	, _path(film->audio_analysis_path(playlist))
 	, _whole_film(whole_film)
@@ -86,35 +94,232 @@ AnalyseAudioJob::run()
 {
 	LOG_DEBUG_AUDIO_ANALYSIS("AnalyseAudioJob::run");
 
-	auto player = make_shared<Player>(_film, _playlist, false);
-	player->set_ignore_video();
-	player->set_ignore_text();
-	player->set_fast();
-	player->set_play_referenced();
-	player->Audio.connect(bind(&AudioAnalyser::analyse, &_analyser, _1, _2));
-	if (!_whole_film) {
-		player->set_disable_audio_processor();
+	auto const pieces = pieces_to_combine();
+	auto const analysis = pieces.empty() ? analyse(_playlist, _whole_film, [this](float p) { set_progress(p); }) : combine(pieces);
+	analysis.write(_path);
+
+	LOG_DEBUG_AUDIO_ANALYSIS("Job finished");
+	set_progress(1);
+	set_state(FINISHED_OK);
+}
+
+
+/** @return The pieces of audio content whose own analyses can be combined to make the analysis that
+ *  we want, or an empty list if we must analyse the whole playlist in one go.
+ */
+vector<shared_ptr<Content>>
+AnalyseAudioJob::pieces_to_combine() const
+{
+	/* An audio processor mixes everything together, so then we can't look at each piece on its own */
+	if (!_whole_film || _film->audio_processor()) {
+		return {};
+	}
+
+	vector<shared_ptr<Content>> pieces;
+	for (auto content: _playlist->content()) {
+		if (content->audio) {
+			pieces.push_back(content);
+		}
+	}
+
+	std::sort(pieces.begin(), pieces.end(), [](shared_ptr<Content> a, shared_ptr<Content> b) {
+		return a->position() < b->position();
+	});
+
+	/* With only one piece there is nothing to combine, and analysing it directly gives the
+	   whole-film analysis more accurately.
+	*/
+	if (pieces.size() < 2) {
+		return {};
+	}
+
+	/* We can't add up the analyses of pieces that play at the same time */
+	for (size_t i = 1; i < pieces.size(); ++i) {
+		if (pieces[i]->position() < pieces[i - 1]->end(_film)) {
+			return {};
+		}
+	}
+
+	return pieces;
+}
+
+
+/** Make our analysis by combining the analyses of each piece of audio content, analysing any pieces
+ *  which have not already been analysed (or have changed since they were).
+ */
+AudioAnalysis
+AnalyseAudioJob::combine(vector<shared_ptr<Content>> const& pieces)
+{
+	auto const sample_rate = _film->audio_frame_rate();
+
+	vector<AudioAnalysis::Part> parts;
+	int analysed = 0;
+	for (size_t i = 0; i < pieces.size(); ++i) {
+		auto content = pieces[i];
+		auto playlist = make_shared<Playlist>();
+		playlist->add(_film, content);
+		auto const path = content_analysis_path(_film, content);
+
+		shared_ptr<AudioAnalysis> analysis;
+		if (dcp::filesystem::exists(path)) {
+			try {
+				analysis = make_shared<AudioAnalysis>(path);
+			} catch (std::exception& e) {
+				LOG_GENERAL("Could not read audio analysis {} ({}); analysing again", path.string(), e.what());
+			}
+		}
+
+		if (!analysis) {
+			analysis = make_shared<AudioAnalysis>(
+				analyse(playlist, false, [this, i, &pieces](float p) { set_progress((i + p) / pieces.size()); })
+				);
+			analysis->write(path);
+			++analysed;
+		}
+
+		auto const gain = content->audio->gain() - analysis->analysis_gain().get_value_or(content->audio->gain());
+		auto const position = content->position().frames_round(sample_rate);
+		auto const length = content->end(_film).frames_round(sample_rate) - position;
+		parts.push_back({analysis, position, length, gain});
 	}
 
+	LOG_GENERAL("Combining audio analyses of {} pieces of content, {} of which were analysed now", pieces.size(), analysed);
+
+	auto const length = _playlist->length(_film).frames_round(sample_rate);
+	return AudioAnalysis::combine(parts, _film->audio_channels(), sample_rate, length, AudioAnalyser::samples_per_point(length));
+}
+
+
+/** @return Path of the analysis of a piece of content on its own, as used by combine().  This is
+ *  kept apart from the paths given by Film::audio_analysis_path(), since when there is only one piece
+ *  of content in a playlist that path does not depend on its position or gain, so the whole-film
+ *  analysis of that playlist (which starts at time 0) would have the same path.
+ */
+boost::filesystem::path
+AnalyseAudioJob::content_analysis_path(shared_ptr<const Film> film, shared_ptr<Content> content)
+{
+	auto playlist = make_shared<Playlist>();
+	playlist->add(film, content);
+	auto path = film->audio_analysis_path(playlist);
+	path += ".content";
+	return path;
+}
+
+
+/** Analyse a playlist, splitting it into parts to be analysed at the same time if that
+ *  looks like it will help.
+ *  @param whole_film true to analyse from time 0 and use the audio processor.
+ */
+AudioAnalysis
+AnalyseAudioJob::analyse(shared_ptr<const Playlist> playlist, bool whole_film, std::function<void (float)> set_progress)
+{
 	bool has_any_audio = false;
-	for (auto c: _playlist->content()) {
+	for (auto c: playlist->content()) {
 		if (c->audio) {
 			has_any_audio = true;
 		}
 	}
 
+	int parts = 1;
+	if (_parts) {
+		parts = *_parts;
+	} else if (has_any_audio) {
+		/* Give each part at least a few minutes, otherwise the time spent
+		 * setting up players and seeking will not be worth it.
+		 */
+		auto const start = whole_film ? DCPTime() : playlist->start().get_value_or(DCPTime());
+		auto const minutes = (playlist->length(_film) - start).seconds() / 60;
+		parts = max(1, min(static_cast<int>(boost::thread::hardware_concurrency()), static_cast<int>(minutes / minimum_part_minutes)));
+	}
+
+	/* Progress of each part; protected by progress_mutex */
+	vector<float> progress(parts, 0);
+	boost::mutex progress_mutex;
+
+	vector<shared_ptr<AudioAnalyser>> analysers;
+	for (int i = 0; i < parts; ++i) {
+		analysers.push_back(
+			make_shared<AudioAnalyser>(
+				_film, playlist, whole_film, i, parts, [i, &progress, &progress_mutex, set_progress](float p) {
+					boost::mutex::scoped_lock lm(progress_mutex);
+					progress[i] = p;
+					float total = 0;
+					for (auto part: progress) {
+						total += part;
+					}
+					set_progress(total / progress.size());
+				})
+			);
+	}
+
 	if (has_any_audio) {
-		player->seek(_analyser.start(), true);
-		while (!player->pass()) {}
+		if (parts == 1) {
+			analyse(analysers[0], playlist, whole_film);
+		} else {
+			LOG_GENERAL("Analysing audio in {} parts", parts);
+
+			std::exception_ptr exception;
+			boost::mutex exception_mutex;
+
+			boost::thread_group threads;
+			for (auto analyser: analysers) {
+				threads.create_thread([this, analyser, playlist, whole_film, &exception, &exception_mutex]() {
+					start_of_thread("AnalyseAudio");
+					try {
+						analyse(analyser, playlist, whole_film);
+					} catch (boost::thread_interrupted&) {
+						/* We have been cancelled */
+					} catch (...) {
+						boost::mutex::scoped_lock lm(exception_mutex);
+						if (!exception) {
+							exception = std::current_exception();
+						}
+					}
+				});
+			}
+
+			try {
+				threads.join_all();
+			} catch (boost::thread_interrupted&) {
+				/* We have been cancelled */
+				threads.interrupt_all();
+				threads.join_all();
+				throw;
+			}
+
+			if (exception) {
+				std::rethrow_exception(exception);
+			}
+		}
 	}
 
 	LOG_DEBUG_AUDIO_ANALYSIS("Loop complete");
 
-	_analyser.finish();
-	auto analysis = _analyser.get();
-	analysis.write(_path);
+	for (size_t i = 1; i < analysers.size(); ++i) {
+		analysers[0]->append(*analysers[i]);
+	}
 
-	LOG_DEBUG_AUDIO_ANALYSIS("Job finished");
-	set_progress(1);
-	set_state(FINISHED_OK);
+	analysers[0]->finish();
+	return analysers[0]->get();
+}
+
+
+/** Pass the audio that an analyser needs from a new player */
+void
+AnalyseAudioJob::analyse(shared_ptr<AudioAnalyser> analyser, shared_ptr<const Playlist> playlist, bool whole_film)
+{
+	auto player = make_shared<Player>(_film, playlist, false);
+	player->set_ignore_video();
+	player->set_ignore_text();
+	player->set_fast();
+	player->set_play_referenced();
+	player->Audio.connect(bind(&AudioAnalyser::analyse, analyser.get(), _1, _2));
+	if (!whole_film) {
+		player->set_disable_audio_processor();
+	}
+
+	player->seek(analyser->start(), true);
+	while (!player->pass() && !analyser->done()) {
+		boost::this_thread::interruption_point();
+	}
 }
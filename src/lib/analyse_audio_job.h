@@ -29,13 +29,17 @@
 #include "dcpomatic_time.h"
 #include "job.h"
 #include <leqm_nrt.h>
+#include <boost/optional.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <functional>
+#include <vector>
 
 
 class AudioAnalysis;
 class AudioBuffers;
 class AudioFilterGraph;
 class AudioPoint;
+class Content;
 class Filter;
 class Playlist;
 
@@ -46,6 +50,11 @@ class Playlist;
  *
  *  After computing the peak and RMS levels the job will write a file
  *  to Film::audio_analysis_path.
+ *
+ *  When the whole film is being analysed, and it has more than one piece of
+ *  audio content with none overlapping, each piece is analysed (or its previous analysis re-used)
+ *  on its own and the results are combined.  This means that changing one
+ *  piece of content only requires that piece to be analysed again.
  */
 class AnalyseAudioJob : public Job
 {
@@ -64,13 +73,26 @@ public:
 		return _path;
 	}
 
+	static boost::filesystem::path content_analysis_path(std::shared_ptr<const Film> film, std::shared_ptr<Content> content);
+
+	/** Set the number of parts to split the audio into, to be analysed at the same time.
+	 *  By default this depends on the number of CPUs and the length of the audio.
+	 */
+	void set_parts(int parts) {
+		_parts = parts;
+	}
+
 private:
-	AudioAnalyser _analyser;
+	std::vector<std::shared_ptr<Content>> pieces_to_combine() const;
+	AudioAnalysis combine(std::vector<std::shared_ptr<Content>> const& pieces);
+	AudioAnalysis analyse(std::shared_ptr<const Playlist> playlist, bool whole_film, std::function<void (float)> set_progress);
+	void analyse(std::shared_ptr<AudioAnalyser> analyser, std::shared_ptr<const Playlist> playlist, bool whole_film);
 
 	std::shared_ptr<const Playlist> _playlist;
 	/** playlist's audio analysis path when the job was created */
 	boost::filesystem::path _path;
 	bool _whole_film;
+	boost::optional<int> _parts;
 
 	static const int _num_points;
 };
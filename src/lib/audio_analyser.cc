@@ -50,14 +50,33 @@ using namespace dcpomatic;
 
 
 static auto constexpr num_points = 1024;
+/** Size of the buffers that leqm_nrt processes, in milliseconds */
+static int constexpr leqm_buffer_ms = 850;
+/** Length of audio to give an analyser for part of a playlist before the part that it is measuring */
+static int constexpr pre_roll_seconds = 2;
 
 
 AudioAnalyser::AudioAnalyser(shared_ptr<const Film> film, shared_ptr<const Playlist> playlist, bool whole_film, std::function<void (float)> set_progress)
+	: AudioAnalyser(film, playlist, whole_film, 0, 1, set_progress)
+{
+
+}
+
+
+AudioAnalyser::AudioAnalyser(
+	shared_ptr<const Film> film,
+	shared_ptr<const Playlist> playlist,
+	bool whole_film,
+	int part,
+	int parts,
+	std::function<void (float)> set_progress
+	)
 	: _film(film)
 	, _playlist(playlist)
 	, _set_progress(set_progress)
 #ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
 	, _ebur128(film->audio_frame_rate(), film->audio_channels())
+	, _loudness(film->audio_frame_rate(), film->audio_channels())
 #endif
 	, _sample_peak(film->audio_channels())
 	, _sample_peak_frame(film->audio_channels())
@@ -120,15 +139,89 @@ AudioAnalyser::AudioAnalyser(shared_ptr<const Film> film, shared_ptr<const Playl
 		film->audio_frame_rate(),
 		24,
 		channel_corrections,
-		850, // suggested by leqm_nrt CLI source
+		leqm_buffer_ms, // suggested by leqm_nrt CLI source
 		64,  // suggested by leqm_nrt CLI source
-		boost::thread::hardware_concurrency()
+		/* The parts are analysed at the same time, so share the CPUs between them */
+		max(1, static_cast<int>(boost::thread::hardware_concurrency()) / parts)
 		));
 
 	DCPTime const length = _playlist->length(_film);
 
 	Frame const len = DCPTime(length - _start).frames_round(film->audio_frame_rate());
-	_samples_per_point = max(int64_t(1), len / num_points);
+	_samples_per_point = samples_per_point(len);
+
+	DCPOMATIC_ASSERT(part >= 0 && part < parts);
+
+	if (parts > 1) {
+		/* Each measurement can only be split at certain frames if the parts are to give the same
+		 * result as a single analysis, so each gets its own range near the nominal ends of this part.
+		 */
+		auto boundary = [len, parts](int index) {
+			return len * index / parts;
+		};
+
+		auto range = [part, parts, boundary](std::function<Frame (Frame)> align) {
+			Range r;
+			r.from = align(boundary(part));
+			if (part < (parts - 1)) {
+				r.to = align(boundary(part + 1));
+			}
+			return r;
+		};
+
+		auto multiple = [](Frame frame, Frame block) {
+			return ((frame + block - 1) / block) * block;
+		};
+
+		auto const spp = _samples_per_point;
+		/* Points are finished on frames that are multiples of _samples_per_point, so split just after one */
+		_points_range = range([spp](Frame frame) { return frame == 0 ? 0 : ((frame + spp - 2) / spp) * spp + 1; });
+		/* leqm_nrt processes its input in independent buffers, so split at the end of one */
+		Frame const leqm_buffer = static_cast<Frame>(film->audio_frame_rate()) * leqm_buffer_ms / 1000;
+		_leqm_range = range([multiple, leqm_buffer](Frame frame) { return multiple(frame, leqm_buffer); });
+		_player_to = std::max(_points_range.to, _leqm_range.to);
+
+#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
+		/* LoudnessMeter measures in blocks, so split at the end of one */
+		Frame const loudness_block = _loudness.block_frames();
+		_loudness_range = range([multiple, loudness_block](Frame frame) { return multiple(frame, loudness_block); });
+		_player_to = std::max(_player_to, _loudness_range.to);
+#endif
+
+		/* Start a little early so that the filters have settled by the time we start measuring */
+		_player_from = std::max(Frame(0), boundary(part) - static_cast<Frame>(film->audio_frame_rate()) * pre_roll_seconds);
+		_done = _player_from;
+	}
+}
+
+
+/** @return Number of samples in each point of an analysis of some audio.
+ *  @param length Length of the audio in frames.
+ */
+int64_t
+AudioAnalyser::samples_per_point(Frame length)
+{
+	return max(int64_t(1), length / num_points);
+}
+
+
+std::pair<int, int>
+AudioAnalyser::Range::overlap(Frame start, int frames) const
+{
+	auto clamp = [frames](Frame f) {
+		return static_cast<int>(std::min(std::max(f, Frame(0)), Frame(frames)));
+	};
+
+	auto const begin = clamp(from - start);
+	auto const end = to ? clamp(*to - start) : frames;
+	return { begin, std::max(begin, end) - begin };
+}
+
+
+DCPTime
+AudioAnalyser::start() const
+{
+	return _start + DCPTime::from_frames(_player_from, _film->audio_frame_rate());
 }
 
 
@@ -143,22 +236,23 @@ AudioAnalyser::analyse(shared_ptr<AudioBuffers> b, DCPTime time)
 	 */
 	DCPOMATIC_ASSERT(b->frames() < 480000);
 
+	int const frames = b->frames();
+
 #ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
 	if (Config::instance()->analyse_ebur128()) {
 		_ebur128.process(b);
+		auto const measure = _loudness_range.overlap(_done, frames);
+		_loudness.process(*b, 0, measure.first, false);
+		_loudness.process(*b, measure.first, measure.second, true);
 	}
 #endif
 
-	int const frames = b->frames();
-	vector<double> interleaved(frames * _leqm_channels);
-
+	auto const points = _points_range.overlap(_done, frames);
 	for (int j = 0; j < _leqm_channels; ++j) {
 		float const* data = b->data(j);
-		for (int i = 0; i < frames; ++i) {
+		for (int i = points.first; i < points.first + points.second; ++i) {
 			float s = data[i];
 
-			interleaved[i * _leqm_channels + j] = s;
-
 			float as = fabsf(s);
 			if (as < 10e-7) {
 				/* We may struggle to serialise and recover inf or -inf, so prevent such
@@ -181,16 +275,83 @@ AudioAnalyser::analyse(shared_ptr<AudioBuffers> b, DCPTime time)
 		}
 	}
 
-	_leqm->add(interleaved);
+	auto const leqm = _leqm_range.overlap(_done, frames);
+	if (leqm.second > 0) {
+		vector<double> interleaved(leqm.second * _leqm_channels);
+		for (int j = 0; j < _leqm_channels; ++j) {
+			float const* data = b->data(j) + leqm.first;
+			for (int i = 0; i < leqm.second; ++i) {
+				interleaved[i * _leqm_channels + j] = data[i];
+			}
+		}
+		_leqm->add(interleaved);
+		_leqm_frames += leqm.second;
+	}
 
 	_done += frames;
 
-	DCPTime const length = _playlist->length(_film);
-	_set_progress((time.seconds() - _start.seconds()) / (length.seconds() - _start.seconds()));
+	if (_player_to) {
+		_set_progress(static_cast<float>(_done - _player_from) / (*_player_to - _player_from));
+	} else {
+		DCPTime const length = _playlist->length(_film);
+		_set_progress((time.seconds() - start().seconds()) / (length.seconds() - start().seconds()));
+	}
 	LOG_DEBUG_AUDIO_ANALYSIS("Frames processed");
 }
 
 
+/** Add the results of the analyser for the next part of the audio to ours.
+ *  Neither analyser should have had finish() called yet.
+ */
+void
+AudioAnalyser::append(AudioAnalyser& other)
+{
+	DCPOMATIC_ASSERT(_points_range.to && *_points_range.to == other._points_range.from);
+	DCPOMATIC_ASSERT(_leqm_range.to && *_leqm_range.to == other._leqm_range.from);
+
+	/* Our last point was finished at the end of our range, so the other analyser's points follow straight on */
+	for (int c = 0; c < other._analysis.channels(); ++c) {
+		for (int p = 0; p < other._analysis.points(c); ++p) {
+			_analysis.add_point(c, other._analysis.get_point(c, p));
+		}
+	}
+	_current = other._current;
+
+	for (size_t i = 0; i < _sample_peak.size(); ++i) {
+		/* As in analyse(), the earliest of any equal peaks wins */
+		if (other._sample_peak[i] > _sample_peak[i]) {
+			_sample_peak[i] = other._sample_peak[i];
+			_sample_peak_frame[i] = other._sample_peak_frame[i];
+		}
+	}
+
+	if (other._leqm_frames > 0) {
+		_appended_leqm.push_back({other._leqm->leq_m(), other._leqm_frames});
+	}
+	_appended_leqm.insert(_appended_leqm.end(), other._appended_leqm.begin(), other._appended_leqm.end());
+
+#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
+	if (Config::instance()->analyse_ebur128()) {
+		void* eb = other._ebur128.get("Parsed_ebur128_0")->priv;
+		_appended_true_peak.resize(_film->audio_channels(), 0);
+		for (int i = 0; i < _film->audio_channels(); ++i) {
+			_appended_true_peak[i] = max(_appended_true_peak[i], static_cast<float>(av_ebur128_get_true_peaks(eb)[i]));
+			if (i < static_cast<int>(other._appended_true_peak.size())) {
+				_appended_true_peak[i] = max(_appended_true_peak[i], other._appended_true_peak[i]);
+			}
+		}
+		_loudness.append(other._loudness);
+	}
+	_loudness_range.to = other._loudness_range.to;
+#endif
+
+	_points_range.to = other._points_range.to;
+	_leqm_range.to = other._leqm_range.to;
+	_player_to = other._player_to;
+	_done = other._done;
+}
+
+
 void
 AudioAnalyser::finish()
 {
@@ -207,11 +368,22 @@ AudioAnalyser::finish()
 		void* eb = _ebur128.get("Parsed_ebur128_0")->priv;
 		vector<float> true_peak;
 		for (int i = 0; i < _film->audio_channels(); ++i) {
-			true_peak.push_back(av_ebur128_get_true_peaks(eb)[i]);
+			float peak = av_ebur128_get_true_peaks(eb)[i];
+			if (i < static_cast<int>(_appended_true_peak.size())) {
+				peak = max(peak, _appended_true_peak[i]);
+			}
+			true_peak.push_back(peak);
 		}
 		_analysis.set_true_peak(true_peak);
-		_analysis.set_integrated_loudness(av_ebur128_get_integrated_loudness(eb));
-		_analysis.set_loudness_range(av_ebur128_get_loudness_range(eb));
+		/* These come from our own meter, rather than FFmpeg's, so that analyses of
+		 * several parts of the audio can be combined.
+		 */
+		_analysis.set_integrated_loudness(_loudness.integrated());
+		_analysis.set_loudness_range(_loudness.range());
+		if (_playlist->content().size() == 1) {
+			/* Keep the blocks so that this analysis can be combined with others by AudioAnalysis::combine() */
+			_analysis.set_loudness_blocks(_loudness.blocks());
+		}
 	}
 #endif
 
@@ -226,5 +398,25 @@ AudioAnalyser::finish()
 
 	_analysis.set_samples_per_point(_samples_per_point);
 	_analysis.set_sample_rate(_film->audio_frame_rate());
-	_analysis.set_leqm(_leqm->leq_m());
+
+	if (_appended_leqm.empty()) {
+		_analysis.set_leqm(_leqm->leq_m());
+	} else {
+		/* LEQ(m) is the log of the mean power over the whole audio (plus a constant), so combine the
+		 * parts by taking the mean of their powers, weighted by their lengths.
+		 */
+		double power = 0;
+		Frame frames = 0;
+		auto add = [&power, &frames](double leqm, Frame part_frames) {
+			power += part_frames * pow(10, leqm / 10);
+			frames += part_frames;
+		};
+		if (_leqm_frames > 0) {
+			add(_leqm->leq_m(), _leqm_frames);
+		}
+		for (auto const& part: _appended_leqm) {
+			add(part.first, part.second);
+		}
+		_analysis.set_leqm(10 * log10(power / frames));
+	}
 }
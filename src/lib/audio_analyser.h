@@ -22,8 +22,10 @@
 #include "audio_analysis.h"
 #include "audio_filter_graph.h"
 #include "dcpomatic_time.h"
+#include "loudness_meter.h"
 #include "types.h"
 #include <leqm_nrt.h>
+#include <boost/optional.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <memory>
 
@@ -41,22 +43,57 @@ class AudioAnalyser
 public:
 	AudioAnalyser(std::shared_ptr<const Film> film, std::shared_ptr<const Playlist> playlist, bool whole_film, std::function<void (float)> set_progress);
 
+	/** Make an analyser for one of a number of parts of the audio, so that the parts can be analysed at
+	 *  the same time.  The results should then be combined by calling append() on the analyser for the
+	 *  first part with each of the others, in order.
+	 *  @param part Index of this part, from 0.
+	 *  @param parts Total number of parts.
+	 */
+	AudioAnalyser(
+		std::shared_ptr<const Film> film,
+		std::shared_ptr<const Playlist> playlist,
+		bool whole_film,
+		int part,
+		int parts,
+		std::function<void (float)> set_progress
+		);
+
 	AudioAnalyser(AudioAnalyser const&) = delete;
 	AudioAnalyser& operator=(AudioAnalyser const&) = delete;
 
 	void analyse(std::shared_ptr<AudioBuffers>, dcpomatic::DCPTime time);
 
-	dcpomatic::DCPTime start() const {
-		return _start;
+	/** @return Time that audio to be passed to analyse() should start from */
+	dcpomatic::DCPTime start() const;
+
+	/** @return true if we have been given all the audio that we need */
+	bool done() const {
+		return _player_to && _done >= *_player_to;
 	}
 
+	void append(AudioAnalyser& other);
 	void finish();
 
 	AudioAnalysis get() const {
 		return _analysis;
 	}
 
+	static int64_t samples_per_point(Frame length);
+
 private:
+	/** A range of frames, counted from _start */
+	struct Range
+	{
+		Frame from = 0;
+		/** end of the range, or none to go to the end of the playlist */
+		boost::optional<Frame> to;
+
+		/** @return The part of the frames [start, start + frames) which is inside this range, as
+		 *  an offset from start and a number of frames.
+		 */
+		std::pair<int, int> overlap(Frame start, int frames) const;
+	};
+
 	std::shared_ptr<const Film> _film;
 	std::shared_ptr<const Playlist> _playlist;
 
@@ -65,12 +102,31 @@ private:
 	dcpomatic::DCPTime _start;
 #ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
 	AudioFilterGraph _ebur128;
+	LoudnessMeter _loudness;
+	/** Frames that _loudness should measure; before this we just use it to settle its filters */
+	Range _loudness_range;
+	/** Highest true peaks from any analysers that have been appended to this one */
+	std::vector<float> _appended_true_peak;
 #endif
 	std::vector<Filter> _filters;
 	Frame _samples_per_point = 1;
 
 	boost::scoped_ptr<leqm_nrt::Calculator> _leqm;
 	int _leqm_channels = 0;
+	/** Frames that should be passed to _leqm */
+	Range _leqm_range;
+	/** Number of frames that have been passed to _leqm */
+	Frame _leqm_frames = 0;
+	/** LEQ(m) and number of frames that it was measured over from any analysers that have been appended to this one */
+	std::vector<std::pair<double, Frame>> _appended_leqm;
+
+	/** Frames that we should make points and find sample peaks for */
+	Range _points_range;
+	/** Frames that we expect to be passed to analyse() */
+	Frame _player_from = 0;
+	boost::optional<Frame> _player_to;
+
+	/** Index of the next frame that analyse() will be given, counted from _start */
 	Frame _done = 0;
 	std::vector<float> _sample_peak;
 	std::vector<Frame> _sample_peak_frame;
@@ -78,4 +134,3 @@ private:
 
 	AudioAnalysis _analysis;
 };
-
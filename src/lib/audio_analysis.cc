@@ -22,18 +22,23 @@
 #include "audio_analysis.h"
 #include "audio_content.h"
 #include "cross.h"
+#include "exceptions.h"
+#include "loudness_meter.h"
 #include "playlist.h"
 #include "util.h"
+#include <dcp/file.h>
 #include <dcp/raw_convert.h>
 #include <dcp/warnings.h>
 LIBDCP_DISABLE_WARNINGS
 #include <libxml++/libxml++.h>
 LIBDCP_ENABLE_WARNINGS
 #include <fmt/format.h>
+#include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 #include <stdint.h>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <inttypes.h>
 
@@ -55,7 +60,9 @@ using dcp::raw_convert;
 using namespace dcpomatic;
 
 
-int const AudioAnalysis::_current_state_version = 3;
+int const AudioAnalysis::_current_state_version = 5;
+/** Version of the last analyses that we wrote as XML */
+static int const last_xml_version = 4;
 
 
 AudioAnalysis::AudioAnalysis (int channels)
@@ -64,12 +71,194 @@ AudioAnalysis::AudioAnalysis (int channels)
 }
 
 
+/** Magic number at the start of an analysis file in our binary format; older files are XML */
+static char const binary_magic[8] = { 'D', 'O', 'M', 'A', 'U', 'D', 'A', 'N' };
+
+
+namespace {
+
+template <class T>
+void
+write_value (dcp::File& file, T value)
+{
+	file.checked_write (&value, sizeof(T));
+}
+
+
+template <class T>
+T
+read_value (dcp::File& file)
+{
+	T value;
+	file.checked_read (&value, sizeof(T));
+	return value;
+}
+
+
+template <class T>
+void
+write_optional (dcp::File& file, optional<T> value)
+{
+	write_value<uint8_t> (file, value ? 1 : 0);
+	write_value<T> (file, value.get_value_or(0));
+}
+
+
+template <class T>
+optional<T>
+read_optional (dcp::File& file)
+{
+	auto const present = read_value<uint8_t>(file);
+	auto const value = read_value<T>(file);
+	if (!present) {
+		return {};
+	}
+	return value;
+}
+
+
+template <class T>
+void
+write_vector (dcp::File& file, vector<T> const& values)
+{
+	write_value<uint64_t> (file, values.size());
+	if (!values.empty()) {
+		file.checked_write (values.data(), values.size() * sizeof(T));
+	}
+}
+
+
+/** Throw if a file does not have room for some items between where we are and its end */
+void
+check_remaining (dcp::File& file, int64_t file_size, boost::filesystem::path filename, uint64_t items, uint64_t item_size)
+{
+	auto const remaining = file_size - file.tell();
+	if (remaining < 0 || items > static_cast<uint64_t>(remaining) / item_size) {
+		throw FileError("Audio analysis file is corrupt", filename);
+	}
+}
+
+
+template <class T>
+vector<T>
+read_vector (dcp::File& file, int64_t file_size, boost::filesystem::path filename)
+{
+	auto const count = read_value<uint64_t>(file);
+	check_remaining (file, file_size, filename, count, sizeof(T));
+	vector<T> values (count);
+	if (!values.empty()) {
+		file.checked_read (values.data(), values.size() * sizeof(T));
+	}
+	return values;
+}
+
+}
+
+
 AudioAnalysis::AudioAnalysis (boost::filesystem::path filename)
+{
+	{
+		dcp::File file (filename, "rb");
+		if (!file) {
+			throw OpenFileError (filename, file.open_error(), OpenFileError::READ);
+		}
+
+		char magic[sizeof(binary_magic)];
+		if (file.read(magic, 1, sizeof(magic)) == sizeof(magic) && memcmp(magic, binary_magic, sizeof(magic)) == 0) {
+			read_binary (file, filename);
+			return;
+		}
+	}
+
+	read_xml (filename);
+}
+
+
+/** Read the rest of a file in our binary format, after the magic number.
+ *
+ *  The file is:
+ *  - the magic number
+ *  - version (int32)
+ *  - samples per point (int64), sample rate (int32)
+ *  - integrated loudness, loudness range (optional float), leqm, analysis gain (optional double);
+ *    each optional is a uint8 which is 1 if the value is present, then the value
+ *  - sample peaks: count (uint64) then { peak (float), time (int64) } for each
+ *  - true peaks: count (uint64) then a float for each
+ *  - loudness blocks: count (uint64) then a double for each
+ *  - number of channels (uint32), then the number of points (uint64) in each channel
+ *  - padding with zeros to the next multiple of 8 bytes
+ *  - for each channel, its points as packed floats; peak then RMS for each point.
+ *
+ *  Everything is in the byte order of the machine which wrote it, and the points are aligned
+ *  and packed so that they can be read in one go (or mapped) without any parsing.
+ */
+void
+AudioAnalysis::read_binary (dcp::File& file, boost::filesystem::path filename)
+{
+	if (read_value<int32_t>(file) < _current_state_version) {
+		throw OldFormatError ("Audio analysis file is too old");
+	}
+
+	/* Check the counts that we read against the size of the file, so that a corrupt
+	 * file is reported as such rather than making us try to allocate something huge.
+	 */
+	auto const start = file.tell();
+	file.seek (0, SEEK_END);
+	auto const file_size = file.tell();
+	file.seek (start, SEEK_SET);
+
+	_samples_per_point = read_value<int64_t>(file);
+	_sample_rate = read_value<int32_t>(file);
+	_integrated_loudness = read_optional<float>(file);
+	_loudness_range = read_optional<float>(file);
+	_leqm = read_optional<double>(file);
+	_analysis_gain = read_optional<double>(file);
+
+	auto const sample_peaks = read_value<uint64_t>(file);
+	check_remaining (file, file_size, filename, sample_peaks, sizeof(float) + sizeof(int64_t));
+	for (uint64_t i = 0; i < sample_peaks; ++i) {
+		auto const peak = read_value<float>(file);
+		auto const time = read_value<int64_t>(file);
+		_sample_peak.push_back (PeakTime(peak, DCPTime(time)));
+	}
+
+	_true_peak = read_vector<float>(file, file_size, filename);
+	_loudness_blocks = read_vector<double>(file, file_size, filename);
+
+	auto const channels = read_value<uint32_t>(file);
+	check_remaining (file, file_size, filename, channels, sizeof(uint64_t));
+	_data.resize (channels);
+	vector<uint64_t> points;
+	for (size_t i = 0; i < _data.size(); ++i) {
+		points.push_back (read_value<uint64_t>(file));
+	}
+
+	file.seek ((file.tell() + 7) & ~int64_t(7), SEEK_SET);
+
+	vector<float> buffer;
+	for (size_t i = 0; i < _data.size(); ++i) {
+		check_remaining (file, file_size, filename, points[i], AudioPoint::COUNT * sizeof(float));
+		buffer.resize (points[i] * AudioPoint::COUNT);
+		if (!buffer.empty()) {
+			file.checked_read (buffer.data(), buffer.size() * sizeof(float));
+		}
+		_data[i].resize (points[i]);
+		for (uint64_t j = 0; j < points[i]; ++j) {
+			_data[i][j][AudioPoint::PEAK] = buffer[j * AudioPoint::COUNT + AudioPoint::PEAK];
+			_data[i][j][AudioPoint::RMS] = buffer[j * AudioPoint::COUNT + AudioPoint::RMS];
+		}
+	}
+}
+
+
+/** Read an analysis file in the XML format that we used before the binary one */
+void
+AudioAnalysis::read_xml (boost::filesystem::path filename)
 {
 	cxml::Document f ("AudioAnalysis");
 	f.read_file(dcp::filesystem::fix_long_path(filename));
 
-	if (f.optional_number_child<int>("Version").get_value_or(1) < _current_state_version) {
+	if (f.optional_number_child<int>("Version").get_value_or(1) < last_xml_version) {
 		/* Too old.  Throw an exception so that this analysis is re-run. */
 		throw OldFormatError ("Audio analysis file is too old");
 	}
@@ -101,6 +290,16 @@ AudioAnalysis::AudioAnalysis (boost::filesystem::path filename)
 	_sample_rate = f.number_child<int64_t>("SampleRate");
 
 	_leqm = f.optional_number_child<double>("Leqm");
+
+	if (auto blocks = f.optional_string_child("LoudnessBlocks")) {
+		vector<string> parts;
+		boost::algorithm::split(parts, *blocks, boost::is_any_of(" "), boost::token_compress_on);
+		for (auto const& i: parts) {
+			if (!i.empty()) {
+				_loudness_blocks.push_back(dcp::raw_convert<double>(i));
+			}
+		}
+	}
 }
 
 
@@ -135,51 +334,53 @@ AudioAnalysis::points (int c) const
 }
 
 
+/** Write this analysis in our binary format; see read_binary() for details */
 void
 AudioAnalysis::write (boost::filesystem::path filename)
 {
-	auto doc = make_shared<xmlpp::Document>();
-	auto root = doc->create_root_node("AudioAnalysis");
-
-	cxml::add_text_child(root, "Version", fmt::to_string(_current_state_version));
-
-	for (auto& i: _data) {
-		auto channel = cxml::add_child(root, "Channel");
-		for (auto& j: i) {
-			j.as_xml(cxml::add_child(channel, "Point"));
-		}
-	}
-
-	for (size_t i = 0; i < _sample_peak.size(); ++i) {
-		auto n = cxml::add_child(root, "SamplePeak");
-		n->add_child_text(fmt::to_string(_sample_peak[i].peak));
-		n->set_attribute("time", fmt::to_string(_sample_peak[i].time.get()));
+	dcp::File file (filename, "wb");
+	if (!file) {
+		throw OpenFileError (filename, file.open_error(), OpenFileError::WRITE);
 	}
 
-	for (auto i: _true_peak) {
-		cxml::add_text_child(root, "TruePeak", fmt::to_string(i));
+	file.checked_write (binary_magic, sizeof(binary_magic));
+	write_value<int32_t> (file, _current_state_version);
+	write_value<int64_t> (file, _samples_per_point);
+	write_value<int32_t> (file, _sample_rate);
+	write_optional<float> (file, _integrated_loudness);
+	write_optional<float> (file, _loudness_range);
+	write_optional<double> (file, _leqm);
+	write_optional<double> (file, _analysis_gain);
+
+	write_value<uint64_t> (file, _sample_peak.size());
+	for (auto const& i: _sample_peak) {
+		write_value<float> (file, i.peak);
+		write_value<int64_t> (file, i.time.get());
 	}
 
-	if (_integrated_loudness) {
-		cxml::add_text_child(root, "IntegratedLoudness", fmt::to_string(_integrated_loudness.get()));
-	}
+	write_vector (file, _true_peak);
+	write_vector (file, _loudness_blocks);
 
-	if (_loudness_range) {
-		cxml::add_text_child(root, "LoudnessRange", fmt::to_string(_loudness_range.get()));
+	write_value<uint32_t> (file, _data.size());
+	for (auto const& i: _data) {
+		write_value<uint64_t> (file, i.size());
 	}
 
-	if (_analysis_gain) {
-		cxml::add_text_child(root, "AnalysisGain", fmt::to_string(_analysis_gain.get()));
+	while (file.tell() % 8) {
+		write_value<uint8_t> (file, 0);
 	}
 
-	cxml::add_text_child(root, "SamplesPerPoint", fmt::to_string(_samples_per_point));
-	cxml::add_text_child(root, "SampleRate", fmt::to_string(_sample_rate));
-
-	if (_leqm) {
-		cxml::add_text_child(root, "Leqm", fmt::to_string(*_leqm));
+	vector<float> buffer;
+	for (auto const& i: _data) {
+		buffer.clear ();
+		for (auto j: i) {
+			buffer.push_back (j[AudioPoint::PEAK]);
+			buffer.push_back (j[AudioPoint::RMS]);
+		}
+		if (!buffer.empty()) {
+			file.checked_write (buffer.data(), buffer.size() * sizeof(float));
+		}
 	}
-
-	doc->write_to_file_formatted (filename.string ());
 }
 
 
@@ -233,3 +434,132 @@ AudioAnalysis::overall_true_peak () const
 	return p;
 }
 
+
+
+/** Make an analysis of some audio from analyses of non-overlapping parts of it, made by AudioAnalyser.
+ *  Anything not covered by a part is taken to be silent.  Points which span the edges of parts, and
+ *  loudness blocks, are approximated; everything else is as if the audio had been analysed in one go.
+ *  @param parts Parts, in order of position.
+ *  @param length Length of the audio, in frames.
+ *  @param samples_per_point Samples per point that AudioAnalyser would use for audio of this length.
+ */
+AudioAnalysis
+AudioAnalysis::combine (vector<Part> const& parts, int channels, int sample_rate, Frame length, int64_t samples_per_point)
+{
+	AudioAnalysis combined (channels);
+	combined.set_samples_per_point (samples_per_point);
+	combined.set_sample_rate (sample_rate);
+
+	/* AudioAnalyser makes a point at frame 0 and then every samples_per_point frames after that */
+	Frame const points = length > 0 ? (length - 1) / samples_per_point + 1 : 0;
+	auto point_start = [](Frame point, int64_t spp) -> Frame {
+		return point == 0 ? 0 : (point - 1) * spp + 1;
+	};
+	auto point_index = [](Frame frame, int64_t spp) -> Frame {
+		return frame == 0 ? 0 : (frame - 1) / spp + 1;
+	};
+
+	/* AudioAnalyser counts silence as this, to avoid infinities */
+	double const silence = 10e-7;
+
+	/* Sum of squares of the samples in each point of each channel, and peak in each */
+	vector<vector<double>> energy (channels);
+	vector<vector<float>> peak (channels);
+	for (int c = 0; c < channels; ++c) {
+		for (Frame p = 0; p < points; ++p) {
+			auto const frames = std::min(samples_per_point, length - point_start(p, samples_per_point));
+			energy[c].push_back (frames * silence * silence);
+			peak[c].push_back (silence);
+		}
+	}
+
+	vector<PeakTime> sample_peak (channels, PeakTime(0, DCPTime()));
+	vector<float> true_peak (channels, 0);
+	bool all_true_peak = true;
+	double leqm_power = 0;
+	bool all_leqm = true;
+	LoudnessMeter loudness (sample_rate, channels);
+	bool all_loudness = true;
+
+	for (auto const& part: parts) {
+		auto const& analysis = *part.analysis;
+		auto const linear_gain = pow (10, part.gain / 20);
+		auto const spp = analysis.samples_per_point ();
+
+		for (int c = 0; c < std::min(channels, analysis.channels()); ++c) {
+			for (int i = 0; i < analysis.points(c); ++i) {
+				auto point = analysis.get_point (c, i);
+				/* Frames that this point covers in the combined analysis */
+				auto const first = part.position + point_start(i, spp);
+				auto const last = part.position + (i == 0 ? 0 : i * spp);
+				/* AudioAnalyser divides the sum of squares by samples_per_point, even for the first point */
+				auto const per_frame = pow (point[AudioPoint::RMS] * linear_gain, 2) * spp / (last - first + 1);
+				for (auto p = point_index(first, samples_per_point); p <= std::min(point_index(last, samples_per_point), points - 1); ++p) {
+					auto const start = point_start (p, samples_per_point);
+					auto const end = point_start (p + 1, samples_per_point) - 1;
+					auto const overlap = std::min(last, end) - max(first, start) + 1;
+					energy[c][p] += overlap * (per_frame - silence * silence);
+					peak[c][p] = max (peak[c][p], static_cast<float>(point[AudioPoint::PEAK] * linear_gain));
+				}
+			}
+		}
+
+		auto const part_sample_peak = analysis.sample_peak ();
+		for (int c = 0; c < std::min(channels, static_cast<int>(part_sample_peak.size())); ++c) {
+			auto const p = static_cast<float>(part_sample_peak[c].peak * linear_gain);
+			if (p > sample_peak[c].peak) {
+				sample_peak[c] = PeakTime (p, part_sample_peak[c].time + DCPTime::from_frames(part.position, sample_rate));
+			}
+		}
+
+		auto const part_true_peak = analysis.true_peak ();
+		if (static_cast<int>(part_true_peak.size()) >= channels) {
+			for (int c = 0; c < channels; ++c) {
+				true_peak[c] = max (true_peak[c], static_cast<float>(part_true_peak[c] * linear_gain));
+			}
+		} else {
+			all_true_peak = false;
+		}
+
+		if (analysis.leqm()) {
+			if (std::isfinite(*analysis.leqm())) {
+				leqm_power += part.length * pow (10, (*analysis.leqm() + part.gain) / 10);
+			}
+		} else {
+			all_leqm = false;
+		}
+
+		if (analysis.integrated_loudness()) {
+			loudness.mix (analysis.loudness_blocks(), static_cast<int>(std::round(static_cast<double>(part.position) / loudness.block_frames())), linear_gain);
+		} else {
+			all_loudness = false;
+		}
+	}
+
+	for (int c = 0; c < channels; ++c) {
+		for (Frame p = 0; p < points; ++p) {
+			AudioPoint point;
+			point[AudioPoint::RMS] = sqrt (energy[c][p] / samples_per_point);
+			point[AudioPoint::PEAK] = peak[c][p];
+			combined.add_point (c, point);
+		}
+	}
+
+	combined.set_sample_peak (sample_peak);
+
+	if (all_true_peak && !parts.empty()) {
+		combined.set_true_peak (true_peak);
+	}
+
+	if (all_leqm && !parts.empty() && length > 0) {
+		/* LEQ(m) is the log of the mean power, and silence has none */
+		combined.set_leqm (10 * log10(leqm_power / length));
+	}
+
+	if (all_loudness && !parts.empty()) {
+		combined.set_integrated_loudness (loudness.integrated());
+		combined.set_loudness_range (loudness.range());
+	}
+
+	return combined;
+}
@@ -25,12 +25,17 @@
 
 #include "dcpomatic_time.h"
 #include "audio_point.h"
+#include "types.h"
 #include <libcxml/cxml.h>
 #include <boost/optional.hpp>
 #include <boost/filesystem.hpp>
 #include <vector>
 
 
+namespace dcp {
+	class File;
+}
+
 namespace xmlpp {
 	class Element;
 }
@@ -129,17 +134,44 @@ public:
 		return _leqm;
 	}
 
+	/** @param blocks Energy in each block measured by a LoudnessMeter */
+	void set_loudness_blocks (std::vector<double> blocks) {
+		_loudness_blocks = blocks;
+	}
+
+	std::vector<double> const& loudness_blocks () const {
+		return _loudness_blocks;
+	}
+
 	void write (boost::filesystem::path);
 
 	float gain_correction (std::shared_ptr<const Playlist> playlist);
 
+	/** An analysis of some audio which is to be combined with others by combine() */
+	struct Part
+	{
+		std::shared_ptr<const AudioAnalysis> analysis;
+		/** Position of the analysed audio in the combined analysis, in frames */
+		Frame position;
+		/** Length of the analysed audio, in frames */
+		Frame length;
+		/** Gain to apply to the analysed audio, in dB */
+		double gain;
+	};
+
+	static AudioAnalysis combine (std::vector<Part> const& parts, int channels, int sample_rate, Frame length, int64_t samples_per_point);
+
 private:
+	void read_binary (dcp::File& file, boost::filesystem::path filename);
+	void read_xml (boost::filesystem::path filename);
+
 	std::vector<std::vector<AudioPoint>> _data;
 	std::vector<PeakTime> _sample_peak;
 	std::vector<float> _true_peak;
 	boost::optional<float> _integrated_loudness;
 	boost::optional<float> _loudness_range;
 	boost::optional<double> _leqm;
+	std::vector<double> _loudness_blocks;
 	/** If this analysis was run on a single piece of
 	 *  content we store its gain in dB when the analysis
 	 *  happened.
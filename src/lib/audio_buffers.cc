@@ -22,14 +22,133 @@
 #include "audio_buffers.h"
 #include "dcpomatic_assert.h"
 #include "maths_util.h"
-#include <dcp/scope_guard.h>
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 #include <cmath>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DCPOMATIC_AUDIO_BUFFERS_X86 1
+#include <immintrin.h>
+#endif
+
 
 using std::shared_ptr;
 using std::make_shared;
+using std::string;
+using std::vector;
+
+
+/* The kernels must give exactly the same results as each other, so none of them use
+ * fused multiply-adds, and gain is applied in double precision as the scalar version does.
+ */
+
+
+static
+void
+accumulate_scalar(float* d, float const* s, int frames)
+{
+	for (int i = 0; i < frames; ++i) {
+		d[i] += s[i];
+	}
+}
+
+
+static
+void
+accumulate_with_gain_scalar(float* d, float const* s, int frames, float gain)
+{
+	for (int i = 0; i < frames; ++i) {
+		d[i] += s[i] * gain;
+	}
+}
+
+
+static
+void
+apply_gain_scalar(float* d, int frames, double gain)
+{
+	for (int i = 0; i < frames; ++i) {
+		d[i] *= gain;
+	}
+}
+
+
+#ifdef DCPOMATIC_AUDIO_BUFFERS_X86
+
+
+__attribute__((target("avx2")))
+static
+void
+accumulate_avx2(float* d, float const* s, int frames)
+{
+	int i = 0;
+	for (; i <= frames - 8; i += 8) {
+		_mm256_storeu_ps(d + i, _mm256_add_ps(_mm256_loadu_ps(d + i), _mm256_loadu_ps(s + i)));
+	}
+	accumulate_scalar(d + i, s + i, frames - i);
+}
+
+
+__attribute__((target("avx2")))
+static
+void
+accumulate_with_gain_avx2(float* d, float const* s, int frames, float gain)
+{
+	auto const g = _mm256_set1_ps(gain);
+	int i = 0;
+	for (; i <= frames - 8; i += 8) {
+		auto const product = _mm256_mul_ps(_mm256_loadu_ps(s + i), g);
+		_mm256_storeu_ps(d + i, _mm256_add_ps(_mm256_loadu_ps(d + i), product));
+	}
+	accumulate_with_gain_scalar(d + i, s + i, frames - i, gain);
+}
+
+
+__attribute__((target("avx2")))
+static
+void
+apply_gain_avx2(float* d, int frames, double gain)
+{
+	auto const g = _mm256_set1_pd(gain);
+	int i = 0;
+	for (; i <= frames - 8; i += 8) {
+		auto const in = _mm256_loadu_ps(d + i);
+		auto const low = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(in)), g));
+		auto const high = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(in, 1)), g));
+		_mm256_storeu_ps(d + i, _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1));
+	}
+	apply_gain_scalar(d + i, frames - i, gain);
+}
+
+
+#endif
+
+
+static
+AudioBuffers::Kernel
+best_kernel()
+{
+#ifdef DCPOMATIC_AUDIO_BUFFERS_X86
+	if (__builtin_cpu_supports("avx2")) {
+		return AudioBuffers::Kernel::AVX2;
+	}
+#endif
+	return AudioBuffers::Kernel::SCALAR;
+}
+
+
+std::atomic<AudioBuffers::Kernel> AudioBuffers::_kernel(best_kernel());
+
+
+/** @return frames rounded up to a multiple of 8, so that each channel starts 32-byte aligned */
+static
+int
+round_up_stride(int frames)
+{
+	return (frames + 7) & ~7;
+}
 
 
 /** Construct a silent AudioBuffers */
@@ -77,18 +196,62 @@ AudioBuffers::operator=(AudioBuffers const & other)
 }
 
 
+/** Throw away any existing data and make space for some silent frames */
 void
 AudioBuffers::allocate(int channels, int frames)
 {
 	DCPOMATIC_ASSERT(frames >= 0);
 	DCPOMATIC_ASSERT(frames == 0 || channels > 0);
 
-	dcp::ScopeGuard sg = [this]() { update_data_pointers(); };
+	_channels = 0;
+	_frames = 0;
+	reallocate(channels, round_up_stride(frames));
+	_frames = frames;
+	update_data_pointers();
+}
+
 
-	_data.resize(channels);
-	for (int channel = 0; channel < channels; ++channel) {
-		_data[channel].resize(frames);
+/** Move our data into a new allocation, keeping as much of the existing data as will fit.
+ *  Any space that is not filled with existing data is made silent.  Caller must call
+ *  update_data_pointers() afterwards.
+ *  @param channels New channel count.
+ *  @param stride New space for each channel, in frames; must be a multiple of 8.
+ */
+void
+AudioBuffers::reallocate(int channels, int stride)
+{
+	DCPOMATIC_ASSERT(stride % 8 == 0);
+
+	auto const size = static_cast<size_t>(channels) * stride;
+	std::unique_ptr<float[]> storage;
+	float* base = nullptr;
+	if (size > 0) {
+		/* Extra 8 floats so that we can align the start */
+		storage.reset(new float[size + 8]);
+		base = reinterpret_cast<float*>((reinterpret_cast<uintptr_t>(storage.get()) + 31) & ~static_cast<uintptr_t>(31));
 	}
+
+	auto const frames_to_keep = std::min(_frames, stride);
+	auto const channels_to_keep = std::min(_channels, channels);
+
+	for (int channel = 0; base && channel < channels; ++channel) {
+		auto to = base + static_cast<size_t>(channel) * stride;
+		int silence_from = 0;
+		if (channel < channels_to_keep && frames_to_keep > 0) {
+			memcpy(to, _base + static_cast<size_t>(channel) * _stride + _offset, frames_to_keep * sizeof(float));
+			silence_from = frames_to_keep;
+		}
+		/* This isn't really allowed, as all-bits-0 is not guaranteed to mean a 0 float,
+		   but it seems that we can get away with it.
+		*/
+		memset(to + silence_from, 0, (stride - silence_from) * sizeof(float));
+	}
+
+	_storage = std::move(storage);
+	_base = base;
+	_channels = channels;
+	_stride = stride;
+	_offset = 0;
 }
 
 
@@ -99,7 +262,7 @@ float*
 AudioBuffers::data(int channel)
 {
 	DCPOMATIC_ASSERT(channel >= 0 && channel < channels());
-	return _data[channel].data();
+	return _data_pointers[channel];
 }
 
 
@@ -110,15 +273,28 @@ float const*
 AudioBuffers::data(int channel) const
 {
 	DCPOMATIC_ASSERT(channel >= 0 && channel < channels());
-	return _data[channel].data();
+	return _data_pointers[channel];
 }
 
 
-/** Set the number of frames in these AudioBuffers */
+/** Set the number of frames in these AudioBuffers.  Any new frames will be silent. */
 void
 AudioBuffers::set_frames(int frames)
 {
-	allocate(_data.size(), frames);
+	DCPOMATIC_ASSERT(frames >= 0);
+	DCPOMATIC_ASSERT(frames == 0 || _channels > 0);
+
+	if (_offset + frames > _stride) {
+		/* Leave some room so that repeated append()s don't each need to reallocate */
+		reallocate(_channels, round_up_stride(frames + frames / 2));
+	}
+
+	for (int channel = 0; channel < _channels && frames > _frames; ++channel) {
+		memset(_base + static_cast<size_t>(channel) * _stride + _offset + _frames, 0, (frames - _frames) * sizeof(float));
+	}
+
+	_frames = frames;
+	update_data_pointers();
 }
 
 
@@ -230,8 +406,17 @@ AudioBuffers::accumulate_channel(AudioBuffers const * from, int from_channel, in
 	auto s = from->data(from_channel);
 	auto d = data(to_channel);
 
-	for (int i = 0; i < N; ++i) {
-		*d++ += (*s++) * gain;
+	switch (_kernel) {
+	case Kernel::SCALAR:
+		accumulate_with_gain_scalar(d, s, N, gain);
+		break;
+#ifdef DCPOMATIC_AUDIO_BUFFERS_X86
+	case Kernel::AVX2:
+		accumulate_with_gain_avx2(d, s, N, gain);
+		break;
+#endif
+	default:
+		DCPOMATIC_ASSERT(false);
 	}
 }
 
@@ -249,10 +434,20 @@ AudioBuffers::accumulate_frames(AudioBuffers const * from, int frames, int read_
 	DCPOMATIC_ASSERT(read_offset >= 0);
 	DCPOMATIC_ASSERT(write_offset >= 0);
 
-	auto from_data = from->data();
 	for (int i = 0; i < channels(); ++i) {
-		for (int j = 0; j < frames; ++j) {
-			_data[i][j + write_offset] += from_data[i][j + read_offset];
+		auto s = from->data(i) + read_offset;
+		auto d = data(i) + write_offset;
+		switch (_kernel) {
+		case Kernel::SCALAR:
+			accumulate_scalar(d, s, frames);
+			break;
+#ifdef DCPOMATIC_AUDIO_BUFFERS_X86
+		case Kernel::AVX2:
+			accumulate_avx2(d, s, frames);
+			break;
+#endif
+		default:
+			DCPOMATIC_ASSERT(false);
 		}
 	}
 }
@@ -265,8 +460,17 @@ AudioBuffers::apply_gain(float dB)
 	auto const linear = db_to_linear(dB);
 
 	for (int i = 0; i < channels(); ++i) {
-		for (int j = 0; j < frames(); ++j) {
-			_data[i][j] *= linear;
+		switch (_kernel) {
+		case Kernel::SCALAR:
+			apply_gain_scalar(data(i), frames(), linear);
+			break;
+#ifdef DCPOMATIC_AUDIO_BUFFERS_X86
+		case Kernel::AVX2:
+			apply_gain_avx2(data(i), frames(), linear);
+			break;
+#endif
+		default:
+			DCPOMATIC_ASSERT(false);
 		}
 	}
 }
@@ -320,19 +524,23 @@ AudioBuffers::append(shared_ptr<const AudioBuffers> other)
 void
 AudioBuffers::trim_start(int frames_to_trim)
 {
-	DCPOMATIC_ASSERT(frames_to_trim <= frames());
-	move(frames() - frames_to_trim, frames_to_trim, 0);
-	set_frames(frames() - frames_to_trim);
+	DCPOMATIC_ASSERT(frames_to_trim >= 0 && frames_to_trim <= frames());
+	_offset += frames_to_trim;
+	_frames -= frames_to_trim;
+	if (_frames == 0) {
+		_offset = 0;
+	}
+	update_data_pointers();
 }
 
 
 void
 AudioBuffers::update_data_pointers()
 {
-        _data_pointers.resize(channels());
-        for (int i = 0; i < channels(); ++i) {
-                _data_pointers[i] = _data[i].data();
-        }
+	_data_pointers.resize(channels());
+	for (int i = 0; i < channels(); ++i) {
+		_data_pointers[i] = _base + static_cast<size_t>(i) * _stride + _offset;
+	}
 }
 
 
@@ -344,13 +552,48 @@ AudioBuffers::set_channels(int new_channels)
 {
 	DCPOMATIC_ASSERT(new_channels > 0);
 
-	dcp::ScopeGuard sg = [this]() { update_data_pointers(); };
+	if (new_channels > _channels) {
+		reallocate(new_channels, _stride);
+	} else {
+		_channels = new_channels;
+	}
+
+	update_data_pointers();
+}
+
+
+void
+AudioBuffers::set_kernel(Kernel kernel)
+{
+	auto const supported = supported_kernels();
+	DCPOMATIC_ASSERT(std::find(supported.begin(), supported.end(), kernel) != supported.end());
+	_kernel = kernel;
+}
 
-	int const old_channels = channels();
-	_data.resize(new_channels);
 
-	for (int channel = old_channels; channel < new_channels; ++channel) {
-		_data[channel].resize(frames());
+vector<AudioBuffers::Kernel>
+AudioBuffers::supported_kernels()
+{
+	vector<Kernel> kernels = { Kernel::SCALAR };
+#ifdef DCPOMATIC_AUDIO_BUFFERS_X86
+	if (__builtin_cpu_supports("avx2")) {
+		kernels.push_back(Kernel::AVX2);
+	}
+#endif
+	return kernels;
+}
+
+
+string
+AudioBuffers::kernel_name(Kernel kernel)
+{
+	switch (kernel) {
+	case Kernel::SCALAR:
+		return "scalar";
+	case Kernel::AVX2:
+		return "AVX2";
+	default:
+		DCPOMATIC_ASSERT(false);
 	}
 }
 
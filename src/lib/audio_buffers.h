@@ -28,12 +28,18 @@
 #define DCPOMATIC_AUDIO_BUFFERS_H
 
 
+#include <atomic>
 #include <memory>
+#include <string>
 #include <vector>
 
 
 /** @class AudioBuffers
  *  @brief A class to hold multi-channel audio data in float format.
+ *
+ *  All the channels are kept in one allocation, one after the other, with some space
+ *  at the end of each so that append() does not usually need to reallocate.  trim_start()
+ *  just moves the start of each channel along.
  */
 class AudioBuffers
 {
@@ -56,11 +62,11 @@ public:
 	float* data(int);
 
 	int channels() const {
-		return _data.size();
+		return _channels;
 	}
 
 	int frames() const {
-		return _data.empty() ? 0 : _data[0].size();
+		return _frames;
 	}
 
 	void set_frames(int f);
@@ -81,14 +87,35 @@ public:
 	void append(std::shared_ptr<const AudioBuffers> other);
 	void trim_start(int frames);
 
+	enum class Kernel {
+		SCALAR,
+		AVX2
+	};
+
+	/** Set the kernel to use for mixing and gain; this is only really useful for tests and benchmarks */
+	static void set_kernel(Kernel kernel);
+	static std::vector<Kernel> supported_kernels();
+	static std::string kernel_name(Kernel kernel);
+
 private:
 	void allocate(int channels, int frames);
+	void reallocate(int channels, int stride);
 	void update_data_pointers();
 
-	/** Audio data (so that, e.g. _data[2][6] is channel 2, sample 6) */
-	std::vector<std::vector<float>> _data;
-	/** Pointers to the data of each vector in _data */
+	int _channels = 0;
+	int _frames = 0;
+	/** Number of frames that have been trimmed from the start of each channel */
+	int _offset = 0;
+	/** Number of frames of space for each channel; always a multiple of 8 */
+	int _stride = 0;
+	/** Memory for all the channels */
+	std::unique_ptr<float[]> _storage;
+	/** 32-byte-aligned start of _storage; channel c starts at _base + c * _stride + _offset */
+	float* _base = nullptr;
+	/** Pointers to the start of each channel's data */
 	std::vector<float*> _data_pointers;
+
+	static std::atomic<Kernel> _kernel;
 };
 
 
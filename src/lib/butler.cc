@@ -20,11 +20,14 @@
 
 
 #include "butler.h"
+#include "config.h"
 #include "cross.h"
 #include "dcpomatic_log.h"
 #include "exceptions.h"
+#include "image_buffer_pool.h"
 #include "log.h"
 #include "player.h"
+#include "trace.h"
 #include "util.h"
 #include "video_content.h"
 
@@ -87,6 +90,8 @@ Butler::Butler(
 	, _fast(fast)
 	, _prepare_only_proxy(prepare_only_proxy)
 {
+	ImageBufferPool::instance()->set_limit(static_cast<size_t>(Config::instance()->image_buffer_pool_size()) * 1024 * 1024);
+
 	_player_video_connection = _player.Video.connect(bind(&Butler::video, this, _1, _2));
 	_player_audio_connection = _player.Audio.connect(bind(&Butler::audio, this, _1, _2, _3));
 	_player_text_connection = _player.Text.connect(bind(&Butler::text, this, _1, _2, _3, _4));
@@ -325,6 +330,7 @@ try
 	auto video = weak_video.lock();
 	/* If the weak_ptr cannot be locked the video obviously no longer requires any work */
 	if (video) {
+		Trace::Span span("Butler::prepare");
 		LOG_TIMING("start-prepare in {}", thread_id());
 		video->prepare(_pixel_format, _video_range, _alignment, _fast, _prepare_only_proxy);
 		LOG_TIMING("finish-prepare in {}", thread_id());
@@ -399,7 +405,12 @@ pair<size_t, string>
 Butler::memory_used() const
 {
 	/* XXX: should also look at _audio.memory_used() */
-	return _video.memory_used();
+	auto video = _video.memory_used();
+	auto const pool = ImageBufferPool::instance()->statistics();
+	return make_pair(
+		video.first + pool.held,
+		fmt::format("{}; {}MB of image buffers kept for re-use ({} hits, {} misses)", video.second, pool.held / (1024 * 1024), pool.hits, pool.misses)
+		);
 }
 
 
@@ -20,6 +20,7 @@
 
 
 #include "check_content_job.h"
+#include "check_content_length_job.h"
 #include "content.h"
 #include "dcp_content.h"
 #include "examine_content_job.h"
@@ -37,6 +38,7 @@ using std::dynamic_pointer_cast;
 using std::make_shared;
 using std::shared_ptr;
 using std::string;
+using std::vector;
 
 
 CheckContentJob::CheckContentJob(shared_ptr<const Film> film)
@@ -95,6 +97,18 @@ CheckContentJob::run()
 		}
 	}
 
+	vector<shared_ptr<FFmpegContent>> fast;
+	for (auto c: content) {
+		auto ffmpeg = dynamic_pointer_cast<FFmpegContent>(c);
+		if (ffmpeg && ffmpeg->examined_with_fast_path() && !ffmpeg->changed()) {
+			fast.push_back(ffmpeg);
+		}
+	}
+	if (!fast.empty()) {
+		/* Check the lengths that we found using containers' indices, after anything else that is waiting */
+		JobManager::instance()->add(make_shared<CheckContentLengthJob>(_film, fast));
+	}
+
 	set_progress(1);
 	set_state(FINISHED_OK);
 }
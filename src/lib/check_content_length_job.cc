@@ -0,0 +1,72 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "check_content_length_job.h"
+#include "ffmpeg_content.h"
+
+#include "i18n.h"
+
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+
+CheckContentLengthJob::CheckContentLengthJob(shared_ptr<const Film> film, vector<shared_ptr<FFmpegContent>> content)
+	: Job(film)
+	, _content(std::move(content))
+{
+
+}
+
+
+CheckContentLengthJob::~CheckContentLengthJob()
+{
+	stop_thread();
+}
+
+
+string
+CheckContentLengthJob::name() const
+{
+	return _("Checking content length");
+}
+
+
+string
+CheckContentLengthJob::json_name() const
+{
+	return N_("check_content_length");
+}
+
+
+void
+CheckContentLengthJob::run()
+{
+	int n = 0;
+	for (auto c: _content) {
+		c->check_length(shared_from_this());
+		++n;
+		set_progress(float(n) / _content.size());
+	}
+	set_progress(1);
+	set_state(FINISHED_OK);
+}
@@ -0,0 +1,44 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "job.h"
+
+
+class FFmpegContent;
+
+
+/** @class CheckContentLengthJob
+ *  @brief A job to read the whole of some content whose length was found using its container's
+ *  index, to make sure that the index was right.
+ */
+class CheckContentLengthJob : public Job
+{
+public:
+	CheckContentLengthJob(std::shared_ptr<const Film> film, std::vector<std::shared_ptr<FFmpegContent>> content);
+	~CheckContentLengthJob();
+
+	std::string name() const override;
+	std::string json_name() const override;
+	void run() override;
+
+private:
+	std::vector<std::shared_ptr<FFmpegContent>> _content;
+};
@@ -161,6 +161,11 @@ Config::set_defaults()
 	   use about 240Mb with 72 encoding threads.
 	*/
 	_frames_in_memory_multiplier = 3;
+	_image_buffer_pool_size = 1024;
+	_ffmpeg_decode_threads = 0;
+	_ffmpeg_read_ahead = true;
+	_j2k_frame_cache_directory = boost::none;
+	_j2k_frame_cache_size = 100;
 	_decode_reduction = optional<int>();
 	_default_notify = false;
 	for (int i = 0; i < NOTIFICATION_COUNT; ++i) {
@@ -566,6 +571,11 @@ try
 		}
 	}
 	_frames_in_memory_multiplier = f.optional_number_child<int>("FramesInMemoryMultiplier").get_value_or(3);
+	_image_buffer_pool_size = f.optional_number_child<int>("ImageBufferPoolSize").get_value_or(1024);
+	_ffmpeg_decode_threads = f.optional_number_child<int>("FFmpegDecodeThreads").get_value_or(0);
+	_ffmpeg_read_ahead = f.optional_bool_child("FFmpegReadAhead").get_value_or(true);
+	_j2k_frame_cache_directory = f.optional_string_child("J2KFrameCacheDirectory");
+	_j2k_frame_cache_size = f.optional_number_child<int>("J2KFrameCacheSize").get_value_or(100);
 	_decode_reduction = f.optional_number_child<int>("DecodeReduction");
 	_default_notify = f.optional_bool_child("DefaultNotify").get_value_or(false);
 
@@ -1001,6 +1011,24 @@ Config::write_config() const
 	   frames to be held in memory at once.
 	*/
 	cxml::add_text_child(root, "FramesInMemoryMultiplier", fmt::to_string(_frames_in_memory_multiplier));
+	/* [XML] ImageBufferPoolSize maximum size, in megabytes, of image memory to keep for re-use rather than
+	   freeing it when images are destroyed.
+	*/
+	cxml::add_text_child(root, "ImageBufferPoolSize", fmt::to_string(_image_buffer_pool_size));
+	/* [XML] FFmpegDecodeThreads number of threads to use when decoding video with FFmpeg, or 0 to choose
+	   automatically from the video size and the number of CPUs.
+	*/
+	cxml::add_text_child(root, "FFmpegDecodeThreads", fmt::to_string(_ffmpeg_decode_threads));
+	/* [XML] FFmpegReadAhead 1 to read packets from FFmpeg content in a separate thread, ahead of decoding them. */
+	cxml::add_text_child(root, "FFmpegReadAhead", _ffmpeg_read_ahead ? "1" : "0");
+	if (_j2k_frame_cache_directory) {
+		/* [XML:opt] J2KFrameCacheDirectory directory in which to keep encoded JPEG2000 frames so that they can be
+		   re-used by any film which would encode exactly the same frame.
+		*/
+		cxml::add_text_child(root, "J2KFrameCacheDirectory", _j2k_frame_cache_directory->string());
+	}
+	/* [XML] J2KFrameCacheSize maximum size of the JPEG2000 frame cache, in gigabytes. */
+	cxml::add_text_child(root, "J2KFrameCacheSize", fmt::to_string(_j2k_frame_cache_size));
 
 	/* [XML] DecodeReduction power of 2 to reduce DCP images by before decoding in the player. */
 	if (_decode_reduction) {
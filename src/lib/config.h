@@ -486,6 +486,30 @@ public:
 		return _frames_in_memory_multiplier;
 	}
 
+	/** @return maximum size of the image buffer pool in megabytes */
+	int image_buffer_pool_size() const {
+		return _image_buffer_pool_size;
+	}
+
+	/** @return number of threads to decode FFmpeg video with, or 0 to choose automatically */
+	int ffmpeg_decode_threads() const {
+		return _ffmpeg_decode_threads;
+	}
+
+	bool ffmpeg_read_ahead() const {
+		return _ffmpeg_read_ahead;
+	}
+
+	/** @return directory to keep encoded JPEG2000 frames in for re-use, or none to not keep them */
+	boost::optional<boost::filesystem::path> j2k_frame_cache_directory() const {
+		return _j2k_frame_cache_directory;
+	}
+
+	/** @return maximum size of the JPEG2000 frame cache in gigabytes */
+	int j2k_frame_cache_size() const {
+		return _j2k_frame_cache_size;
+	}
+
 	boost::optional<int> decode_reduction() const {
 		return _decode_reduction;
 	}
@@ -1012,6 +1036,34 @@ public:
 		maybe_set(_frames_in_memory_multiplier, m);
 	}
 
+	void set_image_buffer_pool_size(int s) {
+		maybe_set(_image_buffer_pool_size, s);
+	}
+
+	void set_ffmpeg_decode_threads(int t) {
+		maybe_set(_ffmpeg_decode_threads, t);
+	}
+
+	void set_ffmpeg_read_ahead(bool r) {
+		maybe_set(_ffmpeg_read_ahead, r);
+	}
+
+	void set_j2k_frame_cache_directory(boost::filesystem::path d) {
+		maybe_set(_j2k_frame_cache_directory, d);
+	}
+
+	void unset_j2k_frame_cache_directory() {
+		if (!_j2k_frame_cache_directory) {
+			return;
+		}
+		_j2k_frame_cache_directory = boost::none;
+		changed();
+	}
+
+	void set_j2k_frame_cache_size(int s) {
+		maybe_set(_j2k_frame_cache_size, s);
+	}
+
 	void set_decode_reduction(boost::optional<int> r) {
 		maybe_set(_decode_reduction, r);
 	}
@@ -1470,6 +1522,16 @@ private:
 	boost::optional<KDMWriteType> _last_kdm_write_type;
 	boost::optional<DKDMWriteType> _last_dkdm_write_type;
 	int _frames_in_memory_multiplier;
+	/** maximum size of the image buffer pool in megabytes */
+	int _image_buffer_pool_size;
+	/** number of threads to decode FFmpeg video with, or 0 to choose automatically */
+	int _ffmpeg_decode_threads;
+	/** true to read packets from FFmpeg content in a separate thread */
+	bool _ffmpeg_read_ahead;
+	/** directory to keep encoded JPEG2000 frames in for re-use, or none */
+	boost::optional<boost::filesystem::path> _j2k_frame_cache_directory;
+	/** maximum size of the JPEG2000 frame cache in gigabytes */
+	int _j2k_frame_cache_size;
 	boost::optional<int> _decode_reduction;
 	bool _default_notify;
 	bool _notification[NOTIFICATION_COUNT];
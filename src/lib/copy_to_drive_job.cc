@@ -68,6 +68,37 @@ CopyToDriveJob::json_name() const
 	return N_("copy");
 }
 
+
+string
+CopyToDriveJob::status() const
+{
+	boost::mutex::scoped_lock lm(_status_mutex);
+	auto s = Job::status();
+	if (!_status.empty() && !finished_in_error()) {
+		s += N_("; ") + _status;
+	}
+	return s;
+}
+
+
+void
+CopyToDriveJob::set_rates(DiskWriterBackEndResponse const& response)
+{
+	string status;
+	if (response.type() == DiskWriterBackEndResponse::Type::COPY_PROGRESS) {
+		status = fmt::format(
+			_("reading {:.1f}MB/s, hashing {:.1f}MB/s, writing {:.1f}MB/s"),
+			response.read_rate(), response.hash_rate(), response.write_rate()
+			);
+	} else {
+		status = fmt::format(_("reading {:.1f}MB/s, hashing {:.1f}MB/s"), response.read_rate(), response.hash_rate());
+	}
+
+	boost::mutex::scoped_lock lm(_status_mutex);
+	_status = status;
+}
+
+
 void
 CopyToDriveJob::run()
 {
@@ -120,6 +151,7 @@ CopyToDriveJob::run()
 				state = COPY;
 			}
 			set_progress(response->progress());
+			set_rates(*response);
 			break;
 		case DiskWriterBackEndResponse::Type::VERIFY_PROGRESS:
 			if (state == COPY) {
@@ -127,6 +159,7 @@ CopyToDriveJob::run()
 				state = VERIFY;
 			}
 			set_progress(response->progress());
+			set_rates(*response);
 			break;
 		}
 	}
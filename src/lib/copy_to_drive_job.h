@@ -19,8 +19,10 @@
 */
 
 #include "cross.h"
+#include "disk_writer_messages.h"
 #include "job.h"
 #include "nanomsg.h"
+#include <boost/thread/mutex.hpp>
 
 class CopyToDriveJob : public Job
 {
@@ -29,6 +31,7 @@ public:
 
 	std::string name() const override;
 	std::string json_name() const override;
+	std::string status() const override;
 	void run() override;
 	bool enable_notify() const override {
 		return true;
@@ -37,7 +40,13 @@ public:
 private:
 	void count(boost::filesystem::path dir, uint64_t& total_bytes);
 	void copy(boost::filesystem::path from, boost::filesystem::path to, uint64_t& total_remaining, uint64_t total);
+	void set_rates(DiskWriterBackEndResponse const& response);
+
 	std::vector<boost::filesystem::path> _dcps;
 	Drive _drive;
 	Nanomsg& _nanomsg;
+
+	mutable boost::mutex _status_mutex;
+	/** description of the speeds that the disk writer is achieving */
+	std::string _status;
 };
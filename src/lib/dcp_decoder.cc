@@ -31,6 +31,7 @@
 #include "ffmpeg_image_proxy.h"
 #include "frame_interval_checker.h"
 #include "image.h"
+#include "j2k_decode_ahead.h"
 #include "j2k_image_proxy.h"
 #include "raw_image_proxy.h"
 #include "text_decoder.h"
@@ -174,41 +175,28 @@ DCPDecoder::pass()
 
 	if ((_j2k_mono_reader || _j2k_stereo_reader || _mpeg2_mono_reader) && (_decode_referenced || !_dcp_content->reference_video())) {
 		auto const entry_point = (*_reel)->main_picture()->entry_point().get_value_or(0);
-		if (_j2k_mono_reader) {
-			video->emit(
-				film(),
-				std::make_shared<J2KImageProxy>(
-					_j2k_mono_reader->get_frame(entry_point + frame),
-					picture_asset->size(),
-					AV_PIX_FMT_XYZ12LE,
-					_forced_reduction
-					),
-				ContentTime::from_frames(_offset + frame, vfr)
-				);
-		} else if (_j2k_stereo_reader) {
-			video->emit(
-				film(),
-				std::make_shared<J2KImageProxy>(
-					_j2k_stereo_reader->get_frame(entry_point + frame),
-					picture_asset->size(),
-					dcp::Eye::LEFT,
-					AV_PIX_FMT_XYZ12LE,
-					_forced_reduction
-					),
-				ContentTime::from_frames(_offset + frame, vfr)
-				);
+		if (_j2k_mono_reader || _j2k_stereo_reader) {
+			vector<shared_ptr<const J2KImageProxy>> proxies;
+			if (_decode_ahead) {
+				proxies = _decode_ahead->get(entry_point + frame);
+			}
+			if (proxies.empty()) {
+				proxies = j2k_proxies(entry_point + frame);
+			}
 
-			video->emit(
-				film(),
-				std::make_shared<J2KImageProxy>(
-					_j2k_stereo_reader->get_frame(entry_point + frame),
-					picture_asset->size(),
-					dcp::Eye::RIGHT,
-					AV_PIX_FMT_XYZ12LE,
-					_forced_reduction
-					),
-				ContentTime::from_frames(_offset + frame, vfr)
-				);
+			if (_decode_ahead) {
+				/* Make sure the frames after this one are being decoded */
+				auto const duration = (*_reel)->main_picture()->duration();
+				for (int i = 1; i <= _decode_ahead->frames() && frame + i < duration; ++i) {
+					if (!_decode_ahead->has(entry_point + frame + i)) {
+						_decode_ahead->add(entry_point + frame + i, j2k_proxies(entry_point + frame + i));
+					}
+				}
+			}
+
+			for (auto proxy: proxies) {
+				video->emit(film(), proxy, ContentTime::from_frames(_offset + frame, vfr));
+			}
 		} else if (_mpeg2_mono_reader) {
 			/* XXX: got to flush this at some point */
 			try {
@@ -404,9 +392,33 @@ DCPDecoder::next_reel()
 }
 
 
+/** @return J2KImageProxy for a frame of the current J2K picture asset, or two (left and then right) if it is 3D */
+vector<shared_ptr<const J2KImageProxy>>
+DCPDecoder::j2k_proxies(int64_t frame) const
+{
+	auto const size = (*_reel)->main_picture()->asset()->size();
+
+	if (_j2k_mono_reader) {
+		return { make_shared<J2KImageProxy>(_j2k_mono_reader->get_frame(frame), size, AV_PIX_FMT_XYZ12LE, _forced_reduction) };
+	}
+
+	DCPOMATIC_ASSERT(_j2k_stereo_reader);
+	auto stereo = _j2k_stereo_reader->get_frame(frame);
+	return {
+		make_shared<J2KImageProxy>(stereo, size, dcp::Eye::LEFT, AV_PIX_FMT_XYZ12LE, _forced_reduction),
+		make_shared<J2KImageProxy>(stereo, size, dcp::Eye::RIGHT, AV_PIX_FMT_XYZ12LE, _forced_reduction)
+	};
+}
+
+
 void
 DCPDecoder::get_readers()
 {
+	if (_decode_ahead) {
+		/* Anything decoded ahead was from the old readers */
+		_decode_ahead->clear();
+	}
+
 	_j2k_mono_reader.reset();
 	_j2k_stereo_reader.reset();
 	_mpeg2_mono_reader.reset();
@@ -533,6 +545,27 @@ DCPDecoder::set_forced_reduction(optional<int> reduction)
 }
 
 
+/** Decode JPEG2000 frames ahead of time on a pool of threads.
+ *  @param frames Number of frames to decode ahead, or 0 to do no decoding ahead.
+ *  @param target_size Size that the decoded images will be scaled to, used to choose the
+ *  decode reduction if there is no forced reduction.
+ */
+void
+DCPDecoder::set_decode_ahead(int frames, optional<dcp::Size> target_size)
+{
+	if (frames == 0) {
+		_decode_ahead.reset();
+		return;
+	}
+
+	if (!_decode_ahead || _decode_ahead->frames() != frames) {
+		_decode_ahead = make_shared<J2KDecodeAhead>(frames);
+	}
+
+	_decode_ahead->set_target_size(target_size);
+}
+
+
 string
 DCPDecoder::calculate_lazy_digest(shared_ptr<const DCPContent> c) const
 {
@@ -42,6 +42,8 @@ namespace dcp {
 }
 
 class DCPContent;
+class J2KDecodeAhead;
+class J2KImageProxy;
 class Log;
 struct dcp_subtitle_within_dcp_test;
 
@@ -63,6 +65,7 @@ public:
 
 	void set_decode_referenced(bool r);
 	void set_forced_reduction(boost::optional<int> reduction);
+	void set_decode_ahead(int frames, boost::optional<dcp::Size> target_size);
 
 	bool pass() override;
 	void seek(dcpomatic::ContentTime t, bool accurate) override;
@@ -78,6 +81,7 @@ private:
 
 	void next_reel();
 	void get_readers();
+	std::vector<std::shared_ptr<const J2KImageProxy>> j2k_proxies(int64_t frame) const;
 	void pass_texts(dcpomatic::ContentTime next, dcp::Size size);
 	void pass_texts(
 		dcpomatic::ContentTime next,
@@ -112,6 +116,7 @@ private:
 
 	bool _decode_referenced = false;
 	boost::optional<int> _forced_reduction;
+	std::shared_ptr<J2KDecodeAhead> _decode_ahead;
 
 	std::string _lazy_digest;
 
@@ -30,21 +30,25 @@
  */
 
 
+#include "colour_conversion.h"
 #include "config.h"
 #include "cross.h"
 #include "dcp_video.h"
 #include "dcpomatic_log.h"
 #include "dcpomatic_socket.h"
+#include "digester.h"
 #include "encode_server_description.h"
 #include "exceptions.h"
 #include "image.h"
 #include "log.h"
 #include "player_video.h"
+#include "rgb_to_xyz.h"
 #include "rng.h"
+#include "stage_times.h"
+#include "trace.h"
 #include "util.h"
 #include <libcxml/cxml.h>
 #include <dcp/openjpeg_image.h>
-#include <dcp/rgb_xyz.h>
 #include <dcp/j2k_transcode.h>
 #include <dcp/warnings.h>
 LIBDCP_DISABLE_WARNINGS
@@ -99,6 +103,24 @@ DCPVideo::DCPVideo(shared_ptr<const PlayerVideo> frame, shared_ptr<const cxml::N
 	_resolution = Resolution(node->optional_number_child<int>("Resolution").get_value_or(static_cast<int>(Resolution::TWO_K)));
 }
 
+/** @return An RGBToXYZ for a conversion.  Making one means building its LUTs, so the last
+ *  one used on each thread is kept; a film almost always uses the same conversion throughout.
+ */
+static RGBToXYZ const&
+rgb_to_xyz(ColourConversion const& conversion)
+{
+	thread_local boost::optional<ColourConversion> cached_conversion;
+	thread_local std::unique_ptr<RGBToXYZ> cached;
+
+	if (!cached || *cached_conversion != conversion) {
+		cached.reset(new RGBToXYZ(conversion));
+		cached_conversion = conversion;
+	}
+
+	return *cached;
+}
+
+
 shared_ptr<dcp::OpenJPEGImage>
 DCPVideo::convert_to_xyz(shared_ptr<const PlayerVideo> frame)
 {
@@ -111,12 +133,7 @@ DCPVideo::convert_to_xyz(shared_ptr<const PlayerVideo> frame)
 	auto image = frame->image(conversion, VideoRange::FULL, false);
 
 	if (frame->colour_conversion()) {
-		xyz = dcp::rgb_to_xyz(
-			image->data()[0],
-			image->size(),
-			image->stride()[0],
-			frame->colour_conversion().get()
-			);
+		xyz = rgb_to_xyz(frame->colour_conversion().get()).convert(image->data()[0], image->size(), image->stride()[0]);
 	} else {
 		xyz = make_shared<dcp::OpenJPEGImage>(image->data()[0], image->size(), image->stride()[0]);
 	}
@@ -142,13 +159,7 @@ DCPVideo::convert_to_xyz(uint16_t* dst) const
 	auto image = _frame->image(conversion, VideoRange::FULL, false);
 
 	if (_frame->colour_conversion()) {
-		dcp::rgb_to_xyz(
-			image->data()[0],
-			dst,
-			image->size(),
-			image->stride()[0],
-			_frame->colour_conversion().get()
-			);
+		rgb_to_xyz(_frame->colour_conversion().get()).convert(image->data()[0], image->size(), image->stride()[0], dst);
 	} else {
 		auto const size = image->size();
 		auto const row_bytes = static_cast<size_t>(size.width) * 3 * sizeof(uint16_t);
@@ -170,6 +181,9 @@ DCPVideo::convert_to_xyz(uint16_t* dst) const
 ArrayData
 DCPVideo::encode_locally() const
 {
+	StageTimes::Period period(StageTimes::Stage::J2K);
+	Trace::Span span("DCPVideo::encode_locally");
+
 	auto const comment = Config::instance()->dcp_j2k_comment();
 
 	ArrayData enc = {};
@@ -244,36 +258,28 @@ DCPVideo::encode_locally() const
 /** Send this frame to a remote server for J2K encoding, then read the result.
  *  @param serv Server to send to.
  *  @param timeout timeout in seconds.
+ *  @param chooser If non-null, used to pick the transport encoding and told how long the frame took to come back.
  *  @return Encoded data.
  */
 ArrayData
-DCPVideo::encode_remotely(EncodeServerDescription serv, int timeout) const
+DCPVideo::encode_remotely(EncodeServerDescription serv, int timeout, TransportEncodingChooser* chooser) const
 {
+	StageTimes::Period period(StageTimes::Stage::REMOTE);
+	Trace::Span span("DCPVideo::encode_remotely");
 	auto socket = make_shared<Socket>(timeout);
 	socket->set_send_buffer_size(512 * 1024);
 
 	socket->connect(serv.host_name(), ENCODE_FRAME_PORT);
 
-	/* Collect all XML metadata */
-	xmlpp::Document doc;
-	auto root = doc.create_root_node("EncodingRequest");
-	cxml::add_text_child(root, "Version", fmt::to_string(SERVER_LINK_VERSION));
-	add_metadata(root);
-
 	LOG_DEBUG_ENCODE(N_("Sending frame {} to remote"), _index);
 
-	{
-		Socket::WriteDigestScope ds(socket);
+	auto const encoding = chooser ? chooser->choose() : TransportEncoding::NONE;
 
-		/* Send XML metadata */
-		auto xml = doc.write_to_string("UTF-8");
-		socket->write(xml.bytes() + 1);
-		socket->write((uint8_t *) xml.c_str(), xml.bytes() + 1);
+	struct timeval start;
+	gettimeofday(&start, 0);
 
-		/* Send binary data */
-		LOG_TIMING("start-remote-send thread={}", thread_id());
-		_frame->write_to_socket(socket);
-	}
+	/* Servers of any version that we can talk to will accept a single frame with the oldest version */
+	write_to_socket(socket, OLDEST_SERVER_LINK_VERSION, encoding);
 
 	/* Read the response (JPEG2000-encoded data); this blocks until the data
 	   is ready and sent back.
@@ -288,11 +294,45 @@ DCPVideo::encode_remotely(EncodeServerDescription serv, int timeout) const
 		throw NetworkError("Checksums do not match");
 	}
 
+	if (chooser) {
+		struct timeval end;
+		gettimeofday(&end, 0);
+		chooser->done(encoding, seconds(end) - seconds(start));
+	}
+
 	LOG_DEBUG_ENCODE(N_("Finished remotely-encoded frame {}"), _index);
 
 	return e;
 }
 
+/** Send an encoding request for this frame, followed by its image data, to an encode server.
+ *  @param link_version Server link version to put in the request.
+ *  @param encoding Encoding to use for the image data; this must be one that the server has said it supports.
+ */
+void
+DCPVideo::write_to_socket(shared_ptr<Socket> socket, int link_version, TransportEncoding encoding) const
+{
+	/* Collect all XML metadata */
+	xmlpp::Document doc;
+	auto root = doc.create_root_node("EncodingRequest");
+	cxml::add_text_child(root, "Version", fmt::to_string(link_version));
+	if (encoding != TransportEncoding::NONE) {
+		cxml::add_text_child(root, "TransportEncoding", transport_encoding_to_string(encoding));
+	}
+	add_metadata(root);
+
+	Socket::WriteDigestScope ds(socket);
+
+	/* Send XML metadata */
+	auto xml = doc.write_to_string("UTF-8");
+	socket->write(xml.bytes() + 1);
+	socket->write((uint8_t *) xml.c_str(), xml.bytes() + 1);
+
+	/* Send binary data */
+	LOG_TIMING("start-remote-send thread={}", thread_id());
+	_frame->write_to_socket(socket, encoding);
+}
+
 void
 DCPVideo::add_metadata(xmlpp::Element* el) const
 {
@@ -303,6 +343,23 @@ DCPVideo::add_metadata(xmlpp::Element* el) const
 	_frame->add_metadata(el);
 }
 
+
+/** @return A digest of everything that goes into the J2K data for this frame, so that we
+ *  can find it again in a J2KFrameCache.
+ */
+string
+DCPVideo::cache_key() const
+{
+	Digester digester;
+	digester.add(_frames_per_second);
+	digester.add(_video_bit_rate);
+	digester.add(static_cast<int>(_resolution));
+	digester.add(Config::instance()->dcp_j2k_comment());
+	_frame->add_to_digest(digester);
+	return digester.get();
+}
+
+
 Eyes
 DCPVideo::eyes() const
 {
@@ -23,6 +23,7 @@
 
 #include "encode_server_description.h"
 #include "resolution.h"
+#include "transport_encoding.h"
 #include <libcxml/cxml.h>
 #include <dcp/array_data.h>
 #include <dcp/openjpeg_image.h>
@@ -35,6 +36,7 @@
 
 class Log;
 class PlayerVideo;
+class Socket;
 
 
 /** @class DCPVideo
@@ -56,7 +58,8 @@ public:
 	DCPVideo& operator=(DCPVideo const&) = default;
 
 	dcp::ArrayData encode_locally() const;
-	dcp::ArrayData encode_remotely(EncodeServerDescription, int timeout = 30) const;
+	dcp::ArrayData encode_remotely(EncodeServerDescription, int timeout = 30, TransportEncodingChooser* chooser = nullptr) const;
+	void write_to_socket(std::shared_ptr<Socket> socket, int link_version, TransportEncoding encoding = TransportEncoding::NONE) const;
 
 	int index() const {
 		return _index;
@@ -66,6 +69,8 @@ public:
 
 	bool same(std::shared_ptr<const DCPVideo> other) const;
 
+	std::string cache_key() const;
+
 	static std::shared_ptr<dcp::OpenJPEGImage> convert_to_xyz(std::shared_ptr<const PlayerVideo> frame);
 
 	void convert_to_xyz(uint16_t* dst) const;
@@ -51,10 +51,26 @@ DiskWriterBackEndResponse::read_from_nanomsg(Nanomsg& nanomsg, int timeout)
 		return DiskWriterBackEndResponse::format_progress(dcp::raw_convert<float>(progress.get_value_or("0")));
 	} else if (*s == DISK_WRITER_COPY_PROGRESS) {
 		auto progress = nanomsg.receive(500);
-		return DiskWriterBackEndResponse::copy_progress(dcp::raw_convert<float>(progress.get_value_or("0")));
+		auto read = nanomsg.receive(500);
+		auto hash = nanomsg.receive(500);
+		auto write = nanomsg.receive(500);
+		return DiskWriterBackEndResponse::copy_progress(
+			dcp::raw_convert<float>(progress.get_value_or("0")),
+			dcp::raw_convert<float>(read.get_value_or("0")),
+			dcp::raw_convert<float>(hash.get_value_or("0")),
+			dcp::raw_convert<float>(write.get_value_or("0"))
+			);
 	} else if (*s == DISK_WRITER_VERIFY_PROGRESS) {
 		auto progress = nanomsg.receive(500);
-		return DiskWriterBackEndResponse::verify_progress(dcp::raw_convert<float>(progress.get_value_or("0")));
+		auto read = nanomsg.receive(500);
+		auto hash = nanomsg.receive(500);
+		/* Write rate, which is always 0 when verifying */
+		nanomsg.receive(500);
+		return DiskWriterBackEndResponse::verify_progress(
+			dcp::raw_convert<float>(progress.get_value_or("0")),
+			dcp::raw_convert<float>(read.get_value_or("0")),
+			dcp::raw_convert<float>(hash.get_value_or("0"))
+			);
 	} else {
 		DCPOMATIC_ASSERT(false);
 	}
@@ -86,11 +102,11 @@ DiskWriterBackEndResponse::write_to_nanomsg(Nanomsg& nanomsg, int timeout) const
 			break;
 		case Type::COPY_PROGRESS:
 			message = fmt::format("{}\n", DISK_WRITER_COPY_PROGRESS);
-			message += fmt::to_string(_progress) + "\n";
+			message += fmt::format("{}\n{}\n{}\n{}\n", _progress, _read_rate, _hash_rate, _write_rate);
 			break;
 		case Type::VERIFY_PROGRESS:
 			message = fmt::format("{}\n", DISK_WRITER_VERIFY_PROGRESS);
-			message += fmt::to_string(_progress) + "\n";
+			message += fmt::format("{}\n{}\n{}\n{}\n", _progress, _read_rate, _hash_rate, _write_rate);
 			break;
 	}
 
@@ -68,13 +68,19 @@ class Nanomsg;
 #define DISK_WRITER_FORMAT_PROGRESS "F"
 // 0.4\n
 
-// data is being copied, 30% done
+// data is being copied, 30% done, reading at 95.2MB/s, hashing at 610.4MB/s and writing at 88.1MB/s
 #define DISK_WRITER_COPY_PROGRESS "C"
 // 0.3\n
+// 95.2\n
+// 610.4\n
+// 88.1\n
 
-// data is being verified, 60% done
+// data is being verified, 60% done, reading at 120.5MB/s and hashing at 598.0MB/s
 #define DISK_WRITER_VERIFY_PROGRESS "V"
 // 0.6\n
+// 120.5\n
+// 598.0\n
+// 0\n
 
 
 /* REQUEST TO QUIT */
@@ -129,15 +135,27 @@ public:
 		return r;
 	}
 
-	static DiskWriterBackEndResponse copy_progress(float p) {
+	/** @param read_rate MB/s achieved reading from the source.
+	 *  @param hash_rate MB/s achieved calculating digests.
+	 *  @param write_rate MB/s achieved writing to the drive.
+	 */
+	static DiskWriterBackEndResponse copy_progress(float p, float read_rate = 0, float hash_rate = 0, float write_rate = 0) {
 		auto r = DiskWriterBackEndResponse(Type::COPY_PROGRESS);
 		r._progress = p;
+		r._read_rate = read_rate;
+		r._hash_rate = hash_rate;
+		r._write_rate = write_rate;
 		return r;
 	}
 
-	static DiskWriterBackEndResponse verify_progress(float p) {
+	/** @param read_rate MB/s achieved reading back from the drive.
+	 *  @param hash_rate MB/s achieved calculating digests.
+	 */
+	static DiskWriterBackEndResponse verify_progress(float p, float read_rate = 0, float hash_rate = 0) {
 		auto r = DiskWriterBackEndResponse(Type::VERIFY_PROGRESS);
 		r._progress = p;
+		r._read_rate = read_rate;
+		r._hash_rate = hash_rate;
 		return r;
 	}
 
@@ -165,6 +183,18 @@ public:
 		return _progress;
 	}
 
+	float read_rate() const {
+		return _read_rate;
+	}
+
+	float hash_rate() const {
+		return _hash_rate;
+	}
+
+	float write_rate() const {
+		return _write_rate;
+	}
+
 private:
 	DiskWriterBackEndResponse(Type type)
 		: _type(type)
@@ -175,5 +205,8 @@ private:
 	int _ext4_error_number = 0;
 	int _platform_error_number = 0;
 	float _progress = 0;
+	float _read_rate = 0;
+	float _hash_rate = 0;
+	float _write_rate = 0;
 };
 
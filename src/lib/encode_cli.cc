@@ -39,6 +39,7 @@
 #include "log.h"
 #include "make_dcp.h"
 #include "ratio.h"
+#include "trace.h"
 #include "transcode_job.h"
 #include "util.h"
 #include "variant.h"
@@ -102,6 +103,7 @@ help(function <void (string)> out)
 	out("      --export-format <format>      export project to a file, rather than making a DCP: specify mov or mp4\n");
 	out("      --export-filename <filename>  filename to export to with --export-format\n");
 	out("      --hints                       analyze film for hints before encoding and abort if any are found\n");
+	out("      --trace <file>                write a Chrome trace JSON file showing where each thread spent its time\n");
 	out("\ne.g.\n");
 	out(fmt::format("\n  {} -t 4 make-dcp my_great_movie\n", program_name));
 	out(fmt::format("\n  {} config grok-licence 12345ABCD\n", program_name));
@@ -177,7 +179,7 @@ list_servers(function <void (string)> out)
 				optional<int> threads;
 				auto j = servers.begin();
 				while (j != servers.end()) {
-					if (i == j->host_name() && j->current_link_version()) {
+					if (i == j->host_name() && j->compatible_link_version()) {
 						threads = j->threads();
 						auto tmp = j;
 						++tmp;
@@ -197,7 +199,7 @@ list_servers(function <void (string)> out)
 
 			/* Now report any left that have been found by broadcast */
 			for (auto const& i: servers) {
-				if (i.current_link_version()) {
+				if (i.compatible_link_version()) {
 					out(fmt::format("{:24} UP     {}\n", i.host_name(), i.threads()));
 				} else {
 					out(fmt::format("{:24} bad version\n", i.host_name()));
@@ -291,6 +293,7 @@ encode_cli(int argc, char* argv[], function<void (string)> out, function<void ()
 	optional<string> export_format;
 	optional<boost::filesystem::path> export_filename;
 	bool hints = false;
+	optional<boost::filesystem::path> trace;
 	string command = "make-dcp";
 
 	/* This makes it possible to call getopt several times in the same executable, for tests */
@@ -317,10 +320,11 @@ encode_cli(int argc, char* argv[], function<void (string)> out, function<void ()
 			{ "export-format", required_argument, 0, 'C' },
 			{ "export-filename", required_argument, 0, 'D' },
 			{ "hints", no_argument, 0, 'E' },
+			{ "trace", required_argument, 0, 'F' },
 			{ 0, 0, 0, 0 }
 		};
 
-		int c = getopt_long(argc, argv, "vhfnrt:j:kAs:ldc:BC:D:E", long_options, &option_index);
+		int c = getopt_long(argc, argv, "vhfnrt:j:kAs:ldc:BC:D:EF:", long_options, &option_index);
 
 		if (c == -1) {
 			break;
@@ -379,6 +383,9 @@ encode_cli(int argc, char* argv[], function<void (string)> out, function<void ()
 		case 'E':
 			hints = true;
 			break;
+		case 'F':
+			trace = optarg;
+			break;
 		}
 	}
 
@@ -604,6 +611,22 @@ encode_cli(int argc, char* argv[], function<void (string)> out, function<void ()
 		}
 	}
 
+	if (trace) {
+		Trace::enable();
+	}
+
+	/* Write the trace, if we are making one, returning an error message if that fails */
+	auto write_trace = [&trace]() -> optional<string> {
+		if (trace) {
+			try {
+				Trace::write(*trace);
+			} catch (std::exception& e) {
+				return fmt::format("Could not write trace: {}\n", e.what());
+			}
+		}
+		return {};
+	};
+
 	TranscodeJob::ChangedBehaviour const behaviour = check ? TranscodeJob::ChangedBehaviour::STOP : TranscodeJob::ChangedBehaviour::IGNORE;
 
 	if (export_format) {
@@ -618,12 +641,17 @@ encode_cli(int argc, char* argv[], function<void (string)> out, function<void ()
 		try {
 			make_dcp(film, behaviour);
 		} catch (runtime_error& e) {
-			return fmt::format("Could not make DCP: {}\n", e.what());
+			/* What we have traced so far may help to show what went wrong */
+			return fmt::format("Could not make DCP: {}\n", e.what()) + write_trace().value_or("");
 		}
 	}
 
 	bool const error = show_jobs_on_console(out, flush, progress);
 
+	if (auto trace_error = write_trace()) {
+		return *trace_error;
+	}
+
 	if (keep_going) {
 		while (true) {
 			dcpomatic_sleep_seconds(3600);
@@ -36,6 +36,7 @@
 #include "image.h"
 #include "log.h"
 #include "player_video.h"
+#include "trace.h"
 #include "util.h"
 #include "variant.h"
 #include "version.h"
@@ -103,6 +104,23 @@ EncodeServer::~EncodeServer ()
 		_worker_threads.join_all ();
 	} catch (...) {}
 
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		for (auto i: _connection_threads) {
+			if (auto socket = i->socket.lock()) {
+				socket->close ();
+			}
+		}
+	}
+
+	/* _terminate is set, so nothing will be added to _connection_threads now */
+	for (auto i: _connection_threads) {
+		i->thread.interrupt ();
+		try {
+			i->thread.join ();
+		} catch (...) {}
+	}
+
 	{
 		boost::mutex::scoped_lock lm (_broadcast.mutex);
 		if (_broadcast.socket) {
@@ -119,12 +137,30 @@ EncodeServer::~EncodeServer ()
 }
 
 
-/** @param after_read Filled in with gettimeofday() after reading the input from the network.
+/** Read a frame's image data from a socket.  The caller must have a Socket::ReadDigestScope
+ *  in place from before the request XML was read.
+ *  @param xml Encoding request which has already been read from the socket.
+ */
+shared_ptr<DCPVideo>
+EncodeServer::read_frame (shared_ptr<Socket> socket, cxml::ConstNodePtr xml)
+{
+	auto pvf = make_shared<PlayerVideo>(xml, socket);
+	return make_shared<DCPVideo>(pvf, xml);
+}
+
+
+/** Handle a newly-accepted connection.  This is either a request to encode a single frame,
+ *  in which case it is dealt with here, or the start of a long-lived connection on which
+ *  many frames will be sent, in which case it is handed over to a new connection_thread().
+ *
+ *  @param after_read Filled in with gettimeofday() after reading the input from the network.
  *  @param after_encode Filled in with gettimeofday() after encoding the image.
+ *  @return Index of the frame that was encoded, or -1.
  */
 int
 EncodeServer::process (shared_ptr<Socket> socket, struct timeval& after_read, struct timeval& after_encode)
 {
+	Trace::Span span("EncodeServer::process");
 	Socket::ReadDigestScope ds (socket);
 
 	auto length = socket->read_uint32 ();
@@ -138,26 +174,48 @@ EncodeServer::process (shared_ptr<Socket> socket, struct timeval& after_read, st
 	string s (buffer.get());
 	auto xml = make_shared<cxml::Document>("EncodingRequest");
 	xml->read_string (s);
+
+	auto const version = xml->number_child<int>("Version");
+
+	if (version == SERVER_LINK_VERSION) {
+		/* This is the start of a long-lived connection; there is nothing else in the request */
+		if (!ds.check()) {
+			throw NetworkError ("Checksums do not match");
+		}
+
+		boost::mutex::scoped_lock lm (_mutex);
+		if (!_terminate) {
+			reap_connection_threads ();
+			auto thread = make_shared<ConnectionThread>();
+			thread->socket = socket;
+			auto finished = &thread->finished;
+			thread->thread = boost::thread ([this, socket, finished]() {
+				connection_thread (socket);
+				*finished = true;
+			});
+			_connection_threads.push_back (thread);
+		}
+		return -1;
+	}
+
 	/* This is a double-check; the server shouldn't even be on the candidate list
 	   if it is the wrong version, but it doesn't hurt to make sure here.
 	*/
-	if (xml->number_child<int> ("Version") != SERVER_LINK_VERSION) {
+	if (version != OLDEST_SERVER_LINK_VERSION) {
 		cerr << "Mismatched server/client versions\n";
 		LOG_ERROR ("Mismatched server/client versions");
 		return -1;
 	}
 
-	auto pvf = make_shared<PlayerVideo>(xml, socket);
+	auto dcp_video_frame = read_frame (socket, xml);
 
 	if (!ds.check()) {
 		throw NetworkError ("Checksums do not match");
 	}
 
-	DCPVideo dcp_video_frame (pvf, xml);
-
 	gettimeofday (&after_read, 0);
 
-	auto encoded = dcp_video_frame.encode_locally ();
+	auto encoded = dcp_video_frame->encode_locally ();
 
 	gettimeofday (&after_encode, 0);
 
@@ -166,14 +224,161 @@ EncodeServer::process (shared_ptr<Socket> socket, struct timeval& after_read, st
 		socket->write (encoded.size());
 		socket->write (encoded.data(), encoded.size());
 	} catch (std::exception& e) {
-		cerr << "Send failed; frame " << dcp_video_frame.index() << "\n";
-		LOG_ERROR ("Send failed; frame {}", dcp_video_frame.index());
+		cerr << "Send failed; frame " << dcp_video_frame->index() << "\n";
+		LOG_ERROR ("Send failed; frame {}", dcp_video_frame->index());
 		throw;
 	}
 
 	++_frames_encoded;
 
-	return dcp_video_frame.index ();
+	return dcp_video_frame->index ();
+}
+
+
+/** Encode a frame that came in on a long-lived connection, and give the result
+ *  back to the connection so that it can be sent when the client asks for it.
+ */
+void
+EncodeServer::process (Frame frame)
+{
+	Trace::Span span("EncodeServer::process");
+	Connection::Encoded encoded;
+	encoded.index = frame.video->index ();
+	encoded.eyes = frame.video->eyes ();
+
+	try {
+		encoded.data = frame.video->encode_locally ();
+		++_frames_encoded;
+	} catch (std::exception& e) {
+		cerr << "Encode failed; frame " << encoded.index << ": " << e.what() << "\n";
+		LOG_ERROR ("Encode failed; frame {} ({})", encoded.index, e.what());
+	}
+
+	struct timeval after_encode;
+	gettimeofday (&after_encode, 0);
+
+	{
+		boost::mutex::scoped_lock lm (frame.connection->mutex);
+		frame.connection->encoded.push_back (encoded);
+		frame.connection->condition.notify_all ();
+	}
+
+	if (encoded.data) {
+		/* We don't know how long it will take to send this back, as that happens when the client asks for it */
+		auto e = make_shared<EncodedLogEntry>(
+			encoded.index, frame.ip,
+			seconds(frame.after_read) - seconds(frame.start),
+			seconds(after_encode) - seconds(frame.after_read),
+			0
+			);
+
+		if (_verbose) {
+			cout << e->get() << "\n";
+		}
+
+		dcpomatic_log->log (e);
+	}
+}
+
+
+/** Thread to read requests from a long-lived connection.  Frames to encode are passed to the worker
+ *  threads, and encoded frames are sent back (in whatever order they finish) each time the client
+ *  says that it is waiting for one.
+ */
+void
+EncodeServer::connection_thread (shared_ptr<Socket> socket)
+try
+{
+	auto connection = make_shared<Connection>();
+	auto const ip = socket->socket().remote_endpoint().address().to_string();
+
+	while (true) {
+		auto const message = socket->read_uint32 ();
+
+		if (message == ENCODE_CONNECTION_FRAME) {
+			Frame frame;
+			frame.connection = connection;
+			frame.ip = ip;
+			gettimeofday (&frame.start, 0);
+
+			Socket::ReadDigestScope ds (socket);
+
+			auto length = socket->read_uint32 ();
+			if (length > 65536) {
+				throw NetworkError("Malformed encode request (too large)");
+			}
+
+			scoped_array<char> buffer (new char[length]);
+			socket->read (reinterpret_cast<uint8_t*>(buffer.get()), length);
+
+			auto xml = make_shared<cxml::Document>("EncodingRequest");
+			xml->read_string (string(buffer.get()));
+			if (xml->number_child<int>("Version") != SERVER_LINK_VERSION) {
+				throw NetworkError ("Mismatched server/client versions");
+			}
+
+			frame.video = read_frame (socket, xml);
+
+			if (!ds.check()) {
+				throw NetworkError ("Checksums do not match");
+			}
+
+			gettimeofday (&frame.after_read, 0);
+
+			/* We don't wait for the queue to go down here; the client limits how many
+			   frames it has in flight on each connection.
+			*/
+			boost::mutex::scoped_lock lm (_mutex);
+			_waker.nudge ();
+			_frames.push_back (frame);
+			_empty_condition.notify_all ();
+		} else if (message == ENCODE_CONNECTION_WAIT) {
+			boost::mutex::scoped_lock lm (connection->mutex);
+			while (connection->encoded.empty()) {
+				connection->condition.wait (lm);
+			}
+
+			auto encoded = connection->encoded.front ();
+			connection->encoded.pop_front ();
+			lm.unlock ();
+
+			Socket::WriteDigestScope ds (socket);
+			socket->write (static_cast<uint32_t>(encoded.index));
+			socket->write (static_cast<uint32_t>(encoded.eyes));
+			if (encoded.data) {
+				socket->write (encoded.data->size());
+				socket->write (encoded.data->data(), encoded.data->size());
+			} else {
+				socket->write (static_cast<uint32_t>(0));
+			}
+		} else {
+			throw NetworkError ("Unexpected message on encode connection");
+		}
+	}
+}
+catch (boost::thread_interrupted &)
+{
+
+}
+catch (std::exception& e)
+{
+	/* This is how we find out that the client has gone away */
+	LOG_GENERAL ("Encode connection closed ({})", e.what());
+}
+
+
+/** Join and forget any connection threads which have finished.  Caller must hold a lock on _mutex */
+void
+EncodeServer::reap_connection_threads ()
+{
+	for (auto i = _connection_threads.begin(); i != _connection_threads.end(); ) {
+		if ((*i)->finished) {
+			(*i)->thread.join ();
+			i = _connection_threads.erase (i);
+		} else {
+			++i;
+		}
+	}
 }
 
 
@@ -182,7 +387,7 @@ EncodeServer::worker_thread ()
 {
 	while (true) {
 		boost::mutex::scoped_lock lock (_mutex);
-		while (_queue.empty () && !_terminate) {
+		while (_queue.empty () && _frames.empty () && !_terminate) {
 			_empty_condition.wait (lock);
 		}
 
@@ -190,6 +395,15 @@ EncodeServer::worker_thread ()
 			return;
 		}
 
+		/* Frames from long-lived connections have already been read, so do them first */
+		if (!_frames.empty ()) {
+			auto frame = _frames.front ();
+			_frames.pop_front ();
+			lock.unlock ();
+			process (frame);
+			continue;
+		}
+
 		auto socket = _queue.front ();
 		_queue.pop_front ();
 
@@ -301,6 +515,8 @@ EncodeServer::broadcast_received ()
 		auto root = doc.create_root_node ("ServerAvailable");
 		cxml::add_text_child(root, "Threads", fmt::to_string(_worker_threads.size()));
 		cxml::add_text_child(root, "Version", fmt::to_string(SERVER_LINK_VERSION));
+		/* Ways we can accept image data other than raw; clients which don't know about this will ignore it */
+		cxml::add_text_child(root, "TransportEncoding", transport_encoding_to_string(TransportEncoding::ZLIB));
 		auto xml = doc.write_to_string ("UTF-8");
 
 		if (_verbose) {
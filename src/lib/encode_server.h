@@ -31,13 +31,19 @@
 #include "cross.h"
 #include "exception_store.h"
 #include "server.h"
+#include "types.h"
+#include <dcp/array_data.h>
+#include <libcxml/cxml.h>
 #include <boost/asio.hpp>
 #include <boost/thread.hpp>
 #include <boost/thread/condition.hpp>
+#include <boost/optional.hpp>
 #include <atomic>
+#include <list>
 #include <string>
 
 
+class DCPVideo;
 class Log;
 class Socket;
 
@@ -59,14 +65,59 @@ public:
 	}
 
 private:
+	/** State of a long-lived connection from a client which can have many frames in flight */
+	struct Connection
+	{
+		struct Encoded
+		{
+			int index;
+			Eyes eyes;
+			/** Encoded data, or empty if the encode failed */
+			boost::optional<dcp::ArrayData> data;
+		};
+
+		boost::mutex mutex;
+		boost::condition condition;
+		/** Frames from this connection which have been encoded and are ready to send back */
+		std::list<Encoded> encoded;
+	};
+
+	/** A thread reading from a long-lived connection */
+	struct ConnectionThread
+	{
+		boost::thread thread;
+		std::weak_ptr<Socket> socket;
+		/** true when the thread has finished, so that it can be joined without waiting */
+		std::atomic<bool> finished{false};
+	};
+
+	/** A frame which has been received on a long-lived connection and is waiting to be encoded */
+	struct Frame
+	{
+		std::shared_ptr<Connection> connection;
+		std::shared_ptr<DCPVideo> video;
+		std::string ip;
+		struct timeval start;
+		struct timeval after_read;
+	};
+
 	void handle (std::shared_ptr<Socket>) override;
 	void worker_thread ();
 	int process (std::shared_ptr<Socket> socket, struct timeval &, struct timeval &);
+	void process (Frame frame);
+	std::shared_ptr<DCPVideo> read_frame (std::shared_ptr<Socket> socket, cxml::ConstNodePtr xml);
+	void connection_thread (std::shared_ptr<Socket> socket);
+	void reap_connection_threads ();
 	void broadcast_thread ();
 	void broadcast_received ();
 
 	boost::thread_group _worker_threads;
+	/** Sockets that have just been accepted */
 	std::list<std::shared_ptr<Socket>> _queue;
+	/** Frames that have been read from long-lived connections */
+	std::list<Frame> _frames;
+	/** Threads reading from long-lived connections; finished ones are removed when a new one is started */
+	std::list<std::shared_ptr<ConnectionThread>> _connection_threads;
 	boost::condition _full_condition;
 	boost::condition _empty_condition;
 	bool _verbose;
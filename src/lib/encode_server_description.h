@@ -23,6 +23,7 @@
 #define DCPOMATIC_ENCODE_SERVER_DESCRIPTION_H
 
 
+#include "transport_encoding.h"
 #include "types.h"
 #include <boost/date_time/posix_time/posix_time.hpp>
 
@@ -43,11 +44,13 @@ public:
 	/** @param h Server host name or IP address in string form.
 	 *  @param t Number of threads to use on the server.
 	 *  @param l Server link version number of the server.
+	 *  @param e Transport encodings that the server can accept, other than TransportEncoding::NONE.
 	 */
-	EncodeServerDescription (std::string h, int t, int l)
+	EncodeServerDescription (std::string h, int t, int l, std::vector<TransportEncoding> e = {})
 		: _host_name (h)
 		, _threads (t)
 		, _link_version (l)
+		, _transport_encodings (e)
 		, _last_seen (boost::posix_time::second_clock::local_time())
 	{}
 
@@ -63,8 +66,19 @@ public:
 		return _threads;
 	}
 
-	bool current_link_version () const {
-		return _link_version == SERVER_LINK_VERSION;
+	/** @return true if we can talk to this server */
+	bool compatible_link_version () const {
+		return _link_version >= OLDEST_SERVER_LINK_VERSION && _link_version <= SERVER_LINK_VERSION;
+	}
+
+	/** @return true if this server can accept a long-lived connection with many frames in flight */
+	bool pipelined () const {
+		return _link_version >= PIPELINED_SERVER_LINK_VERSION;
+	}
+
+	/** @return transport encodings that the server can accept, other than TransportEncoding::NONE */
+	std::vector<TransportEncoding> transport_encodings () const {
+		return _transport_encodings;
 	}
 
 	void set_host_name (std::string n) {
@@ -90,6 +104,7 @@ private:
 	int _threads;
 	/** server link (i.e. protocol) version number */
 	int _link_version;
+	std::vector<TransportEncoding> _transport_encodings;
 	boost::posix_time::ptime _last_seen;
 };
 
@@ -262,7 +262,14 @@ EncodeServerFinder::handle_accept(boost::system::error_code ec)
 		if (i != _servers.end()) {
 			i->set_seen();
 		} else {
-			EncodeServerDescription sd(ip, xml->number_child<int>("Threads"), xml->optional_number_child<int>("Version").get_value_or(0));
+			vector<TransportEncoding> encodings;
+			for (auto encoding: xml->node_children("TransportEncoding")) {
+				/* Ignore anything that we don't understand */
+				if (auto e = string_to_transport_encoding(encoding->content())) {
+					encodings.push_back(*e);
+				}
+			}
+			EncodeServerDescription sd(ip, xml->number_child<int>("Threads"), xml->optional_number_child<int>("Version").get_value_or(0), encodings);
 			_servers.push_back(sd);
 			changed = true;
 		}
@@ -0,0 +1,165 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "encode_server_statistics.h"
+#include <algorithm>
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using boost::optional;
+
+
+float constexpr EncodeServerStatistics::latency_weight;
+
+
+EncodeServerStatistics*
+EncodeServerStatistics::instance()
+{
+	static auto statistics = new EncodeServerStatistics();
+	return statistics;
+}
+
+
+/** @return Entry for a server, creating it if required.  Caller must hold a lock on _mutex */
+shared_ptr<EncodeServerStatistics::Entry>
+EncodeServerStatistics::entry(string const& host_name)
+{
+	auto& e = _servers[host_name];
+	if (!e) {
+		e = make_shared<Entry>();
+	}
+	return e;
+}
+
+
+void
+EncodeServerStatistics::sent(string const& host_name)
+{
+	boost::mutex::scoped_lock lm(_mutex);
+	++entry(host_name)->in_flight;
+}
+
+
+void
+EncodeServerStatistics::received(string const& host_name, float latency)
+{
+	shared_ptr<Entry> e;
+	{
+		boost::mutex::scoped_lock lm(_mutex);
+		e = entry(host_name);
+		if (e->in_flight > 0) {
+			--e->in_flight;
+		}
+		if (e->latency) {
+			e->latency = *e->latency * (1 - latency_weight) + latency * latency_weight;
+		} else {
+			e->latency = latency;
+		}
+	}
+
+	e->history.event();
+}
+
+
+void
+EncodeServerStatistics::failed(string const& host_name, int frames)
+{
+	boost::mutex::scoped_lock lm(_mutex);
+	auto e = entry(host_name);
+	e->in_flight = std::max(0, e->in_flight - frames);
+	e->failures += frames;
+}
+
+
+void
+EncodeServerStatistics::abandoned(string const& host_name, int frames)
+{
+	boost::mutex::scoped_lock lm(_mutex);
+	auto e = entry(host_name);
+	e->in_flight = std::max(0, e->in_flight - frames);
+}
+
+
+void
+EncodeServerStatistics::redispatched(string const& host_name)
+{
+	boost::mutex::scoped_lock lm(_mutex);
+	++entry(host_name)->redispatched;
+}
+
+
+optional<float>
+EncodeServerStatistics::latency(string const& host_name) const
+{
+	boost::mutex::scoped_lock lm(_mutex);
+	auto i = _servers.find(host_name);
+	if (i == _servers.end()) {
+		return {};
+	}
+	return i->second->latency;
+}
+
+
+optional<float>
+EncodeServerStatistics::best_latency() const
+{
+	boost::mutex::scoped_lock lm(_mutex);
+	optional<float> best;
+	for (auto const& i: _servers) {
+		if (i.second->latency && (!best || *i.second->latency < *best)) {
+			best = i.second->latency;
+		}
+	}
+	return best;
+}
+
+
+vector<EncodeServerStatistics::Server>
+EncodeServerStatistics::servers() const
+{
+	boost::mutex::scoped_lock lm(_mutex);
+
+	vector<Server> servers;
+	for (auto const& i: _servers) {
+		Server s;
+		s.host_name = i.first;
+		s.rate = i.second->history.rate();
+		s.latency = i.second->latency;
+		s.in_flight = i.second->in_flight;
+		s.frames = i.second->history.events();
+		s.failures = i.second->failures;
+		s.redispatched = i.second->redispatched;
+		servers.push_back(s);
+	}
+
+	return servers;
+}
+
+
+void
+EncodeServerStatistics::clear()
+{
+	boost::mutex::scoped_lock lm(_mutex);
+	_servers.clear();
+}
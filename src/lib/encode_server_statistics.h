@@ -0,0 +1,126 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/encode_server_statistics.h
+ *  @brief EncodeServerStatistics class.
+ */
+
+
+#ifndef DCPOMATIC_ENCODE_SERVER_STATISTICS_H
+#define DCPOMATIC_ENCODE_SERVER_STATISTICS_H
+
+
+#include "event_history.h"
+#include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/** @class EncodeServerStatistics
+ *  @brief Throughput and latency of each remote encode server that we have used.
+ *
+ *  RemoteJ2KEncoderThreads report here when they send a frame to a server, and when
+ *  they get it back (or fail to).  J2KEncoder uses the latencies to decide when a frame
+ *  has been away for too long, and the statistics are shown in the encode servers dialog
+ *  and by the JSON server.
+ */
+class EncodeServerStatistics
+{
+public:
+	EncodeServerStatistics(EncodeServerStatistics const&) = delete;
+	EncodeServerStatistics& operator=(EncodeServerStatistics const&) = delete;
+
+	/** A frame has been sent to a server */
+	void sent(std::string const& host_name);
+	/** A frame has come back from a server.
+	 *  @param latency Time from sending it to receiving it, in seconds.
+	 */
+	void received(std::string const& host_name, float latency);
+	/** Some frames that were sent to a server failed to come back */
+	void failed(std::string const& host_name, int frames);
+	/** Some frames that were sent to a server will not be waited for, though nothing went wrong;
+	 *  for example, the thread that sent them has been stopped.
+	 */
+	void abandoned(std::string const& host_name, int frames);
+	/** A frame which was sent to a server was given to another encoder because it was taking too long */
+	void redispatched(std::string const& host_name);
+
+	/** @return Smoothed latency of a server in seconds, if we have heard back from it */
+	boost::optional<float> latency(std::string const& host_name) const;
+	/** @return Smallest smoothed latency of any server */
+	boost::optional<float> best_latency() const;
+
+	struct Server
+	{
+		std::string host_name;
+		/** Frames per second over the last few frames */
+		boost::optional<float> rate;
+		/** Smoothed time from sending a frame to getting it back, in seconds */
+		boost::optional<float> latency;
+		/** Number of frames currently sent but not received */
+		int in_flight = 0;
+		/** Number of frames received */
+		int frames = 0;
+		/** Number of frames which failed */
+		int failures = 0;
+		/** Number of frames which were given to another encoder because they were taking too long */
+		int redispatched = 0;
+	};
+
+	/** @return Statistics for each server, sorted by host name */
+	std::vector<Server> servers() const;
+
+	/** Forget everything */
+	void clear();
+
+	static EncodeServerStatistics* instance();
+
+	/** Weight given to each new latency measurement in the smoothed value */
+	static float constexpr latency_weight = 0.2;
+
+private:
+	EncodeServerStatistics() = default;
+
+	struct Entry
+	{
+		Entry()
+			: history(16)
+		{}
+
+		EventHistory history;
+		boost::optional<float> latency;
+		int in_flight = 0;
+		int failures = 0;
+		int redispatched = 0;
+	};
+
+	std::shared_ptr<Entry> entry(std::string const& host_name);
+
+	/** Mutex for _servers and the things in it (apart from their histories, which have their own) */
+	mutable boost::mutex _mutex;
+	std::map<std::string, std::shared_ptr<Entry>> _servers;
+};
+
+
+#endif
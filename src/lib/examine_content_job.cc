@@ -20,21 +20,72 @@
 
 
 #include "content.h"
+#include "dcpomatic_assert.h"
+#include "dcpomatic_log.h"
 #include "examine_content_job.h"
+#include "ffmpeg_content.h"
 #include "film.h"
 #include "log.h"
+#include "util.h"
+#include <dcp/scope_guard.h>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <list>
 
 #include "i18n.h"
 
 
 using std::cout;
+using std::dynamic_pointer_cast;
+using std::list;
+using std::make_shared;
+using std::max;
+using std::min;
 using std::shared_ptr;
 using std::string;
 using std::vector;
 
 
+int constexpr ExamineContentJob::io_bound_threads;
+
+
+/** A Job which is never started, but which is given to Content::examine() to collect the
+ *  progress of examining one piece of content while others are examined at the same time.
+ */
+class ExamineContentJob::Item : public Job
+{
+public:
+	Item(shared_ptr<const Film> film, shared_ptr<Content> content_)
+		: Job(film)
+		, content(content_)
+	{}
+
+	~Item()
+	{
+		stop_thread();
+	}
+
+	string name() const override {
+		return _("Examining content");
+	}
+
+	string json_name() const override {
+		return N_("examine_content_item");
+	}
+
+	void run() override {
+		DCPOMATIC_ASSERT(false);
+	}
+
+	shared_ptr<Content> content;
+	/** true when this content has been examined, or examining it failed */
+	std::atomic<bool> done{false};
+};
+
+
 ExamineContentJob::ExamineContentJob(shared_ptr<const Film> film, vector<shared_ptr<Content>> content, bool tolerant)
 	: Job(film)
 	, _content(std::move(content))
@@ -64,15 +115,130 @@ ExamineContentJob::json_name() const
 }
 
 
+/** @return Maximum number of content items to examine at once where examining means decoding */
+int
+ExamineContentJob::cpu_bound_threads()
+{
+	/* FFmpeg can use several threads for each decode, so don't go mad */
+	return max(1, static_cast<int>(boost::thread::hardware_concurrency()) / 2);
+}
+
+
 void
 ExamineContentJob::run()
 {
-	int n = 0;
-	for (auto c: _content) {
-		c->examine(_film, shared_from_this(), _tolerant);
-		set_progress(float(n) / _content.size());
-		++n;
+	if (_content.size() == 1) {
+		/* No need for any threads; this way the sub-job names and progress from the examiner come straight through */
+		_content.front()->examine(_film, shared_from_this(), _tolerant);
+	} else {
+		vector<shared_ptr<Item>> items;
+		for (auto c: _content) {
+			items.push_back(make_shared<Item>(_film, c));
+		}
+		examine(items);
 	}
+
 	set_progress(1);
 	set_state(FINISHED_OK);
 }
+
+
+/** Examine some content, using one pool of threads for content that needs decoding and
+ *  another for content where we mostly read files.  The progress of each piece of content is
+ *  combined into ours.
+ */
+void
+ExamineContentJob::examine(vector<shared_ptr<Item>> items)
+{
+	/* Items which are waiting to be examined; protected by mutex */
+	list<shared_ptr<Item>> cpu_bound;
+	list<shared_ptr<Item>> io_bound;
+	boost::mutex mutex;
+
+	for (auto item: items) {
+		if (dynamic_pointer_cast<FFmpegContent>(item->content)) {
+			cpu_bound.push_back(item);
+		} else {
+			io_bound.push_back(item);
+		}
+	}
+
+	LOG_GENERAL("Examining {} pieces of content: {} to decode and {} to read", items.size(), cpu_bound.size(), io_bound.size());
+
+	/* Number of worker threads which have not yet finished */
+	std::atomic<int> workers(0);
+
+	auto worker = [this, &mutex, &cpu_bound, &io_bound, &workers](list<shared_ptr<Item>>& queue) {
+		start_of_thread("ExamineContent");
+		dcp::ScopeGuard sg([&workers]() { --workers; });
+
+		while (true) {
+			shared_ptr<Item> item;
+			{
+				boost::mutex::scoped_lock lm(mutex);
+				if (queue.empty()) {
+					return;
+				}
+				item = queue.front();
+				queue.pop_front();
+			}
+
+			try {
+				item->content->examine(_film, item, _tolerant);
+			} catch (boost::thread_interrupted&) {
+				item->done = true;
+				return;
+			} catch (...) {
+				{
+					boost::mutex::scoped_lock lm(_exception_mutex);
+					if (!_exception) {
+						_exception = std::current_exception();
+					}
+				}
+				/* Don't bother examining anything else */
+				boost::mutex::scoped_lock lm(mutex);
+				cpu_bound.clear();
+				io_bound.clear();
+			}
+
+			item->done = true;
+		}
+	};
+
+	int const cpu_threads = min(cpu_bound_threads(), static_cast<int>(cpu_bound.size()));
+	int const io_threads = min(io_bound_threads, static_cast<int>(io_bound.size()));
+	workers = cpu_threads + io_threads;
+
+	boost::thread_group threads;
+	for (int i = 0; i < cpu_threads; ++i) {
+		threads.create_thread([&worker, &cpu_bound]() { worker(cpu_bound); });
+	}
+	for (int i = 0; i < io_threads; ++i) {
+		threads.create_thread([&worker, &io_bound]() { worker(io_bound); });
+	}
+
+	try {
+		while (workers > 0) {
+			float progress = 0;
+			for (auto item: items) {
+				progress += item->done ? 1 : item->progress().get_value_or(0);
+			}
+			set_progress(progress / items.size());
+			boost::this_thread::sleep(boost::posix_time::milliseconds(250));
+		}
+	} catch (boost::thread_interrupted&) {
+		/* We have been cancelled */
+		threads.interrupt_all();
+		threads.join_all();
+		throw;
+	}
+
+	threads.join_all();
+
+	boost::mutex::scoped_lock lm(_exception_mutex);
+	if (_exception) {
+		auto e = _exception;
+		_exception = nullptr;
+		std::rethrow_exception(e);
+	}
+}
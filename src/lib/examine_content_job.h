@@ -20,6 +20,8 @@
 
 
 #include "job.h"
+#include <boost/thread/mutex.hpp>
+#include <exception>
 
 
 class Content;
@@ -39,8 +41,24 @@ public:
 		return _content;
 	}
 
+	/** Maximum number of content items to examine at once where examining is mostly
+	 *  a matter of reading files (image sequences, subtitles, DCPs and so on).
+	 */
+	static int constexpr io_bound_threads = 4;
+
+	static int cpu_bound_threads();
+
 private:
+	class Item;
+
+	void examine(std::vector<std::shared_ptr<Item>> items);
+
 	std::vector<std::shared_ptr<Content>> _content;
 
 	bool _tolerant;
+
+	/** mutex for _exception */
+	boost::mutex _exception_mutex;
+	/** the first exception thrown while examining a piece of content, if any */
+	std::exception_ptr _exception;
 };
@@ -23,11 +23,14 @@
 #include "dcpomatic_log.h"
 #include "digester.h"
 #include "disk_writer_messages.h"
+#include "exception_store.h"
 #include "exceptions.h"
 #include "ext.h"
 #include "nanomsg.h"
+#include "util.h"
 #include <dcp/file.h>
 #include <dcp/filesystem.h>
+#include <dcp/scope_guard.h>
 
 #ifdef DCPOMATIC_LINUX
 #include <linux/fs.h>
@@ -58,7 +61,14 @@ extern "C" {
 #include <lwext4/ext4_mkfs.h>
 }
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/throw_exception.hpp>
+#include <atomic>
 #include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
 #include <string>
 
 
@@ -74,6 +84,11 @@ using std::vector;
 
 /* Use quite a big block size here, as ext4's fwrite() has quite a bit of overhead */
 uint64_t constexpr block_size = 4096 * 4096;
+/* Number of blocks going round each copy or verify pipeline; enough for every stage to have one
+ * to work on with one spare.
+ */
+int constexpr block_count = 4;
+uintptr_t constexpr block_alignment = 4096;
 
 
 static
@@ -106,101 +121,194 @@ set_timestamps_to_now(boost::filesystem::path path)
 }
 
 
-static
-string
-write(boost::filesystem::path from, boost::filesystem::path to, uint64_t& total_remaining, uint64_t total, Nanomsg* nanomsg)
-{
-	ext4_file out;
-	int r = ext4_fopen(&out, to.generic_string().c_str(), "wb");
-	if (r != EOK) {
-		throw CopyError(fmt::format("Failed to open file {}", to.generic_string()), r, ext4_blockdev_errno);
-	}
+namespace {
 
-	dcp::File in(from, "rb");
-	if (!in) {
-		ext4_fclose(&out);
-		throw CopyError(fmt::format("Failed to open file {}", from.string()), 0);
+
+/** A buffer which is passed between the stages of a copy or verify */
+class Block
+{
+public:
+	Block()
+		: storage(block_size + block_alignment)
+	{
+		auto const offset = reinterpret_cast<uintptr_t>(storage.data()) % block_alignment;
+		data = storage.data() + (offset ? block_alignment - offset : 0);
 	}
 
-	std::vector<uint8_t> buffer(block_size);
-	Digester digester;
+	Block(Block const&) = delete;
+	Block& operator=(Block const&) = delete;
+
+	std::vector<uint8_t> storage;
+	/** start of the data, aligned to block_alignment within storage */
+	uint8_t* data;
+	/** index of the file that this data came from */
+	size_t file = 0;
+	/** number of bytes of data */
+	uint64_t size = 0;
+	bool first = false;
+	bool last = false;
+	/** digest of the whole file; set by the hash stage on the last block of a file */
+	string digest;
+};
 
-	int progress_frequency = 1;
-	int progress_count = 0;
-	uint64_t remaining = file_size(from);
-	while (remaining > 0) {
-		uint64_t const this_time = min(remaining, block_size);
-		size_t read = in.read(buffer.data(), 1, this_time);
-		if (read != this_time) {
-			ext4_fclose(&out);
-			throw CopyError(fmt::format("Short read; expected {} but read {}", this_time, read), 0, ext4_blockdev_errno);
-		}
 
-		digester.add(buffer.data(), this_time);
+/** A queue of blocks waiting for the next stage */
+class BlockQueue
+{
+public:
+	void push(Block* block)
+	{
+		boost::mutex::scoped_lock lm(_mutex);
+		_blocks.push_back(block);
+		_condition.notify_all();
+	}
 
-		size_t written;
-		r = ext4_fwrite(&out, buffer.data(), this_time, &written);
-		if (r != EOK) {
-			ext4_fclose(&out);
-			throw CopyError("Write failed", r, ext4_blockdev_errno);
-		}
-		if (written != this_time) {
-			ext4_fclose(&out);
-			throw CopyError(fmt::format("Short write; expected {} but wrote {}", this_time, written), 0, ext4_blockdev_errno);
+	/** @return the next block, or nullptr if the queue has been closed and is empty, or if it has been aborted */
+	Block* pop()
+	{
+		boost::mutex::scoped_lock lm(_mutex);
+		while (_blocks.empty() && !_closed && !_aborted) {
+			_condition.wait(lm);
 		}
-		remaining -= this_time;
-		total_remaining -= this_time;
 
-		++progress_count;
-		if ((progress_count % progress_frequency) == 0 && nanomsg) {
-			DiskWriterBackEndResponse::copy_progress(1 - float(total_remaining) / total).write_to_nanomsg(*nanomsg, SHORT_TIMEOUT);
+		if (_aborted || _blocks.empty()) {
+			return nullptr;
 		}
+
+		auto block = _blocks.front();
+		_blocks.pop_front();
+		return block;
 	}
 
-	ext4_fclose(&out);
+	/** Say that nothing more will be pushed */
+	void close()
+	{
+		boost::mutex::scoped_lock lm(_mutex);
+		_closed = true;
+		_condition.notify_all();
+	}
 
-	set_timestamps_to_now(to);
+	void abort()
+	{
+		boost::mutex::scoped_lock lm(_mutex);
+		_aborted = true;
+		_condition.notify_all();
+	}
 
-	return digester.get();
-}
+private:
+	boost::mutex _mutex;
+	boost::condition _condition;
+	std::list<Block*> _blocks;
+	bool _closed = false;
+	bool _aborted = false;
+};
 
 
-static
-string
-read(boost::filesystem::path from, boost::filesystem::path to, uint64_t& total_remaining, uint64_t total, Nanomsg* nanomsg)
+/** Amount of data that one stage has processed and the time it spent doing it,
+ *  not counting time spent waiting for the other stages.
+ */
+class Rate
 {
-	ext4_file in;
-	LOG_DISK("Opening {} for read", to.generic_string());
-	int r = ext4_fopen(&in, to.generic_string().c_str(), "rb");
-	if (r != EOK) {
-		throw VerifyError(fmt::format("Failed to open file {}", to.generic_string()), r);
+public:
+	void add(uint64_t bytes, std::chrono::steady_clock::time_point start)
+	{
+		_bytes += bytes;
+		_microseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
 	}
-	LOG_DISK("Opened {} for read", to.generic_string());
 
-	std::vector<uint8_t> buffer(block_size);
-	Digester digester;
+	/** @return MB/s that this stage managed while it was busy */
+	float mb_per_second() const
+	{
+		auto const microseconds = _microseconds.load();
+		/* bytes per microsecond is the same as MB per second */
+		return microseconds ? static_cast<float>(_bytes.load()) / microseconds : 0;
+	}
 
-	uint64_t remaining = file_size(from);
-	while (remaining > 0) {
-		uint64_t const this_time = min(remaining, block_size);
-		size_t read;
-		r = ext4_fread(&in, buffer.data(), this_time, &read);
-		if (read != this_time) {
-			ext4_fclose(&in);
-			throw VerifyError(fmt::format("Short read; expected {} but read {}", this_time, read), 0);
+private:
+	std::atomic<uint64_t> _bytes{0};
+	std::atomic<uint64_t> _microseconds{0};
+};
+
+
+/** A set of blocks going round between a read stage, a hash stage and (when copying) a write stage,
+ *  each of which may run in its own thread.  Blocks go from `free' to `to_hash' to `to_write' and then
+ *  back to `free', so the slowest stage sets the speed of the whole thing.
+ *
+ *  Stages run with run() should throw using boost::throw_exception() so that the type of the exception
+ *  survives the trip through the ExceptionStore.
+ */
+class Pipeline : public ExceptionStore
+{
+public:
+	Pipeline()
+	{
+		for (int i = 0; i < block_count; ++i) {
+			_blocks.push_back(std::unique_ptr<Block>(new Block()));
+			free.push(_blocks.back().get());
 		}
+	}
 
-		digester.add(buffer.data(), this_time);
-		remaining -= this_time;
-		total_remaining -= this_time;
-		if (nanomsg) {
-			DiskWriterBackEndResponse::verify_progress(1 - float(total_remaining) / total).write_to_nanomsg(*nanomsg, SHORT_TIMEOUT);
+	Pipeline(Pipeline const&) = delete;
+	Pipeline& operator=(Pipeline const&) = delete;
+
+	~Pipeline()
+	{
+		abort();
+		join();
+	}
+
+	/** Run a stage in a new thread.  If it throws, the exception is stored and the pipeline is aborted */
+	void run(string name, std::function<void ()> stage)
+	{
+		_threads.push_back(boost::thread([this, name, stage]() {
+			start_of_thread(name);
+			try {
+				stage();
+			} catch (...) {
+				store_current();
+				abort();
+			}
+		}));
+	}
+
+	void abort()
+	{
+		free.abort();
+		to_hash.abort();
+		to_write.abort();
+	}
+
+	/** Wait for the threads started by run() to finish, then rethrow anything that they threw */
+	void finish()
+	{
+		join();
+		rethrow();
+	}
+
+	BlockQueue free;
+	BlockQueue to_hash;
+	BlockQueue to_write;
+
+	Rate read_rate;
+	Rate hash_rate;
+	Rate write_rate;
+
+private:
+	void join()
+	{
+		for (auto& thread: _threads) {
+			if (thread.joinable()) {
+				thread.join();
+			}
 		}
+		_threads.clear();
 	}
 
-	ext4_fclose(&in);
+	std::vector<std::unique_ptr<Block>> _blocks;
+	std::vector<boost::thread> _threads;
+};
+
 
-	return digester.get();
 }
 
 
@@ -220,12 +328,148 @@ public:
 };
 
 
-/** @param from File to copy from.
+/** Hash stage for write() and verify(): add each block from `to_hash' to a digest of its file,
+ *  setting the block's digest if it is the last in the file, then give it to `next'.
+ */
+static
+void
+hash(Pipeline& pipeline, std::function<void (Block*)> next)
+{
+	std::unique_ptr<Digester> digester;
+
+	while (auto block = pipeline.to_hash.pop()) {
+		auto const start = std::chrono::steady_clock::now();
+		if (block->first) {
+			digester.reset(new Digester());
+		}
+		digester->add(block->data, block->size);
+		if (block->last) {
+			block->digest = digester->get();
+		}
+		pipeline.hash_rate.add(block->size, start);
+		next(block);
+	}
+}
+
+
+/** Copy some files from the source to the drive, filling in their write_digests.  One thread reads from the
+ *  source, another hashes what was read and this thread writes to the drive.
+ */
+static
+void
+write(vector<CopiedFile>& files, uint64_t total, Nanomsg* nanomsg)
+{
+	Pipeline pipeline;
+	uint64_t total_remaining = total;
+
+	pipeline.run("ext-read", [&pipeline, &files]() {
+		for (size_t i = 0; i < files.size(); ++i) {
+			dcp::File in(files[i].from, "rb");
+			if (!in) {
+				boost::throw_exception(CopyError(fmt::format("Failed to open file {}", files[i].from.string()), 0));
+			}
+
+			uint64_t remaining = file_size(files[i].from);
+			bool first = true;
+			do {
+				auto block = pipeline.free.pop();
+				if (!block) {
+					return;
+				}
+				auto const start = std::chrono::steady_clock::now();
+				block->file = i;
+				block->size = min(remaining, block_size);
+				block->first = first;
+				block->last = block->size == remaining;
+				size_t read = in.read(block->data, 1, block->size);
+				if (read != block->size) {
+					boost::throw_exception(CopyError(fmt::format("Short read; expected {} but read {}", block->size, read), 0, ext4_blockdev_errno));
+				}
+				pipeline.read_rate.add(block->size, start);
+				remaining -= block->size;
+				first = false;
+				pipeline.to_hash.push(block);
+			} while (remaining > 0);
+		}
+		pipeline.to_hash.close();
+	});
+
+	pipeline.run("ext-hash", [&pipeline]() {
+		hash(pipeline, [&pipeline](Block* block) {
+			pipeline.to_write.push(block);
+		});
+		pipeline.to_write.close();
+	});
+
+	ext4_file out;
+	bool out_open = false;
+	dcp::ScopeGuard sg([&out, &out_open]() {
+		if (out_open) {
+			ext4_fclose(&out);
+		}
+	});
+
+	while (auto block = pipeline.to_write.pop()) {
+		auto& file = files[block->file];
+		auto const start = std::chrono::steady_clock::now();
+
+		if (block->first) {
+			int r = ext4_fopen(&out, file.to.generic_string().c_str(), "wb");
+			if (r != EOK) {
+				throw CopyError(fmt::format("Failed to open file {}", file.to.generic_string()), r, ext4_blockdev_errno);
+			}
+			out_open = true;
+		}
+
+		if (block->size > 0) {
+			size_t written;
+			int r = ext4_fwrite(&out, block->data, block->size, &written);
+			if (r != EOK) {
+				throw CopyError("Write failed", r, ext4_blockdev_errno);
+			}
+			if (written != block->size) {
+				throw CopyError(fmt::format("Short write; expected {} but wrote {}", block->size, written), 0, ext4_blockdev_errno);
+			}
+		}
+
+		if (block->last) {
+			ext4_fclose(&out);
+			out_open = false;
+			set_timestamps_to_now(file.to);
+			file.write_digest = block->digest;
+			LOG_DISK("Wrote {} {} with {}", file.from.string(), file.to.generic_string(), file.write_digest);
+		}
+
+		pipeline.write_rate.add(block->size, start);
+		total_remaining -= block->size;
+		pipeline.free.push(block);
+
+		if (nanomsg) {
+			DiskWriterBackEndResponse::copy_progress(
+				1 - float(total_remaining) / total,
+				pipeline.read_rate.mb_per_second(),
+				pipeline.hash_rate.mb_per_second(),
+				pipeline.write_rate.mb_per_second()
+				).write_to_nanomsg(*nanomsg, SHORT_TIMEOUT);
+		}
+	}
+
+	pipeline.finish();
+
+	LOG_DISK(
+		"Copy rates: read {} MB/s, hash {} MB/s, write {} MB/s",
+		pipeline.read_rate.mb_per_second(), pipeline.hash_rate.mb_per_second(), pipeline.write_rate.mb_per_second()
+		);
+}
+
+
+/** Make the directories that we need on the drive, and make a list of the files that must be copied.
+ *  @param from File or directory to copy from.
  *  @param to Directory to copy to.
  */
 static
 void
-copy(boost::filesystem::path from, boost::filesystem::path to, uint64_t& total_remaining, uint64_t total, vector<CopiedFile>& copied_files, Nanomsg* nanomsg)
+copy(boost::filesystem::path from, boost::filesystem::path to, vector<CopiedFile>& files)
 {
 	LOG_DISK("Copy {} -> {}", from.string(), to.generic_string());
 	from = dcp::filesystem::fix_long_path(from);
@@ -242,28 +486,93 @@ copy(boost::filesystem::path from, boost::filesystem::path to, uint64_t& total_r
 		set_timestamps_to_now(cr);
 
 		for (auto i: directory_iterator(from)) {
-			copy(i.path(), cr, total_remaining, total, copied_files, nanomsg);
+			copy(i.path(), cr, files);
 		}
 	} else {
-		string const write_digest = write(from, cr, total_remaining, total, nanomsg);
-		LOG_DISK("Wrote {} {} with {}", from.string(), cr.generic_string(), write_digest);
-		copied_files.push_back(CopiedFile(from, cr, write_digest));
+		files.push_back(CopiedFile(from, cr, {}));
 	}
 }
 
 
+/** Read back some files that we copied and check that their digests are the same as when they were written.
+ *  This thread reads from the drive while another hashes and checks what has been read.
+ */
 static
 void
-verify(vector<CopiedFile> const& copied_files, uint64_t total, Nanomsg* nanomsg)
+verify(vector<CopiedFile> const& files, uint64_t total, Nanomsg* nanomsg)
 {
+	Pipeline pipeline;
+
+	pipeline.run("ext-hash", [&pipeline, &files]() {
+		hash(pipeline, [&pipeline, &files](Block* block) {
+			if (block->last) {
+				auto const& file = files[block->file];
+				LOG_DISK("Read {} {} was {} on write, now {}", file.from.string(), file.to.generic_string(), file.write_digest, block->digest);
+				if (block->digest != file.write_digest) {
+					boost::throw_exception(VerifyError("Hash of written data is incorrect", 0));
+				}
+			}
+			pipeline.free.push(block);
+		});
+	});
+
 	uint64_t total_remaining = total;
-	for (auto const& i: copied_files) {
-		string const read_digest = read(i.from, i.to, total_remaining, total, nanomsg);
-		LOG_DISK("Read {} {} was {} on write, now {}", i.from.string(), i.to.generic_string(), i.write_digest, read_digest);
-		if (read_digest != i.write_digest) {
-			throw VerifyError("Hash of written data is incorrect", 0);
+
+	for (size_t i = 0; i < files.size(); ++i) {
+		auto const& file = files[i];
+
+		ext4_file in;
+		LOG_DISK("Opening {} for read", file.to.generic_string());
+		int r = ext4_fopen(&in, file.to.generic_string().c_str(), "rb");
+		if (r != EOK) {
+			throw VerifyError(fmt::format("Failed to open file {}", file.to.generic_string()), r);
 		}
+		dcp::ScopeGuard sg([&in]() {
+			ext4_fclose(&in);
+		});
+		LOG_DISK("Opened {} for read", file.to.generic_string());
+
+		uint64_t remaining = file_size(file.from);
+		bool first = true;
+		do {
+			auto block = pipeline.free.pop();
+			if (!block) {
+				/* The hash stage failed, so this will throw its exception */
+				pipeline.finish();
+				return;
+			}
+			auto const start = std::chrono::steady_clock::now();
+			block->file = i;
+			block->size = min(remaining, block_size);
+			block->first = first;
+			block->last = block->size == remaining;
+			size_t read = 0;
+			if (block->size > 0) {
+				ext4_fread(&in, block->data, block->size, &read);
+			}
+			if (read != block->size) {
+				throw VerifyError(fmt::format("Short read; expected {} but read {}", block->size, read), 0);
+			}
+			pipeline.read_rate.add(block->size, start);
+			remaining -= block->size;
+			total_remaining -= block->size;
+			first = false;
+			pipeline.to_hash.push(block);
+
+			if (nanomsg) {
+				DiskWriterBackEndResponse::verify_progress(
+					1 - float(total_remaining) / total,
+					pipeline.read_rate.mb_per_second(),
+					pipeline.hash_rate.mb_per_second()
+					).write_to_nanomsg(*nanomsg, SHORT_TIMEOUT);
+			}
+		} while (remaining > 0);
 	}
+
+	pipeline.to_hash.close();
+	pipeline.finish();
+
+	LOG_DISK("Verify rates: read {} MB/s, hash {} MB/s", pipeline.read_rate.mb_per_second(), pipeline.hash_rate.mb_per_second());
 }
 
 
@@ -394,12 +703,13 @@ try
 	uint64_t total_bytes = 0;
 	count(dcp_paths, total_bytes);
 
-	uint64_t total_remaining = total_bytes;
 	vector<CopiedFile> copied_files;
 	for (auto dcp_path: dcp_paths) {
-		copy(dcp_path, "/mp", total_remaining, total_bytes, copied_files, nanomsg);
+		copy(dcp_path, "/mp", copied_files);
 	}
 
+	write(copied_files, total_bytes, nanomsg);
+
 	/* Unmount and re-mount to make sure the write has finished */
 	r = ext4_umount("/mp/");
 	if (r != EOK) {
@@ -37,6 +37,7 @@ extern "C" {
 #include <libswscale/swscale.h>
 }
 #include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
 #include <iostream>
 
 #include "i18n.h"
@@ -45,6 +46,8 @@ extern "C" {
 using std::string;
 using std::cout;
 using std::cerr;
+using std::max;
+using std::min;
 using std::vector;
 using std::shared_ptr;
 using boost::optional;
@@ -184,7 +187,7 @@ FFmpeg::setup_decoder(int stream_index)
 			throw DecodeError("avcodec_parameters_to_context", "FFmpeg::setup_decoders", r);
 		}
 
-		context->thread_count = 8;
+		context->thread_count = decode_threads(stream_index);
 		context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
 
 		AVDictionary* options = nullptr;
@@ -210,6 +213,28 @@ FFmpeg::setup_decoder(int stream_index)
 }
 
 
+/** @return Number of threads that FFmpeg should use to decode a stream */
+int
+FFmpeg::decode_threads(int stream_index) const
+{
+	auto const parameters = _format_context->streams[stream_index]->codecpar;
+	if (parameters->codec_type != AVMEDIA_TYPE_VIDEO) {
+		/* Audio and subtitles are cheap to decode, and their decoders can rarely use threads anyway */
+		return 1;
+	}
+
+	if (auto const threads = Config::instance()->ffmpeg_decode_threads()) {
+		return threads;
+	}
+
+	/* Each frame thread holds a frame in flight, costing memory and latency, so there is
+	   no point having lots of them unless the pictures are big enough to need it.
+	*/
+	int const limit = parameters->width * parameters->height > 2048 * 1080 ? 16 : 8;
+	return max(1, min(static_cast<int>(boost::thread::hardware_concurrency()), limit));
+}
+
+
 AVCodecContext *
 FFmpeg::video_codec_context() const
 {
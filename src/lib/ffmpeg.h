@@ -93,6 +93,7 @@ protected:
 private:
 	void setup_general();
 	void setup_decoders();
+	int decode_threads(int stream_index) const;
 
 	/** AVFrames used for decoding audio streams; accessed with audio_frame() */
 	std::map<std::shared_ptr<const FFmpegAudioStream>, AVFrame*> _audio_frame;
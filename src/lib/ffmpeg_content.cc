@@ -22,6 +22,7 @@
 #include "audio_content.h"
 #include "config.h"
 #include "constants.h"
+#include "dcpomatic_log.h"
 #include "exceptions.h"
 #include "ffmpeg_audio_stream.h"
 #include "ffmpeg_content.h"
@@ -42,6 +43,7 @@ extern "C" {
 }
 #include <libxml++/libxml++.h>
 #include <fmt/format.h>
+#include <algorithm>
 #include <iostream>
 
 #include "i18n.h"
@@ -123,6 +125,7 @@ FFmpegContent::FFmpegContent(cxml::ConstNodePtr node, boost::optional<boost::fil
 	_color_trc = get_optional_enum<AVColorTransferCharacteristic>(node, "ColorTransferCharacteristic");
 	_colorspace = get_optional_enum<AVColorSpace>(node, "Colorspace");
 	_bits_per_pixel = node->optional_number_child<int>("BitsPerPixel");
+	_examined_with_fast_path = node->optional_bool_child("ExaminedWithFastPath").get_value_or(false);
 }
 
 
@@ -185,6 +188,9 @@ FFmpegContent::FFmpegContent(vector<shared_ptr<Content>> c)
 	_color_trc = ref->_color_trc;
 	_colorspace = ref->_colorspace;
 	_bits_per_pixel = ref->_bits_per_pixel;
+	_examined_with_fast_path = std::any_of(c.begin(), c.end(), [](shared_ptr<Content> content) {
+		return dynamic_pointer_cast<FFmpegContent>(content)->examined_with_fast_path();
+	});
 }
 
 
@@ -245,6 +251,9 @@ FFmpegContent::as_xml(xmlpp::Element* element, bool with_paths, PathBehaviour pa
 	if (_bits_per_pixel) {
 		cxml::add_text_child(element, "BitsPerPixel", fmt::to_string(*_bits_per_pixel));
 	}
+	if (_examined_with_fast_path) {
+		cxml::add_text_child(element, "ExaminedWithFastPath", "1");
+	}
 }
 
 
@@ -279,6 +288,7 @@ FFmpegContent::examine(shared_ptr<const Film> film, shared_ptr<Job> job, bool to
 			_color_trc = examiner->color_trc();
 			_colorspace = examiner->colorspace();
 			_bits_per_pixel = examiner->bits_per_pixel();
+			_examined_with_fast_path = examiner->examined_with_fast_path();
 
 			if (examiner->rotation()) {
 				auto rot = *examiner->rotation();
@@ -334,6 +344,50 @@ FFmpegContent::examine(shared_ptr<const Film> film, shared_ptr<Job> job, bool to
 }
 
 
+/** Read the whole of this content to check the lengths that were found when it was examined
+ *  using the container's index, correcting them if required.
+ */
+void
+FFmpegContent::check_length(shared_ptr<Job> job)
+{
+	auto examiner = make_shared<FFmpegExaminer>(shared_from_this(), job, false);
+
+	if (video && examiner->has_video()) {
+		auto length = examiner->video_length();
+		if (examiner->pulldown() && examiner->video_frame_rate() && fabs(*examiner->video_frame_rate() - 29.97) < 0.001) {
+			/* examine() will have done this too */
+			length = length * 24.0 / 30;
+		}
+		if (length != video->length()) {
+			LOG_GENERAL("Video length of {} was {} but is really {}", path(0).string(), video->length(), length);
+			video->set_length(length);
+		}
+	}
+
+	if (audio) {
+		vector<pair<shared_ptr<FFmpegAudioStream>, Frame>> changes;
+		auto streams = ffmpeg_audio_streams();
+		auto examined = examiner->audio_streams();
+		for (size_t i = 0; i < std::min(streams.size(), examined.size()); ++i) {
+			if (streams[i]->length() != examined[i]->length()) {
+				LOG_GENERAL("Length of audio stream {} of {} was {} but is really {}", i, path(0).string(), streams[i]->length(), examined[i]->length());
+				changes.push_back({streams[i], examined[i]->length()});
+			}
+		}
+
+		if (!changes.empty()) {
+			ContentChangeSignaller cc(this, AudioContentProperty::STREAMS);
+			for (auto const& change: changes) {
+				change.first->set_length(change.second);
+			}
+		}
+	}
+
+	boost::mutex::scoped_lock lm(_mutex);
+	_examined_with_fast_path = false;
+}
+
+
 string
 FFmpegContent::summary() const
 {
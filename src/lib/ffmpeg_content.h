@@ -113,6 +113,14 @@ public:
 
 	void signal_subtitle_stream_changed();
 
+	/** @return true if our length was found from the container's index rather than by reading the whole file */
+	bool examined_with_fast_path() const {
+		boost::mutex::scoped_lock lm(_mutex);
+		return _examined_with_fast_path;
+	}
+
+	void check_length(std::shared_ptr<Job> job);
+
 	/** Remove all IDs from any streams we have.  This is only for working around changes
 	 *  to stream identification in 2.18.26.
 	 */
@@ -135,6 +143,7 @@ private:
 	boost::optional<AVColorTransferCharacteristic> _color_trc;
 	boost::optional<AVColorSpace> _colorspace;
 	boost::optional<int> _bits_per_pixel;
+	bool _examined_with_fast_path = false;
 };
 
 #endif
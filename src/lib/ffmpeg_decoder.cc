@@ -27,11 +27,13 @@
 #include "audio_buffers.h"
 #include "audio_content.h"
 #include "audio_decoder.h"
+#include "config.h"
 #include "dcpomatic_log.h"
 #include "exceptions.h"
 #include "ffmpeg_audio_stream.h"
 #include "ffmpeg_content.h"
 #include "ffmpeg_decoder.h"
+#include "ffmpeg_read_ahead.h"
 #include "ffmpeg_subtitle_stream.h"
 #include "film.h"
 #include "filter.h"
@@ -112,6 +114,17 @@ FFmpegDecoder::FFmpegDecoder(shared_ptr<const Film> film, shared_ptr<const FFmpe
 	} else {
 		_packet_queue.reset(new PassthroughPacketQueue());
 	}
+
+	if (Config::instance()->ffmpeg_read_ahead()) {
+		_read_ahead.reset(new FFmpegReadAhead(_format_context));
+	}
+}
+
+
+FFmpegDecoder::~FFmpegDecoder()
+{
+	/* Stop reading before FFmpeg's destructor closes the AVFormatContext */
+	_read_ahead.reset();
 }
 
 
@@ -263,7 +276,7 @@ FFmpegDecoder::pass()
 	auto packet = av_packet_alloc();
 	DCPOMATIC_ASSERT(packet);
 
-	int r = av_read_frame(_format_context, packet);
+	int r = _read_ahead ? _read_ahead->read(packet) : av_read_frame(_format_context, packet);
 
 	/* AVERROR_INVALIDDATA can apparently be returned sometimes even when av_read_frame
 	   has pretty-much succeeded (and hence generated data which should be processed).
@@ -464,6 +477,11 @@ FFmpegDecoder::seek(ContentTime time, bool accurate)
 	_flush_state = FlushState::PACKET_QUEUE;
 	_packet_queue->clear();
 
+	if (_read_ahead) {
+		/* This must stop before we touch _format_context; it will start again on the next pass() */
+		_read_ahead->stop();
+	}
+
 	/* If we are doing an `accurate' seek, we need to use pre-roll, as
 	   we don't really know what the seek will give us.
 	*/
@@ -38,6 +38,7 @@ extern "C" {
 
 class AudioBuffers;
 class FFmpegAudioStream;
+class FFmpegReadAhead;
 class Image;
 class Log;
 class PacketQueue;
@@ -52,6 +53,7 @@ class FFmpegDecoder : public FFmpeg, public Decoder
 {
 public:
 	FFmpegDecoder(std::shared_ptr<const Film> film, std::shared_ptr<const FFmpegContent>, bool fast);
+	~FFmpegDecoder();
 
 	bool pass() override;
 	void seek(dcpomatic::ContentTime time, bool) override;
@@ -110,4 +112,6 @@ private:
 
 	std::vector<boost::optional<dcpomatic::ContentTime>> _dropped_time;
 	std::unique_ptr<PacketQueue> _packet_queue;
+	/** Thread to read packets ahead of us, or nullptr to read them ourselves */
+	std::unique_ptr<FFmpegReadAhead> _read_ahead;
 };
@@ -20,6 +20,7 @@
 
 
 #include "dcpomatic_log.h"
+#include "exceptions.h"
 #include "ffmpeg_examiner.h"
 #include "ffmpeg_content.h"
 #include "job.h"
@@ -38,6 +39,7 @@ extern "C" {
 #include <libavutil/eval.h>
 }
 LIBDCP_ENABLE_WARNINGS
+#include <algorithm>
 #include <iostream>
 
 #include "i18n.h"
@@ -58,12 +60,30 @@ using namespace dcpomatic;
  */
 static const int PULLDOWN_CHECK_FRAMES = 16;
 
+/* If a container says how long its video is but has no index, this is how far from the end
+ * we will go back to find the last frames.
+ */
+static const double END_SAMPLE_SECONDS = 10;
+
+
+/** @param job job that the examiner is operating in, or 0.
+ *  @param fast true to find the length of the content using the container's index, if it has
+ *  one which looks trustworthy, rather than by reading the whole file.
+ */
+FFmpegExaminer::FFmpegExaminer(shared_ptr<const FFmpegContent> c, shared_ptr<Job> job, bool fast)
+	: FFmpegExaminer(c, job, fast, false)
+{
+
+}
+
 
-/** @param job job that the examiner is operating in, or 0 */
-FFmpegExaminer::FFmpegExaminer(shared_ptr<const FFmpegContent> c, shared_ptr<Job> job)
+/** @param ignore_container_duration true to behave as if the container did not say how long the
+ *  content is.
+ */
+FFmpegExaminer::FFmpegExaminer(shared_ptr<const FFmpegContent> c, shared_ptr<Job> job, bool fast, bool ignore_container_duration)
 	: FFmpeg(c)
 {
-	_need_length = _format_context->duration == AV_NOPTS_VALUE;
+	_need_length = ignore_container_duration || _format_context->duration == AV_NOPTS_VALUE;
 	/* Find audio and subtitle streams */
 
 	for (uint32_t i = 0; i < _format_context->nb_streams; ++i) {
@@ -95,12 +115,22 @@ FFmpegExaminer::FFmpegExaminer(shared_ptr<const FFmpegContent> c, shared_ptr<Job
 		_video_length = _need_length ? 0 : llrint((double(_format_context->duration) / AV_TIME_BASE) * video_frame_rate().get());
 	}
 
+	check_for_duplicate_ids();
+
+	if (_need_length && fast && has_video()) {
+		if (job) {
+			job->set_progress_unknown();
+		}
+		if (examine_end()) {
+			_examined_with_fast_path = true;
+			_need_length = false;
+		}
+	}
+
 	if (job && _need_length) {
 		job->sub(_("Finding length"));
 	}
 
-	check_for_duplicate_ids();
-
 	/* Run through until we find:
 	 *   - the first video.
 	 *   - the first audio for each stream.
@@ -214,6 +244,167 @@ FFmpegExaminer::FFmpegExaminer(shared_ptr<const FFmpegContent> c, shared_ptr<Job
 	check_for_duplicate_ids();
 }
 
+
+/** Try to find the lengths of the video and audio without reading the whole file, by seeking to
+ *  the last keyframe in the container's index (or to a little before the end, if the container
+ *  only tells us its length) and decoding from there.  The place that we land and the length that
+ *  we find must agree with what the container said, otherwise we give up.
+ *
+ *  Whatever happens, the file is rewound to the start afterwards.
+ *
+ *  @return true if the lengths were found, false if the whole file must be read instead.
+ */
+bool
+FFmpegExaminer::examine_end()
+{
+	DCPOMATIC_ASSERT(_video_stream);
+
+	auto stream = _format_context->streams[*_video_stream];
+	auto const frame_rate = video_frame_rate().get();
+	auto const time_base = av_q2d(stream->time_base);
+	int64_t const start = stream->start_time == AV_NOPTS_VALUE ? 0 : stream->start_time;
+
+	/* The length that the container claims, measured from time 0 as the full scan does */
+	optional<Frame> expected;
+	if (stream->nb_frames > 0) {
+		expected = stream->nb_frames + llrint(start * time_base * frame_rate);
+	} else if (stream->duration != AV_NOPTS_VALUE && stream->duration > 0) {
+		expected = llrint((start + stream->duration) * time_base * frame_rate);
+	}
+
+	optional<int64_t> seek_to;
+	auto const entries = avformat_index_get_entries_count(stream);
+	if (entries > 0) {
+		seek_to = avformat_index_get_entry(stream, entries - 1)->timestamp;
+	} else if (expected) {
+		seek_to = std::max(start, static_cast<int64_t>(llrint((*expected / frame_rate - END_SAMPLE_SECONDS) / time_base)));
+	}
+
+	if (!seek_to) {
+		LOG_GENERAL_NC("Container has no index or length, so reading the whole file to find its length");
+		return false;
+	}
+
+	int r = av_seek_frame(_format_context, *_video_stream, *seek_to, AVSEEK_FLAG_BACKWARD);
+	if (r < 0) {
+		LOG_GENERAL("Could not seek to {} to find length ({})", *seek_to, r);
+		rewind();
+		return false;
+	}
+
+	for (auto context: _codec_context) {
+		if (context) {
+			avcodec_flush_buffers(context);
+		}
+	}
+
+	optional<ContentTime> first_video;
+	optional<ContentTime> last_video;
+	vector<optional<Frame>> audio_lengths(_audio_streams.size());
+
+	auto decode = [this, &first_video, &last_video, &audio_lengths](AVCodecContext* context, AVPacket* packet, optional<size_t> audio_stream_index) {
+		if (avcodec_send_packet(context, packet) < 0) {
+			return;
+		}
+		while (true) {
+			auto frame = audio_stream_index ? audio_frame(_audio_streams[*audio_stream_index]) : _video_frame;
+			if (avcodec_receive_frame(context, frame) < 0) {
+				break;
+			}
+			if (audio_stream_index) {
+				auto audio_stream = _audio_streams[*audio_stream_index];
+				if (auto t = frame_time(frame, audio_stream->stream(_format_context))) {
+					audio_lengths[*audio_stream_index] = t->frames_round(audio_stream->frame_rate()) + frame->nb_samples;
+				}
+			} else if (auto t = frame_time(frame, _format_context->streams[*_video_stream])) {
+				if (!first_video) {
+					first_video = t;
+				}
+				last_video = t;
+			}
+		}
+	};
+
+	while (true) {
+		auto packet = av_packet_alloc();
+		DCPOMATIC_ASSERT(packet);
+		if (av_read_frame(_format_context, packet) < 0) {
+			av_packet_free(&packet);
+			break;
+		}
+
+		if (packet->stream_index == *_video_stream) {
+			decode(_codec_context[packet->stream_index], packet, {});
+		} else {
+			for (size_t i = 0; i < _audio_streams.size(); ++i) {
+				if (_audio_streams[i]->uses_index(_format_context, packet->stream_index)) {
+					decode(_codec_context[packet->stream_index], packet, i);
+				}
+			}
+		}
+
+		av_packet_free(&packet);
+	}
+
+	decode(_codec_context[*_video_stream], nullptr, {});
+	for (size_t i = 0; i < _audio_streams.size(); ++i) {
+		decode(_codec_context[_audio_streams[i]->index(_format_context)], nullptr, i);
+	}
+
+	rewind();
+
+	if (!first_video || !last_video) {
+		LOG_GENERAL_NC("Found no video near the end of the file, so reading the whole file to find its length");
+		return false;
+	}
+
+	if (first_video->seconds() > (*seek_to * time_base + 1 / frame_rate)) {
+		LOG_GENERAL("Seek to {}s landed at {}s, so reading the whole file to find its length", *seek_to * time_base, first_video->seconds());
+		return false;
+	}
+
+	auto const video_length = last_video->frames_round(frame_rate) + 1;
+	if (expected && std::abs(video_length - *expected) > 1) {
+		LOG_GENERAL("Container says video length is {} but it looks like {}, so reading the whole file to find its length", *expected, video_length);
+		return false;
+	}
+
+	if (std::find(audio_lengths.begin(), audio_lengths.end(), optional<Frame>()) != audio_lengths.end()) {
+		LOG_GENERAL_NC("Found no audio near the end of the file, so reading the whole file to find its length");
+		return false;
+	}
+
+	_video_length = video_length;
+	for (size_t i = 0; i < _audio_streams.size(); ++i) {
+		_audio_streams[i]->set_length(*audio_lengths[i]);
+	}
+
+	LOG_GENERAL("Found video length {} from the container's index", _video_length);
+	return true;
+}
+
+
+/** Go back to the start of the file and reset the decoders */
+void
+FFmpegExaminer::rewind()
+{
+	auto stream = _format_context->streams[*_video_stream];
+	int r = av_seek_frame(_format_context, *_video_stream, stream->start_time == AV_NOPTS_VALUE ? 0 : stream->start_time, AVSEEK_FLAG_BACKWARD);
+	if (r < 0) {
+		r = av_seek_frame(_format_context, -1, 0, AVSEEK_FLAG_BYTE);
+	}
+	if (r < 0) {
+		throw DecodeError(N_("av_seek_frame"), N_("FFmpegExaminer::rewind"), r);
+	}
+
+	for (auto context: _codec_context) {
+		if (context) {
+			avcodec_flush_buffers(context);
+		}
+	}
+}
+
+
 void
 FFmpegExaminer::check_for_duplicate_ids()
 {
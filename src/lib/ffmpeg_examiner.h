@@ -33,7 +33,11 @@ class Job;
 class FFmpegExaminer : public FFmpeg, public VideoExaminer
 {
 public:
-	FFmpegExaminer(std::shared_ptr<const FFmpegContent>, std::shared_ptr<Job> job = std::shared_ptr<Job>());
+	FFmpegExaminer(
+		std::shared_ptr<const FFmpegContent>,
+		std::shared_ptr<Job> job = std::shared_ptr<Job>(),
+		bool fast = true
+		);
 
 	bool has_video() const override;
 
@@ -88,10 +92,28 @@ public:
 		return _pulldown;
 	}
 
+	/** @return true if the lengths were found using the container's index rather than by
+	 *  reading the whole file.
+	 */
+	bool examined_with_fast_path() const {
+		return _examined_with_fast_path;
+	}
+
+protected:
+	/** Constructor for tests, which can pretend that the container did not say how long the content is */
+	FFmpegExaminer(
+		std::shared_ptr<const FFmpegContent>,
+		std::shared_ptr<Job> job,
+		bool fast,
+		bool ignore_container_duration
+		);
+
 private:
 	bool video_packet(AVCodecContext* context, std::string& temporal_reference, AVPacket* packet);
 	bool audio_packet(AVCodecContext* context, std::shared_ptr<FFmpegAudioStream>, AVPacket* packet);
 	void check_for_duplicate_ids();
+	bool examine_end();
+	void rewind();
 
 	std::string stream_name(AVStream* s) const;
 	std::string subtitle_stream_name(AVStream* s) const;
@@ -105,6 +127,7 @@ private:
 	 */
 	Frame _video_length = 0;
 	bool _need_length = false;
+	bool _examined_with_fast_path = false;
 
 	boost::optional<double> _rotation;
 	bool _pulldown = false;
@@ -22,6 +22,7 @@
 #include "cross.h"
 #include "dcpomatic_assert.h"
 #include "dcpomatic_socket.h"
+#include "digester.h"
 #include "exceptions.h"
 #include "ffmpeg_image_proxy.h"
 #include "image.h"
@@ -37,6 +38,7 @@ extern "C" {
 #include <libxml++/libxml++.h>
 LIBDCP_ENABLE_WARNINGS
 #include <fmt/format.h>
+#include <zlib.h>
 #include <iostream>
 
 #include "i18n.h"
@@ -68,12 +70,31 @@ FFmpegImageProxy::FFmpegImageProxy(dcp::ArrayData data)
 
 }
 
-FFmpegImageProxy::FFmpegImageProxy(shared_ptr<Socket> socket)
+FFmpegImageProxy::FFmpegImageProxy(shared_ptr<Socket> socket, TransportEncoding encoding)
 	: _pos(0)
 {
 	uint32_t const size = socket->read_uint32();
 	_data = dcp::ArrayData(size);
-	socket->read(_data.data(), size);
+
+	switch (encoding) {
+	case TransportEncoding::NONE:
+		socket->read(_data.data(), size);
+		break;
+	case TransportEncoding::ZLIB:
+	{
+		auto const compressed_size = socket->read_uint32();
+		if (compressed_size > compressBound(size)) {
+			throw NetworkError(_("Unexpected compressed image size"));
+		}
+		std::unique_ptr<uint8_t[]> compressed(new uint8_t[compressed_size]);
+		socket->read(compressed.get(), compressed_size);
+		uLongf out_size = size;
+		if (uncompress(_data.data(), &out_size, compressed.get(), compressed_size) != Z_OK || out_size != size) {
+			throw NetworkError(_("Could not decompress image data"));
+		}
+		break;
+	}
+	}
 }
 
 static int
@@ -238,12 +259,37 @@ FFmpegImageProxy::add_metadata(xmlpp::Element* element) const
 }
 
 void
-FFmpegImageProxy::write_to_socket(shared_ptr<Socket> socket) const
+FFmpegImageProxy::write_to_socket(shared_ptr<Socket> socket, TransportEncoding encoding) const
 {
 	socket->write(_data.size());
-	socket->write(_data.data(), _data.size());
+
+	switch (encoding) {
+	case TransportEncoding::NONE:
+		socket->write(_data.data(), _data.size());
+		break;
+	case TransportEncoding::ZLIB:
+	{
+		/* Our file might be something like a DPX or TIFF which is not compressed */
+		uLongf compressed_size = compressBound(_data.size());
+		std::unique_ptr<uint8_t[]> compressed(new uint8_t[compressed_size]);
+		if (compress2(compressed.get(), &compressed_size, _data.data(), _data.size(), Z_BEST_SPEED) != Z_OK) {
+			throw NetworkError(_("Could not compress image data"));
+		}
+		socket->write(static_cast<uint32_t>(compressed_size));
+		socket->write(compressed.get(), compressed_size);
+		break;
+	}
+	}
 }
 
+
+void
+FFmpegImageProxy::add_to_digest(Digester& digester) const
+{
+	digester.add(_data.data(), _data.size());
+}
+
+
 bool
 FFmpegImageProxy::same(shared_ptr<const ImageProxy> other) const
 {
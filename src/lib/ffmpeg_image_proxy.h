@@ -28,7 +28,7 @@ class FFmpegImageProxy : public ImageProxy
 public:
 	explicit FFmpegImageProxy(boost::filesystem::path);
 	explicit FFmpegImageProxy(dcp::ArrayData);
-	explicit FFmpegImageProxy(std::shared_ptr<Socket> socket);
+	FFmpegImageProxy(std::shared_ptr<Socket> socket, TransportEncoding encoding);
 
 	Result image(
 		Image::Alignment alignment,
@@ -36,7 +36,8 @@ public:
 		) const override;
 
 	void add_metadata(xmlpp::Element*) const override;
-	void write_to_socket(std::shared_ptr<Socket>) const override;
+	void write_to_socket(std::shared_ptr<Socket>, TransportEncoding) const override;
+	void add_to_digest(Digester& digester) const override;
 	bool same(std::shared_ptr<const ImageProxy> other) const override;
 	size_t memory_used() const override;
 
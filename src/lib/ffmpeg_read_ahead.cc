@@ -0,0 +1,171 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "ffmpeg_read_ahead.h"
+#include "util.h"
+#include <dcp/warnings.h>
+LIBDCP_DISABLE_WARNINGS
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+LIBDCP_ENABLE_WARNINGS
+
+
+int constexpr FFmpegReadAhead::maximum_packets;
+size_t constexpr FFmpegReadAhead::maximum_bytes;
+
+
+FFmpegReadAhead::FFmpegReadAhead(AVFormatContext* context)
+	: _context(context)
+{
+
+}
+
+
+FFmpegReadAhead::~FFmpegReadAhead()
+{
+	stop();
+}
+
+
+/** Caller must hold a lock on _mutex */
+bool
+FFmpegReadAhead::full() const
+{
+	return static_cast<int>(_packets.size()) >= maximum_packets || _bytes >= maximum_bytes;
+}
+
+
+void
+FFmpegReadAhead::thread()
+try
+{
+	start_of_thread("FFmpegReadAhead");
+
+	while (true) {
+		{
+			boost::mutex::scoped_lock lm(_mutex);
+			while (full() && !_stop) {
+				_condition.wait(lm);
+			}
+			if (_stop) {
+				return;
+			}
+		}
+
+		auto packet = av_packet_alloc();
+		if (!packet) {
+			throw std::bad_alloc();
+		}
+
+		int const r = av_read_frame(_context, packet);
+
+		boost::mutex::scoped_lock lm(_mutex);
+		_packets.push_back(std::make_pair(packet, r));
+		_bytes += packet->size;
+		_condition.notify_all();
+
+		/* AVERROR_INVALIDDATA can come with a packet that is worth decoding, and
+		   more packets after it, so we carry on in that case.
+		*/
+		if (r < 0 && r != AVERROR_INVALIDDATA) {
+			return;
+		}
+	}
+}
+catch (...)
+{
+	store_current();
+	boost::mutex::scoped_lock lm(_mutex);
+	/* Make sure that read() does not wait for packets that will never come */
+	_error = AVERROR_EXIT;
+	_condition.notify_all();
+}
+
+
+int
+FFmpegReadAhead::read(AVPacket* packet)
+{
+	boost::mutex::scoped_lock lm(_mutex);
+
+	if (!_running) {
+		_running = true;
+		_stop = false;
+		_thread = boost::thread([this]() { this->thread(); });
+#ifdef DCPOMATIC_LINUX
+		pthread_setname_np(_thread.native_handle(), "ffmpeg-read-ahead");
+#endif
+	}
+
+	while (_packets.empty() && !_error) {
+		_condition.wait(lm);
+	}
+
+	if (_packets.empty()) {
+		lm.unlock();
+		rethrow();
+		return *_error;
+	}
+
+	auto next = _packets.front();
+	_packets.pop_front();
+	_bytes -= next.first->size;
+	_condition.notify_all();
+
+	if (next.second < 0 && next.second != AVERROR_INVALIDDATA) {
+		/* That was the last packet; anybody who asks again will get the same error */
+		_error = next.second;
+	}
+
+	lm.unlock();
+
+	av_packet_move_ref(packet, next.first);
+	av_packet_free(&next.first);
+	return next.second;
+}
+
+
+void
+FFmpegReadAhead::stop()
+{
+	{
+		boost::mutex::scoped_lock lm(_mutex);
+		if (!_running) {
+			return;
+		}
+		_stop = true;
+		_condition.notify_all();
+	}
+
+	try {
+		_thread.join();
+	} catch (...) {}
+
+	boost::mutex::scoped_lock lm(_mutex);
+	for (auto& i: _packets) {
+		av_packet_free(&i.first);
+	}
+	_packets.clear();
+	_bytes = 0;
+	_error = boost::none;
+	_running = false;
+}
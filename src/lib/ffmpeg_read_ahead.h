@@ -0,0 +1,96 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/ffmpeg_read_ahead.h
+ *  @brief FFmpegReadAhead class.
+ */
+
+
+#ifndef DCPOMATIC_FFMPEG_READ_AHEAD_H
+#define DCPOMATIC_FFMPEG_READ_AHEAD_H
+
+
+#include "exception_store.h"
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <deque>
+
+
+struct AVFormatContext;
+struct AVPacket;
+
+
+/** @class FFmpegReadAhead
+ *  @brief A thread which calls av_read_frame() on an AVFormatContext, keeping a queue of
+ *  packets ready for the decoder.
+ *
+ *  This means that the decoding thread does not have to wait for demuxing (and the disk)
+ *  before it can get on with decoding.  The packets come out of read() in exactly the order
+ *  that av_read_frame() gave them.
+ *
+ *  While the thread is running nothing else may use the AVFormatContext, except to look at
+ *  its streams; stop() must be called before seeking.  The thread is started by the first
+ *  read() after construction or stop().
+ */
+class FFmpegReadAhead : public ExceptionStore
+{
+public:
+	explicit FFmpegReadAhead(AVFormatContext* context);
+	~FFmpegReadAhead();
+
+	FFmpegReadAhead(FFmpegReadAhead const&) = delete;
+	FFmpegReadAhead& operator=(FFmpegReadAhead const&) = delete;
+
+	/** Get the next packet.  This is a replacement for av_read_frame(), with the same
+	 *  arguments and return value.
+	 */
+	int read(AVPacket* packet);
+
+	/** Stop the thread and discard any packets that it has read */
+	void stop();
+
+	/** Maximum number of packets to keep */
+	static int constexpr maximum_packets = 256;
+	/** Maximum total size of packets to keep, in bytes */
+	static size_t constexpr maximum_bytes = 64 * 1024 * 1024;
+
+private:
+	void thread();
+	bool full() const;
+
+	AVFormatContext* _context;
+
+	boost::thread _thread;
+	mutable boost::mutex _mutex;
+	boost::condition _condition;
+	/** Packets with the value that av_read_frame() returned when reading them */
+	std::deque<std::pair<AVPacket*, int>> _packets;
+	size_t _bytes = 0;
+	/** Error that av_read_frame() returned which means that there will be no more packets */
+	boost::optional<int> _error;
+	bool _running = false;
+	bool _stop = false;
+};
+
+
+#endif
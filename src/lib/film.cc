@@ -315,6 +315,12 @@ Film::audio_analysis_path(shared_ptr<const Playlist> playlist) const
 
 		digester.add(content->digest());
 		digester.add(content->audio->mapping().digest());
+		/* These change the audio that we analyse, wherever it is */
+		digester.add(content->audio->delay());
+		digester.add(content->audio->fade_in().get());
+		digester.add(content->audio->fade_out().get());
+		digester.add(content->trim_start().get());
+		digester.add(content->trim_end().get());
 		if (playlist->content().size() != 1) {
 			/* Analyses should be considered equal regardless of gain
 			   if they were made from just one piece of content.  This
@@ -328,8 +334,6 @@ Film::audio_analysis_path(shared_ptr<const Playlist> playlist) const
 			 * whole-project view.
 			 */
 			digester.add(content->position().get());
-			digester.add(content->trim_start().get());
-			digester.add(content->trim_end().get());
 		}
 	}
 
@@ -2269,7 +2273,7 @@ Film::copy_from(shared_ptr<const Film> film, std::function<void (float)> set_pro
 		});
 		if (iter != old_assets.end()) {
 			copy_in_bits(path, assets_path() / path.path().filename(), set_progress);
-			new_assets.push_back({path.path().filename(), iter->period(), iter->identifier()});
+			new_assets.push_back({path.path().filename(), iter->period(), iter->identifier(), iter->hash()});
 		}
 	}
 
@@ -26,12 +26,15 @@
 
 #include "dcpomatic_assert.h"
 #include "dcpomatic_socket.h"
+#include "digester.h"
 #include "enum_indexed_vector.h"
 #include "exceptions.h"
 #include "image.h"
+#include "image_buffer_pool.h"
 #include "maths_util.h"
 #include "memory_util.h"
 #include "rect.h"
+#include "scale_context_cache.h"
 #include "timer.h"
 #include <dcp/rgb_xyz.h>
 #include <dcp/transfer_function.h>
@@ -47,6 +50,7 @@ LIBDCP_ENABLE_WARNINGS
 #if DCPOMATIC_HAVE_VALGRIND_MEMCHECK_H
 #include <valgrind/memcheck.h>
 #endif
+#include <zlib.h>
 #include <iostream>
 
 
@@ -60,10 +64,10 @@ using std::make_shared;
 using std::max;
 using std::min;
 using std::pair;
-using std::runtime_error;
 using std::shared_ptr;
 using std::string;
 using std::vector;
+using boost::optional;
 using dcp::Size;
 
 
@@ -241,39 +245,20 @@ Image::crop_scale_window(
 	dcp::Size cropped_size;
 	std::tie(scale_in_data, cropped_size) = crop_source_pointers(crop);
 
-	/* Scale context for a scale from cropped_size to inter_size */
-	auto scale_context = sws_getContext(
-			cropped_size.width, cropped_size.height, pixel_format(),
-			inter_size.width, inter_size.height, out_format,
-			fast ? SWS_FAST_BILINEAR : SWS_BICUBIC, 0, 0, 0
-		);
-
-	if (!scale_context) {
-		throw runtime_error(N_("Could not allocate SwsContext"));
-	}
-
 	DCPOMATIC_ASSERT(yuv_to_rgb < dcp::YUVToRGB::COUNT);
 	EnumIndexedVector<int, dcp::YUVToRGB> lut;
 	lut[dcp::YUVToRGB::REC601] = SWS_CS_ITU601;
 	lut[dcp::YUVToRGB::REC709] = SWS_CS_ITU709;
 	lut[dcp::YUVToRGB::REC2020] = SWS_CS_BT2020;
 
-	/* The 3rd parameter here is:
-	   0 -> source range MPEG (i.e. "video", 16-235)
-	   1 -> source range JPEG (i.e. "full", 0-255)
-	   And the 5th:
-	   0 -> destination range MPEG (i.e. "video", 16-235)
-	   1 -> destination range JPEG (i.e. "full", 0-255)
-
-	   But remember: sws_setColorspaceDetails ignores these
-	   parameters unless the both source and destination images
-	   are isYUV or isGray.  (If either is not, it uses video range).
-	*/
-	sws_setColorspaceDetails(
-		scale_context,
-		sws_getCoefficients(lut[yuv_to_rgb]), video_range == VideoRange::VIDEO ? 0 : 1,
-		sws_getCoefficients(lut[yuv_to_rgb]), out_video_range == VideoRange::VIDEO ? 0 : 1,
-		0, 1 << 16, 1 << 16
+	/* Scale context for a scale from cropped_size to inter_size */
+	auto scale_context = ScaleContextCache::get(
+		cropped_size, pixel_format(),
+		inter_size, out_format,
+		fast ? SWS_FAST_BILINEAR : SWS_BICUBIC,
+		lut[yuv_to_rgb],
+		video_range == VideoRange::FULL,
+		out_video_range == VideoRange::FULL
 		);
 
 	auto out_desc = av_pix_fmt_desc_get(out_format);
@@ -301,8 +286,6 @@ Image::crop_scale_window(
 		scale_out_data.data(), out->stride()
 		);
 
-	sws_freeContext(scale_context);
-
 	/* There are some cases where there will be unwanted image data left in the image at this point:
 	 *
 	 * 1. When we are cropping without any scaling or pixel format conversion.
@@ -311,9 +294,11 @@ Image::crop_scale_window(
 	 *
 	 * Clear out the sides of the image to take care of those cases.
 	 */
-	auto const pad = (out_size.width - inter_size.width) / 2;
-	out->make_part_black(0, pad);
-	out->make_part_black(corner.x + inter_size.width, pad);
+	/* If the difference in widths is odd the right-hand side gets the extra pixel */
+	auto const left_pad = corner.x;
+	auto const right_pad = out_size.width - (corner.x + inter_size.width);
+	out->make_part_black(0, left_pad);
+	out->make_part_black(corner.x + inter_size.width, right_pad);
 
 	if (
 		video_range == VideoRange::VIDEO &&
@@ -328,6 +313,159 @@ Image::crop_scale_window(
 }
 
 
+/** Do the same as crop_scale_window() followed by alpha_blend() of any text and then fade(), but
+ *  working through the image in horizontal bands so that each band is still in the cache for all
+ *  the steps.  This is only implemented for the pixel formats that we use for DCP encoding.
+ *  @param out_format Output pixel format, which must be AV_PIX_FMT_RGB48LE or AV_PIX_FMT_XYZ12LE.
+ *  @param text Image to blend onto the output, if any.
+ *  @param fade Fade to apply to the output, if any.
+ */
+shared_ptr<Image>
+Image::crop_scale_window_composite(
+	Crop crop,
+	dcp::Size inter_size,
+	dcp::Size out_size,
+	dcp::YUVToRGB yuv_to_rgb,
+	VideoRange video_range,
+	AVPixelFormat out_format,
+	VideoRange out_video_range,
+	Alignment out_alignment,
+	bool fast,
+	optional<PositionImage> text,
+	optional<double> fade
+	) const
+{
+	DCPOMATIC_ASSERT(out_format == AV_PIX_FMT_RGB48LE || out_format == AV_PIX_FMT_XYZ12LE);
+
+	/* See crop_scale_window() */
+	DCPOMATIC_ASSERT(alignment() == Alignment::PADDED);
+
+	DCPOMATIC_ASSERT(out_size.width >= inter_size.width);
+	DCPOMATIC_ASSERT(out_size.height >= inter_size.height);
+
+	bool const to_full_range =
+		video_range == VideoRange::VIDEO &&
+		out_video_range == VideoRange::FULL &&
+		av_pix_fmt_desc_get(_pixel_format)->flags & AV_PIX_FMT_FLAG_RGB;
+
+	if (to_full_range && out_format != AV_PIX_FMT_RGB48LE) {
+		throw PixelFormatError("video_range_to_full_range()", out_format);
+	}
+
+	auto out = make_shared<Image>(out_format, out_size, out_alignment);
+
+	vector<uint8_t*> scale_in_data;
+	dcp::Size cropped_size;
+	std::tie(scale_in_data, cropped_size) = crop_source_pointers(crop);
+
+	DCPOMATIC_ASSERT(yuv_to_rgb < dcp::YUVToRGB::COUNT);
+	EnumIndexedVector<int, dcp::YUVToRGB> lut;
+	lut[dcp::YUVToRGB::REC601] = SWS_CS_ITU601;
+	lut[dcp::YUVToRGB::REC709] = SWS_CS_ITU709;
+	lut[dcp::YUVToRGB::REC2020] = SWS_CS_BT2020;
+
+	auto scale_context = ScaleContextCache::get(
+		cropped_size, pixel_format(),
+		inter_size, out_format,
+		fast ? SWS_FAST_BILINEAR : SWS_BICUBIC,
+		lut[yuv_to_rgb],
+		video_range == VideoRange::FULL,
+		out_video_range == VideoRange::FULL
+		);
+
+	/* Neither output format is subsampled, so there's no rounding to do here */
+	Position<int> const corner((out_size.width - inter_size.width) / 2, (out_size.height - inter_size.height) / 2);
+
+	/* Both output formats have 3 16-bit samples per pixel in one plane */
+	int const out_bpp = 6;
+	uint8_t* const out_data = out->data()[0];
+	int const out_stride = out->stride()[0];
+
+	/* FFmpeg memcpy()s this array and assumes it has 4 entries */
+	std::vector<uint8_t*> scale_out_data(4);
+	scale_out_data[0] = out_data + corner.x * out_bpp + corner.y * out_stride;
+
+	/* If the difference in widths is odd the right-hand side gets the extra pixel */
+	auto const left_pad = corner.x;
+	auto const right_pad = out_size.width - (corner.x + inter_size.width);
+
+	/* Do everything after the scale to rows [y0, y1) of the output */
+	auto finish = [&](int y0, int y1, bool window) {
+		if (y0 >= y1) {
+			return;
+		}
+
+		if (window) {
+			/* Black out the sides; see crop_scale_window() for why this is necessary */
+			for (int y = y0; y < y1; ++y) {
+				auto p = out_data + y * out_stride;
+				memset(p, 0, left_pad * out_bpp);
+				memset(p + (corner.x + inter_size.width) * out_bpp, 0, right_pad * out_bpp);
+			}
+
+			if (to_full_range) {
+				float const factor = 65536.0 / 56064.0;
+				for (int y = y0; y < y1; ++y) {
+					auto q = reinterpret_cast<uint16_t*>(out_data + y * out_stride);
+					for (int x = 0; x < out_size.width * 3; ++x) {
+						*q = clamp(lrintf((*q - 4096) * factor), 0L, 65535L);
+						++q;
+					}
+				}
+			}
+		} else {
+			for (int y = y0; y < y1; ++y) {
+				memset(out_data + y * out_stride, 0, out_size.width * out_bpp);
+			}
+		}
+
+		if (text) {
+			out->alpha_blend(text->image, text->position, y0, y1);
+		}
+
+		if (fade) {
+			float const f = fade.get();
+			for (int y = y0; y < y1; ++y) {
+				auto q = reinterpret_cast<uint16_t*>(out_data + y * out_stride);
+				for (int x = 0; x < out_size.width * 3; ++x) {
+					*q = int(*q * f);
+					++q;
+				}
+			}
+		}
+	};
+
+	/* Black bar at the top */
+	finish(0, corner.y, false);
+
+	/* Feed the scaler with slices of the input (of a height that is a multiple of any vertical
+	 * subsampling) and finish each block of output rows as it comes out.
+	 */
+	int constexpr band_out_rows = 16;
+	int const band_in_rows = std::max(4, (band_out_rows * cropped_size.height / inter_size.height) & ~3);
+
+	int out_y = corner.y;
+	for (int in_y = 0; in_y < cropped_size.height; in_y += band_in_rows) {
+		int const rows = min(band_in_rows, cropped_size.height - in_y);
+		uint8_t const* slice[4] = { nullptr, nullptr, nullptr, nullptr };
+		for (int c = 0; c < planes(); ++c) {
+			slice[c] = scale_in_data[c] + stride()[c] * (in_y / vertical_factor(c));
+		}
+		int const done = sws_scale(scale_context, slice, stride(), in_y, rows, scale_out_data.data(), out->stride());
+		finish(out_y, out_y + done, true);
+		out_y += done;
+	}
+
+	/* Black out anything that the scaler did not give us */
+	finish(out_y, corner.y + inter_size.height, false);
+
+	/* Black bar at the bottom */
+	finish(corner.y + inter_size.height, out_size.height, false);
+
+	return out;
+}
+
+
 shared_ptr<Image>
 Image::convert_pixel_format(dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_format, Alignment out_alignment, bool fast) const
 {
@@ -355,13 +493,6 @@ Image::scale(dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_for
 	DCPOMATIC_ASSERT(out_size.height > 0);
 
 	auto scaled = make_shared<Image>(out_format, out_size, out_alignment);
-	auto scale_context = sws_getContext(
-		size().width, size().height, pixel_format(),
-		out_size.width, out_size.height, out_format,
-		(fast ? SWS_FAST_BILINEAR : SWS_BICUBIC) | SWS_ACCURATE_RND, 0, 0, 0
-		);
-
-	DCPOMATIC_ASSERT(scale_context);
 
 	DCPOMATIC_ASSERT(yuv_to_rgb < dcp::YUVToRGB::COUNT);
 	EnumIndexedVector<int, dcp::YUVToRGB> lut;
@@ -369,22 +500,13 @@ Image::scale(dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_for
 	lut[dcp::YUVToRGB::REC709] = SWS_CS_ITU709;
 	lut[dcp::YUVToRGB::REC2020] = SWS_CS_BT2020;
 
-	/* The 3rd parameter here is:
-	   0 -> source range MPEG (i.e. "video", 16-235)
-	   1 -> source range JPEG (i.e. "full", 0-255)
-	   And the 5th:
-	   0 -> destination range MPEG (i.e. "video", 16-235)
-	   1 -> destination range JPEG (i.e. "full", 0-255)
-
-	   But remember: sws_setColorspaceDetails ignores these
-	   parameters unless the corresponding image isYUV or isGray.
-	   (If it's neither, it uses video range).
-	*/
-	sws_setColorspaceDetails(
-		scale_context,
-		sws_getCoefficients(lut[yuv_to_rgb]), 0,
-		sws_getCoefficients(lut[yuv_to_rgb]), 0,
-		0, 1 << 16, 1 << 16
+	auto scale_context = ScaleContextCache::get(
+		size(), pixel_format(),
+		out_size, out_format,
+		(fast ? SWS_FAST_BILINEAR : SWS_BICUBIC) | SWS_ACCURATE_RND,
+		lut[yuv_to_rgb],
+		false,
+		false
 		);
 
 	sws_scale(
@@ -394,8 +516,6 @@ Image::scale(dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_for
 		scaled->data(), scaled->stride()
 		);
 
-	sws_freeContext(scale_context);
-
 	return scaled;
 }
 
@@ -958,6 +1078,14 @@ alpha_blend_onto_yuv444p9or10le(TargetParams const& target, OtherYUVParams const
 
 void
 Image::alpha_blend(shared_ptr<const Image> other, Position<int> position)
+{
+	alpha_blend(other, position, 0, size().height);
+}
+
+
+/** Blend `other' onto the part of this image between rows start_y and end_y (exclusive) */
+void
+Image::alpha_blend(shared_ptr<const Image> other, Position<int> position, int start_y, int end_y)
 {
 	DCPOMATIC_ASSERT(
 		other->pixel_format() == AV_PIX_FMT_BGRA ||
@@ -984,10 +1112,15 @@ Image::alpha_blend(shared_ptr<const Image> other, Position<int> position)
 		start_ty = 0;
 	}
 
+	if (start_ty < start_y) {
+		start_oy += start_y - start_ty;
+		start_ty = start_y;
+	}
+
 	TargetParams target_params = {
 		start_tx,
 		start_ty,
-		size(),
+		dcp::Size(size().width, min(end_y, size().height)),
 		data(),
 		stride(),
 		0
@@ -1151,27 +1284,106 @@ Image::copy(shared_ptr<const Image> other, Position<int> position)
 
 
 void
-Image::read_from_socket(shared_ptr<Socket> socket)
+Image::read_from_socket(shared_ptr<Socket> socket, TransportEncoding encoding)
 {
 	for (int i = 0; i < planes(); ++i) {
 		uint8_t* p = data()[i];
 		int const lines = sample_size(i).height;
-		for (int y = 0; y < lines; ++y) {
-			socket->read(p, line_size()[i]);
-			p += stride()[i];
+		switch (encoding) {
+		case TransportEncoding::NONE:
+			for (int y = 0; y < lines; ++y) {
+				socket->read(p, line_size()[i]);
+				p += stride()[i];
+			}
+			break;
+		case TransportEncoding::ZLIB:
+		{
+			uLong const size = static_cast<uLong>(line_size()[i]) * lines;
+			auto const compressed_size = socket->read_uint32();
+			if (compressed_size > compressBound(size)) {
+				throw NetworkError(_("Unexpected compressed image size"));
+			}
+			std::unique_ptr<uint8_t[]> compressed(new uint8_t[compressed_size]);
+			socket->read(compressed.get(), compressed_size);
+
+			/* If there's no padding we can inflate straight into our data */
+			std::unique_ptr<uint8_t[]> packed;
+			if (line_size()[i] != stride()[i]) {
+				packed.reset(new uint8_t[size]);
+			}
+
+			uLongf out_size = size;
+			if (uncompress(packed ? packed.get() : p, &out_size, compressed.get(), compressed_size) != Z_OK || out_size != size) {
+				throw NetworkError(_("Could not decompress image data"));
+			}
+
+			if (packed) {
+				for (int y = 0; y < lines; ++y) {
+					memcpy(p, packed.get() + y * line_size()[i], line_size()[i]);
+					p += stride()[i];
+				}
+			}
+			break;
+		}
+		}
+	}
+}
+
+
+void
+Image::write_to_socket(shared_ptr<Socket> socket, TransportEncoding encoding) const
+{
+	for (int i = 0; i < planes(); ++i) {
+		uint8_t* p = data()[i];
+		int const lines = sample_size(i).height;
+		switch (encoding) {
+		case TransportEncoding::NONE:
+			for (int y = 0; y < lines; ++y) {
+				socket->write(p, line_size()[i]);
+				p += stride()[i];
+			}
+			break;
+		case TransportEncoding::ZLIB:
+		{
+			/* Deflate the whole plane in one go, without any padding */
+			uLong const size = static_cast<uLong>(line_size()[i]) * lines;
+			std::unique_ptr<uint8_t[]> packed;
+			if (line_size()[i] != stride()[i]) {
+				packed.reset(new uint8_t[size]);
+				for (int y = 0; y < lines; ++y) {
+					memcpy(packed.get() + y * line_size()[i], p, line_size()[i]);
+					p += stride()[i];
+				}
+			}
+
+			uLongf compressed_size = compressBound(size);
+			std::unique_ptr<uint8_t[]> compressed(new uint8_t[compressed_size]);
+			if (compress2(compressed.get(), &compressed_size, packed ? packed.get() : data()[i], size, Z_BEST_SPEED) != Z_OK) {
+				throw NetworkError(_("Could not compress image data"));
+			}
+
+			socket->write(static_cast<uint32_t>(compressed_size));
+			socket->write(compressed.get(), compressed_size);
+			break;
+		}
 		}
 	}
 }
 
 
+/** Add our pixel format, size and image data (without any padding) to a digest */
 void
-Image::write_to_socket(shared_ptr<Socket> socket) const
+Image::add_to_digest(Digester& digester) const
 {
+	digester.add(static_cast<int>(_pixel_format));
+	digester.add(_size.width);
+	digester.add(_size.height);
+
 	for (int i = 0; i < planes(); ++i) {
 		uint8_t* p = data()[i];
 		int const lines = sample_size(i).height;
 		for (int y = 0; y < lines; ++y) {
-			socket->write(p, line_size()[i]);
+			digester.add(p, line_size()[i]);
 			p += stride()[i];
 		}
 	}
@@ -1310,17 +1522,25 @@ Image::allocate()
 		   |XXXwrittenXXX|<------line-size------------->|XXXwrittenXXXXXXwrittenXXX
 		                                                               ^^^^ out of bounds
 		*/
-		_data[i] = (uint8_t *) wrapped_av_malloc(_stride[i] * (sample_size(i).height + 1) + ALIGNMENT);
+		_data[i] = ImageBufferPool::instance()->get(allocation_size(i));
 #ifdef DCPOMATIC_HAVE_VALGRIND_MEMCHECK_H
 		/* The data between the end of the line size and the stride is undefined but processed by
 		   libswscale, causing lots of valgrind errors.  Mark it all defined to quell these errors.
 		*/
-		VALGRIND_MAKE_MEM_DEFINED(_data[i], _stride[i] * (sample_size(i).height + 1) + ALIGNMENT);
+		VALGRIND_MAKE_MEM_DEFINED(_data[i], allocation_size(i));
 #endif
 	}
 }
 
 
+/** @return Number of bytes that allocate() asks for to hold a given plane */
+size_t
+Image::allocation_size(int plane) const
+{
+	return _stride[plane] * (sample_size(plane).height + 1) + ALIGNMENT;
+}
+
+
 Image::Image(Image const & other)
 	: std::enable_shared_from_this<Image>(other)
 	, _size(other._size)
@@ -1417,8 +1637,9 @@ Image::swap(Image & other)
 
 Image::~Image()
 {
+	auto pool = ImageBufferPool::instance();
 	for (int i = 0; i < planes(); ++i) {
-		av_free(_data[i]);
+		pool->put(_data[i], allocation_size(i));
 	}
 
 	av_free(_data);
@@ -29,6 +29,7 @@
 #include "crop.h"
 #include "position.h"
 #include "position_image.h"
+#include "transport_encoding.h"
 #include "video_range.h"
 extern "C" {
 #include <libavutil/pixfmt.h>
@@ -38,6 +39,7 @@ extern "C" {
 
 
 struct AVFrame;
+class Digester;
 class Socket;
 
 
@@ -83,6 +85,19 @@ public:
 		Alignment alignment,
 		bool fast
 		) const;
+	std::shared_ptr<Image> crop_scale_window_composite(
+		Crop crop,
+		dcp::Size inter_size,
+		dcp::Size out_size,
+		dcp::YUVToRGB yuv_to_rgb,
+		VideoRange video_range,
+		AVPixelFormat out_format,
+		VideoRange out_video_range,
+		Alignment alignment,
+		bool fast,
+		boost::optional<PositionImage> text,
+		boost::optional<double> fade
+		) const;
 
 	std::shared_ptr<Image> crop(Crop crop) const;
 
@@ -92,8 +107,9 @@ public:
 	void copy(std::shared_ptr<const Image> image, Position<int> pos);
 	void fade(float);
 
-	void read_from_socket(std::shared_ptr<Socket>);
-	void write_to_socket(std::shared_ptr<Socket>) const;
+	void read_from_socket(std::shared_ptr<Socket>, TransportEncoding encoding = TransportEncoding::NONE);
+	void write_to_socket(std::shared_ptr<Socket>, TransportEncoding encoding = TransportEncoding::NONE) const;
+	void add_to_digest(Digester& digester) const;
 
 	AVPixelFormat pixel_format() const {
 		return _pixel_format;
@@ -111,11 +127,13 @@ private:
 	friend void image_benchmark();
 
 	void allocate();
+	size_t allocation_size(int plane) const;
 	void swap(Image &);
 	void make_part_black(int x, int w);
 	void yuv_16_black(uint16_t, bool);
 	static uint16_t swap_16(uint16_t);
 	void video_range_to_full_range();
+	void alpha_blend(std::shared_ptr<const Image> image, Position<int> pos, int start_y, int end_y);
 	std::pair<std::vector<uint8_t*>, dcp::Size> crop_source_pointers(Crop crop) const;
 
 	dcp::Size _size;
@@ -0,0 +1,253 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "image_buffer_pool.h"
+#include "memory_util.h"
+#include <dcp/warnings.h>
+LIBDCP_DISABLE_WARNINGS
+extern "C" {
+#include <libavutil/mem.h>
+}
+LIBDCP_ENABLE_WARNINGS
+#include <boost/thread/tss.hpp>
+#include <algorithm>
+
+
+using std::pair;
+using std::vector;
+
+
+size_t constexpr ImageBufferPool::minimum_size;
+size_t constexpr ImageBufferPool::default_limit;
+size_t constexpr ImageBufferPool::max_thread_cached_fraction;
+
+
+/** Buffers which are kept by one thread, most-recently-used last */
+class ImageBufferThreadCache
+{
+public:
+	ImageBufferThreadCache() = default;
+
+	ImageBufferThreadCache(ImageBufferThreadCache const&) = delete;
+	ImageBufferThreadCache& operator=(ImageBufferThreadCache const&) = delete;
+
+	~ImageBufferThreadCache()
+	{
+		/* The thread is finishing, so give everything to the shared pool */
+		auto pool = ImageBufferPool::instance();
+		for (auto const& i: buffers) {
+			pool->_held -= i.first;
+			pool->_thread_cached -= i.first;
+			pool->put_shared(i.second, i.first);
+		}
+	}
+
+	/** Size class and buffer */
+	vector<pair<size_t, uint8_t*>> buffers;
+
+	/** Maximum number of buffers to keep in each thread */
+	static int constexpr max_buffers = 2;
+};
+
+
+int constexpr ImageBufferThreadCache::max_buffers;
+
+static boost::thread_specific_ptr<ImageBufferThreadCache> thread_cache;
+
+
+ImageBufferPool*
+ImageBufferPool::instance()
+{
+	/* This is never deleted so that Images which are destroyed late on can still give their buffers back */
+	static auto pool = new ImageBufferPool();
+	return pool;
+}
+
+
+/** @return size class for a buffer of a given size; this is the size rounded up to the next
+ *  1/8th of a power of 2, so we waste at most 12.5% of each buffer.
+ */
+size_t
+ImageBufferPool::size_class(size_t size)
+{
+	size_t power = 1;
+	while (power * 2 <= size) {
+		power *= 2;
+	}
+	auto const step = std::max(power / 8, static_cast<size_t>(1));
+	return ((size + step - 1) / step) * step;
+}
+
+
+uint8_t*
+ImageBufferPool::get(size_t size)
+{
+	if (size < minimum_size) {
+		return static_cast<uint8_t*>(wrapped_av_malloc(size));
+	}
+
+	auto const sc = size_class(size);
+
+	if (thread_cache.get()) {
+		auto& buffers = thread_cache->buffers;
+		for (auto i = buffers.rbegin(); i != buffers.rend(); ++i) {
+			if (i->first == sc) {
+				auto buffer = i->second;
+				buffers.erase(std::next(i).base());
+				_held -= sc;
+				_thread_cached -= sc;
+				++_hits;
+				return buffer;
+			}
+		}
+	}
+
+	{
+		boost::mutex::scoped_lock lm(_mutex);
+		auto i = _buffers.find(sc);
+		if (i != _buffers.end() && !i->second.empty()) {
+			auto buffer = i->second.back();
+			i->second.pop_back();
+			_held -= sc;
+			++_hits;
+			return buffer;
+		}
+	}
+
+	++_misses;
+	return static_cast<uint8_t*>(wrapped_av_malloc(sc));
+}
+
+
+void
+ImageBufferPool::put(uint8_t* buffer, size_t size)
+{
+	if (!buffer) {
+		return;
+	}
+
+	if (size < minimum_size) {
+		av_free(buffer);
+		return;
+	}
+
+	auto const sc = size_class(size);
+
+	if (!thread_cache.get()) {
+		thread_cache.reset(new ImageBufferThreadCache());
+	}
+
+	auto& buffers = thread_cache->buffers;
+	if (static_cast<int>(buffers.size()) == ImageBufferThreadCache::max_buffers) {
+		/* Move our least-recently-used buffer to the shared pool to make room */
+		_held -= buffers.front().first;
+		_thread_cached -= buffers.front().first;
+		put_shared(buffers.front().second, buffers.front().first);
+		buffers.erase(buffers.begin());
+	}
+
+	if (_thread_cached + sc > _limit / max_thread_cached_fraction) {
+		/* The thread caches have as much as they are allowed, so that there is still
+		 * room for the buffers that threads pass between each other in the shared pool.
+		 */
+		put_shared(buffer, sc);
+		return;
+	}
+
+	if (_held + sc > _limit) {
+		av_free(buffer);
+		return;
+	}
+
+	buffers.push_back(std::make_pair(sc, buffer));
+	_held += sc;
+	_thread_cached += sc;
+}
+
+
+/** Put a buffer into the shared pool, or free it if there is no room.
+ *  The buffer must not already be counted in _held.
+ */
+void
+ImageBufferPool::put_shared(uint8_t* buffer, size_t size_class)
+{
+	boost::mutex::scoped_lock lm(_mutex);
+
+	/* If we are over the limit, free shared buffers of other sizes first, since
+	 * they are probably left over from something we are no longer doing.
+	 */
+	for (auto i = _buffers.begin(); i != _buffers.end() && _held + size_class > _limit; ++i) {
+		while (i->first != size_class && !i->second.empty() && _held + size_class > _limit) {
+			av_free(i->second.back());
+			i->second.pop_back();
+			_held -= i->first;
+		}
+	}
+
+	if (_held + size_class > _limit) {
+		av_free(buffer);
+		return;
+	}
+
+	_buffers[size_class].push_back(buffer);
+	_held += size_class;
+}
+
+
+void
+ImageBufferPool::set_limit(size_t bytes)
+{
+	_limit = bytes;
+}
+
+
+void
+ImageBufferPool::clear()
+{
+	if (thread_cache.get()) {
+		for (auto const& i: thread_cache->buffers) {
+			av_free(i.second);
+			_held -= i.first;
+			_thread_cached -= i.first;
+		}
+		thread_cache->buffers.clear();
+	}
+
+	boost::mutex::scoped_lock lm(_mutex);
+	for (auto& i: _buffers) {
+		for (auto j: i.second) {
+			av_free(j);
+			_held -= i.first;
+		}
+	}
+	_buffers.clear();
+}
+
+
+ImageBufferPool::Statistics
+ImageBufferPool::statistics() const
+{
+	Statistics s;
+	s.hits = _hits;
+	s.misses = _misses;
+	s.held = _held;
+	return s;
+}
@@ -0,0 +1,118 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/image_buffer_pool.h
+ *  @brief ImageBufferPool class.
+ */
+
+
+#ifndef DCPOMATIC_IMAGE_BUFFER_POOL_H
+#define DCPOMATIC_IMAGE_BUFFER_POOL_H
+
+
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+
+/** @class ImageBufferPool
+ *  @brief A pool of the large buffers that Image uses for its planes.
+ *
+ *  Each frame that goes through the player is decoded, scaled and converted into new
+ *  Images, and at 4K these can be tens of megabytes each.  Rather than give them back to
+ *  the system when an Image is destroyed we keep them here, sorted into size classes,
+ *  so that the next Image of the same size can have them.
+ *
+ *  Each thread keeps a couple of buffers of its own so that it does not need to take
+ *  the pool's lock; the rest are shared.  The total size of buffers kept (in the thread
+ *  caches and the shared pool) is limited; anything over that is freed.  The thread caches
+ *  together may only hold a fraction of that limit, so that with many threads they cannot
+ *  starve the shared pool.
+ */
+class ImageBufferPool
+{
+public:
+	ImageBufferPool(ImageBufferPool const&) = delete;
+	ImageBufferPool& operator=(ImageBufferPool const&) = delete;
+
+	/** @param size Required size in bytes.
+	 *  @return Buffer of at least `size' bytes, allocated with av_malloc.
+	 */
+	uint8_t* get(size_t size);
+
+	/** Give back a buffer which came from get().
+	 *  @param buffer Buffer.
+	 *  @param size Size that was passed to get().
+	 */
+	void put(uint8_t* buffer, size_t size);
+
+	/** Set the maximum number of bytes that will be kept for re-use */
+	void set_limit(size_t bytes);
+
+	/** Free all the shared buffers, and those in the calling thread's cache */
+	void clear();
+
+	struct Statistics
+	{
+		/** Number of buffers that were re-used */
+		uint64_t hits = 0;
+		/** Number of buffers that had to be allocated */
+		uint64_t misses = 0;
+		/** Number of bytes currently being kept for re-use */
+		size_t held = 0;
+	};
+
+	Statistics statistics() const;
+
+	static ImageBufferPool* instance();
+
+	/** Buffers smaller than this are not worth pooling */
+	static size_t constexpr minimum_size = 256 * 1024;
+	/** Default limit on the size of buffers that we keep */
+	static size_t constexpr default_limit = 1024 * 1024 * 1024;
+	/** The thread caches may hold at most 1 / this of the limit between them */
+	static size_t constexpr max_thread_cached_fraction = 4;
+
+private:
+	ImageBufferPool() = default;
+
+	friend class ImageBufferThreadCache;
+
+	static size_t size_class(size_t size);
+	void put_shared(uint8_t* buffer, size_t size_class);
+
+	mutable boost::mutex _mutex;
+	/** Shared buffers, keyed by size class */
+	std::map<size_t, std::vector<uint8_t*>> _buffers;
+
+	std::atomic<size_t> _limit{default_limit};
+	/** Total size of buffers in the thread caches and _buffers */
+	std::atomic<size_t> _held{0};
+	/** Total size of buffers in the thread caches */
+	std::atomic<size_t> _thread_cached{0};
+	std::atomic<uint64_t> _hits{0};
+	std::atomic<uint64_t> _misses{0};
+};
+
+
+#endif
@@ -40,12 +40,12 @@ using std::string;
 
 
 shared_ptr<ImageProxy>
-image_proxy_factory(shared_ptr<cxml::Node> xml, shared_ptr<Socket> socket)
+image_proxy_factory(shared_ptr<cxml::Node> xml, shared_ptr<Socket> socket, TransportEncoding encoding)
 {
 	if (xml->string_child("Type") == N_("Raw")) {
-		return make_shared<RawImageProxy>(xml, socket);
+		return make_shared<RawImageProxy>(xml, socket, encoding);
 	} else if (xml->string_child("Type") == N_("FFmpeg")) {
-		return make_shared<FFmpegImageProxy>(socket);
+		return make_shared<FFmpegImageProxy>(socket, encoding);
 	} else if (xml->string_child("Type") == N_("J2K")) {
 		return make_shared<J2KImageProxy>(xml, socket);
 	}
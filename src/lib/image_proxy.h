@@ -37,6 +37,7 @@ extern "C" {
 #include <boost/utility.hpp>
 
 
+class Digester;
 class Image;
 class Socket;
 
@@ -96,7 +97,13 @@ public:
 		) const = 0;
 
 	virtual void add_metadata(xmlpp::Element *) const = 0;
-	virtual void write_to_socket(std::shared_ptr<Socket>) const = 0;
+	/** Write our image data to a socket.
+	 *  @param encoding Encoding to use for the image data; J2K proxies hold data which is already
+	 *  compressed and send it as it is.
+	 */
+	virtual void write_to_socket(std::shared_ptr<Socket>, TransportEncoding encoding) const = 0;
+	/** Add the data that our image will be made from to a digest */
+	virtual void add_to_digest(Digester& digester) const = 0;
 	/** @return true if our image is definitely the same as another, false if it is probably not */
 	virtual bool same(std::shared_ptr<const ImageProxy>) const = 0;
 	/** Do any useful work that would speed up a subsequent call to ::image().
@@ -108,7 +115,7 @@ public:
 };
 
 
-std::shared_ptr<ImageProxy> image_proxy_factory(std::shared_ptr<cxml::Node> xml, std::shared_ptr<Socket> socket);
+std::shared_ptr<ImageProxy> image_proxy_factory(std::shared_ptr<cxml::Node> xml, std::shared_ptr<Socket> socket, TransportEncoding encoding);
 
 
 #endif
@@ -0,0 +1,145 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "image.h"
+#include "j2k_decode_ahead.h"
+#include "j2k_image_proxy.h"
+#include "util.h"
+#include <algorithm>
+
+
+using std::max;
+using std::min;
+using std::shared_ptr;
+using std::vector;
+using std::weak_ptr;
+using boost::optional;
+
+
+J2KDecodeAhead::J2KDecodeAhead(int frames)
+	: _frames(frames)
+	, _work(dcpomatic::make_work_guard(_context))
+{
+	int const threads = max(1, min(frames, static_cast<int>(boost::thread::hardware_concurrency())));
+	for (int i = 0; i < threads; ++i) {
+		_pool.create_thread([this]() {
+			start_of_thread("J2KDecodeAhead");
+			_context.run();
+		});
+	}
+}
+
+
+J2KDecodeAhead::~J2KDecodeAhead()
+{
+	boost::this_thread::disable_interruption dis;
+
+	clear();
+
+	/* Anything still waiting to be decoded is no longer needed */
+	_work.reset();
+	_context.stop();
+	try {
+		_pool.join_all();
+	} catch (...) {}
+}
+
+
+void
+J2KDecodeAhead::set_target_size(optional<dcp::Size> size)
+{
+	boost::mutex::scoped_lock lm(_mutex);
+	_target_size = size;
+}
+
+
+bool
+J2KDecodeAhead::has(int64_t frame) const
+{
+	boost::mutex::scoped_lock lm(_mutex);
+	return _cache.find(frame) != _cache.end();
+}
+
+
+void
+J2KDecodeAhead::add(int64_t frame, vector<shared_ptr<const J2KImageProxy>> proxies)
+{
+	{
+		boost::mutex::scoped_lock lm(_mutex);
+		if (static_cast<int>(_cache.size()) >= _frames) {
+			return;
+		}
+		_cache[frame] = proxies;
+	}
+
+	for (auto proxy: proxies) {
+		weak_ptr<const J2KImageProxy> weak_proxy = proxy;
+		dcpomatic::post(_context, [this, weak_proxy]() { decode(weak_proxy); });
+	}
+}
+
+
+vector<shared_ptr<const J2KImageProxy>>
+J2KDecodeAhead::get(int64_t frame)
+{
+	boost::mutex::scoped_lock lm(_mutex);
+
+	vector<shared_ptr<const J2KImageProxy>> proxies;
+	auto i = _cache.find(frame);
+	if (i != _cache.end()) {
+		proxies = i->second;
+	}
+
+	_cache.erase(_cache.begin(), _cache.upper_bound(frame));
+	return proxies;
+}
+
+
+void
+J2KDecodeAhead::clear()
+{
+	boost::mutex::scoped_lock lm(_mutex);
+	_cache.clear();
+}
+
+
+void
+J2KDecodeAhead::decode(weak_ptr<const J2KImageProxy> weak_proxy)
+{
+	/* If the proxy has gone (e.g. because of a seek) there's nothing to do */
+	auto proxy = weak_proxy.lock();
+	if (!proxy) {
+		return;
+	}
+
+	optional<dcp::Size> target_size;
+	{
+		boost::mutex::scoped_lock lm(_mutex);
+		target_size = _target_size;
+	}
+
+	try {
+		/* Use the same alignment as PlayerVideo::make_image() */
+		proxy->prepare(Image::Alignment::PADDED, target_size);
+	} catch (...) {
+		/* The butler will try again when it prepares this frame, and report any error then */
+	}
+}
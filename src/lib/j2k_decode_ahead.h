@@ -0,0 +1,98 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/j2k_decode_ahead.h
+ *  @brief J2KDecodeAhead class.
+ */
+
+
+#ifndef DCPOMATIC_J2K_DECODE_AHEAD_H
+#define DCPOMATIC_J2K_DECODE_AHEAD_H
+
+
+#include "io_context.h"
+#include <dcp/types.h>
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <memory>
+#include <vector>
+
+
+class J2KImageProxy;
+
+
+/** @class J2KDecodeAhead
+ *  @brief Decompress JPEG2000 frames from a DCP on a pool of threads, before they are needed.
+ *
+ *  DCPDecoder adds the frames that are coming up next, and then takes them back out as it
+ *  emits them.  While we have a frame we decompress it at a reduction chosen from the target
+ *  size, so that by the time the butler prepares it the J2KImageProxy already has its image.
+ *  At most frames() frames are held at any one time.
+ */
+class J2KDecodeAhead
+{
+public:
+	/** @param frames Number of frames to decode ahead */
+	explicit J2KDecodeAhead(int frames);
+	~J2KDecodeAhead();
+
+	J2KDecodeAhead(J2KDecodeAhead const&) = delete;
+	J2KDecodeAhead& operator=(J2KDecodeAhead const&) = delete;
+
+	int frames() const {
+		return _frames;
+	}
+
+	/** Set the size that the decoded images will be scaled to, which is used to choose
+	 *  the reduction to decode at (unless the J2KImageProxy has a forced reduction).
+	 */
+	void set_target_size(boost::optional<dcp::Size> size);
+
+	/** @return true if we have a given frame */
+	bool has(int64_t frame) const;
+	/** Add a frame and start decoding it */
+	void add(int64_t frame, std::vector<std::shared_ptr<const J2KImageProxy>> proxies);
+	/** @return The proxies for a frame, or an empty vector if we don't have it.  This frame,
+	 *  and any before it, are forgotten.
+	 */
+	std::vector<std::shared_ptr<const J2KImageProxy>> get(int64_t frame);
+	/** Forget all frames, for example after a seek */
+	void clear();
+
+private:
+	void decode(std::weak_ptr<const J2KImageProxy> proxy);
+
+	int const _frames;
+
+	/** Mutex for _cache and _target_size */
+	mutable boost::mutex _mutex;
+	std::map<int64_t, std::vector<std::shared_ptr<const J2KImageProxy>>> _cache;
+	boost::optional<dcp::Size> _target_size;
+
+	boost::thread_group _pool;
+	dcpomatic::io_context _context;
+	boost::optional<dcpomatic::work_guard> _work;
+};
+
+
+#endif
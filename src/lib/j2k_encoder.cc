@@ -30,6 +30,7 @@
 #include "dcpomatic_log.h"
 #include "encode_server_description.h"
 #include "encode_server_finder.h"
+#include "encode_server_statistics.h"
 #include "film.h"
 #include "cpu_j2k_encoder_thread.h"
 #ifdef DCPOMATIC_GROK
@@ -38,11 +39,17 @@
 #endif
 #include "remote_j2k_encoder_thread.h"
 #include "j2k_encoder.h"
+#include "j2k_frame_cache.h"
+#include "image_buffer_pool.h"
 #include "log.h"
 #include "player_video.h"
+#include "scale_context_cache.h"
+#include "stage_times.h"
+#include "text_raster_cache.h"
 #include "util.h"
 #include "writer.h"
 #include <libcxml/cxml.h>
+#include <dcp/scope_guard.h>
 #include <iostream>
 
 #include "i18n.h"
@@ -59,6 +66,19 @@ using boost::optional;
 using dcp::Data;
 using namespace dcpomatic;
 
+
+/** Maximum number of frames that can be waiting in J2KEncoder::_queue */
+static size_t constexpr queue_capacity = 4096;
+/** A frame that the writer is waiting for is given to another encoder if it has been with a
+ *  server for more than this many times the best latency of any server...
+ */
+static float constexpr overdue_factor = 3;
+/** ...and more than this many seconds */
+static double constexpr minimum_overdue = 2;
+/** Minimum time between looks for overdue frames, in seconds */
+static double constexpr overdue_check_interval = 0.5;
+
+
 #ifdef DCPOMATIC_GROK
 
 namespace grk_plugin {
@@ -92,7 +112,14 @@ grk_plugin::IMessengerLogger* getMessengerLogger(void)
  */
 J2KEncoder::J2KEncoder(shared_ptr<const Film> film, Writer& writer)
 	: VideoEncoder(film, writer)
+	, _queue(queue_capacity)
+	, _retry_queue_size(0)
+	, _queue_size(0)
+	, _threads_waiting_for_frames(0)
+	, _threads_waiting_for_space(0)
+	, _last_overdue_check(0)
 	, _waker(Waker::Reason::ENCODING)
+	, _frame_cache(J2KFrameCache::from_config())
 #ifdef DCPOMATIC_GROK
 	, _give_up(false)
 #endif
@@ -151,6 +178,8 @@ J2KEncoder::servers_list_changed()
 void
 J2KEncoder::begin()
 {
+	ImageBufferPool::instance()->set_limit(static_cast<size_t>(Config::instance()->image_buffer_pool_size()) * 1024 * 1024);
+
 	_server_found_connection = EncodeServerFinder::instance()->ServersListChanged.connect(
 		boost::bind(&J2KEncoder::servers_list_changed, this)
 		);
@@ -196,16 +225,18 @@ void J2KEncoder::resume()
 void
 J2KEncoder::end()
 {
-	boost::mutex::scoped_lock lock(_queue_mutex);
-
-	LOG_GENERAL(N_("Clearing queue of {}"), _queue.size());
+	LOG_GENERAL(N_("Clearing queue of {}"), _queue_size.load());
 
 	/* Keep waking workers until the queue is empty */
-	while (!_queue.empty()) {
+	while (_queue_size > 0) {
 		rethrow();
-		_full_condition.wait(lock);
+		boost::mutex::scoped_lock lock(_queue_mutex);
+		++_threads_waiting_for_space;
+		dcp::ScopeGuard sg([this]() { --_threads_waiting_for_space; });
+		if (_queue_size > 0) {
+			_full_condition.wait(lock);
+		}
 	}
-	lock.unlock();
 
 	LOG_GENERAL(N_("Terminating encoder threads"));
 
@@ -214,7 +245,7 @@ J2KEncoder::end()
 	/* Something might have been thrown during terminate_threads */
 	rethrow();
 
-	LOG_GENERAL(N_("Mopping up {}"), _queue.size());
+	LOG_GENERAL(N_("Mopping up {}"), _queue_size.load());
 
 	/* The following sequence of events can occur in the above code:
 	     1. a remote worker takes the last image off the queue
@@ -224,7 +255,8 @@ J2KEncoder::end()
 
 	     So just mop up anything left in the queue here.
 	*/
-	for (auto & i: _queue) {
+	while (auto frame = try_pop()) {
+		auto& i = *frame;
 #ifdef DCPOMATIC_GROK
 		if (Config::instance()->grok().enable) {
 			if (!_context->scheduleCompress(i)){
@@ -253,6 +285,19 @@ J2KEncoder::end()
 	delete _context;
 	_context = nullptr;
 #endif
+
+	LOG_GENERAL(N_("Scale context cache: {} hits, {} misses"), ScaleContextCache::hits(), ScaleContextCache::misses());
+	auto const pool = ImageBufferPool::instance()->statistics();
+	LOG_GENERAL(N_("Image buffer pool: {} hits, {} misses, {} bytes held"), pool.hits, pool.misses, pool.held);
+	auto const text = TextRasterCache::instance()->statistics();
+	LOG_GENERAL(N_("Text raster cache: {} hits, {} misses"), text.hits, text.misses);
+	if (_frame_cache) {
+		auto const cache = _frame_cache->statistics();
+		LOG_GENERAL(
+			N_("J2K frame cache {}: {} hits, {} misses, {} stored, {} evicted, {} bytes held"),
+			_frame_cache->directory().string(), cache.hits, cache.misses, cache.stored, cache.evicted, cache.size
+			);
+	}
 }
 
 
@@ -291,15 +336,23 @@ J2KEncoder::encode(shared_ptr<PlayerVideo> pv, DCPTime time)
 		threads = _threads.size();
 	}
 
-	boost::mutex::scoped_lock queue_lock(_queue_mutex);
-
 	/* Wait until the queue has gone down a bit.  Allow one thing in the queue even
 	   when there are no threads.
 	*/
-	while (_queue.size() >= (threads * 2) + 1) {
-		LOG_TIMING("decoder-sleep queue={} threads={}", _queue.size(), threads);
-		_full_condition.wait(queue_lock);
-		LOG_TIMING("decoder-wake queue={} threads={}", _queue.size(), threads);
+	auto const limit = static_cast<int>(std::min(threads * 2 + 1, queue_capacity));
+	{
+		/* Time spent waiting here is not part of whatever stage we were called from */
+		StageTimes::Pause pause;
+		while (_queue_size >= limit) {
+			boost::mutex::scoped_lock lock(_queue_mutex);
+			++_threads_waiting_for_space;
+			dcp::ScopeGuard sg([this]() { --_threads_waiting_for_space; });
+			if (_queue_size >= limit) {
+				LOG_TIMING("decoder-sleep queue={} threads={}", _queue_size.load(), threads);
+				_full_condition.wait(lock);
+				LOG_TIMING("decoder-wake queue={} threads={}", _queue_size.load(), threads);
+			}
+		}
 	}
 
 	_writer.rethrow();
@@ -326,9 +379,6 @@ J2KEncoder::encode(shared_ptr<PlayerVideo> pv, DCPTime time)
 		_writer.repeat(position, pv->eyes());
 		frame_done(pv->eyes());
 	} else {
-		LOG_DEBUG_ENCODE("Frame @ {} ENCODE", to_string(time));
-		/* Queue this new frame for encoding */
-		LOG_TIMING("add-frame-to-queue queue={}", _queue.size());
 		auto dcpv = DCPVideo(
 				pv,
 				position,
@@ -336,12 +386,19 @@ J2KEncoder::encode(shared_ptr<PlayerVideo> pv, DCPTime time)
 				_film->video_bit_rate(VideoEncoding::JPEG2000),
 				_film->resolution()
 				);
-		_queue.push_back(dcpv);
+
+		LOG_DEBUG_ENCODE("Frame @ {} ENCODE", to_string(time));
+		/* Queue this new frame for encoding */
+		LOG_TIMING("add-frame-to-queue queue={}", _queue_size.load());
+		++_queue_size;
+		/* We only ever have one thing calling encode(), and we waited for space above, so this can't fail */
+		auto const pushed = _queue.try_push(dcpv);
+		DCPOMATIC_ASSERT(pushed);
 
 		/* The queue might not be empty any more, so notify anything which is
 		   waiting on that.
 		*/
-		_empty_condition.notify_all();
+		wake_threads_waiting_for_frames();
 	}
 
 	_last_player_video[pv->eyes()] = pv;
@@ -427,7 +484,7 @@ J2KEncoder::remake_threads(int cpu, int gpu, list<EncodeServerDescription> serve
 	/* Remote */
 
 	for (auto const& server: servers) {
-		if (!server.current_link_version()) {
+		if (!server.compatible_link_version()) {
 			continue;
 		}
 
@@ -459,21 +516,163 @@ J2KEncoder::remake_threads(int cpu, int gpu, list<EncodeServerDescription> serve
 }
 
 
+/** @return The next frame to encode, if there is one.  The caller must decrement _queue_size
+ *  if a frame is returned.
+ */
+optional<DCPVideo>
+J2KEncoder::take()
+{
+	if (_retry_queue_size > 0) {
+		boost::mutex::scoped_lock lock(_retry_mutex);
+		if (!_retry_queue.empty()) {
+			auto frame = _retry_queue.front();
+			_retry_queue.pop_front();
+			--_retry_queue_size;
+			return frame;
+		}
+	}
+
+	optional<DCPVideo> frame;
+	_queue.try_pop(frame);
+	return frame;
+}
+
+
+void
+J2KEncoder::wake_threads_waiting_for_frames()
+{
+	/* Taking the lock here means that we can't notify in between a waiting thread
+	 * checking _queue_size and it starting to wait.
+	 */
+	if (_threads_waiting_for_frames > 0) {
+		boost::mutex::scoped_lock lock(_queue_mutex);
+		_empty_condition.notify_all();
+	}
+}
+
+
+void
+J2KEncoder::wake_threads_waiting_for_space()
+{
+	if (_threads_waiting_for_space > 0) {
+		boost::mutex::scoped_lock lock(_queue_mutex);
+		_full_condition.notify_all();
+	}
+}
+
+
 DCPVideo
 J2KEncoder::pop()
 {
-	boost::mutex::scoped_lock lock(_queue_mutex);
-	while (_queue.empty()) {
-		_empty_condition.wait(lock);
+	optional<DCPVideo> frame;
+	while (!frame) {
+		frame = pop_for(overdue_check_interval);
+	}
+	return *frame;
+}
+
+
+/** @param timeout Maximum time to wait for a frame, in seconds.
+ *  @return The next frame to encode, or an empty optional if there was nothing within the timeout.
+ */
+optional<DCPVideo>
+J2KEncoder::pop_for(double timeout)
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	auto const give_up = seconds(tv) + timeout;
+
+	optional<DCPVideo> frame;
+	while (true) {
+		redispatch_overdue_frames();
+		frame = take();
+		if (frame) {
+			if (!write_from_cache(*frame)) {
+				break;
+			}
+			--_queue_size;
+			wake_threads_waiting_for_space();
+			continue;
+		}
+
+		gettimeofday(&tv, 0);
+		auto const remaining = give_up - seconds(tv);
+		if (remaining <= 0) {
+			return {};
+		}
+
+		boost::mutex::scoped_lock lock(_queue_mutex);
+		++_threads_waiting_for_frames;
+		dcp::ScopeGuard sg([this]() { --_threads_waiting_for_frames; });
+		if (_queue_size == 0) {
+			/* Wake up now and again to see if there are any overdue frames to take over */
+			_empty_condition.timed_wait(lock, boost::posix_time::milliseconds(static_cast<int>(std::min(remaining, overdue_check_interval) * 1000)));
+		}
+	}
+
+	--_queue_size;
+
+	LOG_TIMING("encoder-wake thread={} queue={}", thread_id(), _queue_size.load());
+
+	wake_threads_waiting_for_space();
+	return frame;
+}
+
+
+/** @return The next frame to encode, or an empty optional if there is nothing waiting; this never blocks */
+optional<DCPVideo>
+J2KEncoder::try_pop()
+{
+	redispatch_overdue_frames();
+	auto frame = take();
+	while (frame && write_from_cache(*frame)) {
+		--_queue_size;
+		wake_threads_waiting_for_space();
+		frame = take();
+	}
+	if (frame) {
+		--_queue_size;
+		wake_threads_waiting_for_space();
 	}
+	return frame;
+}
 
-	LOG_TIMING("encoder-wake thread={} queue={}", thread_id(), _queue.size());
 
-	auto vf = _queue.front();
-	_queue.pop_front();
+/** Look for a frame in the frame cache and write it if it's there.  This is called by the
+ *  encoder threads, rather than from encode(), so that the frames' cache keys (which need
+ *  the whole image to be hashed) are made in parallel.
+ *  @return true if the frame was found in the cache, so it no longer needs to be encoded.
+ */
+bool
+J2KEncoder::write_from_cache(DCPVideo const& frame)
+{
+	if (!_frame_cache) {
+		return false;
+	}
+
+	auto const index = std::make_pair(frame.index(), frame.eyes());
 
-	_full_condition.notify_all();
-	return vf;
+	{
+		boost::mutex::scoped_lock lm(_frame_cache_keys_mutex);
+		if (_frame_cache_keys.find(index) != _frame_cache_keys.end()) {
+			/* We already looked for this frame before it was retried or redispatched */
+			return false;
+		}
+	}
+
+	auto const key = frame.cache_key();
+	if (auto cached = _frame_cache->get(key)) {
+		LOG_DEBUG_ENCODE("Frame {} CACHED", frame.index());
+		boost::this_thread::disable_interruption dis;
+		if (_writer.write(cached, frame.index(), frame.eyes())) {
+			frame_done(frame.eyes());
+		}
+		return true;
+	}
+
+	boost::mutex::scoped_lock lm(_frame_cache_keys_mutex);
+	_frame_cache_keys[index] = key;
+	return false;
 }
 
 
@@ -498,17 +697,127 @@ J2KEncoder::retry(DCPVideo video)
 	}
 #endif
 
+	++_queue_size;
+
 	{
-		boost::mutex::scoped_lock lock(_queue_mutex);
-		_queue.push_front(video);
-		_empty_condition.notify_all();
+		boost::mutex::scoped_lock lock(_retry_mutex);
+		_retry_queue.push_front(video);
+		++_retry_queue_size;
 	}
+
+	wake_threads_waiting_for_frames();
 }
 
 
 void
 J2KEncoder::write(shared_ptr<const dcp::Data> data, int index, Eyes eyes)
 {
-	_writer.write(data, index, eyes);
+	/* The writer will ignore this if it already has it from another encoder */
+	if (!_writer.write(data, index, eyes)) {
+		return;
+	}
+
 	frame_done(eyes);
+
+	if (_frame_cache) {
+		std::string key;
+		{
+			boost::mutex::scoped_lock lm(_frame_cache_keys_mutex);
+			auto i = _frame_cache_keys.find(std::make_pair(index, eyes));
+			if (i == _frame_cache_keys.end()) {
+				return;
+			}
+			key = i->second;
+			_frame_cache_keys.erase(i);
+		}
+		_frame_cache->put(key, *data);
+	}
+}
+
+
+/** Called by a remote encoder thread when it has sent a frame to its server.
+ *  It must call returned() with the same frame when it comes back, or fails.
+ */
+void
+J2KEncoder::sent(DCPVideo const& frame, std::string const& host_name)
+{
+	struct timeval now;
+	gettimeofday(&now, 0);
+
+	boost::mutex::scoped_lock lm(_in_flight_mutex);
+	_in_flight.push_back({frame, host_name, seconds(now), false});
+}
+
+
+void
+J2KEncoder::returned(DCPVideo const& frame, std::string const& host_name)
+{
+	boost::mutex::scoped_lock lm(_in_flight_mutex);
+	auto i = std::find_if(_in_flight.begin(), _in_flight.end(), [&frame, &host_name](InFlight const& f) {
+		return f.frame.index() == frame.index() && f.frame.eyes() == frame.eyes() && f.host_name == host_name;
+	});
+	if (i != _in_flight.end()) {
+		_in_flight.erase(i);
+	}
+}
+
+
+/** If any frame that the writer is waiting for has been with a remote server for much longer than
+ *  we would expect, put a copy of it on the retry queue so that some other encoder can have a go.
+ *  Whichever copy comes back first is written; the writer ignores the other.
+ */
+void
+J2KEncoder::redispatch_overdue_frames()
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	auto const now = seconds(tv);
+
+	/* Only one thread needs to look, and only now and again */
+	auto last = _last_overdue_check.load();
+	if ((now - last) < overdue_check_interval || !_last_overdue_check.compare_exchange_strong(last, now)) {
+		return;
+	}
+
+	{
+		boost::mutex::scoped_lock lm(_in_flight_mutex);
+		if (_in_flight.empty()) {
+			return;
+		}
+	}
+
+	auto statistics = EncodeServerStatistics::instance();
+	auto const best_latency = statistics->best_latency();
+	if (!best_latency) {
+		/* We have no idea how long frames should take yet */
+		return;
+	}
+
+	auto const limit = std::max(minimum_overdue, static_cast<double>(*best_latency * overdue_factor));
+	auto const awaited = _writer.awaited_frames();
+
+	list<DCPVideo> overdue;
+	{
+		boost::mutex::scoped_lock lm(_in_flight_mutex);
+		for (auto& i: _in_flight) {
+			if (i.redispatched || (now - i.sent) < limit) {
+				continue;
+			}
+			auto const key = std::make_pair(static_cast<Frame>(i.frame.index()), i.frame.eyes());
+			if (std::find(awaited.begin(), awaited.end(), key) == awaited.end()) {
+				continue;
+			}
+			LOG_GENERAL(
+				N_("Frame {} has been with {} for {:.1f}s (best latency {:.1f}s); giving it to another encoder"),
+				i.frame.index(), i.host_name, now - i.sent, *best_latency
+				);
+			statistics->redispatched(i.host_name);
+			i.redispatched = true;
+			overdue.push_back(i.frame);
+		}
+	}
+
+	for (auto const& i: overdue) {
+		retry(i);
+	}
 }
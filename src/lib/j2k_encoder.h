@@ -29,10 +29,12 @@
 
 
 #include "cross.h"
+#include "dcp_video.h"
 #include "enum_indexed_vector.h"
 #include "event_history.h"
 #include "exception_store.h"
 #include "j2k_encoder_thread.h"
+#include "mpmc_queue.h"
 #include "writer.h"
 #include "video_encoder.h"
 #include <boost/optional.hpp>
@@ -40,13 +42,15 @@
 #include <boost/thread.hpp>
 #include <boost/thread/condition.hpp>
 #include <boost/thread/mutex.hpp>
+#include <atomic>
 #include <list>
+#include <map>
 #include <stdint.h>
 
 
-class DCPVideo;
 class EncodeServerDescription;
 class Film;
+class J2KFrameCache;
 class Job;
 class PlayerVideo;
 
@@ -58,6 +62,7 @@ namespace grk_plugin {
 struct local_threads_created_and_destroyed;
 struct remote_threads_created_and_destroyed;
 struct frames_not_lost_when_threads_disappear;
+struct remote_encode_with_old_and_new_link_versions;
 
 
 /** @class J2KEncoder
@@ -88,13 +93,19 @@ public:
 	void end() override;
 
 	DCPVideo pop();
+	boost::optional<DCPVideo> pop_for(double timeout);
+	boost::optional<DCPVideo> try_pop();
 	void retry(DCPVideo frame);
 	void write(std::shared_ptr<const dcp::Data> data, int index, Eyes eyes);
 
+	void sent(DCPVideo const& frame, std::string const& host_name);
+	void returned(DCPVideo const& frame, std::string const& host_name);
+
 private:
 	friend struct ::local_threads_created_and_destroyed;
 	friend struct ::remote_threads_created_and_destroyed;
 	friend struct ::frames_not_lost_when_threads_disappear;
+	friend struct ::remote_encode_with_old_and_new_link_versions;
 
 	void frame_done(Eyes eyes);
 	void servers_list_changed();
@@ -104,12 +115,52 @@ private:
 	boost::mutex _threads_mutex;
 	std::vector<std::shared_ptr<J2KEncoderThread>> _threads;
 
-	mutable boost::mutex _queue_mutex;
-	std::list<DCPVideo> _queue;
+	boost::optional<DCPVideo> take();
+	bool write_from_cache(DCPVideo const& frame);
+	void wake_threads_waiting_for_frames();
+	void wake_threads_waiting_for_space();
+	void redispatch_overdue_frames();
+
+	/** Frames waiting to be encoded, in order */
+	MPMCQueue<DCPVideo> _queue;
+	/** Frames that some thread failed to encode; these are given out again before anything in _queue */
+	boost::mutex _retry_mutex;
+	std::list<DCPVideo> _retry_queue;
+	std::atomic<int> _retry_queue_size;
+	/** Number of frames in _queue and _retry_queue.  This is incremented before a frame is added
+	 *  and decremented after one is taken, so it can briefly over-estimate but never under-estimate.
+	 */
+	std::atomic<int> _queue_size;
+
+	/** Mutex which is only used to put threads to sleep, and wake them up, when
+	 *  _queue is empty or full.  Nothing needs to take it to add or remove frames.
+	 */
+	boost::mutex _queue_mutex;
 	/** condition to manage thread wakeups when we have nothing to do */
 	boost::condition _empty_condition;
 	/** condition to manage thread wakeups when we have too much to do */
 	boost::condition _full_condition;
+	/** Number of threads waiting (or about to wait) on _empty_condition */
+	std::atomic<int> _threads_waiting_for_frames;
+	/** Number of threads waiting (or about to wait) on _full_condition */
+	std::atomic<int> _threads_waiting_for_space;
+
+	struct InFlight
+	{
+		DCPVideo frame;
+		std::string host_name;
+		/** Time that the frame was sent, in seconds */
+		double sent;
+		/** true if we have already given a copy of this frame to another encoder */
+		bool redispatched;
+	};
+
+	/** Mutex for _in_flight */
+	boost::mutex _in_flight_mutex;
+	/** Frames which have been sent to remote servers and not yet come back */
+	std::list<InFlight> _in_flight;
+	/** Last time that redispatch_overdue_frames() looked for overdue frames, in seconds */
+	std::atomic<double> _last_overdue_check;
 
 	Waker _waker;
 
@@ -117,6 +168,13 @@ private:
 
 	boost::signals2::scoped_connection _server_found_connection;
 
+	/** Cache of previously-encoded frames, or nullptr if it is not enabled */
+	std::shared_ptr<J2KFrameCache> _frame_cache;
+	/** Mutex for _frame_cache_keys */
+	boost::mutex _frame_cache_keys_mutex;
+	/** Cache keys of frames which have been taken for encoding but not yet written */
+	std::map<std::pair<int, Eyes>, std::string> _frame_cache_keys;
+
 #ifdef DCPOMATIC_GROK
 	grk_plugin::DcpomaticContext* _dcpomatic_context = nullptr;
 	grk_plugin::GrokContext *_context = nullptr;
@@ -0,0 +1,260 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "config.h"
+#include "dcpomatic_assert.h"
+#include "dcpomatic_log.h"
+#include "j2k_frame_cache.h"
+#include <dcp/filesystem.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <ctime>
+#include <tuple>
+#include <vector>
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+
+J2KFrameCache::J2KFrameCache(boost::filesystem::path directory, uint64_t maximum_size)
+	: _directory(directory)
+	, _maximum_size(maximum_size)
+{
+	boost::system::error_code ec;
+	boost::filesystem::create_directories(_directory, ec);
+
+	/* Find out what is already there, and the order in which it was last used */
+	vector<std::tuple<std::time_t, string, uint64_t>> existing;
+	for (auto i = boost::filesystem::recursive_directory_iterator(dcp::filesystem::fix_long_path(_directory), ec); i != boost::filesystem::recursive_directory_iterator(); i.increment(ec)) {
+		if (ec) {
+			break;
+		}
+		if (i->path().extension() == ".tmp") {
+			/* Left over from a put() that never finished */
+			boost::system::error_code remove_ec;
+			boost::filesystem::remove(i->path(), remove_ec);
+			continue;
+		}
+		if (i->path().extension() != ".j2c") {
+			continue;
+		}
+		boost::system::error_code time_ec;
+		boost::system::error_code size_ec;
+		auto const time = boost::filesystem::last_write_time(i->path(), time_ec);
+		auto const size = boost::filesystem::file_size(i->path(), size_ec);
+		if (!time_ec && !size_ec) {
+			existing.push_back(std::make_tuple(time, i->path().stem().string(), size));
+		}
+	}
+
+	std::sort(existing.begin(), existing.end());
+	vector<string> evict;
+	{
+		boost::mutex::scoped_lock lm(_mutex);
+		for (auto const& frame: existing) {
+			add(std::get<1>(frame), std::get<2>(frame));
+		}
+		/* The maximum size might have been reduced since we last ran */
+		evict = make_space();
+	}
+	remove(evict);
+
+	LOG_GENERAL("J2K frame cache in {} has {} frames ({} bytes)", _directory.string(), _entries.size(), _size);
+}
+
+
+boost::filesystem::path
+J2KFrameCache::file(string const& key) const
+{
+	/* Use a sub-directory per first two characters of the key so that we don't get huge directories */
+	return _directory / key.substr(0, 2) / (key + ".j2c");
+}
+
+
+/** Add a frame to the front of the LRU list, or move it there if it is already in the list.
+ *  Caller must hold a lock on _mutex.
+ */
+void
+J2KFrameCache::add(string const& key, uint64_t size)
+{
+	auto i = _entries.find(key);
+	if (i != _entries.end()) {
+		_lru.splice(_lru.begin(), _lru, i->second.lru);
+		_size -= i->second.size;
+		i->second.size = size;
+	} else {
+		_lru.push_front(key);
+		_entries[key] = { size, _lru.begin() };
+	}
+	_size += size;
+}
+
+
+/** Remove the least-recently-used frames from our index until we are no bigger than
+ *  the maximum size.  Caller must hold a lock on _mutex.
+ *  @return Keys of the frames that were removed, whose files should be passed to remove().
+ */
+vector<string>
+J2KFrameCache::make_space()
+{
+	vector<string> evict;
+	while (_size > _maximum_size && _lru.size() > 1) {
+		auto const& oldest = _lru.back();
+		auto i = _entries.find(oldest);
+		DCPOMATIC_ASSERT(i != _entries.end());
+		_size -= i->second.size;
+		evict.push_back(oldest);
+		_entries.erase(i);
+		_lru.pop_back();
+	}
+	return evict;
+}
+
+
+/** Remove the files of some frames which have been taken out of our index */
+void
+J2KFrameCache::remove(vector<string> const& keys)
+{
+	for (auto const& key: keys) {
+		boost::system::error_code ec;
+		boost::filesystem::remove(file(key), ec);
+		++_evicted;
+	}
+}
+
+
+shared_ptr<dcp::ArrayData>
+J2KFrameCache::get(string const& key)
+{
+	{
+		boost::mutex::scoped_lock lm(_mutex);
+		auto i = _entries.find(key);
+		if (i == _entries.end()) {
+			++_misses;
+			return {};
+		}
+		_lru.splice(_lru.begin(), _lru, i->second.lru);
+	}
+
+	auto const path = file(key);
+
+	try {
+		auto data = make_shared<dcp::ArrayData>(path);
+		/* Remember that we used this, in case we start again with an empty index */
+		boost::system::error_code ec;
+		boost::filesystem::last_write_time(path, std::time(nullptr), ec);
+		++_hits;
+		return data;
+	} catch (std::exception& e) {
+		/* Perhaps another process removed it */
+		LOG_GENERAL("Could not read {} from J2K frame cache ({})", path.string(), e.what());
+	}
+
+	boost::mutex::scoped_lock lm(_mutex);
+	auto i = _entries.find(key);
+	if (i != _entries.end()) {
+		_size -= i->second.size;
+		_lru.erase(i->second.lru);
+		_entries.erase(i);
+	}
+	++_misses;
+	return {};
+}
+
+
+void
+J2KFrameCache::put(string const& key, dcp::Data const& data)
+{
+	{
+		boost::mutex::scoped_lock lm(_mutex);
+		if (_entries.find(key) != _entries.end()) {
+			/* We already have it (perhaps another encoder got there first) */
+			return;
+		}
+	}
+
+	auto const path = file(key);
+	/* Another thread or process might be writing the same frame, so use a temporary name of our own */
+	auto const temporary = boost::filesystem::unique_path(path.string() + ".%%%%-%%%%-%%%%.tmp");
+
+	try {
+		boost::system::error_code ec;
+		boost::filesystem::create_directories(path.parent_path(), ec);
+		data.write(temporary);
+		/* Rename so that nobody ever sees a half-written frame */
+		boost::filesystem::rename(temporary, path);
+	} catch (std::exception& e) {
+		LOG_GENERAL("Could not write {} to J2K frame cache ({})", path.string(), e.what());
+		boost::system::error_code ec;
+		boost::filesystem::remove(temporary, ec);
+		return;
+	}
+
+	++_stored;
+
+	vector<string> evict;
+	{
+		boost::mutex::scoped_lock lm(_mutex);
+		add(key, data.size());
+		evict = make_space();
+	}
+
+	remove(evict);
+}
+
+
+J2KFrameCache::Statistics
+J2KFrameCache::statistics() const
+{
+	Statistics s;
+	s.hits = _hits;
+	s.misses = _misses;
+	s.stored = _stored;
+	s.evicted = _evicted;
+
+	boost::mutex::scoped_lock lm(_mutex);
+	s.size = _size;
+	return s;
+}
+
+
+shared_ptr<J2KFrameCache>
+J2KFrameCache::from_config()
+{
+	static boost::mutex mutex;
+	static shared_ptr<J2KFrameCache> cache;
+
+	auto const directory = Config::instance()->j2k_frame_cache_directory();
+	auto const maximum_size = static_cast<uint64_t>(Config::instance()->j2k_frame_cache_size()) * 1000000000;
+
+	boost::mutex::scoped_lock lm(mutex);
+
+	if (!directory) {
+		cache.reset();
+	} else if (!cache || cache->_directory != *directory || cache->_maximum_size != maximum_size) {
+		cache = make_shared<J2KFrameCache>(*directory, maximum_size);
+	}
+
+	return cache;
+}
@@ -0,0 +1,114 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/j2k_frame_cache.h
+ *  @brief J2KFrameCache class.
+ */
+
+
+#ifndef DCPOMATIC_J2K_FRAME_CACHE_H
+#define DCPOMATIC_J2K_FRAME_CACHE_H
+
+
+#include <dcp/array_data.h>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+/** @class J2KFrameCache
+ *  @brief An on-disk store of encoded JPEG2000 frames, which may be shared between films.
+ *
+ *  Frames are stored by a key which is a digest of everything that went into making
+ *  them (see DCPVideo::cache_key()), so a frame can be re-used by any film which
+ *  would encode exactly the same thing.  When the cache gets bigger than its maximum
+ *  size the least-recently-used frames are removed.  The last-write time of each file
+ *  is updated when it is used, so that this order survives between runs.
+ */
+class J2KFrameCache
+{
+public:
+	/** @param directory Directory to keep frames in; it will be created if required.
+	 *  @param maximum_size Maximum size of the frames that we keep, in bytes.
+	 */
+	J2KFrameCache(boost::filesystem::path directory, uint64_t maximum_size);
+
+	J2KFrameCache(J2KFrameCache const&) = delete;
+	J2KFrameCache& operator=(J2KFrameCache const&) = delete;
+
+	/** @return The frame with the given key, or nullptr if we don't have it */
+	std::shared_ptr<dcp::ArrayData> get(std::string const& key);
+	/** Add a frame, removing old ones if the cache is too big */
+	void put(std::string const& key, dcp::Data const& data);
+
+	struct Statistics
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t stored = 0;
+		uint64_t evicted = 0;
+		/** total size of the frames that we have, in bytes */
+		uint64_t size = 0;
+	};
+
+	Statistics statistics() const;
+
+	boost::filesystem::path directory() const {
+		return _directory;
+	}
+
+	/** @return The cache configured in Config, or nullptr if the cache is not enabled */
+	static std::shared_ptr<J2KFrameCache> from_config();
+
+private:
+	boost::filesystem::path file(std::string const& key) const;
+	void add(std::string const& key, uint64_t size);
+	std::vector<std::string> make_space();
+	void remove(std::vector<std::string> const& keys);
+
+	boost::filesystem::path _directory;
+	uint64_t _maximum_size;
+
+	/** mutex for _lru, _entries and _size */
+	mutable boost::mutex _mutex;
+	/** keys of frames that we have, most-recently-used first */
+	std::list<std::string> _lru;
+	struct Entry
+	{
+		uint64_t size;
+		std::list<std::string>::iterator lru;
+	};
+	std::unordered_map<std::string, Entry> _entries;
+	uint64_t _size = 0;
+
+	std::atomic<uint64_t> _hits{0};
+	std::atomic<uint64_t> _misses{0};
+	std::atomic<uint64_t> _stored{0};
+	std::atomic<uint64_t> _evicted{0};
+};
+
+
+#endif
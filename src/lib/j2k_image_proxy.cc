@@ -21,6 +21,8 @@
 
 #include "dcpomatic_assert.h"
 #include "dcpomatic_socket.h"
+#include "digester.h"
+#include "event_history.h"
 #include "image.h"
 #include "j2k_image_proxy.h"
 #include <dcp/colour_conversion.h>
@@ -43,13 +45,27 @@ LIBDCP_ENABLE_WARNINGS
 using std::cout;
 using std::dynamic_pointer_cast;
 using std::make_shared;
+using std::map;
 using std::max;
 using std::shared_ptr;
 using std::string;
+using std::unique_ptr;
 using boost::optional;
 using dcp::ArrayData;
 
 
+namespace {
+
+/** Number of decodes to measure each rate over */
+int constexpr decode_history_size = 48;
+
+boost::mutex decode_histories_mutex;
+/** History of decodes at each reduction */
+map<int, unique_ptr<EventHistory>> decode_histories;
+
+}
+
+
 /** Construct a J2KImageProxy from a JPEG2000 file */
 J2KImageProxy::J2KImageProxy(boost::filesystem::path path, dcp::Size size, AVPixelFormat pixel_format)
 	: _data(new dcp::ArrayData(path))
@@ -121,11 +137,6 @@ J2KImageProxy::prepare(Image::Alignment alignment, optional<dcp::Size> target_si
 {
 	boost::mutex::scoped_lock lm(_mutex);
 
-	if (_image && target_size == _target_size) {
-		DCPOMATIC_ASSERT(_reduce);
-		return *_reduce;
-	}
-
 	int reduce = 0;
 
 	if (_forced_reduction) {
@@ -139,6 +150,13 @@ J2KImageProxy::prepare(Image::Alignment alignment, optional<dcp::Size> target_si
 		reduce = max(0, reduce);
 	}
 
+	/* We may already have the image at this reduction, perhaps decoded ahead of time by
+	 * J2KDecodeAhead with a slightly different target size.
+	 */
+	if (_image && _reduce == reduce) {
+		return reduce;
+	}
+
 	try {
 		/* XXX: should check that potentially trashing _data here doesn't matter */
 		auto decompressed = dcp::decompress_j2k(const_cast<uint8_t*>(_data->data()), _data->size(), reduce);
@@ -165,13 +183,14 @@ J2KImageProxy::prepare(Image::Alignment alignment, optional<dcp::Size> target_si
 				++p;
 			}
 		}
+
+		decoded(reduce);
 	} catch (dcp::J2KDecompressionError& e) {
 		_image = make_shared<Image>(_pixel_format, _size, alignment);
 		_image->make_black();
 		_error = true;
 	}
 
-	_target_size = target_size;
 	_reduce = reduce;
 
 	return reduce;
@@ -204,12 +223,20 @@ J2KImageProxy::add_metadata(xmlpp::Element* element) const
 
 
 void
-J2KImageProxy::write_to_socket(shared_ptr<Socket> socket) const
+J2KImageProxy::write_to_socket(shared_ptr<Socket> socket, TransportEncoding) const
 {
 	socket->write(_data->data(), _data->size());
 }
 
 
+void
+J2KImageProxy::add_to_digest(Digester& digester) const
+{
+	digester.add(static_cast<int>(_pixel_format));
+	digester.add(_data->data(), _data->size());
+}
+
+
 bool
 J2KImageProxy::same(shared_ptr<const ImageProxy> other) const
 {
@@ -243,3 +270,30 @@ J2KImageProxy::memory_used() const
 	}
 	return m;
 }
+
+
+void
+J2KImageProxy::decoded(int reduction)
+{
+	boost::mutex::scoped_lock lm(decode_histories_mutex);
+	auto& history = decode_histories[reduction];
+	if (!history) {
+		history.reset(new EventHistory(decode_history_size));
+	}
+	history->event();
+}
+
+
+map<int, float>
+J2KImageProxy::decode_rates()
+{
+	boost::mutex::scoped_lock lm(decode_histories_mutex);
+
+	map<int, float> rates;
+	for (auto const& history: decode_histories) {
+		if (auto rate = history.second->rate()) {
+			rates[history.first] = *rate;
+		}
+	}
+	return rates;
+}
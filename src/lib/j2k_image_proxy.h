@@ -23,6 +23,7 @@
 #include <dcp/array_data.h>
 #include <dcp/util.h>
 #include <boost/thread/mutex.hpp>
+#include <map>
 
 
 namespace dcp {
@@ -62,7 +63,8 @@ public:
 		) const override;
 
 	void add_metadata(xmlpp::Element*) const override;
-	void write_to_socket(std::shared_ptr<Socket> override) const override;
+	void write_to_socket(std::shared_ptr<Socket>, TransportEncoding) const override;
+	void add_to_digest(Digester& digester) const override;
 	/** @return true if our image is definitely the same as another, false if it is probably not */
 	bool same(std::shared_ptr<const ImageProxy>) const override;
 	int prepare(Image::Alignment alignment, boost::optional<dcp::Size> = boost::optional<dcp::Size>()) const override;
@@ -81,12 +83,16 @@ public:
 
 	size_t memory_used() const override;
 
+	/** @return Rate (in frames per second) at which we have recently been decoding frames at each reduction */
+	static std::map<int, float> decode_rates();
+
 private:
+	static void decoded(int reduction);
+
 	std::shared_ptr<const dcp::Data> _data;
 	dcp::Size _size;
 	boost::optional<dcp::Eye> _eye;
 	mutable std::shared_ptr<Image> _image;
-	mutable boost::optional<dcp::Size> _target_size;
 	mutable boost::optional<int> _reduce;
 	AVPixelFormat _pixel_format;
 	mutable boost::mutex _mutex;
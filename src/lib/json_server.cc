@@ -19,6 +19,7 @@
 */
 
 
+#include "encode_server_statistics.h"
 #include "film.h"
 #include "job_manager.h"
 #include "json_server.h"
@@ -184,6 +185,26 @@ split_get_request(string url)
 }
 
 
+/** @return s with characters that are special in JSON strings escaped */
+static
+string
+escape(string s)
+{
+	string out;
+	for (auto c: s) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			out += fmt::format("\\u{:04x}", static_cast<int>(c));
+		} else {
+			out += c;
+		}
+	}
+	return out;
+}
+
+
 void
 JSONServer::request(string url, shared_ptr<tcp::socket> socket)
 {
@@ -209,10 +230,10 @@ JSONServer::request(string url, shared_ptr<tcp::socket> socket)
 			json += "{ ";
 
 			if ((*i)->film()) {
-				json += "\"dcp\": \"" + (*i)->film()->dcp_name() + "\", ";
+				json += "\"dcp\": \"" + escape((*i)->film()->dcp_name()) + "\", ";
 			}
 
-			json += "\"name\": \"" + (*i)->json_name() + "\", ";
+			json += "\"name\": \"" + escape((*i)->json_name()) + "\", ";
 			if ((*i)->progress()) {
 				json += "\"progress\": " + fmt::to_string((*i)->progress().get()) + ", ";
 			} else {
@@ -227,6 +248,32 @@ JSONServer::request(string url, shared_ptr<tcp::socket> socket)
 				json += ", ";
 			}
 		}
+		json += "], ";
+
+		auto servers = EncodeServerStatistics::instance()->servers();
+
+		json += "\"servers\": [";
+		for (auto i = servers.cbegin(); i != servers.cend(); ++i) {
+			json += "{ ";
+			json += "\"host\": \"" + escape(i->host_name) + "\", ";
+			if (i->rate) {
+				json += "\"rate\": " + fmt::to_string(*i->rate) + ", ";
+			}
+			if (i->latency) {
+				json += "\"latency\": " + fmt::to_string(*i->latency) + ", ";
+			}
+			json += "\"in_flight\": " + fmt::to_string(i->in_flight) + ", ";
+			json += "\"frames\": " + fmt::to_string(i->frames) + ", ";
+			json += "\"failures\": " + fmt::to_string(i->failures) + ", ";
+			json += "\"redispatched\": " + fmt::to_string(i->redispatched);
+			json += " }";
+
+			auto j = i;
+			++j;
+			if (j != servers.end()) {
+				json += ", ";
+			}
+		}
 		json += "] }";
 	}
 
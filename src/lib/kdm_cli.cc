@@ -202,21 +202,6 @@ write_files(
 }
 
 
-class ScreenDetails
-{
-public:
-	ScreenDetails(CinemaID const& cinema_id, Cinema const& cinema, Screen const& screen)
-		: cinema_id(cinema_id)
-		, cinema(cinema)
-		, screen(screen)
-	{}
-
-	CinemaID cinema_id;
-	Cinema cinema;
-	Screen screen;
-};
-
-
 static
 void
 from_film(
@@ -260,27 +245,19 @@ from_film(
 	std::vector<KDMCertificatePeriod> period_checks;
 
 	try {
-		list<KDMWithMetadataPtr> kdms;
-		for (auto screen_details: screens) {
-			std::function<dcp::DecryptedKDM(dcp::LocalTime, dcp::LocalTime)> make_kdm = [film, cpl](dcp::LocalTime begin, dcp::LocalTime end) {
-				return film->make_kdm(cpl, begin, end);
-			};
-			auto p = kdm_for_screen(
-				make_kdm,
-				screen_details.cinema_id,
-				screen_details.cinema,
-				screen_details.screen,
-				valid_from,
-				valid_to,
-				formulation,
-				disable_forensic_marking_picture,
-				disable_forensic_marking_audio,
-				period_checks
-				);
-			if (p) {
-				kdms.push_back(p);
-			}
-		}
+		std::function<dcp::DecryptedKDM(dcp::LocalTime, dcp::LocalTime)> make_kdm = [film, cpl](dcp::LocalTime begin, dcp::LocalTime end) {
+			return film->make_kdm(cpl, begin, end);
+		};
+		auto kdms = kdms_for_screens(
+			make_kdm,
+			screens,
+			valid_from,
+			valid_to,
+			formulation,
+			disable_forensic_marking_picture,
+			disable_forensic_marking_audio,
+			period_checks
+			);
 
 		if (find_if(
 			period_checks.begin(),
@@ -340,42 +317,6 @@ find_dkdm(string thing)
 }
 
 
-static
-dcp::EncryptedKDM
-kdm_from_dkdm(
-	dcp::DecryptedKDM dkdm,
-	dcp::Certificate target,
-	vector<string> trusted_devices,
-	dcp::LocalTime valid_from,
-	dcp::LocalTime valid_to,
-	dcp::Formulation formulation,
-	bool disable_forensic_marking_picture,
-	optional<int> disable_forensic_marking_audio
-	)
-{
-	/* Signer for new KDM */
-	auto signer = Config::instance()->signer_chain();
-	if (!signer->valid()) {
-		throw KDMCLIError("signing certificate chain is invalid.");
-	}
-
-	/* Make a new empty KDM and add the keys from the DKDM to it */
-	dcp::DecryptedKDM kdm(
-		valid_from,
-		valid_to,
-		dkdm.annotation_text().get_value_or(""),
-		dkdm.content_title_text(),
-		dcp::LocalTime().as_string()
-		);
-
-	for (auto const& j: dkdm.keys()) {
-		kdm.add_key(j);
-	}
-
-	return kdm.encrypt(signer, target, trusted_devices, formulation, disable_forensic_marking_picture, disable_forensic_marking_audio);
-}
-
-
 static
 void
 from_dkdm(
@@ -395,39 +336,40 @@ from_dkdm(
 	std::function<void (string)> out
 	)
 {
-	dcp::NameFormat::Map values;
+	/* Signer for new KDMs */
+	if (!Config::instance()->signer_chain()->valid()) {
+		throw KDMCLIError("signing certificate chain is invalid.");
+	}
 
 	try {
-		list<KDMWithMetadataPtr> kdms;
-		for (auto const& screen_details: screens) {
-			if (!screen_details.screen.recipient()) {
-				continue;
+		/* Make a new empty KDM and add the keys from the DKDM to it */
+		std::function<dcp::DecryptedKDM(dcp::LocalTime, dcp::LocalTime)> make_kdm = [&dkdm](dcp::LocalTime begin, dcp::LocalTime end) {
+			dcp::DecryptedKDM kdm(
+				begin,
+				end,
+				dkdm.annotation_text().get_value_or(""),
+				dkdm.content_title_text(),
+				dcp::LocalTime().as_string()
+				);
+
+			for (auto const& j: dkdm.keys()) {
+				kdm.add_key(j);
 			}
 
-			dcp::LocalTime begin(valid_from, screen_details.cinema.utc_offset);
-			dcp::LocalTime end(valid_to, screen_details.cinema.utc_offset);
-
-			auto const kdm = kdm_from_dkdm(
-							dkdm,
-							screen_details.screen.recipient().get(),
-							screen_details.screen.trusted_device_thumbprints(),
-							begin,
-							end,
-							formulation,
-							disable_forensic_marking_picture,
-							disable_forensic_marking_audio
-							);
-
-			dcp::NameFormat::Map name_values;
-			name_values['c'] = screen_details.cinema.name;
-			name_values['s'] = screen_details.screen.name;
-			name_values['f'] = kdm.content_title_text();
-			name_values['b'] = begin.date() + " " + begin.time_of_day(true, false);
-			name_values['e'] = end.date() + " " + end.time_of_day(true, false);
-			name_values['i'] = kdm.cpl_id();
-
-			kdms.push_back(make_shared<KDMWithMetadata>(name_values, screen_details.cinema_id, screen_details.cinema.emails, kdm));
-		}
+			return kdm;
+		};
+
+		vector<KDMCertificatePeriod> period_checks;
+		auto kdms = kdms_for_screens(
+			make_kdm,
+			screens,
+			valid_from,
+			valid_to,
+			formulation,
+			disable_forensic_marking_picture,
+			disable_forensic_marking_audio,
+			period_checks
+			);
 		write_files(kdms, zip, output, container_name_format, filename_format, verbose, out);
 		if (email) {
 			send_emails({kdms}, container_name_format, filename_format, dkdm.annotation_text().get_value_or(""), {});
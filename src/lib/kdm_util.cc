@@ -21,8 +21,15 @@
 
 #include "kdm_util.h"
 #include "screen.h"
+#include "util.h"
 #include <dcp/certificate.h>
+#include <dcp/scope_guard.h>
 #include <boost/optional.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <algorithm>
+#include <atomic>
+#include <exception>
 
 #include "i18n.h"
 
@@ -31,6 +38,7 @@ using std::list;
 using std::pair;
 using std::shared_ptr;
 using std::string;
+using std::vector;
 using boost::optional;
 
 
@@ -74,3 +82,84 @@ check_kdm_and_certificate_validity_periods(
 	}
 }
 
+
+
+void
+run_kdm_tasks(vector<std::function<void ()>> const& tasks, std::function<void (int)> progress)
+{
+	int const total = tasks.size();
+	if (total == 0) {
+		return;
+	}
+
+	int const threads = std::max(1, std::min(static_cast<int>(boost::thread::hardware_concurrency()), total));
+
+	/* Index of the next task to start */
+	std::atomic<int> next(0);
+
+	/* These are protected by mutex */
+	boost::mutex mutex;
+	boost::condition condition;
+	int done = 0;
+	int running = threads;
+	std::exception_ptr exception;
+
+	auto worker = [&]() {
+		start_of_thread("KDM");
+		dcp::ScopeGuard sg([&]() {
+			boost::mutex::scoped_lock lm(mutex);
+			--running;
+			condition.notify_all();
+		});
+
+		while (true) {
+			int const index = next++;
+			if (index >= total) {
+				return;
+			}
+
+			try {
+				tasks[index]();
+			} catch (...) {
+				boost::mutex::scoped_lock lm(mutex);
+				if (!exception) {
+					exception = std::current_exception();
+				}
+				/* Don't start anything else */
+				next = total;
+			}
+
+			boost::mutex::scoped_lock lm(mutex);
+			++done;
+			condition.notify_all();
+		}
+	};
+
+	boost::thread_group group;
+	for (int i = 0; i < threads; ++i) {
+		group.create_thread(worker);
+	}
+
+	{
+		boost::mutex::scoped_lock lm(mutex);
+		int reported = 0;
+		while (running > 0 || reported != done) {
+			if (reported != done) {
+				reported = done;
+				if (progress) {
+					lm.unlock();
+					progress(reported);
+					lm.lock();
+				}
+			} else {
+				condition.wait(lm);
+			}
+		}
+	}
+
+	group.join_all();
+
+	if (exception) {
+		std::rethrow_exception(exception);
+	}
+}
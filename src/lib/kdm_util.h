@@ -24,7 +24,9 @@
 
 
 #include <dcp/local_time.h>
+#include <functional>
 #include <utility>
+#include <vector>
 
 
 namespace dcp {
@@ -71,5 +73,13 @@ KDMCertificatePeriod check_kdm_and_certificate_validity_periods(
 	);
 
 
+/** Run some KDM-making tasks (which are mostly RSA encryption and signing) using a thread for each CPU.
+ *  If any task throws, no more are started and the first exception is rethrown here once the
+ *  running ones have finished.
+ *  @param progress Called in the calling thread, with the number of tasks that have finished, each time that changes.
+ */
+void run_kdm_tasks(std::vector<std::function<void ()>> const& tasks, std::function<void (int)> progress = {});
+
+
 #endif
 
@@ -24,6 +24,7 @@
 #include "cross.h"
 #include "dcpomatic_log.h"
 #include "email.h"
+#include "kdm_util.h"
 #include "kdm_with_metadata.h"
 #include "screen.h"
 #include "util.h"
@@ -67,15 +68,20 @@ write_files(
 		dcp::filesystem::create_directories(directory);
 	}
 
-	/* Write KDMs to the specified directory */
+	/* Write KDMs to the specified directory; confirm_overwrite may ask the user, so do that here
+	 * and only the writing in other threads.
+	 */
+	vector<function<void ()>> tasks;
 	for (auto i: kdms) {
 		auto out = directory / careful_string_filter(name_format.get(i->name_values(), ".xml"));
 		if (!dcp::filesystem::exists(out) || confirm_overwrite(out)) {
-			i->kdm_as_xml(out);
+			tasks.push_back([i, out]() { i->kdm_as_xml(out); });
 			++written;
 		}
 	}
 
+	run_kdm_tasks(tasks);
+
 	return written;
 }
 
@@ -174,6 +180,7 @@ write_zip_files(
 {
 	int written = 0;
 
+	vector<function<void ()>> tasks;
 	for (auto const& kdm: kdms) {
 		auto path = directory;
 		path /= container_name_format.get(kdm.front()->name_values(), ".zip", "s");
@@ -182,11 +189,13 @@ write_zip_files(
 				/* Creating a new zip file over an existing one is an error */
 				dcp::filesystem::remove(path);
 			}
-			make_zip_file(kdm, path, filename_format);
+			tasks.push_back([kdm, path, filename_format]() { make_zip_file(kdm, path, filename_format); });
 			written += kdm.size();
 		}
 	}
 
+	run_kdm_tasks(tasks);
+
 	return written;
 }
 
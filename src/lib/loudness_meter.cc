@@ -0,0 +1,273 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "audio_buffers.h"
+#include "dcpomatic_assert.h"
+#include "loudness_meter.h"
+#include <dcp/types.h>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+
+using std::vector;
+
+
+/** Length of the blocks that we measure, in seconds */
+static double constexpr block_length = 0.1;
+/** Length of the measurements used for integrated loudness (400ms), in blocks */
+static int constexpr momentary_blocks = 4;
+/** Length of the measurements used for loudness range (3s), in blocks */
+static int constexpr short_term_blocks = 30;
+/** Absolute gate, in LUFS */
+static double constexpr absolute_gate = -70;
+
+
+static
+double
+lufs(double mean_square)
+{
+	return -0.691 + 10 * log10(mean_square);
+}
+
+
+LoudnessMeter::LoudnessMeter(int sample_rate, int channels)
+	: _weights(channels, 0)
+	, _state(channels)
+	, _block_frames(static_cast<int>(std::round(sample_rate * block_length)))
+{
+	/* The two stages of the K-weighting filter, with coefficients worked out for any
+	 * sample rate in the same way as libebur128.  At 48kHz they are the ones given in BS.1770.
+	 */
+
+	{
+		/* Shelving filter to model the acoustic effect of the head */
+		double const f0 = 1681.974450955533;
+		double const G = 3.999843853973347;
+		double const Q = 0.7071752369554196;
+		double const K = tan(M_PI * f0 / sample_rate);
+		double const Vh = pow(10, G / 20);
+		double const Vb = pow(Vh, 0.4996667741545416);
+		double const a0 = 1 + K / Q + K * K;
+		auto& shelf = _stages[0];
+		shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+		shelf.b1 = 2 * (K * K - Vh) / a0;
+		shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+		shelf.a1 = 2 * (K * K - 1) / a0;
+		shelf.a2 = (1 - K / Q + K * K) / a0;
+	}
+
+	{
+		/* High-pass filter */
+		double const f0 = 38.13547087602444;
+		double const Q = 0.5003270373238773;
+		double const K = tan(M_PI * f0 / sample_rate);
+		double const a0 = 1 + K / Q + K * K;
+		auto& high_pass = _stages[1];
+		high_pass.b0 = 1;
+		high_pass.b1 = -2;
+		high_pass.b2 = 1;
+		high_pass.a1 = 2 * (K * K - 1) / a0;
+		high_pass.a2 = (1 - K / Q + K * K) / a0;
+	}
+
+	for (int i = 0; i < channels; ++i) {
+		switch (static_cast<dcp::Channel>(i)) {
+		case dcp::Channel::LEFT:
+		case dcp::Channel::RIGHT:
+		case dcp::Channel::CENTRE:
+		case dcp::Channel::LC:
+		case dcp::Channel::RC:
+			_weights[i] = 1;
+			break;
+		case dcp::Channel::LS:
+		case dcp::Channel::RS:
+		case dcp::Channel::BSL:
+		case dcp::Channel::BSR:
+			_weights[i] = 1.41;
+			break;
+		default:
+			/* LFE, HI/VI, sync and so on are not counted */
+			break;
+		}
+	}
+}
+
+
+void
+LoudnessMeter::process(AudioBuffers const& audio, int offset, int frames, bool measure)
+{
+	DCPOMATIC_ASSERT(offset >= 0);
+	DCPOMATIC_ASSERT(offset + frames <= audio.frames());
+
+	int const channels = std::min(audio.channels(), static_cast<int>(_weights.size()));
+	auto data = audio.data();
+
+	/* Go through frame by frame so that the sums come out the same however the audio is split up */
+	for (int i = offset; i < offset + frames; ++i) {
+		double sum = 0;
+		for (int c = 0; c < channels; ++c) {
+			if (_weights[c] == 0) {
+				continue;
+			}
+			double x = data[c][i];
+			for (int s = 0; s < 2; ++s) {
+				auto const& f = _stages[s];
+				auto& state = _state[c][s];
+				double const y = f.b0 * x + f.b1 * state.x1 + f.b2 * state.x2 - f.a1 * state.y1 - f.a2 * state.y2;
+				state.x2 = state.x1;
+				state.x1 = x;
+				state.y2 = state.y1;
+				state.y1 = y;
+				x = y;
+			}
+			sum += _weights[c] * x * x;
+		}
+
+		if (measure) {
+			_current += sum;
+			if (++_current_frames == _block_frames) {
+				_blocks.push_back(_current);
+				_current = 0;
+				_current_frames = 0;
+			}
+		}
+	}
+}
+
+
+void
+LoudnessMeter::append(LoudnessMeter const& other)
+{
+	DCPOMATIC_ASSERT(_current_frames == 0);
+	DCPOMATIC_ASSERT(_block_frames == other._block_frames);
+
+	_blocks.insert(_blocks.end(), other._blocks.begin(), other._blocks.end());
+	_current = other._current;
+	_current_frames = other._current_frames;
+	_state = other._state;
+}
+
+
+void
+LoudnessMeter::mix(vector<double> const& blocks, int offset, double gain)
+{
+	DCPOMATIC_ASSERT(offset >= 0);
+
+	if (_blocks.size() < offset + blocks.size()) {
+		_blocks.resize(offset + blocks.size(), 0);
+	}
+
+	/* The blocks are sums of squares */
+	auto const scale = gain * gain;
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		_blocks[offset + i] += blocks[i] * scale;
+	}
+}
+
+
+/** @return Mean square of the audio in each measurement of the given length, with measurements starting at every block */
+vector<double>
+LoudnessMeter::mean_squares(int blocks_per_measurement) const
+{
+	vector<double> values;
+	for (size_t i = 0; i + blocks_per_measurement <= _blocks.size(); ++i) {
+		double sum = 0;
+		for (int j = 0; j < blocks_per_measurement; ++j) {
+			sum += _blocks[i + j];
+		}
+		values.push_back(sum / (static_cast<double>(blocks_per_measurement) * _block_frames));
+	}
+	return values;
+}
+
+
+/** @return Those values which are above the absolute gate */
+static
+vector<double>
+absolute_gated(vector<double> const& values)
+{
+	vector<double> gated;
+	std::copy_if(values.begin(), values.end(), std::back_inserter(gated), [](double v) { return lufs(v) > absolute_gate; });
+	return gated;
+}
+
+
+/** @return Loudness of the mean of some values */
+static
+double
+mean_lufs(vector<double> const& values)
+{
+	double sum = 0;
+	for (auto v: values) {
+		sum += v;
+	}
+	return lufs(sum / values.size());
+}
+
+
+double
+LoudnessMeter::integrated() const
+{
+	auto const gated = absolute_gated(mean_squares(momentary_blocks));
+	if (gated.empty()) {
+		return absolute_gate;
+	}
+
+	auto const relative_gate = mean_lufs(gated) - 10;
+
+	vector<double> kept;
+	std::copy_if(gated.begin(), gated.end(), std::back_inserter(kept), [relative_gate](double v) { return lufs(v) > relative_gate; });
+	if (kept.empty()) {
+		return absolute_gate;
+	}
+
+	return mean_lufs(kept);
+}
+
+
+double
+LoudnessMeter::range() const
+{
+	auto const gated = absolute_gated(mean_squares(short_term_blocks));
+	if (gated.empty()) {
+		return 0;
+	}
+
+	auto const relative_gate = mean_lufs(gated) - 20;
+
+	vector<double> kept;
+	for (auto v: gated) {
+		if (lufs(v) > relative_gate) {
+			kept.push_back(lufs(v));
+		}
+	}
+	if (kept.empty()) {
+		return 0;
+	}
+
+	std::sort(kept.begin(), kept.end());
+	auto percentile = [&kept](double p) {
+		return kept[static_cast<size_t>((kept.size() - 1) * p + 0.5)];
+	};
+
+	return percentile(0.95) - percentile(0.10);
+}
@@ -0,0 +1,121 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/loudness_meter.h
+ *  @brief LoudnessMeter class.
+ */
+
+
+#ifndef DCPOMATIC_LOUDNESS_METER_H
+#define DCPOMATIC_LOUDNESS_METER_H
+
+
+#include <array>
+#include <vector>
+
+
+class AudioBuffers;
+
+
+/** @class LoudnessMeter
+ *  @brief Measure integrated loudness (ITU-R BS.1770) and loudness range (EBU Tech 3342).
+ *
+ *  The audio is K-weighted and the channel-weighted energy of each 100ms block is kept.
+ *  The gated measurements are made from these blocks when they are asked for, so two
+ *  meters which measured consecutive stretches of audio can be combined with append()
+ *  to give exactly the same result as one meter which measured the lot.
+ */
+class LoudnessMeter
+{
+public:
+	LoudnessMeter(int sample_rate, int channels);
+
+	/** Pass some audio through the meter.
+	 *  @param audio Audio, with channels in DCP order.
+	 *  @param offset Offset of the first frame in audio to use.
+	 *  @param frames Number of frames to use.
+	 *  @param measure true to measure this audio, false to use it only to settle the K-weighting filters
+	 *  before measuring whatever comes next.
+	 */
+	void process(AudioBuffers const& audio, int offset, int frames, bool measure);
+
+	/** Add the measurements from another meter, which measured the audio immediately after ours.
+	 *  What we have measured so far must end at the end of a block.
+	 */
+	void append(LoudnessMeter const& other);
+
+	/** Add some blocks that another meter measured to ours.
+	 *  @param blocks Blocks from the other meter's blocks().
+	 *  @param offset Index of our block that the first of the other blocks should be added to.
+	 *  @param gain Linear gain to apply to the other audio.
+	 */
+	void mix(std::vector<double> const& blocks, int offset, double gain);
+
+	std::vector<double> const& blocks() const {
+		return _blocks;
+	}
+
+	/** @return Integrated loudness in LUFS, or -70 if nothing was loud enough to measure */
+	double integrated() const;
+	/** @return Loudness range in LU */
+	double range() const;
+
+	/** @return Number of frames in each block that we measure */
+	int block_frames() const {
+		return _block_frames;
+	}
+
+private:
+	/** One stage of the K-weighting filter */
+	struct Biquad
+	{
+		double b0 = 1;
+		double b1 = 0;
+		double b2 = 0;
+		double a1 = 0;
+		double a2 = 0;
+	};
+
+	/** State of one stage of the filter for one channel */
+	struct State
+	{
+		double x1 = 0;
+		double x2 = 0;
+		double y1 = 0;
+		double y2 = 0;
+	};
+
+	std::vector<double> mean_squares(int blocks_per_measurement) const;
+
+	std::array<Biquad, 2> _stages;
+	/** Weight for each channel (G in BS.1770) */
+	std::vector<double> _weights;
+	std::vector<std::array<State, 2>> _state;
+	int _block_frames;
+	/** Sum of the weighted squares of the K-weighted samples in each complete block */
+	std::vector<double> _blocks;
+	/** The same sum for the block that we are part-way through */
+	double _current = 0;
+	int _current_frames = 0;
+};
+
+
+#endif
@@ -0,0 +1,142 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/mpmc_queue.h
+ *  @brief MPMCQueue class.
+ */
+
+
+#ifndef DCPOMATIC_MPMC_QUEUE_H
+#define DCPOMATIC_MPMC_QUEUE_H
+
+
+#include "dcpomatic_assert.h"
+#include <boost/optional.hpp>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+
+/** @class MPMCQueue
+ *  @brief A bounded, lock-free, multi-producer multi-consumer FIFO.
+ *
+ *  This is Dmitry Vyukov's bounded MPMC queue: each cell carries a sequence number
+ *  which tells producers and consumers whether it is free to write or ready to read,
+ *  so the only contended operations are a compare-and-swap on the head or tail.
+ *
+ *  try_push() and try_pop() never block; callers that want to wait must arrange
+ *  that themselves.
+ */
+template <typename T>
+class MPMCQueue
+{
+public:
+	/** @param capacity Maximum number of items in the queue; must be a power of 2 */
+	explicit MPMCQueue(size_t capacity)
+		: _cells(new Cell[capacity])
+		, _mask(capacity - 1)
+	{
+		DCPOMATIC_ASSERT(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+		for (size_t i = 0; i < capacity; ++i) {
+			_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MPMCQueue(MPMCQueue const&) = delete;
+	MPMCQueue& operator=(MPMCQueue const&) = delete;
+
+	/** @return true if the item was added, false if the queue was full */
+	bool try_push(T const& item)
+	{
+		Cell* cell = nullptr;
+		auto position = _tail.load(std::memory_order_relaxed);
+		while (true) {
+			cell = &_cells[position & _mask];
+			auto const sequence = cell->sequence.load(std::memory_order_acquire);
+			auto const diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+			if (diff == 0) {
+				if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (diff < 0) {
+				return false;
+			} else {
+				position = _tail.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->data = item;
+		cell->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	/** @return true if an item was taken and put into `item', false if the queue was empty */
+	bool try_pop(boost::optional<T>& item)
+	{
+		Cell* cell = nullptr;
+		auto position = _head.load(std::memory_order_relaxed);
+		while (true) {
+			cell = &_cells[position & _mask];
+			auto const sequence = cell->sequence.load(std::memory_order_acquire);
+			auto const diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+			if (diff == 0) {
+				if (_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (diff < 0) {
+				return false;
+			} else {
+				position = _head.load(std::memory_order_relaxed);
+			}
+		}
+
+		item = std::move(cell->data);
+		cell->data = boost::none;
+		cell->sequence.store(position + _mask + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t capacity() const {
+		return _mask + 1;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		boost::optional<T> data;
+	};
+
+	std::unique_ptr<Cell[]> _cells;
+	size_t const _mask;
+
+	/* Keep the head and tail on separate cache lines so that producers and
+	 * consumers don't fight over the same one.
+	 */
+	char _pad0[64];
+	std::atomic<size_t> _tail{0};
+	char _pad1[64];
+	std::atomic<size_t> _head{0};
+	char _pad2[64];
+};
+
+
+#endif
@@ -43,6 +43,7 @@ public:
 	{}
 
 	std::shared_ptr<Content> content;
+	/** Decoder for our content, or null if the Player is not decoding it at the moment */
 	std::shared_ptr<Decoder> decoder;
 	std::vector<dcpomatic::DCPTimePeriod> ignore_video;
 	std::vector<dcpomatic::DCPTimePeriod> ignore_atmos;
@@ -44,10 +44,12 @@
 #include "player_video.h"
 #include "playlist.h"
 #include "raw_image_proxy.h"
-#include "render_text.h"
 #include "shuffler.h"
+#include "stage_times.h"
 #include "text_content.h"
 #include "text_decoder.h"
+#include "text_raster_cache.h"
+#include "trace.h"
 #include "video_decoder.h"
 #include <dcp/reel.h>
 #include <dcp/reel_picture_asset.h>
@@ -80,6 +82,12 @@ using namespace boost::placeholders;
 using namespace dcpomatic;
 
 
+/** Pieces which start within this time of the playhead get decoders straight away; the others get
+ *  them when they are needed.
+ */
+static auto const decoder_window = DCPTime::from_seconds(2);
+
+
 Player::Player(shared_ptr<const Film> film, Image::Alignment subtitle_alignment, bool tolerant)
 	: _film(film)
 	, _suspended(0)
@@ -91,6 +99,7 @@ Player::Player(shared_ptr<const Film> film, Image::Alignment subtitle_alignment,
 	, _fast(false)
 	, _tolerant(tolerant)
 	, _play_referenced(false)
+	, _dcp_decode_ahead(0)
 	, _audio_merger(film->audio_frame_rate())
 	, _playback_length(dcpomatic::DCPTime{})
 	, _subtitle_alignment(subtitle_alignment)
@@ -111,6 +120,7 @@ Player::Player(shared_ptr<const Film> film, shared_ptr<const Playlist> playlist_
 	, _fast(false)
 	, _tolerant(tolerant)
 	, _play_referenced(false)
+	, _dcp_decode_ahead(0)
 	, _audio_merger(film->audio_frame_rate())
 	, _playback_length(dcpomatic::DCPTime{})
 {
@@ -154,6 +164,7 @@ Player::Player(Player&& other)
 	, _playlist(std::move(other._playlist))
 	, _suspended(other._suspended.load())
 	, _pieces(std::move(other._pieces))
+	, _retired_decoders(std::move(other._retired_decoders))
 	, _video_container_size(other._video_container_size.load())
 	, _black_image(std::move(other._black_image))
 	, _ignore_video(other._ignore_video.load())
@@ -166,6 +177,7 @@ Player::Player(Player&& other)
 	, _next_video_time(other._next_video_time)
 	, _next_audio_time(other._next_audio_time)
 	, _dcp_decode_reduction(other._dcp_decode_reduction)
+	, _dcp_decode_ahead(other._dcp_decode_ahead.load())
 	, _last_video(std::move(other._last_video))
 	, _audio_merger(std::move(other._audio_merger))
 	, _shuffler(std::move(other._shuffler))
@@ -194,6 +206,7 @@ Player::operator=(Player&& other)
 	_playlist = std::move(other._playlist);
 	_suspended = other._suspended.load();
 	_pieces = std::move(other._pieces);
+	_retired_decoders = std::move(other._retired_decoders);
 	_video_container_size = other._video_container_size.load();
 	_black_image = std::move(other._black_image);
 	_ignore_video = other._ignore_video.load();
@@ -206,6 +219,7 @@ Player::operator=(Player&& other)
 	_next_video_time = other._next_video_time;
 	_next_audio_time = other._next_audio_time;
 	_dcp_decode_reduction = other._dcp_decode_reduction;
+	_dcp_decode_ahead = other._dcp_decode_ahead.load();
 	_last_video = std::move(other._last_video);
 	_audio_merger = std::move(other._audio_merger);
 	_shuffler = std::move(other._shuffler);
@@ -252,6 +266,8 @@ Player::setup_pieces()
 		return;
 	}
 
+	auto const playhead = _next_video_time.get_value_or(_next_audio_time.get_value_or(DCPTime()));
+
 	_playback_length = _playlist ? _playlist->length(film) : film->length();
 
 	auto playlist_content = playlist()->content();
@@ -266,8 +282,13 @@ Player::setup_pieces()
 	if (have_threed) {
 		_shuffler.reset(new Shuffler());
 		_shuffler->Video.connect(bind(&Player::video, this, _1, _2));
+	} else {
+		_shuffler.reset();
 	}
 
+	/* These decoders belong to the old pieces, so they can't be used any more */
+	_retired_decoders.clear();
+
 	for (auto content: playlist()->content()) {
 
 		if (!paths_exist(content->paths())) {
@@ -287,67 +308,14 @@ Player::setup_pieces()
 			}
 		}
 
-		auto decoder = decoder_factory(film, content, _fast, _tolerant, old_decoder);
-		DCPOMATIC_ASSERT(decoder);
-
-		FrameRateChange frc(film, content);
-
-		if (decoder->video && _ignore_video) {
-			decoder->video->set_ignore(true);
-		}
-
-		if (decoder->audio && _ignore_audio) {
-			decoder->audio->set_ignore(true);
-		}
-
-		if (_ignore_text) {
-			for (auto i: decoder->text) {
-				i->set_ignore(true);
-			}
-		}
-
-		auto dcp = dynamic_pointer_cast<DCPDecoder>(decoder);
-		if (dcp) {
-			dcp->set_decode_referenced(_play_referenced);
-			if (_play_referenced) {
-				dcp->set_forced_reduction(_dcp_decode_reduction);
-			}
-		}
-
-		auto piece = make_shared<Piece>(content, decoder, frc);
+		auto piece = make_shared<Piece>(content, shared_ptr<Decoder>(), FrameRateChange(film, content));
 		_pieces.push_back(piece);
 
-		if (decoder->video) {
-			if (have_threed) {
-				/* We need a Shuffler to cope with 3D L/R video data arriving out of sequence */
-				decoder->video->Data.connect(bind(&Shuffler::video, _shuffler.get(), weak_ptr<Piece>(piece), _1));
-			} else {
-				decoder->video->Data.connect(bind(&Player::video, this, weak_ptr<Piece>(piece), _1));
-			}
-		}
-
-		if (decoder->audio) {
-			decoder->audio->Data.connect(bind(&Player::audio, this, weak_ptr<Piece>(piece), _1, _2));
-		}
-
-		auto j = decoder->text.begin();
-
-		while (j != decoder->text.end()) {
-			(*j)->BitmapStart.connect(
-				bind(&Player::bitmap_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
-				);
-			(*j)->PlainStart.connect(
-				bind(&Player::plain_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
-				);
-			(*j)->Stop.connect(
-				bind(&Player::text_stop, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
-				);
-
-			++j;
-		}
-
-		if (decoder->atmos) {
-			decoder->atmos->Data.connect(bind(&Player::atmos, this, weak_ptr<Piece>(piece), _1));
+		/* Only make decoders for content near the playhead now; the rest will be made when they are needed.
+		 * If there was a decoder for this content before, make a new one now so that it can re-use the old one's data.
+		 */
+		if (old_decoder || (content->position() < playhead + decoder_window && playhead < content->end(film))) {
+			open_decoder(piece, old_decoder);
 		}
 	}
 
@@ -400,6 +368,107 @@ Player::setup_pieces()
 }
 
 
+/** Make a decoder for a piece, or give it back the one that it had before if it is still in
+ *  _retired_decoders.  Caller must hold a lock on _mutex.
+ *  @param old_decoder Decoder which was previously used for the same content, whose data may be re-used.
+ */
+void
+Player::open_decoder(shared_ptr<Piece> piece, shared_ptr<Decoder> old_decoder)
+{
+	DCPOMATIC_ASSERT(!piece->decoder);
+
+	auto film = _film.lock();
+	DCPOMATIC_ASSERT(film);
+
+	for (auto i = _retired_decoders.begin(); i != _retired_decoders.end(); ++i) {
+		if (i->first.lock() == piece) {
+			piece->decoder = i->second;
+			_retired_decoders.erase(i);
+			if (auto dcp = dynamic_pointer_cast<DCPDecoder>(piece->decoder)) {
+				dcp->set_decode_ahead(_dcp_decode_ahead, dcp_decode_ahead_size(film, piece->content));
+			}
+			return;
+		}
+	}
+
+	auto decoder = decoder_factory(film, piece->content, _fast, _tolerant, old_decoder);
+	DCPOMATIC_ASSERT(decoder);
+
+	if (decoder->video && _ignore_video) {
+		decoder->video->set_ignore(true);
+	}
+
+	if (decoder->audio && _ignore_audio) {
+		decoder->audio->set_ignore(true);
+	}
+
+	if (_ignore_text) {
+		for (auto i: decoder->text) {
+			i->set_ignore(true);
+		}
+	}
+
+	auto dcp = dynamic_pointer_cast<DCPDecoder>(decoder);
+	if (dcp) {
+		dcp->set_decode_referenced(_play_referenced);
+		if (_play_referenced) {
+			dcp->set_forced_reduction(_dcp_decode_reduction);
+		}
+		dcp->set_decode_ahead(_dcp_decode_ahead, dcp_decode_ahead_size(film, piece->content));
+	}
+
+	if (decoder->video) {
+		if (_shuffler) {
+			/* We need a Shuffler to cope with 3D L/R video data arriving out of sequence */
+			decoder->video->Data.connect(bind(&Shuffler::video, _shuffler.get(), weak_ptr<Piece>(piece), _1));
+		} else {
+			decoder->video->Data.connect(bind(&Player::video, this, weak_ptr<Piece>(piece), _1));
+		}
+	}
+
+	if (decoder->audio) {
+		decoder->audio->Data.connect(bind(&Player::audio, this, weak_ptr<Piece>(piece), _1, _2));
+	}
+
+	for (auto text: decoder->text) {
+		text->BitmapStart.connect(
+			bind(&Player::bitmap_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>(text->content()), _1)
+			);
+		text->PlainStart.connect(
+			bind(&Player::plain_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>(text->content()), _1)
+			);
+		text->Stop.connect(
+			bind(&Player::text_stop, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>(text->content()), _1)
+			);
+	}
+
+	if (decoder->atmos) {
+		decoder->atmos->Data.connect(bind(&Player::atmos, this, weak_ptr<Piece>(piece), _1));
+	}
+
+	piece->decoder = decoder;
+}
+
+
+/** Take a piece's decoder away (if it has one) and put it in _retired_decoders in case it is
+ *  wanted again soon.  Caller must hold a lock on _mutex.
+ */
+void
+Player::retire_decoder(shared_ptr<Piece> piece)
+{
+	if (!piece->decoder) {
+		return;
+	}
+
+	_retired_decoders.push_front(make_pair(weak_ptr<Piece>(piece), piece->decoder));
+	piece->decoder.reset();
+
+	while (_retired_decoders.size() > max_retired_decoders) {
+		_retired_decoders.pop_back();
+	}
+}
+
+
 void
 Player::playlist_content_change(ChangeType type, int property, bool frequent)
 {
@@ -454,6 +523,57 @@ Player::set_video_container_size(dcp::Size s)
 		_black_image = make_shared<Image>(AV_PIX_FMT_RGB24, _video_container_size, Image::Alignment::PADDED);
 		_black_image->make_black();
 	}
+
+	setup_decode_ahead();
+}
+
+
+/** Decode JPEG2000 frames from DCPs on several threads, ahead of when they are needed.
+ *  @param frames Number of frames to decode ahead, or 0 to disable this.
+ */
+void
+Player::set_dcp_decode_ahead(int frames)
+{
+	_dcp_decode_ahead = frames;
+	setup_decode_ahead();
+}
+
+
+/** Give the current decode-ahead settings to our DCP decoders */
+void
+Player::setup_decode_ahead()
+{
+	auto film = _film.lock();
+	if (!film) {
+		return;
+	}
+
+	boost::mutex::scoped_lock lm(_mutex);
+
+	for (auto piece: _pieces) {
+		if (auto dcp = dynamic_pointer_cast<DCPDecoder>(piece->decoder)) {
+			dcp->set_decode_ahead(_dcp_decode_ahead, dcp_decode_ahead_size(film, piece->content));
+		}
+	}
+}
+
+
+/** @return The size that video from some content will be scaled to before it goes into our
+ *  video container, which is the size that decode-ahead should aim for.
+ */
+optional<dcp::Size>
+Player::dcp_decode_ahead_size(shared_ptr<const Film> film, shared_ptr<const Content> content) const
+{
+	if (!content->video) {
+		return {};
+	}
+
+	auto const scaled_size = content->video->scaled_size(film->frame_size());
+	if (!scaled_size) {
+		return {};
+	}
+
+	return scale_for_display(*scaled_size, _video_container_size, film->frame_size(), content->video->pixel_quanta());
 }
 
 
@@ -689,14 +809,18 @@ Player::earliest_piece_and_time() const
 			continue;
 		}
 
-		auto const t = content_time_to_dcp(piece, max(piece->decoder->position(), piece->content->trim_start()));
+		/* A piece without a decoder has not started yet */
+		auto const t = piece->decoder ?
+			content_time_to_dcp(piece, max(piece->decoder->position(), piece->content->trim_start())) :
+			piece->content->position();
+		auto const has_text = piece->decoder ? !piece->decoder->text.empty() : !piece->content->text.empty();
 		if (t > piece->content->end(film)) {
 			piece->done = true;
 		} else {
 			/* Given two choices at the same time, pick the one with texts so we see it before
 			   the video.
 			*/
-			if (!earliest_time || t < *earliest_time || (t == *earliest_time && !piece->decoder->text.empty())) {
+			if (!earliest_time || t < *earliest_time || (t == *earliest_time && has_text)) {
 				earliest_time = t;
 				earliest_content = piece;
 			}
@@ -711,6 +835,7 @@ bool
 Player::pass()
 {
 	boost::mutex::scoped_lock lm(_mutex);
+	Trace::Span span("Player::pass");
 
 	if (_suspended) {
 		/* We can't pass in this state */
@@ -732,6 +857,12 @@ Player::pass()
 	optional<DCPTime> earliest_time;
 	std::tie(earliest_content, earliest_time) = earliest_piece_and_time();
 
+	for (auto piece: _pieces) {
+		if (piece->done) {
+			retire_decoder(piece);
+		}
+	}
+
 	bool done = false;
 
 	enum {
@@ -759,7 +890,21 @@ Player::pass()
 	case CONTENT:
 	{
 		LOG_DEBUG_PLAYER("PLY: Calling pass() on {} @ {}", earliest_content->content->path(0).string(), to_string(*earliest_time));
-		earliest_content->done = earliest_content->decoder->pass();
+		if (!earliest_content->decoder) {
+			/* We have got to some content that was too far away to have a decoder when we set up or seeked;
+			   seek its new decoder accurately to its start, as seek() would have done.
+			*/
+			open_decoder(earliest_content);
+			earliest_content->decoder->seek(dcp_to_content_time(earliest_content, earliest_content->content->position()), true);
+		}
+		{
+			StageTimes::Period period(StageTimes::Stage::DECODE);
+			Trace::Span span("Decoder::pass");
+			earliest_content->done = earliest_content->decoder->pass();
+		}
+		if (earliest_content->done) {
+			retire_decoder(earliest_content);
+		}
 		auto dcp = dynamic_pointer_cast<DCPContent>(earliest_content->content);
 		if (dcp && !_play_referenced) {
 			if (dcp->reference_video()) {
@@ -967,7 +1112,7 @@ Player::open_texts_for_frame(DCPTime time) const
 
 			/* String texts (rendered to an image) */
 			if (!text.string.empty()) {
-				auto s = render_text(text.string, _video_container_size, time, vfr);
+				auto s = TextRasterCache::instance()->render(text.string, _video_container_size, time, vfr);
 				copy_if(s.begin(), s.end(), back_inserter(texts), [](PositionImage const& image) {
 					return image.image->size().width && image.image->size().height;
 				});
@@ -1445,19 +1590,31 @@ Player::seek(DCPTime time, bool accurate)
 
 	for (auto i: _pieces) {
 		if (time < i->content->position()) {
-			/* Before; seek to the start of the content.  Even if this request is for an inaccurate seek
-			   we must seek this (following) content accurately, otherwise when we come to the end of the current
-			   content we may not start right at the beginning of the next, causing a gap (if the next content has
-			   been trimmed to a point between keyframes, or something).
-			*/
-			i->decoder->seek(dcp_to_content_time(i, i->content->position()), true);
+			if (i->content->position() < time + decoder_window) {
+				/* Before, but soon; seek to the start of the content.  Even if this request is for an inaccurate seek
+				   we must seek this (following) content accurately, otherwise when we come to the end of the current
+				   content we may not start right at the beginning of the next, causing a gap (if the next content has
+				   been trimmed to a point between keyframes, or something).
+				*/
+				if (!i->decoder) {
+					open_decoder(i);
+				}
+				i->decoder->seek(dcp_to_content_time(i, i->content->position()), true);
+			} else {
+				/* Well before; we'll get a decoder for this (and seek it accurately) when we need it */
+				retire_decoder(i);
+			}
 			i->done = false;
 		} else if (i->content->position() <= time && time < i->content->end(film)) {
 			/* During; seek to position */
+			if (!i->decoder) {
+				open_decoder(i);
+			}
 			i->decoder->seek(dcp_to_content_time(i, time), accurate);
 			i->done = false;
 		} else {
 			/* After; this piece is done */
+			retire_decoder(i);
 			i->done = true;
 		}
 	}
@@ -50,6 +50,7 @@ namespace dcp {
 class AtmosContent;
 class AudioBuffers;
 class Content;
+class Decoder;
 class Film;
 class PlayerVideo;
 class Playlist;
@@ -106,6 +107,7 @@ public:
 	void set_fast();
 	void set_play_referenced();
 	void set_dcp_decode_reduction(boost::optional<int> reduction);
+	void set_dcp_decode_ahead(int frames);
 	void set_disable_audio_processor();
 
 	boost::optional<dcpomatic::DCPTime> content_time_to_dcp(std::shared_ptr<const Content> content, dcpomatic::ContentTime t) const;
@@ -142,10 +144,15 @@ private:
 	friend struct empty_test2;
 	friend struct check_reuse_old_data_test;
 	friend struct overlap_video_test1;
+	friend struct player_lazy_decoders_test;
 
 	void construct();
 	void connect();
 	void setup_pieces();
+	void open_decoder(std::shared_ptr<Piece> piece, std::shared_ptr<Decoder> old_decoder = {});
+	void retire_decoder(std::shared_ptr<Piece> piece);
+	void setup_decode_ahead();
+	boost::optional<dcp::Size> dcp_decode_ahead_size(std::shared_ptr<const Film> film, std::shared_ptr<const Content> content) const;
 	void film_change(ChangeType, FilmProperty);
 	void playlist_change(ChangeType);
 	void playlist_content_change(ChangeType, int, bool);
@@ -195,6 +202,12 @@ private:
 	/** > 0 if we are suspended (i.e. pass() and seek() do nothing) */
 	std::atomic<int> _suspended;
 	std::vector<std::shared_ptr<Piece>> _pieces;
+	/** Decoders which have been taken away from pieces that we are not decoding at the moment,
+	 *  most-recently-retired first, so that they can be given back if the pieces are needed again.
+	 */
+	std::list<std::pair<std::weak_ptr<Piece>, std::shared_ptr<Decoder>>> _retired_decoders;
+	/** Maximum size of _retired_decoders */
+	static size_t constexpr max_retired_decoders = 4;
 
 	/** Size of the image we are rendering to; this may be the DCP frame size, or
 	 *  the size of preview in a window.
@@ -223,6 +236,8 @@ private:
 	boost::optional<dcpomatic::DCPTime> _next_audio_time;
 
 	boost::optional<int> _dcp_decode_reduction;
+	/** Number of frames to decode ahead in DCPDecoders, or 0 */
+	std::atomic<int> _dcp_decode_ahead;
 
 	EnumIndexedVector<std::pair<std::shared_ptr<PlayerVideo>, dcpomatic::DCPTime>, Eyes> _last_video;
 
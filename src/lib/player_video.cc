@@ -20,12 +20,15 @@
 
 
 #include "content.h"
+#include "digester.h"
+#include "exceptions.h"
 #include "film.h"
 #include "image.h"
 #include "image_proxy.h"
 #include "j2k_image_proxy.h"
 #include "player.h"
 #include "player_video.h"
+#include "stage_times.h"
 #include "video_content.h"
 extern "C" {
 #include <libavutil/pixfmt.h>
@@ -93,7 +96,13 @@ PlayerVideo::PlayerVideo(shared_ptr<cxml::Node> node, shared_ptr<Socket> socket)
 	/* Assume that the ColourConversion uses the current state version */
 	_colour_conversion = ColourConversion::from_xml(node, Film::current_state_version);
 
-	_in = image_proxy_factory(node->node_child("In"), socket);
+	auto const encoding_name = node->optional_string_child("TransportEncoding").get_value_or("none");
+	auto const encoding = string_to_transport_encoding(encoding_name);
+	if (!encoding) {
+		throw NetworkError(fmt::format("Unknown transport encoding {}", encoding_name));
+	}
+
+	_in = image_proxy_factory(node->node_child("In"), socket, *encoding);
 
 	if (node->optional_number_child<int>("SubtitleX")) {
 
@@ -101,7 +110,7 @@ PlayerVideo::PlayerVideo(shared_ptr<cxml::Node> node, shared_ptr<Socket> socket)
 			AV_PIX_FMT_BGRA, dcp::Size(node->number_child<int>("SubtitleWidth"), node->number_child<int>("SubtitleHeight")), Image::Alignment::PADDED
 			);
 
-		image->read_from_socket(socket);
+		image->read_from_socket(socket, *encoding);
 
 		_text = PositionImage(image, Position<int>(node->number_child<int>("SubtitleX"), node->number_child<int>("SubtitleY")));
 	}
@@ -122,6 +131,7 @@ PlayerVideo::image(function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRa
 
 	boost::mutex::scoped_lock lm(_mutex);
 	if (!_image || _crop != _image_crop || _inter_size != _image_inter_size || _out_size != _image_out_size || _fade != _image_fade) {
+		StageTimes::Period period(StageTimes::Stage::PLAYER);
 		make_image(pixel_format, video_range, fast);
 	}
 	return _image;
@@ -182,8 +192,18 @@ PlayerVideo::make_image(function<AVPixelFormat (AVPixelFormat)> pixel_format, Vi
 		yuv_to_rgb = _colour_conversion.get().yuv_to_rgb();
 	}
 
+	auto const out_format = pixel_format(prox.image->pixel_format());
+
+	if (out_format == AV_PIX_FMT_RGB48LE || out_format == AV_PIX_FMT_XYZ12LE) {
+		/* This is the DCP encoding path, so it's worth doing all the steps in one pass */
+		_image = prox.image->crop_scale_window_composite(
+			total_crop, _inter_size, _out_size, yuv_to_rgb, _video_range, out_format, video_range, Image::Alignment::COMPACT, fast, _text, _fade
+			);
+		return;
+	}
+
 	_image = prox.image->crop_scale_window(
-		total_crop, _inter_size, _out_size, yuv_to_rgb, _video_range, pixel_format(prox.image->pixel_format()), video_range, Image::Alignment::COMPACT, fast
+		total_crop, _inter_size, _out_size, yuv_to_rgb, _video_range, out_format, video_range, Image::Alignment::COMPACT, fast
 		);
 
 	if (_text) {
@@ -225,11 +245,27 @@ PlayerVideo::add_metadata(xmlpp::Element* element) const
 
 
 void
-PlayerVideo::write_to_socket(shared_ptr<Socket> socket) const
+PlayerVideo::write_to_socket(shared_ptr<Socket> socket, TransportEncoding encoding) const
+{
+	_in->write_to_socket(socket, encoding);
+	if (_text) {
+		_text->image->write_to_socket(socket, encoding);
+	}
+}
+
+
+/** Add everything that affects the image that we will make to a digest */
+void
+PlayerVideo::add_to_digest(Digester& digester) const
 {
-	_in->write_to_socket(socket);
+	xmlpp::Document doc;
+	add_metadata(doc.create_root_node("PlayerVideo"));
+	auto const xml = doc.write_to_string("UTF-8");
+	digester.add(xml.c_str(), xml.bytes());
+
+	_in->add_to_digest(digester);
 	if (_text) {
-		_text->image->write_to_socket(socket);
+		_text->image->add_to_digest(digester);
 	}
 }
 
@@ -35,6 +35,7 @@ extern "C" {
 #include <boost/thread/mutex.hpp>
 
 
+class Digester;
 class Image;
 class ImageProxy;
 class Film;
@@ -80,7 +81,8 @@ public:
 	std::shared_ptr<const Image> raw_image() const;
 
 	void add_metadata(xmlpp::Element* element) const;
-	void write_to_socket(std::shared_ptr<Socket> socket) const;
+	void write_to_socket(std::shared_ptr<Socket> socket, TransportEncoding encoding) const;
+	void add_to_digest(Digester& digester) const;
 
 	bool reset_metadata(std::shared_ptr<const Film> film, dcp::Size player_video_container_size);
 
@@ -20,6 +20,7 @@
 
 
 #include "dcpomatic_assert.h"
+#include "digester.h"
 #include "raw_image_proxy.h"
 #include "image.h"
 #include <dcp/util.h>
@@ -52,14 +53,14 @@ RawImageProxy::RawImageProxy(shared_ptr<const Image> image)
 }
 
 
-RawImageProxy::RawImageProxy (shared_ptr<cxml::Node> xml, shared_ptr<Socket> socket)
+RawImageProxy::RawImageProxy (shared_ptr<cxml::Node> xml, shared_ptr<Socket> socket, TransportEncoding encoding)
 {
 	dcp::Size size (
 		xml->number_child<int>("Width"), xml->number_child<int>("Height")
 		);
 
 	auto image = make_shared<Image>(static_cast<AVPixelFormat>(xml->number_child<int>("PixelFormat")), size, Image::Alignment::PADDED);
-	image->read_from_socket (socket);
+	image->read_from_socket (socket, encoding);
 	_image = image;
 }
 
@@ -83,9 +84,16 @@ RawImageProxy::add_metadata(xmlpp::Element* element) const
 
 
 void
-RawImageProxy::write_to_socket (shared_ptr<Socket> socket) const
+RawImageProxy::write_to_socket (shared_ptr<Socket> socket, TransportEncoding encoding) const
 {
-	_image->write_to_socket (socket);
+	_image->write_to_socket (socket, encoding);
+}
+
+
+void
+RawImageProxy::add_to_digest(Digester& digester) const
+{
+	_image->add_to_digest(digester);
 }
 
 
@@ -30,7 +30,7 @@ class RawImageProxy : public ImageProxy
 {
 public:
 	explicit RawImageProxy(std::shared_ptr<const Image>);
-	RawImageProxy (std::shared_ptr<cxml::Node> xml, std::shared_ptr<Socket> socket);
+	RawImageProxy (std::shared_ptr<cxml::Node> xml, std::shared_ptr<Socket> socket, TransportEncoding encoding);
 
 	Result image (
 		Image::Alignment alignment,
@@ -38,7 +38,8 @@ public:
 		) const override;
 
 	void add_metadata(xmlpp::Element*) const override;
-	void write_to_socket (std::shared_ptr<Socket>) const override;
+	void write_to_socket (std::shared_ptr<Socket>, TransportEncoding encoding) const override;
+	void add_to_digest(Digester& digester) const override;
 	bool same (std::shared_ptr<const ImageProxy>) const override;
 	size_t memory_used () const override;
 
@@ -30,6 +30,8 @@
 #include "job.h"
 #include "reel_writer.h"
 #include "remembered_asset.h"
+#include "stage_times.h"
+#include "trace.h"
 #include <dcp/atmos_asset.h>
 #include <dcp/atmos_asset_writer.h>
 #include <dcp/certificate_chain.h>
@@ -52,6 +54,7 @@
 #include <dcp/stereo_j2k_picture_asset.h>
 #include <dcp/text_image.h>
 #include <fmt/format.h>
+#include <algorithm>
 
 #include "i18n.h"
 
@@ -59,6 +62,7 @@
 using std::dynamic_pointer_cast;
 using std::list;
 using std::make_shared;
+using std::pair;
 using std::set;
 using std::shared_ptr;
 using std::string;
@@ -127,8 +131,15 @@ ReelWriter::ReelWriter(
 	DCPOMATIC_ASSERT(film()->directory());
 
 	auto existing_asset_filename = find_asset(remembered_assets, *film()->directory(), period, film()->video_identifier());
+	optional<string> existing_asset_hash;
 	if (existing_asset_filename) {
 		_first_nonexistent_frame = check_existing_picture_asset(*existing_asset_filename);
+		auto remembered = std::find_if(remembered_assets.begin(), remembered_assets.end(), [&existing_asset_filename](RememberedAsset const& asset) {
+			return asset.filename().filename() == existing_asset_filename->filename();
+		});
+		if (remembered != remembered_assets.end()) {
+			existing_asset_hash = remembered->hash();
+		}
 	}
 
 	if (_first_nonexistent_frame < period.duration().frames_round(film()->video_frame_rate())) {
@@ -203,6 +214,12 @@ ReelWriter::ReelWriter(
 		} else {
 			_mpeg2_picture_asset = make_shared<dcp::MonoMPEG2PictureAsset>(new_asset_filename);
 		}
+
+		if (existing_asset_hash) {
+			/* We worked out the digest when we wrote this asset, so there's no need to read it all again */
+			picture_asset()->set_hash(*existing_asset_hash);
+			_picture_digest_done = true;
+		}
 	}
 
 	if (film()->audio_channels()) {
@@ -352,6 +369,53 @@ ReelWriter::repeat_write(Frame frame, Eyes eyes)
 }
 
 
+shared_ptr<dcp::PictureAsset>
+ReelWriter::picture_asset() const
+{
+	if (_j2k_picture_asset) {
+		return _j2k_picture_asset;
+	}
+
+	return _mpeg2_picture_asset;
+}
+
+
+/** Called from a Writer thread once every frame of this reel's J2K picture has been written.
+ *  We finish the picture asset straight away and calculate its digest, so that (unless this is
+ *  the last reel) we can do it while the rest of the DCP is being encoded, rather than at the
+ *  end when the file is likely to have dropped out of the disk cache.
+ *  @param set_progress Method to call with progress; it may throw boost::thread_interrupted
+ *  to abandon the calculation, in which case it will be done again by calculate_digests().
+ */
+void
+ReelWriter::finish_picture(std::function<void (int64_t, int64_t)> set_progress)
+{
+	if (!_j2k_picture_asset_writer) {
+		return;
+	}
+
+	if (!_j2k_picture_asset_writer->finalize()) {
+		/* Nothing was written to the J2K picture asset */
+		LOG_GENERAL("Nothing was written to J2K asset for reel {} of {}", _reel_index, _reel_count);
+		_j2k_picture_asset.reset();
+	}
+	_j2k_picture_asset_writer.reset();
+
+	if (!_j2k_picture_asset) {
+		return;
+	}
+
+	try {
+		StageTimes::Period period(StageTimes::Stage::DIGEST);
+		Trace::Span span("ReelWriter::finish_picture");
+		_j2k_picture_asset->hash(set_progress);
+		_picture_digest_done = true;
+	} catch (boost::thread_interrupted) {
+		/* We have been asked to stop, and calculate_digests() will have another go if required */
+	}
+}
+
+
 void
 ReelWriter::finish(boost::filesystem::path output_dcp)
 {
@@ -765,11 +829,10 @@ try
 {
 	vector<shared_ptr<const dcp::Asset>> assets;
 
-	if (_j2k_picture_asset) {
-		assets.push_back(_j2k_picture_asset);
-	}
-	if (_mpeg2_picture_asset) {
-		assets.push_back(_mpeg2_picture_asset);
+	if (auto picture = picture_asset()) {
+		if (!_picture_digest_done) {
+			assets.push_back(picture);
+		}
 	}
 	if (_sound_asset) {
 		assets.push_back(_sound_asset);
@@ -783,6 +846,9 @@ try
 		total_size += asset->file() ? dcp::filesystem::file_size(*asset->file()) : 0;
 	}
 
+	StageTimes::Period period(StageTimes::Stage::DIGEST);
+	Trace::Span span("ReelWriter::calculate_digests");
+
 	int64_t total_done = 0;
 	for (auto asset: assets) {
 		asset->hash([&total_done, total_size, set_progress](int64_t done, int64_t) {
@@ -798,6 +864,19 @@ try
 }
 
 
+/** @return Our picture asset's file and digest, if we have one */
+optional<pair<boost::filesystem::path, string>>
+ReelWriter::picture_digest() const
+{
+	auto picture = picture_asset();
+	if (!picture || !picture->file()) {
+		return {};
+	}
+
+	return std::make_pair(*picture->file(), picture->hash());
+}
+
+
 Frame
 ReelWriter::start() const
 {
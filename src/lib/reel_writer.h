@@ -50,6 +50,7 @@ namespace dcp {
 	class J2KPictureAsset;
 	class J2KPictureAssetWriter;
 	class MPEG2PictureAsset;
+	class PictureAsset;
 	class Reel;
 	class ReelAsset;
 	class ReelPictureAsset;
@@ -82,6 +83,7 @@ public:
 	void write(std::shared_ptr<const dcp::AtmosFrame> atmos, AtmosMetadata metadata);
 	void write(std::shared_ptr<dcp::MonoMPEG2PictureFrame> image);
 
+	void finish_picture(std::function<void (int64_t, int64_t)> set_progress);
 	void finish(boost::filesystem::path output_dcp);
 	std::shared_ptr<dcp::Reel> create_reel(
 		std::list<ReferencedReelAsset> const & refs,
@@ -90,6 +92,7 @@ public:
 		std::set<DCPTextTrack> ensure_closed_captions
 		);
 	void calculate_digests(std::function<void (int64_t, int64_t)> set_progress);
+	boost::optional<std::pair<boost::filesystem::path, std::string>> picture_digest() const;
 
 	Frame start() const;
 
@@ -108,6 +111,7 @@ private:
 	Frame check_existing_picture_asset(boost::filesystem::path asset);
 	bool existing_picture_frame_ok(dcp::File& asset_file, Frame frame);
 	std::shared_ptr<dcp::TextAsset> empty_text_asset(TextType type, boost::optional<DCPTextTrack> track, bool with_dummy) const;
+	std::shared_ptr<dcp::PictureAsset> picture_asset() const;
 
 	std::shared_ptr<dcp::ReelPictureAsset> create_reel_picture(std::shared_ptr<dcp::Reel> reel, std::list<ReferencedReelAsset> const & refs) const;
 	void create_reel_sound(std::shared_ptr<dcp::Reel> reel, std::list<ReferencedReelAsset> const & refs) const;
@@ -141,6 +145,8 @@ private:
 	dcp::File _info_file;
 
 	std::shared_ptr<dcp::J2KPictureAsset> _j2k_picture_asset;
+	/** true if we have already calculated the digest of our picture asset (or got it from a previous run) */
+	bool _picture_digest_done = false;
 	std::shared_ptr<dcp::MPEG2PictureAsset> _mpeg2_picture_asset;
 	/** picture asset writer, or 0 if we are not writing any picture because we already have one */
 	std::shared_ptr<dcp::J2KPictureAssetWriter> _j2k_picture_asset_writer;
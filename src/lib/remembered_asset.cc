@@ -45,6 +45,7 @@ RememberedAsset::RememberedAsset(cxml::ConstNodePtr node)
 	};
 
 	_identifier = node->string_child("Identifier");
+	_hash = node->optional_string_child("Hash");
 }
 
 
@@ -56,6 +57,9 @@ RememberedAsset::as_xml(xmlpp::Element* parent) const
 	cxml::add_text_child(period_node, "From", fmt::to_string(_period.from.get()));
 	cxml::add_text_child(period_node, "To", fmt::to_string(_period.to.get()));
 	cxml::add_text_child(parent, "Identifier", _identifier);
+	if (_hash) {
+		cxml::add_text_child(parent, "Hash", *_hash);
+	}
 }
 
 
@@ -30,6 +30,7 @@ LIBDCP_DISABLE_WARNINGS
 #include <libxml++/libxml++.h>
 LIBDCP_ENABLE_WARNINGS
 #include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
 
 
 class RememberedAsset
@@ -37,10 +38,16 @@ class RememberedAsset
 public:
 	explicit RememberedAsset(cxml::ConstNodePtr node);
 
-	RememberedAsset(boost::filesystem::path filename, dcpomatic::DCPTimePeriod period, std::string identifier)
+	RememberedAsset(
+		boost::filesystem::path filename,
+		dcpomatic::DCPTimePeriod period,
+		std::string identifier,
+		boost::optional<std::string> hash = boost::none
+		)
 		: _filename(filename)
 		, _period(period)
 		, _identifier(std::move(identifier))
+		, _hash(std::move(hash))
 	{}
 
 	void as_xml(xmlpp::Element* parent) const;
@@ -57,10 +64,20 @@ public:
 		return _identifier;
 	}
 
+	boost::optional<std::string> hash() const {
+		return _hash;
+	}
+
+	void set_hash(std::string hash) {
+		_hash = std::move(hash);
+	}
+
 private:
 	boost::filesystem::path _filename;
 	dcpomatic::DCPTimePeriod _period;
 	std::string _identifier;
+	/** Digest of the asset, if we have calculated it */
+	boost::optional<std::string> _hash;
 };
 
 
@@ -21,25 +21,76 @@
 
 #include "dcp_video.h"
 #include "dcpomatic_log.h"
+#include "dcpomatic_socket.h"
+#include "encode_server_statistics.h"
+#include "exceptions.h"
 #include "j2k_encoder.h"
 #include "remote_j2k_encoder_thread.h"
+#include "stage_times.h"
 #include "util.h"
+#include <dcp/scope_guard.h>
+#include <dcp/warnings.h>
+#include <libcxml/cxml.h>
+LIBDCP_DISABLE_WARNINGS
+#include <libxml++/libxml++.h>
+LIBDCP_ENABLE_WARNINGS
+#include <fmt/format.h>
+#include <algorithm>
+#include <cmath>
+#include <list>
 
 #include "i18n.h"
 
 
+using std::list;
 using std::make_shared;
 using std::shared_ptr;
+using boost::optional;
+
+
+int constexpr RemoteJ2KEncoderThread::initial_frames_in_flight;
+int constexpr RemoteJ2KEncoderThread::maximum_frames_in_flight;
+float constexpr RemoteJ2KEncoderThread::target_time_in_flight;
+float constexpr RemoteJ2KEncoderThread::idle_connection_time;
 
 
 RemoteJ2KEncoderThread::RemoteJ2KEncoderThread(J2KEncoder& encoder, EncodeServerDescription server)
 	: J2KSyncEncoderThread(encoder)
 	, _server(server)
+	, _transport_encoding(server.transport_encodings())
+	, _history(8)
 {
 
 }
 
 
+/** @param rate Rate at which frames are coming back on a connection, in frames per second, if it is known.
+ *  @return Number of frames to keep in flight on the connection.  A fast server gets enough frames to
+ *  keep it busy while we send and receive, but a slow one gets few so that it does not sit on frames
+ *  that the writer will soon need.
+ */
+int
+RemoteJ2KEncoderThread::frames_in_flight(optional<float> rate)
+{
+	if (!rate) {
+		return initial_frames_in_flight;
+	}
+
+	return std::max(1, std::min(maximum_frames_in_flight, static_cast<int>(std::lround(*rate * target_time_in_flight))));
+}
+
+
+void
+RemoteJ2KEncoderThread::run()
+{
+	if (_server.pipelined()) {
+		run_pipelined();
+	} else {
+		J2KSyncEncoderThread::run();
+	}
+}
+
+
 void
 RemoteJ2KEncoderThread::log_thread_start() const
 {
@@ -53,8 +104,18 @@ RemoteJ2KEncoderThread::encode(DCPVideo const& frame)
 {
 	shared_ptr<dcp::ArrayData> encoded;
 
+	auto statistics = EncodeServerStatistics::instance();
+	_encoder.sent(frame, _server.host_name());
+	statistics->sent(_server.host_name());
+
+	struct timeval start;
+	gettimeofday(&start, 0);
+
 	try {
-		encoded = make_shared<dcp::ArrayData>(frame.encode_remotely(_server));
+		encoded = make_shared<dcp::ArrayData>(frame.encode_remotely(_server, 30, &_transport_encoding));
+		struct timeval end;
+		gettimeofday(&end, 0);
+		statistics->received(_server.host_name(), seconds(end) - seconds(start));
 		if (_remote_backoff > 0) {
 			LOG_GENERAL("{} was lost, but now she is found; removing backoff", _server.host_name());
 			_remote_backoff = 0;
@@ -71,10 +132,197 @@ RemoteJ2KEncoderThread::encode(DCPVideo const& frame)
 		);
 	}
 
-	if (!encoded && _remote_backoff < 60) {
-		_remote_backoff += 10;
+	_encoder.returned(frame, _server.host_name());
+
+	if (!encoded) {
+		statistics->failed(_server.host_name(), 1);
+		if (_remote_backoff < 60) {
+			_remote_backoff += 10;
+		}
 	}
 
 	return encoded;
 }
 
+
+/** Open a long-lived connection to our server */
+shared_ptr<Socket>
+RemoteJ2KEncoderThread::connect()
+{
+	auto socket = make_shared<Socket>();
+	socket->set_send_buffer_size(512 * 1024);
+	socket->connect(_server.host_name(), ENCODE_FRAME_PORT);
+
+	xmlpp::Document doc;
+	auto root = doc.create_root_node("EncodingRequest");
+	cxml::add_text_child(root, "Version", fmt::to_string(SERVER_LINK_VERSION));
+
+	Socket::WriteDigestScope ds(socket);
+	auto xml = doc.write_to_string("UTF-8");
+	socket->write(xml.bytes() + 1);
+	socket->write((uint8_t *) xml.c_str(), xml.bytes() + 1);
+
+	return socket;
+}
+
+
+/** Encode frames using a long-lived connection to a server which supports it.  We keep several frames
+ *  in flight so that the server always has something to do while we are sending and receiving;
+ *  how many depends on how quickly the server has been getting through them.
+ *  Encoded frames come back in whatever order the server finishes them.
+ */
+void
+RemoteJ2KEncoderThread::run_pipelined()
+try
+{
+	log_thread_start();
+
+	struct Pending
+	{
+		DCPVideo frame;
+		bool sent;
+		/** Time that the frame was sent, in seconds */
+		double sent_time;
+		/** Encoding that the frame was sent with */
+		TransportEncoding encoding;
+	};
+
+	auto statistics = EncodeServerStatistics::instance();
+
+	/* Frames that we have taken from the encoder but which have not yet been written */
+	list<Pending> pending;
+	shared_ptr<Socket> socket;
+
+	/* Give everything that we are holding back to the encoder.  error is true if this is because
+	 * something went wrong, so that frames we had sent count as failures.
+	 */
+	auto give_back = [this, statistics, &pending](bool error) {
+		boost::this_thread::disable_interruption dis;
+		int sent = 0;
+		for (auto const& i: pending) {
+			if (i.sent) {
+				_encoder.returned(i.frame, _server.host_name());
+				++sent;
+			}
+			_encoder.retry(i.frame);
+		}
+		if (error) {
+			statistics->failed(_server.host_name(), sent);
+		} else {
+			statistics->abandoned(_server.host_name(), sent);
+		}
+		pending.clear();
+	};
+
+	/* Make sure that anything we are holding goes back to the encoder if we are stopped */
+	dcp::ScopeGuard pending_guard([&give_back]() { give_back(false); });
+
+	while (true) {
+		if (auto wait = backoff()) {
+			LOG_ERROR(N_("Encoder thread sleeping (due to backoff) for {}s"), wait);
+			boost::this_thread::sleep(boost::posix_time::seconds(wait));
+		}
+
+		if (pending.empty()) {
+			LOG_TIMING("encoder-sleep thread={}", thread_id());
+			/* Keep the connection open in case more frames come soon, but close it if
+			 * we have nothing to do for a while.
+			 */
+			auto frame = socket ? _encoder.pop_for(idle_connection_time) : optional<DCPVideo>();
+			if (!frame) {
+				socket.reset();
+				frame = _encoder.pop();
+			}
+			pending.push_back({*frame, false, 0, TransportEncoding::NONE});
+		}
+
+		try {
+			StageTimes::Period period(StageTimes::Stage::REMOTE);
+			auto const window = frames_in_flight(_history.rate());
+			while (static_cast<int>(pending.size()) < window) {
+				auto frame = _encoder.try_pop();
+				if (!frame) {
+					break;
+				}
+				pending.push_back({*frame, false, 0, TransportEncoding::NONE});
+			}
+
+			if (!socket) {
+				socket = connect();
+			}
+
+			for (auto& i: pending) {
+				if (!i.sent) {
+					LOG_TIMING("encoder-pop thread={} frame={} eyes={}", thread_id(), i.frame.index(), static_cast<int>(i.frame.eyes()));
+					socket->write(static_cast<uint32_t>(ENCODE_CONNECTION_FRAME));
+					struct timeval start;
+					gettimeofday(&start, 0);
+					i.sent = true;
+					i.sent_time = seconds(start);
+					i.encoding = _transport_encoding.choose();
+					_encoder.sent(i.frame, _server.host_name());
+					statistics->sent(_server.host_name());
+					i.frame.write_to_socket(socket, SERVER_LINK_VERSION, i.encoding);
+				}
+			}
+
+			/* Ask for the next frame that the server finishes */
+			socket->write(static_cast<uint32_t>(ENCODE_CONNECTION_WAIT));
+
+			Socket::ReadDigestScope ds(socket);
+			LOG_TIMING("start-remote-encode thread={}", thread_id());
+			int const index = socket->read_uint32();
+			auto const eyes = static_cast<Eyes>(socket->read_uint32());
+			auto encoded = make_shared<dcp::ArrayData>(socket->read_uint32());
+			LOG_TIMING("start-remote-receive thread={}", thread_id());
+			if (encoded->size() > 0) {
+				socket->read(encoded->data(), encoded->size());
+			}
+			LOG_TIMING("finish-remote-receive thread={}", thread_id());
+			if (!ds.check()) {
+				throw NetworkError("Checksums do not match");
+			}
+
+			auto done = std::find_if(pending.begin(), pending.end(), [index, eyes](Pending const& p) {
+				return p.sent && p.frame.index() == index && p.frame.eyes() == eyes;
+			});
+
+			if (done == pending.end()) {
+				throw NetworkError(fmt::format("Server sent back frame {} which we did not ask for", index));
+			}
+
+			boost::this_thread::disable_interruption dis;
+			_encoder.returned(done->frame, _server.host_name());
+			if (encoded->size() == 0) {
+				/* The server could not encode this one, so give it to someone else */
+				LOG_ERROR(N_("Remote encode of {} on {} failed"), index, _server.host_name());
+				statistics->failed(_server.host_name(), 1);
+				_encoder.retry(done->frame);
+			} else {
+				struct timeval now;
+				gettimeofday(&now, 0);
+				statistics->received(_server.host_name(), seconds(now) - done->sent_time);
+				_transport_encoding.done(done->encoding, seconds(now) - done->sent_time);
+				_history.event();
+				_encoder.write(encoded, index, eyes);
+				if (_remote_backoff > 0) {
+					LOG_GENERAL("{} was lost, but now she is found; removing backoff", _server.host_name());
+					_remote_backoff = 0;
+				}
+			}
+			pending.erase(done);
+		} catch (std::exception& e) {
+			LOG_ERROR(N_("Remote encode on {} failed ({}); {} frames will be retried"), _server.host_name(), e.what(), pending.size());
+			socket.reset();
+			give_back(true);
+			if (_remote_backoff < 60) {
+				_remote_backoff += 10;
+			}
+		}
+
+		boost::this_thread::interruption_point();
+	}
+} catch (boost::thread_interrupted& e) {
+} catch (...) {
+	store_current();
+}
@@ -1,5 +1,11 @@
 #include "encode_server_description.h"
+#include "event_history.h"
 #include "j2k_sync_encoder_thread.h"
+#include "transport_encoding.h"
+#include <boost/optional.hpp>
+
+
+class Socket;
 
 
 class RemoteJ2KEncoderThread : public J2KSyncEncoderThread
@@ -7,6 +13,7 @@ class RemoteJ2KEncoderThread : public J2KSyncEncoderThread
 public:
 	RemoteJ2KEncoderThread(J2KEncoder& encoder, EncodeServerDescription server);
 
+	void run() override;
 	void log_thread_start() const override;
 	std::shared_ptr<dcp::ArrayData> encode(DCPVideo const& frame) override;
 
@@ -18,8 +25,25 @@ public:
 		return _remote_backoff;
 	}
 
+	static int frames_in_flight(boost::optional<float> rate);
+
+	/** Number of frames that we keep in flight on a long-lived connection before we know how fast it is */
+	static int constexpr initial_frames_in_flight = 3;
+	/** Maximum number of frames that we will keep in flight on a long-lived connection */
+	static int constexpr maximum_frames_in_flight = 8;
+	/** We try to give each long-lived connection about this many seconds' worth of frames */
+	static float constexpr target_time_in_flight = 2;
+	/** Time in seconds that we keep a long-lived connection open when we have nothing to send on it */
+	static float constexpr idle_connection_time = 10;
+
 private:
+	void run_pipelined();
+	std::shared_ptr<Socket> connect();
+
 	EncodeServerDescription _server;
+	TransportEncodingChooser _transport_encoding;
 	/** Number of seconds that we currently wait between attempts to connect to the server */
 	int _remote_backoff = 0;
+	/** Frames that have come back from the server on this thread */
+	EventHistory _history;
 };
@@ -204,7 +204,8 @@ create_surface(shared_ptr<Image> image)
 }
 
 
-static float
+/** @return Opacity (from 0 to 1) of a subtitle at a given time, taking its fade in and out into account */
+float
 calculate_fade_factor(StringText const& first, DCPTime time, int frame_rate)
 {
 	float fade_factor = 1;
@@ -335,13 +336,12 @@ struct Layout
  *  at the same time and with the same fade in/out.
  */
 static Layout
-setup_layout(vector<StringText> subtitles, dcp::Size target, DCPTime time, int frame_rate)
+setup_layout(vector<StringText> subtitles, dcp::Size target, float fade_factor)
 {
 	DCPOMATIC_ASSERT(!subtitles.empty());
 	auto const& first = subtitles.front();
 
 	auto const font_name = FontConfig::instance()->make_font_available(first.font).get_value_or("Arial");
-	auto const fade_factor = calculate_fade_factor(first, time, frame_rate);
 	auto const markup = marked_up(subtitles, target.height, fade_factor, font_name);
 	auto layout = create_layout(font_name, markup);
 	auto ink = layout->get_ink_extents();
@@ -374,9 +374,10 @@ border_width_for_subtitle(StringText const& subtitle, dcp::Size target)
 
 /** @param subtitles A list of subtitles that are all on the same line,
  *  at the same time and with the same fade in/out.
+ *  @param fade_factor Opacity to render with, from 0 to 1.
  */
-static PositionImage
-render_line(vector<StringText> subtitles, dcp::Size target, DCPTime time, int frame_rate)
+PositionImage
+render_line(vector<StringText> const& subtitles, dcp::Size target, float fade_factor)
 {
 	/* XXX: this method can only handle italic / bold changes mid-line,
 	   nothing else yet.
@@ -384,9 +385,8 @@ render_line(vector<StringText> subtitles, dcp::Size target, DCPTime time, int fr
 
 	DCPOMATIC_ASSERT(!subtitles.empty());
 	auto const& first = subtitles.front();
-	auto const fade_factor = calculate_fade_factor(first, time, frame_rate);
 
-	auto layout = setup_layout(subtitles, target, time, frame_rate);
+	auto layout = setup_layout(subtitles, target, fade_factor);
 
 	/* Calculate x and y scale factors.  These are only used to stretch
 	   the font away from its normal aspect ratio.
@@ -456,15 +456,12 @@ render_line(vector<StringText> subtitles, dcp::Size target, DCPTime time, int fr
 }
 
 
-/** @param time Time of the frame that these subtitles are going on.
- *  @param target Size of the container that this subtitle will end up in.
- *  @param frame_rate DCP frame rate.
- */
-vector<PositionImage>
-render_text(vector<StringText> subtitles, dcp::Size target, DCPTime time, int frame_rate)
+/** Split some subtitles into lines, each of which can be given to render_line() */
+vector<vector<StringText>>
+split_into_lines(vector<StringText> const& subtitles)
 {
+	vector<vector<StringText>> lines;
 	vector<StringText> pending;
-	vector<PositionImage> images;
 
 	for (auto const& i: subtitles) {
 		if (!pending.empty()) {
@@ -473,7 +470,7 @@ render_text(vector<StringText> subtitles, dcp::Size target, DCPTime time, int fr
 			auto const different_h = i.h_align() != last.h_align() || !text_positions_close(i.h_position(), pending.back().h_position());
 			if (different_v || different_h) {
 				/* We need a new line if any new positioning (horizontal or vertical) changes for this section */
-				images.push_back(render_line(pending, target, time, frame_rate));
+				lines.push_back(pending);
 				pending.clear();
 			}
 		}
@@ -481,7 +478,24 @@ render_text(vector<StringText> subtitles, dcp::Size target, DCPTime time, int fr
 	}
 
 	if (!pending.empty()) {
-		images.push_back(render_line(pending, target, time, frame_rate));
+		lines.push_back(pending);
+	}
+
+	return lines;
+}
+
+
+/** @param time Time of the frame that these subtitles are going on.
+ *  @param target Size of the container that this subtitle will end up in.
+ *  @param frame_rate DCP frame rate.
+ */
+vector<PositionImage>
+render_text(vector<StringText> subtitles, dcp::Size target, DCPTime time, int frame_rate)
+{
+	vector<PositionImage> images;
+
+	for (auto const& line: split_into_lines(subtitles)) {
+		images.push_back(render_line(line, target, calculate_fade_factor(line.front(), time, frame_rate)));
 	}
 
 	return images;
@@ -497,8 +511,8 @@ bounding_box(vector<StringText> subtitles, dcp::Size target, optional<dcp::Subti
 	auto use_pending = [&pending, &rects, target, override_standard]() {
 		auto const& subtitle = pending.front();
 		auto standard = override_standard.get_value_or(subtitle.valign_standard);
-		/* We can provide dummy values for time and frame rate here as they are only used to calculate fades */
-		auto layout = setup_layout(pending, target, DCPTime(), 24);
+		/* The fade does not change the size of the layout */
+		auto layout = setup_layout(pending, target, 1);
 		int const x = x_position(subtitle.h_align(), subtitle.h_position(), target.width, layout.size.width);
 		auto const border_width = border_width_for_subtitle(subtitle, target);
 		int const y = y_position(standard, subtitle.v_align(), subtitle.v_position(), target.height, layout.baseline_to_bottom(border_width), layout.size.height);
@@ -34,6 +34,9 @@ namespace dcpomatic {
 
 std::string marked_up(std::vector<StringText> subtitles, int target_height, float fade_factor, std::string font_name);
 std::vector<PositionImage> render_text(std::vector<StringText>, dcp::Size, dcpomatic::DCPTime, int);
+std::vector<std::vector<StringText>> split_into_lines(std::vector<StringText> const& subtitles);
+PositionImage render_line(std::vector<StringText> const& subtitles, dcp::Size target, float fade_factor);
+float calculate_fade_factor(StringText const& first, dcpomatic::DCPTime time, int frame_rate);
 std::vector<dcpomatic::Rect<int>> bounding_box(std::vector<StringText> subtitles, dcp::Size target, boost::optional<dcp::SubtitleStandard> override_standard = boost::none);
 
 
@@ -0,0 +1,288 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "dcpomatic_assert.h"
+#include "rgb_to_xyz.h"
+#include <dcp/colour_conversion.h>
+#include <dcp/openjpeg_image.h>
+#include <dcp/rgb_xyz.h>
+#include <dcp/transfer_function.h>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DCPOMATIC_RGB_TO_XYZ_X86 1
+#include <immintrin.h>
+#endif
+
+
+using std::make_shared;
+using std::max;
+using std::min;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+
+/* All the kernels must do their sums in the same order as dcp::rgb_to_xyz, and without
+ * fused multiply-adds, so that the results are exactly the same.
+ */
+
+
+static
+void
+convert_row_scalar(uint16_t const* p, int width, uint16_t* out, double const* lut_in, int32_t const* lut_out, double const* m)
+{
+	for (int x = 0; x < width; ++x) {
+		/* In gamma LUT (converting 16-bit to 12-bit) */
+		double const r = lut_in[*p++ >> 4];
+		double const g = lut_in[*p++ >> 4];
+		double const b = lut_in[*p++ >> 4];
+
+		/* RGB to XYZ, Bradford transform and DCI companding, then clamp */
+		double const cx = max(0.0, min(1.0, r * m[0] + g * m[1] + b * m[2]));
+		double const cy = max(0.0, min(1.0, r * m[3] + g * m[4] + b * m[5]));
+		double const cz = max(0.0, min(1.0, r * m[6] + g * m[7] + b * m[8]));
+
+		/* Out gamma LUT */
+		*out++ = lut_out[lrint(cx * 65535)];
+		*out++ = lut_out[lrint(cy * 65535)];
+		*out++ = lut_out[lrint(cz * 65535)];
+	}
+}
+
+
+#ifdef DCPOMATIC_RGB_TO_XYZ_X86
+
+
+/** @return Indices into the output LUT for one row of the matrix */
+__attribute__((target("sse4.1")))
+static inline
+__m128i
+matrix_row_sse41(__m128d r, __m128d g, __m128d b, double const* m)
+{
+	auto v = _mm_add_pd(_mm_add_pd(_mm_mul_pd(r, _mm_set1_pd(m[0])), _mm_mul_pd(g, _mm_set1_pd(m[1]))), _mm_mul_pd(b, _mm_set1_pd(m[2])));
+	v = _mm_max_pd(_mm_setzero_pd(), _mm_min_pd(_mm_set1_pd(1), v));
+	/* This rounds to nearest even, like lrint() */
+	return _mm_cvtpd_epi32(_mm_mul_pd(v, _mm_set1_pd(65535)));
+}
+
+
+/** Two pixels at a time; the LUT lookups are scalar but the arithmetic is not */
+__attribute__((target("sse4.1")))
+static
+void
+convert_row_sse41(uint16_t const* p, int width, uint16_t* out, double const* lut_in, int32_t const* lut_out, double const* m)
+{
+
+	int x = 0;
+	for (; x + 2 <= width; x += 2) {
+		auto const r = _mm_setr_pd(lut_in[p[0] >> 4], lut_in[p[3] >> 4]);
+		auto const g = _mm_setr_pd(lut_in[p[1] >> 4], lut_in[p[4] >> 4]);
+		auto const b = _mm_setr_pd(lut_in[p[2] >> 4], lut_in[p[5] >> 4]);
+
+		auto const cx = matrix_row_sse41(r, g, b, m);
+		auto const cy = matrix_row_sse41(r, g, b, m + 3);
+		auto const cz = matrix_row_sse41(r, g, b, m + 6);
+
+		out[0] = lut_out[_mm_cvtsi128_si32(cx)];
+		out[1] = lut_out[_mm_cvtsi128_si32(cy)];
+		out[2] = lut_out[_mm_cvtsi128_si32(cz)];
+		out[3] = lut_out[_mm_extract_epi32(cx, 1)];
+		out[4] = lut_out[_mm_extract_epi32(cy, 1)];
+		out[5] = lut_out[_mm_extract_epi32(cz, 1)];
+
+		p += 6;
+		out += 6;
+	}
+
+	convert_row_scalar(p, width - x, out, lut_in, lut_out, m);
+}
+
+
+/** @return Indices into the output LUT for one row of the matrix */
+__attribute__((target("avx2")))
+static inline
+__m128i
+matrix_row_avx2(__m256d r, __m256d g, __m256d b, double const* m)
+{
+	auto v = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(r, _mm256_set1_pd(m[0])), _mm256_mul_pd(g, _mm256_set1_pd(m[1]))), _mm256_mul_pd(b, _mm256_set1_pd(m[2])));
+	v = _mm256_max_pd(_mm256_setzero_pd(), _mm256_min_pd(_mm256_set1_pd(1), v));
+	/* This rounds to nearest even, like lrint() */
+	return _mm256_cvtpd_epi32(_mm256_mul_pd(v, _mm256_set1_pd(65535)));
+}
+
+
+/** Four pixels at a time.  Gathers are no quicker than scalar loads for the LUT lookups on most
+ *  CPUs, so we just use AVX for the arithmetic.
+ */
+__attribute__((target("avx2")))
+static
+void
+convert_row_avx2(uint16_t const* p, int width, uint16_t* out, double const* lut_in, int32_t const* lut_out, double const* m)
+{
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		auto const r = _mm256_setr_pd(lut_in[p[0] >> 4], lut_in[p[3] >> 4], lut_in[p[6] >> 4], lut_in[p[9] >> 4]);
+		auto const g = _mm256_setr_pd(lut_in[p[1] >> 4], lut_in[p[4] >> 4], lut_in[p[7] >> 4], lut_in[p[10] >> 4]);
+		auto const b = _mm256_setr_pd(lut_in[p[2] >> 4], lut_in[p[5] >> 4], lut_in[p[8] >> 4], lut_in[p[11] >> 4]);
+
+		auto const cx = matrix_row_avx2(r, g, b, m);
+		auto const cy = matrix_row_avx2(r, g, b, m + 3);
+		auto const cz = matrix_row_avx2(r, g, b, m + 6);
+
+		out[0] = lut_out[_mm_cvtsi128_si32(cx)];
+		out[1] = lut_out[_mm_cvtsi128_si32(cy)];
+		out[2] = lut_out[_mm_cvtsi128_si32(cz)];
+		out[3] = lut_out[_mm_extract_epi32(cx, 1)];
+		out[4] = lut_out[_mm_extract_epi32(cy, 1)];
+		out[5] = lut_out[_mm_extract_epi32(cz, 1)];
+		out[6] = lut_out[_mm_extract_epi32(cx, 2)];
+		out[7] = lut_out[_mm_extract_epi32(cy, 2)];
+		out[8] = lut_out[_mm_extract_epi32(cz, 2)];
+		out[9] = lut_out[_mm_extract_epi32(cx, 3)];
+		out[10] = lut_out[_mm_extract_epi32(cy, 3)];
+		out[11] = lut_out[_mm_extract_epi32(cz, 3)];
+		out += 12;
+
+		p += 12;
+	}
+
+	convert_row_scalar(p, width - x, out, lut_in, lut_out, m);
+}
+
+
+#endif
+
+
+RGBToXYZ::RGBToXYZ(dcp::ColourConversion const& conversion)
+	: _lut_in(4096)
+	, _lut_out(65536)
+	, _kernel(supported_kernels().back())
+{
+	auto lut_in = conversion.in()->double_lut(0, 1, 12, false);
+	for (int i = 0; i < 4096; ++i) {
+		_lut_in[i] = lut_in[i];
+	}
+
+	auto lut_out = conversion.out()->int_lut(0, 1, 16, true, 4095);
+	for (int i = 0; i < 65536; ++i) {
+		_lut_out[i] = lut_out[i];
+	}
+
+	dcp::combined_rgb_to_xyz(conversion, _matrix);
+}
+
+
+void
+RGBToXYZ::convert_row(uint16_t const* rgb, int width, uint16_t* dst) const
+{
+	switch (_kernel) {
+	case Kernel::SCALAR:
+		convert_row_scalar(rgb, width, dst, _lut_in.data(), _lut_out.data(), _matrix);
+		break;
+#ifdef DCPOMATIC_RGB_TO_XYZ_X86
+	case Kernel::SSE41:
+		convert_row_sse41(rgb, width, dst, _lut_in.data(), _lut_out.data(), _matrix);
+		break;
+	case Kernel::AVX2:
+		convert_row_avx2(rgb, width, dst, _lut_in.data(), _lut_out.data(), _matrix);
+		break;
+#endif
+	default:
+		DCPOMATIC_ASSERT(false);
+	}
+}
+
+
+void
+RGBToXYZ::convert(uint8_t const* rgb, dcp::Size size, int stride, uint16_t* dst) const
+{
+	for (int y = 0; y < size.height; ++y) {
+		convert_row(reinterpret_cast<uint16_t const*>(rgb + y * stride), size.width, dst);
+		dst += size.width * 3;
+	}
+}
+
+
+shared_ptr<dcp::OpenJPEGImage>
+RGBToXYZ::convert(uint8_t const* rgb, dcp::Size size, int stride) const
+{
+	auto xyz = make_shared<dcp::OpenJPEGImage>(size);
+
+	int* cx = xyz->data(0);
+	int* cy = xyz->data(1);
+	int* cz = xyz->data(2);
+
+	vector<uint16_t> row(size.width * 3);
+	for (int y = 0; y < size.height; ++y) {
+		convert_row(reinterpret_cast<uint16_t const*>(rgb + y * stride), size.width, row.data());
+		auto p = row.data();
+		for (int x = 0; x < size.width; ++x) {
+			*cx++ = *p++;
+			*cy++ = *p++;
+			*cz++ = *p++;
+		}
+	}
+
+	return xyz;
+}
+
+
+void
+RGBToXYZ::set_kernel(Kernel kernel)
+{
+	auto const supported = supported_kernels();
+	DCPOMATIC_ASSERT(std::find(supported.begin(), supported.end(), kernel) != supported.end());
+	_kernel = kernel;
+}
+
+
+vector<RGBToXYZ::Kernel>
+RGBToXYZ::supported_kernels()
+{
+	vector<Kernel> kernels = { Kernel::SCALAR };
+#ifdef DCPOMATIC_RGB_TO_XYZ_X86
+	if (__builtin_cpu_supports("sse4.1")) {
+		kernels.push_back(Kernel::SSE41);
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		kernels.push_back(Kernel::AVX2);
+	}
+#endif
+	return kernels;
+}
+
+
+string
+RGBToXYZ::kernel_name(Kernel kernel)
+{
+	switch (kernel) {
+	case Kernel::SCALAR:
+		return "scalar";
+	case Kernel::SSE41:
+		return "SSE4.1";
+	case Kernel::AVX2:
+		return "AVX2";
+	default:
+		DCPOMATIC_ASSERT(false);
+	}
+}
@@ -0,0 +1,96 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/rgb_to_xyz.h
+ *  @brief RGBToXYZ class.
+ */
+
+
+#ifndef DCPOMATIC_RGB_TO_XYZ_H
+#define DCPOMATIC_RGB_TO_XYZ_H
+
+
+#include <dcp/types.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace dcp {
+	class ColourConversion;
+	class OpenJPEGImage;
+}
+
+
+/** @class RGBToXYZ
+ *  @brief Convert RGB48LE images to 12-bit XYZ for JPEG2000 encoding.
+ *
+ *  This gives exactly the same results as dcp::rgb_to_xyz (input LUT, matrix including
+ *  the Bradford transform and DCI companding, then output LUT) but does it in one pass
+ *  with SSE4.1 or AVX2 where the CPU has them.
+ */
+class RGBToXYZ
+{
+public:
+	enum class Kernel {
+		SCALAR,
+		SSE41,
+		AVX2
+	};
+
+	explicit RGBToXYZ(dcp::ColourConversion const& conversion);
+
+	/** Convert to interleaved XYZ, 3 samples per pixel.
+	 *  @param rgb RGB48LE data.
+	 *  @param size Size of the image.
+	 *  @param stride Stride of the RGB data in bytes.
+	 *  @param dst Buffer to write XYZ to, which must have room for size.width * size.height * 3 samples.
+	 */
+	void convert(uint8_t const* rgb, dcp::Size size, int stride, uint16_t* dst) const;
+
+	/** Convert to a planar XYZ image for OpenJPEG.
+	 *  @param rgb RGB48LE data.
+	 *  @param size Size of the image.
+	 *  @param stride Stride of the RGB data in bytes.
+	 */
+	std::shared_ptr<dcp::OpenJPEGImage> convert(uint8_t const* rgb, dcp::Size size, int stride) const;
+
+	/** Use a particular kernel rather than the best that the CPU supports; this is for testing */
+	void set_kernel(Kernel kernel);
+
+	/** @return Kernels that can be used on this CPU, slowest first */
+	static std::vector<Kernel> supported_kernels();
+	static std::string kernel_name(Kernel kernel);
+
+private:
+	void convert_row(uint16_t const* rgb, int width, uint16_t* dst) const;
+
+	/** Input LUT, indexed by 12-bit RGB */
+	std::vector<double> _lut_in;
+	/** Output LUT, indexed by 16-bit XYZ, giving 12-bit XYZ */
+	std::vector<int32_t> _lut_out;
+	double _matrix[9];
+	Kernel _kernel;
+};
+
+
+#endif
@@ -0,0 +1,175 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "scale_context_cache.h"
+#include <dcp/warnings.h>
+LIBDCP_DISABLE_WARNINGS
+extern "C" {
+#include <libswscale/swscale.h>
+}
+LIBDCP_ENABLE_WARNINGS
+#include <boost/thread/tss.hpp>
+#include <list>
+#include <stdexcept>
+
+
+using std::list;
+using std::runtime_error;
+
+
+std::atomic<uint64_t> ScaleContextCache::_hits(0);
+std::atomic<uint64_t> ScaleContextCache::_misses(0);
+
+
+namespace {
+
+
+struct Key
+{
+	dcp::Size in_size;
+	AVPixelFormat in_format;
+	dcp::Size out_size;
+	AVPixelFormat out_format;
+	int flags;
+	int colourspace;
+	bool in_full_range;
+	bool out_full_range;
+
+	bool operator==(Key const& other) const {
+		return in_size == other.in_size &&
+			in_format == other.in_format &&
+			out_size == other.out_size &&
+			out_format == other.out_format &&
+			flags == other.flags &&
+			colourspace == other.colourspace &&
+			in_full_range == other.in_full_range &&
+			out_full_range == other.out_full_range;
+	}
+};
+
+
+/** The contexts belonging to one thread, most-recently-used first */
+class Contexts
+{
+public:
+	Contexts() = default;
+
+	Contexts(Contexts const&) = delete;
+	Contexts& operator=(Contexts const&) = delete;
+
+	~Contexts()
+	{
+		for (auto& entry: entries) {
+			sws_freeContext(entry.second);
+		}
+	}
+
+	list<std::pair<Key, SwsContext*>> entries;
+};
+
+
+/** Maximum number of contexts to keep for each thread.  We usually only need one, but
+ *  things like the player may flip between a few (e.g. when showing 3D or when the
+ *  viewer is being resized).
+ */
+int constexpr max_contexts_per_thread = 4;
+
+boost::thread_specific_ptr<Contexts> contexts;
+
+
+}
+
+
+SwsContext*
+ScaleContextCache::get(
+	dcp::Size in_size,
+	AVPixelFormat in_format,
+	dcp::Size out_size,
+	AVPixelFormat out_format,
+	int flags,
+	int colourspace,
+	bool in_full_range,
+	bool out_full_range
+	)
+{
+	if (!contexts.get()) {
+		contexts.reset(new Contexts());
+	}
+
+	auto& entries = contexts->entries;
+
+	Key const key = { in_size, in_format, out_size, out_format, flags, colourspace, in_full_range, out_full_range };
+
+	for (auto i = entries.begin(); i != entries.end(); ++i) {
+		if (i->first == key) {
+			++_hits;
+			/* Move it to the front so that it's the last to be evicted */
+			entries.splice(entries.begin(), entries, i);
+			return entries.front().second;
+		}
+	}
+
+	++_misses;
+
+	auto context = sws_getContext(
+		in_size.width, in_size.height, in_format,
+		out_size.width, out_size.height, out_format,
+		flags, 0, 0, 0
+		);
+
+	if (!context) {
+		throw runtime_error("Could not allocate SwsContext");
+	}
+
+	/* The 3rd parameter here is:
+	   0 -> source range MPEG (i.e. "video", 16-235)
+	   1 -> source range JPEG (i.e. "full", 0-255)
+	   And the 5th:
+	   0 -> destination range MPEG (i.e. "video", 16-235)
+	   1 -> destination range JPEG (i.e. "full", 0-255)
+
+	   But remember: sws_setColorspaceDetails ignores these
+	   parameters unless the both source and destination images
+	   are isYUV or isGray.  (If either is not, it uses video range).
+	*/
+	sws_setColorspaceDetails(
+		context,
+		sws_getCoefficients(colourspace), in_full_range ? 1 : 0,
+		sws_getCoefficients(colourspace), out_full_range ? 1 : 0,
+		0, 1 << 16, 1 << 16
+		);
+
+	entries.push_front(std::make_pair(key, context));
+
+	while (static_cast<int>(entries.size()) > max_contexts_per_thread) {
+		sws_freeContext(entries.back().second);
+		entries.pop_back();
+	}
+
+	return context;
+}
+
+
+void
+ScaleContextCache::clear()
+{
+	contexts.reset();
+}
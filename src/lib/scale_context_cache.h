@@ -0,0 +1,92 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/scale_context_cache.h
+ *  @brief ScaleContextCache class.
+ */
+
+
+#ifndef DCPOMATIC_SCALE_CONTEXT_CACHE_H
+#define DCPOMATIC_SCALE_CONTEXT_CACHE_H
+
+
+#include <dcp/types.h>
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+#include <atomic>
+#include <cstdint>
+
+
+struct SwsContext;
+
+
+/** @class ScaleContextCache
+ *  @brief A per-thread cache of libswscale contexts.
+ *
+ *  Setting up a SwsContext is expensive, and during a transcode we tend to ask
+ *  for the same scale over and over again.  Each thread gets its own small cache
+ *  of contexts (since a SwsContext cannot be used by more than one thread at a time)
+ *  so no locking is needed to look things up.
+ */
+class ScaleContextCache
+{
+public:
+	/** @param in_size Size of the input image.
+	 *  @param in_format Pixel format of the input image.
+	 *  @param out_size Size of the output image.
+	 *  @param out_format Pixel format of the output image.
+	 *  @param flags Flags to pass to sws_getContext.
+	 *  @param colourspace One of the SWS_CS_* constants.
+	 *  @param in_full_range true if the input is full ("JPEG") range, false for video ("MPEG") range.
+	 *  @param out_full_range true if the output is full ("JPEG") range, false for video ("MPEG") range.
+	 *  @return Context to use; this is owned by the cache and may only be used by the calling thread.
+	 *  It remains valid until the next call to get() from the same thread.
+	 */
+	static SwsContext* get(
+		dcp::Size in_size,
+		AVPixelFormat in_format,
+		dcp::Size out_size,
+		AVPixelFormat out_format,
+		int flags,
+		int colourspace,
+		bool in_full_range,
+		bool out_full_range
+		);
+
+	/** Free all the contexts cached by the calling thread */
+	static void clear();
+
+	static uint64_t hits() {
+		return _hits;
+	}
+
+	static uint64_t misses() {
+		return _misses;
+	}
+
+private:
+	static std::atomic<uint64_t> _hits;
+	static std::atomic<uint64_t> _misses;
+};
+
+
+#endif
@@ -29,10 +29,15 @@
 #include <libxml++/libxml++.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <map>
 
 
+using std::function;
 using std::list;
+using std::make_pair;
 using std::make_shared;
+using std::map;
+using std::pair;
 using std::shared_ptr;
 using std::string;
 using std::vector;
@@ -51,6 +56,37 @@ Screen::trusted_device_thumbprints () const
 }
 
 
+static
+KDMWithMetadataPtr
+encrypt_for_screen(
+	dcp::DecryptedKDM const& decrypted,
+	shared_ptr<const dcp::CertificateChain> signer,
+	CinemaID cinema_id,
+	Cinema const& cinema,
+	Screen const& screen,
+	dcp::LocalTime begin,
+	dcp::LocalTime end,
+	dcp::Formulation formulation,
+	bool disable_forensic_marking_picture,
+	optional<int> disable_forensic_marking_audio
+	)
+{
+	auto kdm = decrypted.encrypt(
+		signer, screen.recipient().get(), screen.trusted_device_thumbprints(), formulation, disable_forensic_marking_picture, disable_forensic_marking_audio
+		);
+
+	dcp::NameFormat::Map name_values;
+	name_values['c'] = cinema.name;
+	name_values['s'] = screen.name;
+	name_values['f'] = kdm.content_title_text();
+	name_values['b'] = begin.date() + " " + begin.time_of_day(true, false);
+	name_values['e'] = end.date() + " " + end.time_of_day(true, false);
+	name_values['i'] = kdm.cpl_id();
+
+	return make_shared<KDMWithMetadata>(name_values, cinema_id, cinema.emails, kdm);
+}
+
+
 KDMWithMetadataPtr
 kdm_for_screen (
 	std::function<dcp::DecryptedKDM (dcp::LocalTime, dcp::LocalTime)> make_kdm,
@@ -79,18 +115,86 @@ kdm_for_screen (
 		throw InvalidSignerError();
 	}
 
-	auto kdm = make_kdm(begin, end).encrypt(
-		signer, screen.recipient().get(), screen.trusted_device_thumbprints(), formulation, disable_forensic_marking_picture, disable_forensic_marking_audio
+	return encrypt_for_screen(
+		make_kdm(begin, end), signer, cinema_id, cinema, screen, begin, end, formulation, disable_forensic_marking_picture, disable_forensic_marking_audio
 		);
+}
 
-	dcp::NameFormat::Map name_values;
-	name_values['c'] = cinema.name;
-	name_values['s'] = screen.name;
-	name_values['f'] = kdm.content_title_text();
-	name_values['b'] = begin.date() + " " + begin.time_of_day(true, false);
-	name_values['e'] = end.date() + " " + end.time_of_day(true, false);
-	name_values['i'] = kdm.cpl_id();
 
-	return make_shared<KDMWithMetadata>(name_values, cinema_id, cinema.emails, kdm);
-}
+list<KDMWithMetadataPtr>
+kdms_for_screens(
+	function<dcp::DecryptedKDM (dcp::LocalTime, dcp::LocalTime)> make_kdm,
+	vector<ScreenDetails> const& screens,
+	boost::posix_time::ptime valid_from,
+	boost::posix_time::ptime valid_to,
+	dcp::Formulation formulation,
+	bool disable_forensic_marking_picture,
+	optional<int> disable_forensic_marking_audio,
+	vector<KDMCertificatePeriod>& period_checks,
+	function<void (int, int)> progress
+	)
+{
+	auto signer = Config::instance()->signer_chain();
+	if (!signer->valid()) {
+		throw InvalidSignerError();
+	}
+
+	/* Decrypted KDMs for each validity window, keyed by its start and end.  Making one of these can mean
+	 * reading the CPL and decrypting other KDMs, so we only want to do it once for each window.
+	 */
+	map<pair<string, string>, dcp::DecryptedKDM> decrypted;
+
+	/* One entry for each screen, filled in by the tasks */
+	vector<KDMWithMetadataPtr> kdms(screens.size());
+	vector<function<void ()>> tasks;
+
+	for (size_t i = 0; i < screens.size(); ++i) {
+		auto const& details = screens[i];
+		if (!details.screen.recipient()) {
+			continue;
+		}
+
+		dcp::LocalTime const begin(valid_from, details.cinema.utc_offset);
+		dcp::LocalTime const end  (valid_to,   details.cinema.utc_offset);
+
+		period_checks.push_back(check_kdm_and_certificate_validity_periods(details.cinema.name, details.screen.name, details.screen.recipient().get(), begin, end));
+
+		auto const window = make_pair(begin.as_string(), end.as_string());
+		auto kdm = decrypted.find(window);
+		if (kdm == decrypted.end()) {
+			kdm = decrypted.insert(make_pair(window, make_kdm(begin, end))).first;
+		}
+
+		auto const* kdm_for_window = &kdm->second;
+		auto output = &kdms[i];
+		tasks.push_back([=, &details]() {
+			*output = encrypt_for_screen(
+				*kdm_for_window,
+				signer,
+				details.cinema_id,
+				details.cinema,
+				details.screen,
+				begin,
+				end,
+				formulation,
+				disable_forensic_marking_picture,
+				disable_forensic_marking_audio
+				);
+		});
+	}
 
+	int const total = tasks.size();
+	run_kdm_tasks(tasks, [progress, total](int done) {
+		if (progress) {
+			progress(done, total);
+		}
+	});
+
+	list<KDMWithMetadataPtr> result;
+	for (auto kdm: kdms) {
+		if (kdm) {
+			result.push_back(kdm);
+		}
+	}
+	return result;
+}
@@ -23,6 +23,7 @@
 #define DCPOMATIC_SCREEN_H
 
 
+#include "cinema.h"
 #include "cinema_list.h"
 #include "kdm_recipient.h"
 #include "kdm_util.h"
@@ -33,10 +34,11 @@
 #include <dcp/utc_offset.h>
 #include <libcxml/cxml.h>
 #include <boost/optional.hpp>
+#include <list>
 #include <string>
+#include <vector>
 
 
-class Cinema;
 class Film;
 
 
@@ -97,4 +99,40 @@ kdm_for_screen (
 	);
 
 
+/** A screen that we want a KDM for, along with the cinema that it is in */
+class ScreenDetails
+{
+public:
+	ScreenDetails(CinemaID const& cinema_id, Cinema const& cinema, dcpomatic::Screen const& screen)
+		: cinema_id(cinema_id)
+		, cinema(cinema)
+		, screen(screen)
+	{}
+
+	CinemaID cinema_id;
+	Cinema cinema;
+	dcpomatic::Screen screen;
+};
+
+
+/** Make KDMs for some screens.  make_kdm is called once for each different validity window
+ *  (i.e. once for each different UTC offset in the cinemas) and the resulting KDMs are encrypted
+ *  for each screen using a thread per CPU.
+ *  @param progress Called with the number of screens done so far, and the total.
+ *  @return KDMs in the same order as screens; screens without a recipient certificate are skipped.
+ */
+std::list<KDMWithMetadataPtr>
+kdms_for_screens(
+	std::function<dcp::DecryptedKDM (dcp::LocalTime, dcp::LocalTime)> make_kdm,
+	std::vector<ScreenDetails> const& screens,
+	boost::posix_time::ptime valid_from,
+	boost::posix_time::ptime valid_to,
+	dcp::Formulation formulation,
+	bool disable_forensic_marking_picture,
+	boost::optional<int> disable_forensic_marking_audio,
+	std::vector<KDMCertificatePeriod>& period_checks,
+	std::function<void (int, int)> progress = {}
+	);
+
+
 #endif
@@ -0,0 +1,126 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "dcpomatic_assert.h"
+#include "stage_times.h"
+
+
+using std::string;
+using boost::optional;
+
+
+std::atomic<bool> StageTimes::_enabled(false);
+std::array<std::atomic<int64_t>, static_cast<int>(StageTimes::Stage::COUNT)> StageTimes::_nanoseconds;
+
+
+void
+StageTimes::enable()
+{
+	reset();
+	_enabled = true;
+}
+
+
+void
+StageTimes::reset()
+{
+	for (auto& total: _nanoseconds) {
+		total = 0;
+	}
+}
+
+
+double
+StageTimes::seconds(Stage stage)
+{
+	return _nanoseconds[static_cast<int>(stage)] / 1e9;
+}
+
+
+string
+StageTimes::name(Stage stage)
+{
+	switch (stage) {
+	case Stage::DECODE:
+		return "decode";
+	case Stage::PLAYER:
+		return "player";
+	case Stage::J2K:
+		return "j2k";
+	case Stage::REMOTE:
+		return "remote";
+	case Stage::WRITER:
+		return "writer";
+	case Stage::DIGEST:
+		return "digest";
+	case Stage::COUNT:
+		break;
+	}
+
+	DCPOMATIC_ASSERT(false);
+	return {};
+}
+
+
+/** The innermost Period on each thread */
+static thread_local StageTimes::Period* current_period = nullptr;
+
+
+StageTimes::Period::Period(optional<Stage> stage)
+	: _stage(stage)
+	, _enabled(StageTimes::enabled())
+{
+	if (!_enabled) {
+		return;
+	}
+
+	_parent = current_period;
+	if (_parent) {
+		_parent->stop();
+	}
+	current_period = this;
+	_start = std::chrono::steady_clock::now();
+}
+
+
+StageTimes::Period::~Period()
+{
+	if (!_enabled) {
+		return;
+	}
+
+	stop();
+	current_period = _parent;
+	if (_parent) {
+		_parent->_start = std::chrono::steady_clock::now();
+	}
+}
+
+
+/** Add the time since _start to our stage */
+void
+StageTimes::Period::stop()
+{
+	if (_stage) {
+		auto const time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start);
+		_nanoseconds[static_cast<int>(*_stage)] += time.count();
+	}
+}
@@ -0,0 +1,127 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/stage_times.h
+ *  @brief StageTimes class.
+ */
+
+
+#ifndef DCPOMATIC_STAGE_TIMES_H
+#define DCPOMATIC_STAGE_TIMES_H
+
+
+#include <boost/optional.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+
+/** @class StageTimes
+ *  @brief Total time spent in each stage of making a DCP, summed over all threads.
+ *
+ *  Nothing is measured until enable() is called, so when it is off the cost to each
+ *  stage is one atomic load.  Since the stages run at the same time on different
+ *  threads the totals can add up to more than the time that the encode took.
+ */
+class StageTimes
+{
+public:
+	enum class Stage
+	{
+		/** Decoders' pass() */
+		DECODE,
+		/** Making the final image for each frame from a PlayerVideo */
+		PLAYER,
+		/** JPEG2000 compression */
+		J2K,
+		/** Sending frames to encode servers and waiting for them to come back */
+		REMOTE,
+		/** Writing encoded frames to picture assets */
+		WRITER,
+		/** Calculating digests of assets */
+		DIGEST,
+		COUNT
+	};
+
+	static void enable();
+	static bool enabled() {
+		return _enabled;
+	}
+
+	/** Set all the totals back to zero */
+	static void reset();
+
+	/** @return Total time spent in a stage, in seconds */
+	static double seconds(Stage stage);
+	static std::string name(Stage stage);
+
+	/** @class Period
+	 *  @brief Adds the time between its construction and destruction to a stage, if StageTimes is enabled.
+	 *
+	 *  Periods may be nested on one thread; time spent in an inner Period is not counted
+	 *  in the outer one.
+	 */
+	class Period
+	{
+	public:
+		explicit Period(Stage stage)
+			: Period(boost::optional<Stage>(stage))
+		{}
+
+		~Period();
+
+		Period(Period const&) = delete;
+		Period& operator=(Period const&) = delete;
+
+	protected:
+		explicit Period(boost::optional<Stage> stage);
+
+	private:
+		void stop();
+
+		boost::optional<Stage> _stage;
+		bool _enabled;
+		/** Period that was running on this thread when we started */
+		Period* _parent = nullptr;
+		std::chrono::steady_clock::time_point _start;
+	};
+
+	/** @class Pause
+	 *  @brief Stops the time between its construction and destruction being counted by the
+	 *  Period (if any) that is running on this thread; for example, while waiting for another stage.
+	 */
+	class Pause : public Period
+	{
+	public:
+		Pause()
+			: Period(boost::none)
+		{}
+	};
+
+private:
+	static std::atomic<bool> _enabled;
+	static std::array<std::atomic<int64_t>, static_cast<int>(Stage::COUNT)> _nanoseconds;
+};
+
+
+#endif
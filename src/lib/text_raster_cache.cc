@@ -0,0 +1,170 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "dcpomatic_assert.h"
+#include "image.h"
+#include "render_text.h"
+#include "text_raster_cache.h"
+#include <cmath>
+
+
+using std::make_shared;
+using std::vector;
+using namespace dcpomatic;
+
+
+int constexpr TextRasterCache::max_entries;
+
+
+TextRasterCache*
+TextRasterCache::instance()
+{
+	static auto cache = new TextRasterCache();
+	return cache;
+}
+
+
+static
+bool
+same(StringText const& a, StringText const& b)
+{
+	if (!(static_cast<dcp::TextString const&>(a) == static_cast<dcp::TextString const&>(b))) {
+		return false;
+	}
+
+	if (a.outline_width != b.outline_width || a.valign_standard != b.valign_standard) {
+		return false;
+	}
+
+	if (!a.font || !b.font) {
+		return a.font == b.font;
+	}
+
+	return *a.font == *b.font;
+}
+
+
+static
+bool
+same(vector<StringText> const& a, vector<StringText> const& b)
+{
+	if (a.size() != b.size()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < a.size(); ++i) {
+		if (!same(a[i], b[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/** @return Copy of a premultiplied BGRA image with its opacity scaled by fade_factor */
+static
+std::shared_ptr<const Image>
+fade(std::shared_ptr<const Image> in, float fade_factor)
+{
+	DCPOMATIC_ASSERT(in->pixel_format() == AV_PIX_FMT_BGRA);
+
+	auto out = make_shared<Image>(*in);
+	/* Since the pixels are premultiplied we scale all four components */
+	int const scale = lrintf(fade_factor * 256);
+	int const line_bytes = out->size().width * 4;
+	for (int y = 0; y < out->size().height; ++y) {
+		auto p = out->data()[0] + y * out->stride()[0];
+		for (int x = 0; x < line_bytes; ++x) {
+			*p = (*p * scale) >> 8;
+			++p;
+		}
+	}
+
+	return out;
+}
+
+
+/** @return Image of a line at full opacity, from the cache if possible */
+PositionImage
+TextRasterCache::get(vector<StringText> const& line, dcp::Size target)
+{
+	{
+		boost::mutex::scoped_lock lm(_mutex);
+		for (auto i = _entries.begin(); i != _entries.end(); ++i) {
+			if (i->target == target && same(i->line, line)) {
+				++_hits;
+				/* Move it to the front so that it's the last to be evicted */
+				_entries.splice(_entries.begin(), _entries, i);
+				return _entries.front().image;
+			}
+		}
+	}
+
+	++_misses;
+
+	/* Render without the lock held so that other threads can use the cache meanwhile */
+	auto image = render_line(line, target, 1);
+
+	boost::mutex::scoped_lock lm(_mutex);
+	_entries.push_front({line, target, image});
+	while (static_cast<int>(_entries.size()) > max_entries) {
+		_entries.pop_back();
+	}
+
+	return image;
+}
+
+
+vector<PositionImage>
+TextRasterCache::render(vector<StringText> const& subtitles, dcp::Size target, DCPTime time, int frame_rate)
+{
+	vector<PositionImage> images;
+
+	for (auto const& line: split_into_lines(subtitles)) {
+		auto image = get(line, target);
+		auto const fade_factor = calculate_fade_factor(line.front(), time, frame_rate);
+		if (fade_factor < 1) {
+			image.image = fade(image.image, fade_factor);
+		}
+		images.push_back(image);
+	}
+
+	return images;
+}
+
+
+void
+TextRasterCache::clear()
+{
+	boost::mutex::scoped_lock lm(_mutex);
+	_entries.clear();
+}
+
+
+TextRasterCache::Statistics
+TextRasterCache::statistics() const
+{
+	Statistics statistics;
+	statistics.hits = _hits;
+	statistics.misses = _misses;
+	return statistics;
+}
@@ -0,0 +1,96 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/text_raster_cache.h
+ *  @brief TextRasterCache class.
+ */
+
+
+#ifndef DCPOMATIC_TEXT_RASTER_CACHE_H
+#define DCPOMATIC_TEXT_RASTER_CACHE_H
+
+
+#include "dcpomatic_time.h"
+#include "position_image.h"
+#include "string_text.h"
+#include <dcp/types.h>
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <vector>
+
+
+/** @class TextRasterCache
+ *  @brief Lines of subtitle text which have been rendered at full opacity.
+ *
+ *  A subtitle usually stays on screen unchanged for many frames, so the Player uses this
+ *  to avoid laying it out and rendering it again for each one.  During a fade the cached
+ *  image is copied and its (premultiplied) pixels scaled by the opacity.
+ */
+class TextRasterCache
+{
+public:
+	TextRasterCache(TextRasterCache const&) = delete;
+	TextRasterCache& operator=(TextRasterCache const&) = delete;
+
+	/** Does the same as render_text(), but using the cache */
+	std::vector<PositionImage> render(std::vector<StringText> const& subtitles, dcp::Size target, dcpomatic::DCPTime time, int frame_rate);
+
+	void clear();
+
+	struct Statistics
+	{
+		/** Number of lines that were found in the cache */
+		uint64_t hits = 0;
+		/** Number of lines that had to be rendered */
+		uint64_t misses = 0;
+	};
+
+	Statistics statistics() const;
+
+	static TextRasterCache* instance();
+
+	/** Maximum number of lines to keep */
+	static int constexpr max_entries = 16;
+
+private:
+	TextRasterCache() = default;
+
+	PositionImage get(std::vector<StringText> const& line, dcp::Size target);
+
+	struct Entry
+	{
+		std::vector<StringText> line;
+		dcp::Size target;
+		PositionImage image;
+	};
+
+	mutable boost::mutex _mutex;
+	/** Entries, most-recently-used first */
+	std::list<Entry> _entries;
+
+	std::atomic<uint64_t> _hits{0};
+	std::atomic<uint64_t> _misses{0};
+};
+
+
+#endif
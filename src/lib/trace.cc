@@ -0,0 +1,283 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "exceptions.h"
+#include "trace.h"
+#include <dcp/file.h>
+#include <dcp/filesystem.h>
+#include <fmt/format.h>
+#include <boost/thread/mutex.hpp>
+#include <memory>
+#include <vector>
+
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+
+std::atomic<bool> Trace::_enabled(false);
+std::chrono::steady_clock::time_point Trace::_epoch;
+int constexpr Trace::max_events_per_block;
+int constexpr Trace::max_events_per_thread;
+
+
+namespace {
+
+
+struct Event
+{
+	char const* name;
+	/** Start time relative to Trace::_epoch, in nanoseconds */
+	int64_t start;
+	/** Duration, in nanoseconds */
+	int64_t duration;
+};
+
+
+/** A block of events in a thread's buffer.  Only the thread that owns the buffer writes to it,
+ *  and it publishes each event by incrementing size, so that Trace::write() can read what is
+ *  there without stopping the thread.
+ */
+struct Chunk
+{
+	static int constexpr capacity = Trace::max_events_per_block;
+
+	Event events[capacity];
+	std::atomic<int> size{0};
+	/** Next chunk; protected by Buffer::_mutex */
+	Chunk* next = nullptr;
+};
+
+
+int constexpr Chunk::capacity;
+
+
+class Buffer
+{
+public:
+	Buffer(int id_, string name_)
+		: id(id_)
+		, name(name_)
+		, _first(new Chunk())
+		, _last(_first)
+	{}
+
+	~Buffer()
+	{
+		auto chunk = _first;
+		while (chunk) {
+			auto next = chunk->next;
+			delete chunk;
+			chunk = next;
+		}
+	}
+
+	Buffer(Buffer const&) = delete;
+	Buffer& operator=(Buffer const&) = delete;
+
+	/** Add an event; must only be called by the thread which owns this buffer */
+	void add(Event event)
+	{
+		if (_last->size.load(std::memory_order_relaxed) == Chunk::capacity) {
+			auto chunk = new Chunk();
+			Chunk* dropped = nullptr;
+			{
+				boost::mutex::scoped_lock lm(_mutex);
+				_last->next = chunk;
+				_last = chunk;
+				if (++_chunks > Trace::max_events_per_thread / Chunk::capacity) {
+					dropped = _first;
+					_first = _first->next;
+					--_chunks;
+				}
+			}
+			delete dropped;
+		}
+
+		auto const size = _last->size.load(std::memory_order_relaxed);
+		_last->events[size] = event;
+		_last->size.store(size + 1, std::memory_order_release);
+	}
+
+	/** @return Events which have been added, and not dropped, so far; may be called by any thread */
+	vector<Event> events() const
+	{
+		vector<Event> events;
+		boost::mutex::scoped_lock lm(_mutex);
+		for (auto chunk = _first; chunk; chunk = chunk->next) {
+			auto const size = chunk->size.load(std::memory_order_acquire);
+			events.insert(events.end(), chunk->events, chunk->events + size);
+		}
+		return events;
+	}
+
+	int const id;
+	/** Name of the thread; protected by buffers_mutex */
+	string name;
+
+private:
+	/** Mutex for the list of chunks (but not the events in them) */
+	mutable boost::mutex _mutex;
+	Chunk* _first;
+	/** Last chunk; only used by the thread which owns this buffer */
+	Chunk* _last;
+	int _chunks = 1;
+};
+
+
+/** Mutex for buffers and the names in them */
+boost::mutex buffers_mutex;
+/** Buffers of every thread which has recorded anything; they are kept after their threads finish */
+vector<shared_ptr<Buffer>> buffers;
+
+thread_local Buffer* this_thread_buffer = nullptr;
+thread_local string this_thread_name;
+
+
+Buffer*
+buffer()
+{
+	if (!this_thread_buffer) {
+		boost::mutex::scoped_lock lm(buffers_mutex);
+		auto const id = static_cast<int>(buffers.size()) + 1;
+		buffers.push_back(std::make_shared<Buffer>(id, this_thread_name.empty() ? fmt::format("Thread {}", id) : this_thread_name));
+		this_thread_buffer = buffers.back().get();
+	}
+
+	return this_thread_buffer;
+}
+
+
+string
+escape(string s)
+{
+	string out;
+	for (auto c: s) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if (static_cast<unsigned char>(c) >= 0x20) {
+			out += c;
+		}
+	}
+	return out;
+}
+
+
+}
+
+
+void
+Trace::enable()
+{
+	_epoch = std::chrono::steady_clock::now();
+	_enabled = true;
+}
+
+
+void
+Trace::set_thread_name(string name)
+{
+	this_thread_name = name;
+	if (this_thread_buffer) {
+		boost::mutex::scoped_lock lm(buffers_mutex);
+		this_thread_buffer->name = name;
+	}
+}
+
+
+void
+Trace::write(boost::filesystem::path path)
+{
+	auto temporary = path;
+	temporary += ".tmp";
+
+	dcp::File file(temporary, "w");
+	if (!file) {
+		throw OpenFileError(temporary, file.open_error(), OpenFileError::WRITE);
+	}
+
+	auto put = [&file](string const& s) {
+		file.checked_write(s.c_str(), s.length());
+	};
+
+	vector<shared_ptr<Buffer>> all;
+	{
+		boost::mutex::scoped_lock lm(buffers_mutex);
+		all = buffers;
+	}
+
+	put("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	bool first = true;
+	for (auto buffer: all) {
+		string name;
+		{
+			boost::mutex::scoped_lock lm(buffers_mutex);
+			name = buffer->name;
+		}
+
+		put(fmt::format(
+			"{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+			first ? "" : ",\n", buffer->id, escape(name)
+			));
+		first = false;
+
+		for (auto const& event: buffer->events()) {
+			/* Chrome trace times are in microseconds */
+			put(fmt::format(
+				",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+				escape(event.name), buffer->id, event.start / 1e3, event.duration / 1e3
+				));
+		}
+	}
+
+	put("\n]}\n");
+	file.close();
+
+	dcp::filesystem::rename(temporary, path);
+}
+
+
+Trace::Span::Span(char const* name)
+	: _name(name)
+	, _enabled(Trace::enabled())
+{
+	if (_enabled) {
+		_start = std::chrono::steady_clock::now();
+	}
+}
+
+
+Trace::Span::~Span()
+{
+	if (!_enabled) {
+		return;
+	}
+
+	auto const end = std::chrono::steady_clock::now();
+	buffer()->add({
+		_name,
+		std::chrono::duration_cast<std::chrono::nanoseconds>(_start - Trace::_epoch).count(),
+		std::chrono::duration_cast<std::chrono::nanoseconds>(end - _start).count()
+	});
+}
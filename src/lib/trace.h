@@ -0,0 +1,92 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/trace.h
+ *  @brief Trace class.
+ */
+
+
+#ifndef DCPOMATIC_TRACE_H
+#define DCPOMATIC_TRACE_H
+
+
+#include <boost/filesystem.hpp>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+
+/** @class Trace
+ *  @brief Records when each thread was doing what, so that it can be written as a
+ *  Chrome trace JSON file and looked at with Perfetto or chrome://tracing.
+ *
+ *  Nothing is recorded until enable() is called.  After that, each thread adds events to
+ *  its own buffer, only taking a lock when it needs a new block of max_events_per_block.
+ *  Each thread keeps its most recent max_events_per_thread events; older ones are dropped
+ *  so that a program which runs for a long time does not keep growing.
+ */
+class Trace
+{
+public:
+	static void enable();
+	static bool enabled() {
+		return _enabled;
+	}
+
+	/** Set the name that the calling thread will be given in the trace */
+	static void set_thread_name(std::string name);
+
+	/** Write everything that has been recorded so far.  This can be called while
+	 *  other threads are still recording.  The file is written under a temporary name
+	 *  and then renamed, so a reader never sees a partial trace.
+	 */
+	static void write(boost::filesystem::path path);
+
+	static int constexpr max_events_per_block = 4096;
+	static int constexpr max_events_per_thread = max_events_per_block * 16;
+
+	/** @class Span
+	 *  @brief Records the time between its construction and destruction, if tracing is enabled.
+	 */
+	class Span
+	{
+	public:
+		/** @param name Name of the span; this must be a string literal, since only the pointer is kept */
+		explicit Span(char const* name);
+		~Span();
+
+		Span(Span const&) = delete;
+		Span& operator=(Span const&) = delete;
+
+	private:
+		char const* _name;
+		bool _enabled;
+		std::chrono::steady_clock::time_point _start;
+	};
+
+private:
+	static std::atomic<bool> _enabled;
+	/** Time that all event times are relative to */
+	static std::chrono::steady_clock::time_point _epoch;
+};
+
+
+#endif
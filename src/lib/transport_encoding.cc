@@ -0,0 +1,128 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "dcpomatic_assert.h"
+#include "transport_encoding.h"
+#include <algorithm>
+
+
+using std::string;
+using std::vector;
+using boost::optional;
+
+
+string
+transport_encoding_to_string(TransportEncoding e)
+{
+	switch (e) {
+	case TransportEncoding::NONE:
+		return "none";
+	case TransportEncoding::ZLIB:
+		return "zlib";
+	default:
+		DCPOMATIC_ASSERT (false);
+	}
+}
+
+
+optional<TransportEncoding>
+string_to_transport_encoding(string s)
+{
+	if (s == "none") {
+		return TransportEncoding::NONE;
+	} else if (s == "zlib") {
+		return TransportEncoding::ZLIB;
+	}
+
+	/* Could be something from a newer version that we don't know about */
+	return {};
+}
+
+
+/** Number of frames between attempts to use an encoding other than the best one */
+static int constexpr probe_interval = 50;
+
+
+TransportEncodingChooser::TransportEncodingChooser(vector<TransportEncoding> available)
+	: _available(available)
+{
+	/* Any server can take raw data */
+	if (std::find(_available.begin(), _available.end(), TransportEncoding::NONE) == _available.end()) {
+		_available.push_back(TransportEncoding::NONE);
+	}
+}
+
+
+TransportEncoding
+TransportEncodingChooser::choose()
+{
+	/* Try everything once before we start comparing */
+	for (auto i: _available) {
+		if (_time.find(i) == _time.end()) {
+			return i;
+		}
+	}
+
+	auto const b = best();
+
+	++_frames;
+	if (_available.size() > 1 && (_frames % probe_interval) == 0) {
+		/* See if one of the others has become quicker */
+		auto const others = _available.size() - 1;
+		auto const probe = (_frames / probe_interval) % others;
+		size_t n = 0;
+		for (auto i: _available) {
+			if (i != b && n++ == probe) {
+				return i;
+			}
+		}
+	}
+
+	return b;
+}
+
+
+void
+TransportEncodingChooser::done(TransportEncoding encoding, double seconds)
+{
+	auto i = _time.find(encoding);
+	if (i == _time.end()) {
+		_time[encoding] = seconds;
+	} else {
+		i->second = i->second * 0.8 + seconds * 0.2;
+	}
+}
+
+
+TransportEncoding
+TransportEncodingChooser::best() const
+{
+	auto best = TransportEncoding::NONE;
+	optional<double> best_time;
+	for (auto const& i: _time) {
+		if (!best_time || i.second < *best_time) {
+			best = i.first;
+			best_time = i.second;
+		}
+	}
+
+	return best;
+}
@@ -0,0 +1,86 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/transport_encoding.h
+ *  @brief TransportEncoding enum and TransportEncodingChooser class.
+ */
+
+
+#ifndef DCPOMATIC_TRANSPORT_ENCODING_H
+#define DCPOMATIC_TRANSPORT_ENCODING_H
+
+
+#include <boost/optional.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+
+/** Ways that the image data of a frame can be packed when we send it to an encode server */
+enum class TransportEncoding
+{
+	NONE, ///< raw image planes
+	ZLIB  ///< each image plane deflated with zlib
+};
+
+
+extern std::string transport_encoding_to_string(TransportEncoding e);
+extern boost::optional<TransportEncoding> string_to_transport_encoding(std::string s);
+
+
+/** @class TransportEncodingChooser
+ *  @brief Decide which TransportEncoding to use when sending frames to a particular server.
+ *
+ *  Compressing a frame costs us CPU time (and costs the server a little to decompress)
+ *  but saves time on the network; which is better depends on how fast the link is
+ *  compared to how quickly we can compress.  We keep a running average of how long it
+ *  takes for a frame sent with each encoding that the server supports to come back
+ *  encoded, and use the quickest, trying the others every so often in case things have changed.
+ *
+ *  This class is not thread-safe; each encoder thread should have its own.
+ */
+class TransportEncodingChooser
+{
+public:
+	/** @param available Encodings that the server says it can accept */
+	explicit TransportEncodingChooser(std::vector<TransportEncoding> available);
+
+	/** @return Encoding to use for the next frame */
+	TransportEncoding choose();
+
+	/** Record how long a frame took to come back from the server.
+	 *  @param encoding Encoding that was used to send it.
+	 *  @param seconds Time from starting to send the frame to having read the encoded data back.
+	 */
+	void done(TransportEncoding encoding, double seconds);
+
+	/** @return The encoding which currently looks quickest */
+	TransportEncoding best() const;
+
+private:
+	std::vector<TransportEncoding> _available;
+	/** Moving average of the round-trip time of a frame with each encoding that we have tried */
+	std::map<TransportEncoding, double> _time;
+	int _frames = 0;
+};
+
+
+#endif
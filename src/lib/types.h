@@ -44,8 +44,24 @@ class FFmpegContent;
  *  64 - first version used
  *  65 - v2.16.0 - checksums added to communication
  *  66 - v2.17.x - J2KBandwidth -> VideoBitRate in metadata
+ *  67 - v2.18.x - long-lived connections with several frames in flight
  */
-#define SERVER_LINK_VERSION (64+2)
+#define SERVER_LINK_VERSION (64+3)
+
+/** The oldest server link version that we can still talk to.  Servers of this
+ *  version (and requests of this version sent to newer servers) use a new
+ *  connection for each frame.
+ */
+#define OLDEST_SERVER_LINK_VERSION (64+2)
+
+/** The first server link version which can use long-lived connections */
+#define PIPELINED_SERVER_LINK_VERSION (64+3)
+
+/** Messages sent by the client on a long-lived (SERVER_LINK_VERSION >= PIPELINED_SERVER_LINK_VERSION) connection */
+/** A frame to encode follows */
+#define ENCODE_CONNECTION_FRAME 1
+/** The client is waiting for the server to send back one encoded frame */
+#define ENCODE_CONNECTION_WAIT 2
 
 /** A film of F seconds at f FPS will be Ff frames;
     Consider some delta FPS d, so if we run the same
@@ -44,6 +44,7 @@
 #include "rect.h"
 #include "render_text.h"
 #include "text_decoder.h"
+#include "trace.h"
 #include "util.h"
 #include "variant.h"
 #include "video_content.h"
@@ -982,13 +983,14 @@ default_font_file()
 void
 start_of_thread(string name)
 {
+	Trace::set_thread_name(name);
 	std::cout << "THREAD:" << name << ":" << std::hex << pthread_self() << "\n";
 }
 #else
 void
-start_of_thread(string)
+start_of_thread(string name)
 {
-
+	Trace::set_thread_name(name);
 }
 #endif
 
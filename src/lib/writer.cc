@@ -30,7 +30,9 @@
 #include "frame_info.h"
 #include "job.h"
 #include "reel_writer.h"
+#include "stage_times.h"
 #include "text_content.h"
+#include "trace.h"
 #include "util.h"
 #include "version.h"
 #include "writer.h"
@@ -39,6 +41,7 @@
 #include <dcp/locale_convert.h>
 #include <dcp/reel_file_asset.h>
 #include <dcp/reel_text_asset.h>
+#include <algorithm>
 #include <set>
 
 #include "i18n.h"
@@ -51,6 +54,7 @@
 using std::dynamic_pointer_cast;
 using std::make_shared;
 using std::max;
+using std::pair;
 using std::shared_ptr;
 using std::string;
 using std::vector;
@@ -84,6 +88,7 @@ Writer::Writer(weak_ptr<const Film> weak_film, weak_ptr<Job> weak_job, boost::fi
 		_reels.emplace_back(weak_film, p, job, reel_index++, reels.size(), text_only, _output_dir);
 	}
 
+	_queues.resize(reels.size());
 	_last_written.resize(reels.size());
 
 	/* We can keep track of the current audio, subtitle and closed caption reels easily because audio
@@ -108,10 +113,12 @@ void
 Writer::start()
 {
 	if (!_text_only) {
-		_thread = boost::thread(boost::bind(&Writer::thread, this));
+		for (size_t reel = 0; reel < _reels.size(); ++reel) {
+			_threads.push_back(boost::thread(boost::bind(&Writer::thread, this, reel)));
 #ifdef DCPOMATIC_LINUX
-		pthread_setname_np(_thread.native_handle(), "writer");
+			pthread_setname_np(_threads.back().native_handle(), fmt::format("writer-{}", reel).c_str());
 #endif
+		}
 	}
 }
 
@@ -119,29 +126,31 @@ Writer::start()
 Writer::~Writer()
 {
 	if (!_text_only) {
-		terminate_thread(false);
+		terminate_threads(false);
 	}
 }
 
 
 /** Pass a video frame to the writer for writing to disk at some point.
- *  This method can be called with frames out of order.
+ *  This method can be called with frames out of order, and can be given the same
+ *  frame more than once; any copies after the first are ignored.
  *  @param encoded JPEG2000-encoded data.
  *  @param frame Frame index within the DCP.
  *  @param eyes Eyes that this frame image is for.
+ *  @return true if the frame was taken, false if it was ignored.
  */
-void
+bool
 Writer::write(shared_ptr<const Data> encoded, Frame frame, Eyes eyes)
 {
 	boost::mutex::scoped_lock lock(_state_mutex);
 
 	if (_zombie) {
-		return;
+		return false;
 	}
 
 	while (_queued_full_in_memory > _maximum_frames_in_memory) {
-		/* There are too many full frames in memory; wake the main writer thread and
-		   wait until it sorts everything out */
+		/* There are too many full frames in memory; wake the writer threads and
+		   wait until they sort everything out */
 		_empty_condition.notify_all();
 		_full_condition.wait(lock);
 	}
@@ -155,11 +164,20 @@ Writer::write(shared_ptr<const Data> encoded, Frame frame, Eyes eyes)
 	DCPOMATIC_ASSERT((film()->three_d() && eyes != Eyes::BOTH) || (!film()->three_d() && eyes == Eyes::BOTH));
 
 	qi.eyes = eyes;
-	_queue.push_back(qi);
+
+	auto& queue = _queues[qi.reel];
+	if (_last_written[qi.reel].written(qi) || std::find(queue.begin(), queue.end(), qi) != queue.end()) {
+		/* J2KEncoder may give the same frame to more than one encoder if one of them is slow */
+		LOG_DEBUG_ENCODE(N_("Writer ignores duplicate of {} ({}) in reel {}"), qi.frame, static_cast<int>(qi.eyes), qi.reel);
+		return false;
+	}
+
+	queue.push_back(qi);
 	++_queued_full_in_memory;
 
 	/* Now there's something to do: wake anything wait()ing on _empty_condition */
 	_empty_condition.notify_all();
+	return true;
 }
 
 
@@ -184,10 +202,12 @@ Writer::can_repeat(Frame frame) const
 void
 Writer::repeat(Frame frame, Eyes eyes)
 {
+	auto const reel = video_reel(frame);
+
 	boost::mutex::scoped_lock lock(_state_mutex);
 
-	while (_queue.size() > _maximum_queue_size && have_sequenced_image_at_queue_head()) {
-		/* The queue is too big, and the main writer thread can run and fix it, so
+	while (_queues[reel].size() > _maximum_queue_size && have_sequenced_image_at_queue_head(reel)) {
+		/* The queue is too big, and the reel's writer thread can run and fix it, so
 		   wake it and wait until it has done.
 		*/
 		_empty_condition.notify_all();
@@ -196,16 +216,16 @@ Writer::repeat(Frame frame, Eyes eyes)
 
 	QueueItem qi;
 	qi.type = QueueItem::Type::REPEAT;
-	qi.reel = video_reel(frame);
-	qi.frame = frame - _reels[qi.reel].start();
+	qi.reel = reel;
+	qi.frame = frame - _reels[reel].start();
 	if (film()->three_d() && eyes == Eyes::BOTH) {
 		qi.eyes = Eyes::LEFT;
-		_queue.push_back(qi);
+		_queues[reel].push_back(qi);
 		qi.eyes = Eyes::RIGHT;
-		_queue.push_back(qi);
+		_queues[reel].push_back(qi);
 	} else {
 		qi.eyes = eyes;
-		_queue.push_back(qi);
+		_queues[reel].push_back(qi);
 	}
 
 	/* Now there's something to do: wake anything wait()ing on _empty_condition */
@@ -216,10 +236,12 @@ Writer::repeat(Frame frame, Eyes eyes)
 void
 Writer::fake_write(Frame frame, Eyes eyes)
 {
+	auto const reel = video_reel(frame);
+
 	boost::mutex::scoped_lock lock(_state_mutex);
 
-	while (_queue.size() > _maximum_queue_size && have_sequenced_image_at_queue_head()) {
-		/* The queue is too big, and the main writer thread can run and fix it, so
+	while (_queues[reel].size() > _maximum_queue_size && have_sequenced_image_at_queue_head(reel)) {
+		/* The queue is too big, and the reel's writer thread can run and fix it, so
 		   wake it and wait until it has done.
 		*/
 		_empty_condition.notify_all();
@@ -230,11 +252,10 @@ Writer::fake_write(Frame frame, Eyes eyes)
 
 	QueueItem qi;
 	qi.type = QueueItem::Type::FAKE;
-	auto const reel = video_reel(frame);
 	qi.reel = reel;
 	qi.frame = frame - _reels[reel].start();
 	qi.eyes = eyes;
-	_queue.push_back(qi);
+	_queues[reel].push_back(qi);
 
 	/* Now there's something to do: wake anything wait()ing on _empty_condition */
 	_empty_condition.notify_all();
@@ -251,6 +272,8 @@ Writer::write (shared_ptr<const AudioBuffers> audio, DCPTime const time)
 {
 	DCPOMATIC_ASSERT(audio);
 
+	StageTimes::Period period(StageTimes::Stage::WRITER);
+
 	int const afr = film()->audio_frame_rate();
 
 	DCPTime const end = time + DCPTime::from_frames(audio->frames(), afr);
@@ -320,15 +343,15 @@ Writer::write(shared_ptr<const dcp::AtmosFrame> atmos, DCPTime time, AtmosMetada
 
 /** Caller must hold a lock on _state_mutex */
 bool
-Writer::have_sequenced_image_at_queue_head()
+Writer::have_sequenced_image_at_queue_head(size_t reel)
 {
-	if (_queue.empty()) {
+	auto& queue = _queues[reel];
+	if (queue.empty()) {
 		return false;
 	}
 
-	_queue.sort();
-	auto const & f = _queue.front();
-	return _last_written[f.reel].next(f);
+	queue.sort();
+	return _last_written[reel].next(queue.front());
 }
 
 
@@ -354,6 +377,34 @@ Writer::LastWritten::next(QueueItem qi) const
 }
 
 
+bool
+Writer::LastWritten::written(QueueItem qi) const
+{
+	if (qi.eyes == Eyes::BOTH) {
+		/* 2D */
+		return qi.frame <= _frame;
+	}
+
+	/* 3D */
+	return qi.frame < _frame || (qi.frame == _frame && (qi.eyes == Eyes::LEFT || _eyes == Eyes::RIGHT));
+}
+
+
+pair<int, Eyes>
+Writer::LastWritten::following(bool three_d) const
+{
+	if (!three_d) {
+		return { _frame + 1, Eyes::BOTH };
+	}
+
+	if (_eyes == Eyes::LEFT) {
+		return { _frame, Eyes::RIGHT };
+	}
+
+	return { _frame + 1, Eyes::LEFT };
+}
+
+
 void
 Writer::LastWritten::update(QueueItem qi)
 {
@@ -362,30 +413,38 @@ Writer::LastWritten::update(QueueItem qi)
 }
 
 
+/** Thread to write the pictures for one reel.
+ *  @param reel_index Index of the reel in _reels.
+ */
 void
-Writer::thread()
+Writer::thread(size_t reel_index)
 try
 {
-	start_of_thread("Writer");
+	start_of_thread(fmt::format("Writer-{}", reel_index));
+
+	auto& queue = _queues[reel_index];
+	auto const three_d = film()->three_d();
 
 	while (true)
 	{
 		boost::mutex::scoped_lock lock(_state_mutex);
-		if (_zombie) {
-			return;
-		}
 
 		while (true) {
 
-			if (_finish || _queued_full_in_memory > _maximum_frames_in_memory || have_sequenced_image_at_queue_head()) {
+			if (_zombie) {
+				/* Another reel's thread has failed */
+				return;
+			}
+
+			if (_finish || _queued_full_in_memory > _maximum_frames_in_memory || have_sequenced_image_at_queue_head(reel_index)) {
 				/* We've got something to do: go and do it */
 				break;
 			}
 
 			/* Nothing to do: wait until something happens which may indicate that we do */
-			LOG_TIMING(N_("writer-sleep queue={}"), _queue.size());
+			LOG_TIMING(N_("writer-sleep reel={} queue={}"), reel_index, queue.size());
 			_empty_condition.wait(lock);
-			LOG_TIMING(N_("writer-wake queue={}"), _queue.size());
+			LOG_TIMING(N_("writer-wake reel={} queue={}"), reel_index, queue.size());
 		}
 
 		/* We stop here if we have been asked to finish, and if either the queue
@@ -393,11 +452,11 @@ try
 		   case we will never terminate as no new frames will be sent once
 		   _finish is true).
 		*/
-		if (_finish && (!have_sequenced_image_at_queue_head() || _queue.empty())) {
+		if (_finish && (!have_sequenced_image_at_queue_head(reel_index) || queue.empty())) {
 			/* (Hopefully temporarily) log anything that was not written */
-			if (!_queue.empty() && !have_sequenced_image_at_queue_head()) {
-				LOG_WARNING(N_("Finishing writer with a left-over queue of {}:"), _queue.size());
-				for (auto const& i: _queue) {
+			if (!queue.empty() && !have_sequenced_image_at_queue_head(reel_index)) {
+				LOG_WARNING(N_("Finishing writer for reel {} with a left-over queue of {}:"), reel_index, queue.size());
+				for (auto const& i: queue) {
 					if (i.type == QueueItem::Type::FULL) {
 						LOG_WARNING(N_("- type FULL, frame {}, eyes {}"), i.frame, (int) i.eyes);
 					} else {
@@ -409,72 +468,77 @@ try
 		}
 
 		/* Write any frames that we can write; i.e. those that are in sequence. */
-		while (have_sequenced_image_at_queue_head()) {
-			auto qi = _queue.front();
-			_last_written[qi.reel].update(qi);
-			_queue.pop_front();
+		while (have_sequenced_image_at_queue_head(reel_index)) {
+			auto qi = queue.front();
+			_last_written[reel_index].update(qi);
+			queue.pop_front();
 			if (qi.encoded) {
 				--_queued_full_in_memory;
 			}
 
 			lock.unlock();
 
-			auto& reel = _reels[qi.reel];
+			auto& reel = _reels[reel_index];
+
+			{
+				StageTimes::Period period(StageTimes::Stage::WRITER);
+				Trace::Span span("Writer::write");
+
+				switch (qi.type) {
+				case QueueItem::Type::FULL:
+					LOG_DEBUG_ENCODE(N_("Writer FULL-writes {} ({}) in reel {}"), qi.frame, (int) qi.eyes, reel_index);
+					if (!qi.encoded) {
+						/* Get the data back from disk where we stored it temporarily */
+						auto temp = film()->j2c_path(qi.reel, qi.frame, qi.eyes, false);
+						DCPOMATIC_ASSERT(dcp::filesystem::exists(temp));
+						qi.encoded = make_shared<ArrayData>(temp);
+						dcp::filesystem::remove(temp);
+					}
+					reel.write(qi.encoded, qi.frame, qi.eyes);
+					break;
+				case QueueItem::Type::FAKE:
+					LOG_DEBUG_ENCODE(N_("Writer FAKE-writes {} in reel {}"), qi.frame, reel_index);
+					reel.fake_write(qi.frame, qi.eyes);
+					break;
+				case QueueItem::Type::REPEAT:
+					LOG_DEBUG_ENCODE(N_("Writer REPEAT-writes {} in reel {}"), qi.frame, reel_index);
+					reel.repeat_write(qi.frame, qi.eyes);
+					break;
+				}
+			}
+
+			lock.lock();
 
 			switch (qi.type) {
 			case QueueItem::Type::FULL:
-				LOG_DEBUG_ENCODE(N_("Writer FULL-writes {} ({})"), qi.frame, (int) qi.eyes);
-				if (!qi.encoded) {
-					/* Get the data back from disk where we stored it temporarily */
-					auto temp = film()->j2c_path(qi.reel, qi.frame, qi.eyes, false);
-					DCPOMATIC_ASSERT(dcp::filesystem::exists(temp));
-					qi.encoded = make_shared<ArrayData>(temp);
-					dcp::filesystem::remove(temp);
-				}
-				reel.write(qi.encoded, qi.frame, qi.eyes);
 				++_full_written;
 				break;
 			case QueueItem::Type::FAKE:
-				LOG_DEBUG_ENCODE(N_("Writer FAKE-writes {}"), qi.frame);
-				reel.fake_write(qi.frame, qi.eyes);
 				++_fake_written;
 				break;
 			case QueueItem::Type::REPEAT:
-				LOG_DEBUG_ENCODE(N_("Writer REPEAT-writes {}"), qi.frame);
-				reel.repeat_write(qi.frame, qi.eyes);
 				++_repeat_written;
 				break;
 			}
 
-			lock.lock();
 			_full_condition.notify_all();
-		}
 
-		while (_queued_full_in_memory > _maximum_frames_in_memory) {
-			/* Too many frames in memory which can't yet be written to the stream.
-			   Write some FULL frames to disk.
-			*/
-
-			/* Find one from the back of the queue */
-			_queue.sort();
-			auto item = _queue.rbegin();
-			while (item != _queue.rend() && !item->encoded) {
-				++item;
+			if ((reel_index + 1) < _reels.size() && _last_written[reel_index].following(three_d).first == (_reels[reel_index + 1].start() - reel.start())) {
+				/* That was the last picture for this reel, so we can finish it off while the others carry on */
+				lock.unlock();
+				LOG_GENERAL(N_("Finishing picture asset for reel {}"), reel_index);
+				reel.finish_picture([this](int64_t, int64_t) {
+					boost::mutex::scoped_lock lm(_state_mutex);
+					if (_zombie) {
+						throw boost::thread_interrupted();
+					}
+				});
+				lock.lock();
 			}
+		}
 
-			DCPOMATIC_ASSERT(item != _queue.rend());
-			++_pushed_to_disk;
-
-			LOG_GENERAL("Writer full; pushes {} to disk while awaiting {}", item->frame, _last_written[_queue.front().reel].frame() + 1);
-
-			item->encoded->write_via_temp(
-				film()->j2c_path(item->reel, item->frame, item->eyes, true),
-				film()->j2c_path(item->reel, item->frame, item->eyes, false)
-				);
-
-			item->encoded.reset();
-			--_queued_full_in_memory;
-			_full_condition.notify_all();
+		while (_queued_full_in_memory > _maximum_frames_in_memory) {
+			push_to_disk();
 		}
 	}
 }
@@ -485,8 +549,46 @@ catch (...)
 }
 
 
+/** Too many frames are in memory which can't yet be written to their reels, so write
+ *  the one which will be needed last to a temporary file.  Caller must hold a lock on
+ *  _state_mutex.
+ */
+void
+Writer::push_to_disk()
+{
+	/* Look from the back of the last reel's queue; frames there are the furthest from being written */
+	for (auto queue = _queues.rbegin(); queue != _queues.rend(); ++queue) {
+		queue->sort();
+		auto item = queue->rbegin();
+		while (item != queue->rend() && !item->encoded) {
+			++item;
+		}
+
+		if (item == queue->rend()) {
+			continue;
+		}
+
+		++_pushed_to_disk;
+
+		LOG_GENERAL("Writer full; pushes {} in reel {} to disk while awaiting {}", item->frame, item->reel, _last_written[item->reel].frame() + 1);
+
+		item->encoded->write_via_temp(
+			film()->j2c_path(item->reel, item->frame, item->eyes, true),
+			film()->j2c_path(item->reel, item->frame, item->eyes, false)
+			);
+
+		item->encoded.reset();
+		--_queued_full_in_memory;
+		_full_condition.notify_all();
+		return;
+	}
+
+	DCPOMATIC_ASSERT(false);
+}
+
+
 void
-Writer::terminate_thread(bool can_throw)
+Writer::terminate_threads(bool can_throw)
 {
 	boost::this_thread::disable_interruption dis;
 
@@ -497,9 +599,13 @@ Writer::terminate_thread(bool can_throw)
 	_full_condition.notify_all();
 	lock.unlock();
 
-	try {
-		_thread.join();
-	} catch (...) {}
+	for (auto& thread: _threads) {
+		try {
+			thread.join();
+		} catch (...) {}
+	}
+
+	_threads.clear();
 
 	if (can_throw) {
 		rethrow();
@@ -567,12 +673,38 @@ Writer::calculate_digests()
 }
 
 
+/** Store the digests of our picture assets with the film's remembered assets, so that if we
+ *  re-use any of those assets in a later run we need not read them all again.
+ */
+void
+Writer::remember_digests()
+{
+	auto assets = film()->read_remembered_assets();
+	bool changed = false;
+
+	for (auto const& reel: _reels) {
+		if (auto digest = reel.picture_digest()) {
+			for (auto& asset: assets) {
+				if (asset.filename().filename() == digest->first.filename() && asset.period() == reel.period() && asset.hash() != digest->second) {
+					asset.set_hash(digest->second);
+					changed = true;
+				}
+			}
+		}
+	}
+
+	if (changed) {
+		film()->write_remembered_assets(assets);
+	}
+}
+
+
 void
 Writer::finish()
 {
-	if (_thread.joinable()) {
-		LOG_GENERAL("Terminating writer thread");
-		terminate_thread(true);
+	if (!_threads.empty()) {
+		LOG_GENERAL("Terminating writer threads");
+		terminate_threads(true);
 	}
 
 	LOG_GENERAL("Finishing ReelWriters");
@@ -596,6 +728,7 @@ Writer::finish()
 	dcp.add(cpl);
 
 	calculate_digests();
+	remember_digests();
 
 	/* Add reels */
 
@@ -844,6 +977,28 @@ operator==(QueueItem const & a, QueueItem const & b)
 }
 
 
+/** @return Frames (as indices within the DCP, and eyes) which are holding up the writing of
+ *  some reel; i.e. the reel has later frames waiting to be written but does not have this one.
+ */
+vector<pair<Frame, Eyes>>
+Writer::awaited_frames()
+{
+	boost::mutex::scoped_lock lock(_state_mutex);
+
+	auto const three_d = film()->three_d();
+
+	vector<pair<Frame, Eyes>> frames;
+	for (size_t reel = 0; reel < _queues.size(); ++reel) {
+		if (!_queues[reel].empty() && !have_sequenced_image_at_queue_head(reel)) {
+			auto const wanted = _last_written[reel].following(three_d);
+			frames.push_back({ _reels[reel].start() + wanted.first, wanted.second });
+		}
+	}
+
+	return frames;
+}
+
+
 void
 Writer::set_encoder_threads(int threads)
 {
@@ -977,9 +1132,12 @@ Writer::zombify()
 {
 	boost::mutex::scoped_lock lock(_state_mutex);
 
-	_queue.clear();
+	for (auto& queue: _queues) {
+		queue.clear();
+	}
 	_queued_full_in_memory = 0;
 	_zombie = true;
+	_empty_condition.notify_all();
 	_full_condition.notify_all();
 }
 
@@ -43,6 +43,7 @@
 #include <boost/thread.hpp>
 #include <boost/thread/condition.hpp>
 #include <list>
+#include <utility>
 
 
 namespace dcp {
@@ -99,6 +100,10 @@ bool operator==(QueueItem const & a, QueueItem const & b);
  *
  *  write() for Data (picture) can be called out of order, and the Writer
  *  will sort it out.  write() for AudioBuffers must be called in order.
+ *
+ *  Each reel has its own queue of pictures and its own thread to write them, so
+ *  pictures for a later reel can be written as soon as they arrive in order for
+ *  that reel, without waiting for earlier reels to be finished.
  */
 
 class Writer : public ExceptionStore, public WeakConstFilm
@@ -114,7 +119,7 @@ public:
 
 	bool can_fake_write(Frame) const;
 
-	void write(std::shared_ptr<const dcp::Data>, Frame, Eyes);
+	bool write(std::shared_ptr<const dcp::Data>, Frame, Eyes);
 	void fake_write(Frame, Eyes);
 	bool can_repeat(Frame) const;
 	void repeat(Frame, Eyes);
@@ -128,6 +133,8 @@ public:
 
 	void set_encoder_threads(int threads);
 
+	std::vector<std::pair<Frame, Eyes>> awaited_frames();
+
 	void zombify();
 
 private:
@@ -135,14 +142,16 @@ private:
 	friend struct ::writer_disambiguate_font_ids2;
 	friend struct ::writer_disambiguate_font_ids3;
 
-	void thread();
-	void terminate_thread(bool);
-	bool have_sequenced_image_at_queue_head();
+	void thread(size_t reel);
+	void terminate_threads(bool);
+	bool have_sequenced_image_at_queue_head(size_t reel);
+	void push_to_disk();
 	size_t video_reel(int frame) const;
 	void set_digest_progress(Job* job, int id, int64_t done, int64_t size);
 	void calculate_referenced_digests(std::function<void (int64_t, int64_t)> set_progress);
 	void write_hanging_text(ReelWriter& reel);
 	void calculate_digests();
+	void remember_digests();
 
 	std::weak_ptr<Job> _job;
 	std::vector<ReelWriter> _reels;
@@ -152,12 +161,12 @@ private:
 	std::vector<ReelWriter>::iterator _atmos_reel;
 
 	boost::filesystem::path _output_dir;
-	/** our thread */
-	boost::thread _thread;
-	/** true if our thread should finish */
+	/** our threads, one for each reel */
+	std::vector<boost::thread> _threads;
+	/** true if our threads should finish */
 	bool _finish = false;
-	/** queue of things to write to disk */
-	std::list<QueueItem> _queue;
+	/** queues of things to write to disk, one for each reel */
+	std::vector<std::list<QueueItem>> _queues;
 	/** number of FULL frames whose JPEG200 data is currently held in RAM */
 	int _queued_full_in_memory = 0;
 	/** mutex for thread state */
@@ -170,6 +179,7 @@ private:
 	 *  ordering
 	 */
 	int _maximum_frames_in_memory;
+	/** maximum number of FAKE and REPEAT frames to queue for each reel */
 	unsigned int _maximum_queue_size;
 
 	class LastWritten
@@ -182,6 +192,10 @@ private:
 
 		/** @return true if qi is the next item after this one */
 		bool next(QueueItem qi) const;
+		/** @return true if qi is this item or one before it */
+		bool written(QueueItem qi) const;
+		/** @return frame index within the reel, and eyes, of the next item after this one */
+		std::pair<int, Eyes> following(bool three_d) const;
 		void update(QueueItem qi);
 
 		int frame() const {
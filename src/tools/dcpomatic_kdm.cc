@@ -66,6 +66,7 @@ LIBDCP_DISABLE_WARNINGS
 #include <wx/dnd.h>
 #include <wx/filepicker.h>
 #include <wx/preferences.h>
+#include <wx/progdlg.h>
 #include <wx/splash.h>
 #include <wx/srchctrl.h>
 #include <wx/treectrl.h>
@@ -436,24 +437,27 @@ private:
 
 			CinemaList cinemas;
 
+			vector<ScreenDetails> screens;
 			for (auto i: _screens->screens()) {
+				screens.push_back({i.first, *cinemas.cinema(i.first), *cinemas.screen(i.second)});
+			}
+
+			{
+				wxProgressDialog progress(variant::wx::dcpomatic_kdm_creator(), _("Making KDMs"), std::max(1, static_cast<int>(screens.size())), this);
 
-				auto kdm = kdm_for_screen(
+				kdms = kdms_for_screens(
 					make_kdm,
-					i.first,
-					*cinemas.cinema(i.first),
-					*cinemas.screen(i.second),
+					screens,
 					_timing->from(),
 					_timing->until(),
 					_output->formulation(),
 					!_output->forensic_mark_video(),
 					_output->forensic_mark_audio() ? boost::optional<int>() : 0,
-					period_checks
+					period_checks,
+					[&progress](int done, int) {
+						progress.Update(done);
+					}
 					);
-
-				if (kdm) {
-					kdms.push_back(kdm);
-				}
 			}
 
 			if (kdms.empty()) {
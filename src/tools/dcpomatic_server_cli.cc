@@ -20,6 +20,7 @@
 
 #include "lib/config.h"
 #include "lib/config.h"
+#include "lib/cross.h"
 #include "lib/dcp_video.h"
 #include "lib/dcpomatic_log.h"
 #include "lib/encode_server.h"
@@ -30,6 +31,7 @@
 #endif
 #include "lib/image.h"
 #include "lib/null_log.h"
+#include "lib/trace.h"
 #include "lib/util.h"
 #include "lib/variant.h"
 #include "lib/version.h"
@@ -60,7 +62,8 @@ help (string n)
 	     << "  -h, --help         show this help\n"
 	     << "  -t, --threads      number of parallel encoding threads to use\n"
 	     << "  --verbose          be verbose to stdout\n"
-	     << "  --log              write a log file of activity\n";
+	     << "  --log              write a log file of activity\n"
+	     << "  --trace <file>     write a Chrome trace JSON file showing where each thread spends its time\n";
 }
 
 int
@@ -75,6 +78,7 @@ main (int argc, char* argv[])
 	int num_threads = Config::instance()->server_encoding_threads ();
 	bool verbose = false;
 	bool write_log = false;
+	boost::optional<boost::filesystem::path> trace;
 
 	int option_index = 0;
 	while (true) {
@@ -84,10 +88,11 @@ main (int argc, char* argv[])
 			{ "threads", required_argument, 0, 't'},
 			{ "verbose", no_argument, 0, 'A'},
 			{ "log", no_argument, 0, 'B'},
+			{ "trace", required_argument, 0, 'C'},
 			{ 0, 0, 0, 0 }
 		};
 
-		int c = getopt_long(fixer.argc(), fixer.argv(), "vht:AB", long_options, &option_index);
+		int c = getopt_long(fixer.argc(), fixer.argv(), "vht:ABC:", long_options, &option_index);
 
 		if (c == -1) {
 			break;
@@ -109,6 +114,9 @@ main (int argc, char* argv[])
 		case 'B':
 			write_log = true;
 			break;
+		case 'C':
+			trace = boost::filesystem::path(optarg);
+			break;
 		}
 	}
 
@@ -121,6 +129,24 @@ main (int argc, char* argv[])
 	setup_grok_library_path();
 #endif
 
+	if (trace) {
+		Trace::enable();
+		/* The server runs until it is killed, so write out what we have every so often.  Only the
+		 * most recent events of each thread are kept, so the trace does not keep growing.
+		 */
+		boost::thread([trace]() {
+			start_of_thread("TraceWriter");
+			while (true) {
+				dcpomatic_sleep_seconds(10);
+				try {
+					Trace::write(*trace);
+				} catch (std::exception& e) {
+					cerr << "Could not write trace: " << e.what() << "\n";
+				}
+			}
+		}).detach();
+	}
+
 	EncodeServer server (verbose, num_threads);
 
 	try {
@@ -28,9 +28,11 @@
 #include "lib/analyse_audio_job.h"
 #include "lib/audio_analysis.h"
 #include "lib/audio_content.h"
+#include "lib/exceptions.h"
 #include "lib/film.h"
 #include "lib/job_manager.h"
 #include "lib/maths_util.h"
+#include <dcp/exceptions.h>
 #include <dcp/filesystem.h>
 #include <libxml++/libxml++.h>
 #include <boost/filesystem.hpp>
@@ -242,6 +244,18 @@ AudioDialog::try_to_load_analysis()
 			film, _playlist, !static_cast<bool>(check), _analysis_finished_connection, bind(&AudioDialog::analysis_finished, this)
 			);
 		return;
+	} catch (dcp::FileError& e) {
+		/* Probably a truncated analysis file: recreate it */
+		JobManager::instance()->analyse_audio(
+			film, _playlist, !static_cast<bool>(check), _analysis_finished_connection, bind(&AudioDialog::analysis_finished, this)
+			);
+		return;
+	} catch (FileError& e) {
+		/* A corrupt analysis file: recreate it */
+		JobManager::instance()->analyse_audio(
+			film, _playlist, !static_cast<bool>(check), _analysis_finished_connection, bind(&AudioDialog::analysis_finished, this)
+			);
+		return;
         }
 
 	_plot->set_analysis(_analysis);
@@ -51,6 +51,7 @@ using namespace dcpomatic;
 int const AudioPlot::_minimum = -70;
 int const AudioPlot::_cursor_size = 8;
 int const AudioPlot::max_smoothing = 128;
+int const AudioPlot::_minimum_level_points = 64;
 
 
 AudioPlot::AudioPlot(wxWindow* parent)
@@ -112,6 +113,29 @@ AudioPlot::set_analysis(shared_ptr<AudioAnalysis> a)
 {
 	_analysis = a;
 
+	/* Make the pyramid of decimated levels, each with half the points of the one before,
+	   until they would be too coarse to be any use.
+	*/
+	_levels.clear();
+	if (a && a->channels() > 0) {
+		while (points(static_cast<int>(_levels.size()), 0) / 2 >= _minimum_level_points) {
+			int const source = static_cast<int>(_levels.size());
+			vector<vector<AudioPoint>> level(a->channels());
+			for (int c = 0; c < a->channels(); ++c) {
+				int const N = points(source, c);
+				for (int i = 0; i < N; i += 2) {
+					auto first = raw_point(source, c, i);
+					auto second = i + 1 < N ? raw_point(source, c, i + 1) : first;
+					AudioPoint merged;
+					merged[AudioPoint::PEAK] = max(first[AudioPoint::PEAK], second[AudioPoint::PEAK]);
+					merged[AudioPoint::RMS] = sqrt((pow(first[AudioPoint::RMS], 2) + pow(second[AudioPoint::RMS], 2)) / 2);
+					level[c].push_back(merged);
+				}
+			}
+			_levels.push_back(level);
+		}
+	}
+
 	if (!a) {
 		_message = _("Please wait; audio is being analysed...");
 	}
@@ -150,6 +174,7 @@ struct Metrics
 	int height;
 	int y_pad;
 	float x_scale; ///< pixels per data point
+	int level; ///< level of the pyramid that we are plotting
 	float y_scale;
 };
 
@@ -184,8 +209,14 @@ AudioPlot::paint()
 	metrics.db_label_width += 8;
 
 	int const data_width = GetSize().GetWidth() - metrics.db_label_width;
-	/* Assume all channels have the same number of points */
-	metrics.x_scale = data_width / float(_analysis->points(0));
+	/* Use the coarsest level which still has at least one point per pixel.
+	   Assume all channels have the same number of points.
+	*/
+	metrics.level = 0;
+	while (metrics.level < static_cast<int>(_levels.size()) && points(metrics.level + 1, 0) >= data_width) {
+		++metrics.level;
+	}
+	metrics.x_scale = data_width / float(points(metrics.level, 0));
 	metrics.height = GetSize().GetHeight();
 	metrics.y_pad = 32;
 	metrics.y_scale = (metrics.height - 2 * metrics.y_pad) / -_minimum;
@@ -207,7 +238,7 @@ AudioPlot::paint()
 	auto v_grid = gc->CreatePath();
 
 	DCPOMATIC_ASSERT(_analysis->samples_per_point() != 0.0);
-	double const pps = _analysis->sample_rate() * metrics.x_scale / _analysis->samples_per_point();
+	double const pps = _analysis->sample_rate() * metrics.x_scale / samples_per_point(metrics.level);
 
 	double const mark_interval = calculate_mark_interval(rint(128 / pps));
 
@@ -297,17 +328,19 @@ AudioPlot::y_for_linear(float p, Metrics const & metrics) const
 void
 AudioPlot::plot_peak(wxGraphicsPath& path, int channel, Metrics const & metrics) const
 {
-	if (_analysis->points(channel) == 0) {
+	int const N = points(metrics.level, channel);
+	if (N == 0) {
 		return;
 	}
 
 	_peak[channel] = PointList();
 
 	float peak = 0;
-	int const N = _analysis->points(channel);
+	/* Decay by the same amount per unit time whichever level we are using */
+	float const decay = 0.01f * (1 - log10(_smoothing) / log10(max_smoothing)) * (1 << metrics.level);
 	for (int i = 0; i < N; ++i) {
-		float const p = get_point(channel, i)[AudioPoint::PEAK];
-		peak -= 0.01f * (1 - log10(_smoothing) / log10(max_smoothing));
+		float const p = get_point(metrics.level, channel, i)[AudioPoint::PEAK];
+		peak -= decay;
 		if (p > peak) {
 			peak = p;
 		} else if (peak < 0) {
@@ -317,7 +350,7 @@ AudioPlot::plot_peak(wxGraphicsPath& path, int channel, Metrics const & metrics)
 		_peak[channel].push_back(
 			Point(
 				wxPoint(metrics.db_label_width + i * metrics.x_scale, y_for_linear(peak, metrics)),
-				DCPTime::from_frames(i * _analysis->samples_per_point(), _analysis->sample_rate()),
+				DCPTime::from_frames(i * samples_per_point(metrics.level), _analysis->sample_rate()),
 				linear_to_db(peak)
 				)
 			);
@@ -335,7 +368,8 @@ AudioPlot::plot_peak(wxGraphicsPath& path, int channel, Metrics const & metrics)
 void
 AudioPlot::plot_rms(wxGraphicsPath& path, int channel, Metrics const & metrics) const
 {
-	if (_analysis->points(channel) == 0) {
+	int const N = points(metrics.level, channel);
+	if (N == 0) {
 		return;
 	}
 
@@ -343,13 +377,13 @@ AudioPlot::plot_rms(wxGraphicsPath& path, int channel, Metrics const & metrics)
 
 	list<float> smoothing;
 
-	int const N = _analysis->points(channel);
-
-	float const first = get_point(channel, 0)[AudioPoint::RMS];
-	float const last = get_point(channel, N - 1)[AudioPoint::RMS];
+	float const first = get_point(metrics.level, channel, 0)[AudioPoint::RMS];
+	float const last = get_point(metrics.level, channel, N - 1)[AudioPoint::RMS];
 
-	int const before = _smoothing / 2;
-	int const after = _smoothing - before;
+	/* Smooth over the same length of time whichever level we are using */
+	int const window = max(1, _smoothing >> metrics.level);
+	int const before = window / 2;
+	int const after = window - before;
 
 	/* Pre-load the smoothing list */
 	for (int i = 0; i < before; ++i) {
@@ -357,7 +391,7 @@ AudioPlot::plot_rms(wxGraphicsPath& path, int channel, Metrics const & metrics)
 	}
 	for (int i = 0; i < after; ++i) {
 		if (i < N) {
-			smoothing.push_back(get_point(channel, i)[AudioPoint::RMS]);
+			smoothing.push_back(get_point(metrics.level, channel, i)[AudioPoint::RMS]);
 		} else {
 			smoothing.push_back(last);
 		}
@@ -368,7 +402,7 @@ AudioPlot::plot_rms(wxGraphicsPath& path, int channel, Metrics const & metrics)
 		int const next_for_window = i + after;
 
 		if (next_for_window < N) {
-			smoothing.push_back(get_point(channel, i)[AudioPoint::RMS]);
+			smoothing.push_back(get_point(metrics.level, channel, i)[AudioPoint::RMS]);
 		} else {
 			smoothing.push_back(last);
 		}
@@ -387,7 +421,7 @@ AudioPlot::plot_rms(wxGraphicsPath& path, int channel, Metrics const & metrics)
 		_rms[channel].push_back(
 			Point(
 				wxPoint(metrics.db_label_width + i * metrics.x_scale, y_for_linear(p, metrics)),
-				DCPTime::from_frames(i * _analysis->samples_per_point(), _analysis->sample_rate()),
+				DCPTime::from_frames(i * samples_per_point(metrics.level), _analysis->sample_rate()),
 				linear_to_db(p)
 				)
 			);
@@ -420,10 +454,33 @@ AudioPlot::set_gain_correction(double gain)
 }
 
 
+/** @return Number of points in a channel at a level of the pyramid; level 0 is the analysis itself */
+int
+AudioPlot::points(int level, int channel) const
+{
+	return level == 0 ? _analysis->points(channel) : _levels[level - 1][channel].size();
+}
+
+
+int64_t
+AudioPlot::samples_per_point(int level) const
+{
+	return _analysis->samples_per_point() << level;
+}
+
+
+/** @return A point at a level of the pyramid, without any gain correction */
+AudioPoint
+AudioPlot::raw_point(int level, int channel, int point) const
+{
+	return level == 0 ? _analysis->get_point(channel, point) : _levels[level - 1][channel][point];
+}
+
+
 AudioPoint
-AudioPlot::get_point(int channel, int point) const
+AudioPlot::get_point(int level, int channel, int point) const
 {
-	auto p = _analysis->get_point(channel, point);
+	auto p = raw_point(level, channel, point);
 	for (int i = 0; i < AudioPoint::COUNT; ++i) {
 		p[i] *= db_to_linear(_gain_correction);
 	}
@@ -73,12 +73,19 @@ private:
 	void plot_peak(wxGraphicsPath &, int, Metrics const &) const;
 	void plot_rms(wxGraphicsPath &, int, Metrics const &) const;
 	float y_for_linear (float, Metrics const &) const;
-	AudioPoint get_point(int channel, int point) const;
+	int points(int level, int channel) const;
+	int64_t samples_per_point(int level) const;
+	AudioPoint raw_point(int level, int channel, int point) const;
+	AudioPoint get_point(int level, int channel, int point) const;
 	void left_down();
 	void mouse_moved(wxMouseEvent& ev);
 	void mouse_leave(wxMouseEvent& ev);
 
 	std::shared_ptr<AudioAnalysis> _analysis;
+	/** Decimated copies of _analysis' points, indexed by level - 1 and then channel.  Each level has
+	 *  half as many points as the one before, each being the peak and RMS of two from that level.
+	 */
+	std::vector<std::vector<std::vector<AudioPoint>>> _levels;
 	bool _channel_visible[MAX_DCP_AUDIO_CHANNELS];
 	bool _type_visible[AudioPoint::COUNT];
 	int _smoothing;
@@ -95,4 +102,6 @@ private:
 
 	static const int _minimum;
 	static const int _cursor_size;
+	/** Smallest number of points that we will put in a level of the pyramid */
+	static const int _minimum_level_points;
 };
@@ -177,6 +177,10 @@ FilmViewer::set_film(shared_ptr<Film> film)
 		if (_dcp_decode_reduction) {
 			_player->set_dcp_decode_reduction(_dcp_decode_reduction);
 		}
+		/* Decode DCP frames ahead on all our cores, but not so many that the decoded
+		 * images take up too much memory.
+		 */
+		_player->set_dcp_decode_ahead(std::min(16, static_cast<int>(boost::thread::hardware_concurrency())));
 	} catch (bad_alloc &) {
 		error_dialog(_video_view->get(), _("There is not enough free memory to do that."));
 		_film.reset();
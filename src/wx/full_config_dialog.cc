@@ -1251,6 +1251,28 @@ private:
 			table->Add(s, 1);
 		}
 
+		{
+			add_label_to_sizer(table, _panel, _("Memory to keep for re-use by images"), true, 0, wxLEFT | wxRIGHT | wxALIGN_CENTRE_VERTICAL);
+			auto s = new wxBoxSizer(wxHORIZONTAL);
+			_image_buffer_pool_size = new wxSpinCtrl(_panel);
+			s->Add(_image_buffer_pool_size, 1);
+			add_label_to_sizer(s, _panel, _("MB"), false, 0, wxLEFT | wxALIGN_CENTRE_VERTICAL);
+			table->Add(s, 1);
+		}
+
+		{
+			add_label_to_sizer(table, _panel, _("Threads to use for decoding video"), true, 0, wxLEFT | wxRIGHT | wxALIGN_CENTRE_VERTICAL);
+			auto s = new wxBoxSizer(wxHORIZONTAL);
+			_ffmpeg_decode_threads = new wxSpinCtrl(_panel);
+			s->Add(_ffmpeg_decode_threads, 1);
+			add_label_to_sizer(s, _panel, _("(0 for automatic)"), false, 0, wxLEFT | wxALIGN_CENTRE_VERTICAL);
+			table->Add(s, 1);
+		}
+
+		_ffmpeg_read_ahead = new CheckBox(_panel, _("Read video files ahead of decoding"));
+		table->Add(_ffmpeg_read_ahead, 1, wxEXPAND | wxLEFT, DCPOMATIC_SIZER_GAP);
+		table->AddSpacer(0);
+
 		{
 			auto format = create_label(_panel, _("DCP metadata filename format"), true);
 #ifdef DCPOMATIC_OSX
@@ -1339,6 +1361,11 @@ private:
 		_only_servers_encode->bind(&AdvancedPage::only_servers_encode_changed, this);
 		_layout_for_short_screen->bind(&AdvancedPage::layout_for_short_screen_changed, this);
 		_frames_in_memory_multiplier->Bind(wxEVT_SPINCTRL, boost::bind(&AdvancedPage::frames_in_memory_multiplier_changed, this));
+		_image_buffer_pool_size->SetRange(0, 65536);
+		_image_buffer_pool_size->Bind(wxEVT_SPINCTRL, boost::bind(&AdvancedPage::image_buffer_pool_size_changed, this));
+		_ffmpeg_decode_threads->SetRange(0, 128);
+		_ffmpeg_decode_threads->Bind(wxEVT_SPINCTRL, boost::bind(&AdvancedPage::ffmpeg_decode_threads_changed, this));
+		_ffmpeg_read_ahead->bind(&AdvancedPage::ffmpeg_read_ahead_changed, this);
 		_dcp_metadata_filename_format->Changed.connect(boost::bind(&AdvancedPage::dcp_metadata_filename_format_changed, this));
 		_dcp_asset_filename_format->Changed.connect(boost::bind(&AdvancedPage::dcp_asset_filename_format_changed, this));
 		_log_general->bind(&AdvancedPage::log_changed, this);
@@ -1384,6 +1411,9 @@ private:
 		checked_set(_log_debug_audio_analysis, config->log_types() & LogEntry::TYPE_DEBUG_AUDIO_ANALYSIS);
 		checked_set(_log_debug_butler, config->log_types() & LogEntry::TYPE_DEBUG_BUTLER);
 		checked_set(_frames_in_memory_multiplier, config->frames_in_memory_multiplier());
+		checked_set(_image_buffer_pool_size, config->image_buffer_pool_size());
+		checked_set(_ffmpeg_decode_threads, config->ffmpeg_decode_threads());
+		checked_set(_ffmpeg_read_ahead, config->ffmpeg_read_ahead());
 #ifdef DCPOMATIC_WINDOWS
 		checked_set(_win32_console, config->win32_console());
 #endif
@@ -1403,6 +1433,21 @@ private:
 		Config::instance()->set_frames_in_memory_multiplier(_frames_in_memory_multiplier->GetValue());
 	}
 
+	void image_buffer_pool_size_changed()
+	{
+		Config::instance()->set_image_buffer_pool_size(_image_buffer_pool_size->GetValue());
+	}
+
+	void ffmpeg_decode_threads_changed()
+	{
+		Config::instance()->set_ffmpeg_decode_threads(_ffmpeg_decode_threads->GetValue());
+	}
+
+	void ffmpeg_read_ahead_changed()
+	{
+		Config::instance()->set_ffmpeg_read_ahead(_ffmpeg_read_ahead->GetValue());
+	}
+
 	void show_experimental_audio_processors_changed()
 	{
 		Config::instance()->set_show_experimental_audio_processors(_show_experimental_audio_processors->GetValue());
@@ -1476,6 +1521,9 @@ private:
 
 	wxChoice* _video_display_mode = nullptr;
 	wxSpinCtrl* _frames_in_memory_multiplier = nullptr;
+	wxSpinCtrl* _image_buffer_pool_size = nullptr;
+	wxSpinCtrl* _ffmpeg_decode_threads = nullptr;
+	CheckBox* _ffmpeg_read_ahead = nullptr;
 	CheckBox* _show_experimental_audio_processors = nullptr;
 	CheckBox* _only_servers_encode = nullptr;
 	CheckBox* _layout_for_short_screen = nullptr;
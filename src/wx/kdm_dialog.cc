@@ -43,6 +43,7 @@
 #include <dcp/warnings.h>
 LIBDCP_DISABLE_WARNINGS
 #include <wx/listctrl.h>
+#include <wx/progdlg.h>
 #include <wx/treectrl.h>
 LIBDCP_ENABLE_WARNINGS
 
@@ -206,22 +207,27 @@ KDMDialog::make_clicked()
 
 		CinemaList cinemas;
 
+		vector<ScreenDetails> screens;
 		for (auto screen: _screens->screens()) {
-			auto p = kdm_for_screen(
+			screens.push_back({screen.first, *cinemas.cinema(screen.first), *cinemas.screen(screen.second)});
+		}
+
+		{
+			wxProgressDialog progress(variant::wx::dcpomatic(), _("Making KDMs"), std::max(1, static_cast<int>(screens.size())), this);
+
+			kdms = kdms_for_screens(
 				make_kdm,
-				screen.first,
-				*cinemas.cinema(screen.first),
-				*cinemas.screen(screen.second),
+				screens,
 				_timing->from(),
 				_timing->until(),
 				_output->formulation(),
 				!_output->forensic_mark_video(),
 				for_audio,
-				period_checks
+				period_checks,
+				[&progress](int done, int) {
+					progress.Update(done);
+				}
 				);
-			if (p) {
-				kdms.push_back(p);
-			}
 		}
 
 		if (
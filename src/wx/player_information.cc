@@ -27,6 +27,7 @@
 #include "lib/audio_content.h"
 #include "lib/dcp_content.h"
 #include "lib/film.h"
+#include "lib/j2k_image_proxy.h"
 
 
 using std::cout;
@@ -90,6 +91,7 @@ PlayerInformation::PlayerInformation(wxWindow* parent, FilmViewer const& viewer)
 		add_label_to_sizer(s, this, _("Performance"), false, 0)->SetFont(title_font);
 		_dropped = add_label_to_sizer(s, this, {}, false, 0);
 		_decode_resolution = add_label_to_sizer(s, this, {}, false, 0);
+		_decode_rate = add_label_to_sizer(s, this, {}, false, 0);
 		_sizer->Add (s, 2, wxEXPAND | wxALL, 6);
 	}
 
@@ -113,6 +115,26 @@ PlayerInformation::periodic_update ()
 		s += wxString::Format(_(" (%d errors)"), _viewer.errored());
 	}
 	checked_set (_dropped, s);
+
+	/* Show the rate that we have recently been decoding JPEG2000 at, for each reduction
+	 * that has been used.
+	 */
+	wxString rates;
+	for (auto const& rate: J2KImageProxy::decode_rates()) {
+		if (!rates.IsEmpty()) {
+			rates += char_to_wx(", ");
+		}
+		if (rate.first == 0) {
+			rates += wxString::Format(_("%.1f fps at full size"), rate.second);
+		} else {
+			rates += wxString::Format(_("%.1f fps at 1/%d size"), rate.second, 1 << rate.first);
+		}
+	}
+	if (rates.IsEmpty()) {
+		checked_set(_decode_rate, wxString{});
+	} else {
+		checked_set(_decode_rate, wxString::Format(_("Decode rate: %s"), rates));
+	}
 }
 
 
@@ -48,5 +48,6 @@ private:
 	wxStaticText* _kdm_to;
 	wxStaticText* _dropped;
 	wxStaticText* _decode_resolution;
+	wxStaticText* _decode_rate;
 	boost::scoped_ptr<wxTimer> _timer;
 };
@@ -23,7 +23,9 @@
 #include "wx_util.h"
 #include "lib/encode_server_finder.h"
 #include "lib/encode_server_description.h"
+#include "lib/encode_server_statistics.h"
 #include <boost/lexical_cast.hpp>
+#include <algorithm>
 
 
 using std::list;
@@ -33,11 +35,12 @@ using boost::lexical_cast;
 
 ServersListDialog::ServersListDialog (wxWindow* parent)
 	: wxDialog (parent, wxID_ANY, _("Encoding Servers"))
+	, _timer (this)
 {
 	wxBoxSizer* s = new wxBoxSizer (wxVERTICAL);
 	SetSizer (s);
 
-	_list = new wxListCtrl (this, wxID_ANY, wxDefaultPosition, wxSize (500, 200), wxLC_REPORT | wxLC_SINGLE_SEL);
+	_list = new wxListCtrl (this, wxID_ANY, wxDefaultPosition, wxSize (900, 200), wxLC_REPORT | wxLC_SINGLE_SEL);
 
 	{
 		wxListItem ip;
@@ -55,6 +58,25 @@ ServersListDialog::ServersListDialog (wxWindow* parent)
 		_list->InsertColumn (1, ip);
 	}
 
+	wxString const statistics[] = {
+		_("Frames per second"),
+		_("Latency"),
+		_("In flight"),
+		_("Frames"),
+		_("Failures"),
+		_("Re-sent")
+	};
+
+	int column = 2;
+	for (auto const& i: statistics) {
+		wxListItem ip;
+		ip.SetId (column);
+		ip.SetText (i);
+		ip.SetWidth (75);
+		_list->InsertColumn (column, ip);
+		++column;
+	}
+
 	s->Add (_list, 1, wxEXPAND | wxALL, 12);
 
 	wxSizer* buttons = CreateSeparatedButtonSizer (wxOK);
@@ -70,8 +92,12 @@ ServersListDialog::ServersListDialog (wxWindow* parent)
 		boost::bind (&ServersListDialog::servers_list_changed, this)
 		);
 	servers_list_changed ();
+
+	Bind (wxEVT_TIMER, boost::bind (&ServersListDialog::update_statistics, this));
+	_timer.Start (1000);
 }
 
+
 void
 ServersListDialog::servers_list_changed ()
 {
@@ -85,11 +111,42 @@ ServersListDialog::servers_list_changed ()
 		_list->InsertItem (list_item);
 
 		_list->SetItem (n, 0, std_to_wx (i.host_name ()));
-		if (i.current_link_version()) {
+		if (i.compatible_link_version()) {
 			_list->SetItem (n, 1, std_to_wx (lexical_cast<string> (i.threads ())));
 		} else {
 			_list->SetItem (n, 1, _("Incorrect version"));
 		}
 		++n;
 	}
+
+	update_statistics ();
+}
+
+
+/** Fill in the statistics columns with what we know about how each server has been doing */
+void
+ServersListDialog::update_statistics ()
+{
+	auto const statistics = EncodeServerStatistics::instance()->servers();
+
+	for (int i = 0; i < _list->GetItemCount(); ++i) {
+		auto const host = wx_to_std (_list->GetItemText(i, 0));
+		auto server = std::find_if (statistics.begin(), statistics.end(), [host](EncodeServerStatistics::Server const& s) {
+			return s.host_name == host;
+		});
+
+		if (server == statistics.end()) {
+			for (int j = 2; j < 8; ++j) {
+				_list->SetItem (i, j, wxString());
+			}
+			continue;
+		}
+
+		_list->SetItem (i, 2, server->rate ? wxString::Format(char_to_wx("%.1f"), *server->rate) : wxString());
+		_list->SetItem (i, 3, server->latency ? wxString::Format(_("%.1fs"), *server->latency) : wxString());
+		_list->SetItem (i, 4, std_to_wx (lexical_cast<string> (server->in_flight)));
+		_list->SetItem (i, 5, std_to_wx (lexical_cast<string> (server->frames)));
+		_list->SetItem (i, 6, std_to_wx (lexical_cast<string> (server->failures)));
+		_list->SetItem (i, 7, std_to_wx (lexical_cast<string> (server->redispatched)));
+	}
 }
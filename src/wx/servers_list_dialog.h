@@ -33,8 +33,10 @@ public:
 
 private:
 	void servers_list_changed ();
+	void update_statistics ();
 
 	wxListCtrl* _list;
+	wxTimer _timer;
 
 	boost::signals2::scoped_connection _server_finder_connection;
 };
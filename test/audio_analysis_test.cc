@@ -33,6 +33,7 @@
 #include "lib/content_factory.h"
 #include "lib/dcp_content.h"
 #include "lib/dcp_content_type.h"
+#include "lib/exceptions.h"
 #include "lib/ffmpeg_content.h"
 #include "lib/ffmpeg_content.h"
 #include "lib/film.h"
@@ -40,12 +41,15 @@
 #include "lib/playlist.h"
 #include "lib/ratio.h"
 #include "test.h"
+#include <dcp/file.h>
 #include <dcp/scope_guard.h>
 #include <boost/test/unit_test.hpp>
 #include <numeric>
 
 
 using std::make_shared;
+using std::shared_ptr;
+using std::string;
 using std::vector;
 using namespace dcpomatic;
 
@@ -101,6 +105,98 @@ BOOST_AUTO_TEST_CASE(audio_analysis_serialisation_test)
 }
 
 
+/** Check that we can still read analyses in the XML format that we used before the binary one */
+BOOST_AUTO_TEST_CASE(audio_analysis_read_xml_test)
+{
+	boost::filesystem::path const path = "build/test/audio_analysis_read_xml_test";
+	{
+		dcp::File file(path, "w");
+		BOOST_REQUIRE(file);
+		string const xml =
+			"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			"<AudioAnalysis>"
+			"<Version>4</Version>"
+			"<Channel><Point><Peak>0.5</Peak><RMS>0.25</RMS></Point><Point><Peak>0.75</Peak><RMS>0.125</RMS></Point></Channel>"
+			"<Channel><Point><Peak>0.1</Peak><RMS>0.05</RMS></Point><Point><Peak>0.2</Peak><RMS>0.1</RMS></Point></Channel>"
+			"<SamplePeak time=\"96000\">0.75</SamplePeak>"
+			"<SamplePeak time=\"48000\">0.2</SamplePeak>"
+			"<TruePeak>0.8</TruePeak>"
+			"<TruePeak>0.3</TruePeak>"
+			"<IntegratedLoudness>-23.5</IntegratedLoudness>"
+			"<SamplesPerPoint>1000</SamplesPerPoint>"
+			"<SampleRate>48000</SampleRate>"
+			"<Leqm>81.5</Leqm>"
+			"<LoudnessBlocks>0.5 0.25 </LoudnessBlocks>"
+			"</AudioAnalysis>\n";
+		file.checked_write(xml.c_str(), xml.length());
+	}
+
+	AudioAnalysis analysis(path);
+	BOOST_REQUIRE_EQUAL(analysis.channels(), 2);
+	BOOST_REQUIRE_EQUAL(analysis.points(0), 2);
+	BOOST_CHECK_CLOSE(analysis.get_point(0, 1)[AudioPoint::PEAK], 0.75, 0.1);
+	BOOST_CHECK_CLOSE(analysis.get_point(1, 0)[AudioPoint::RMS], 0.05, 0.1);
+	BOOST_REQUIRE_EQUAL(analysis.sample_peak().size(), 2U);
+	BOOST_CHECK_EQUAL(analysis.sample_peak()[0].time.get(), 96000);
+	BOOST_CHECK_EQUAL(analysis.true_peak().size(), 2U);
+	BOOST_REQUIRE(analysis.integrated_loudness());
+	BOOST_CHECK_CLOSE(*analysis.integrated_loudness(), -23.5, 0.1);
+	BOOST_CHECK(!analysis.loudness_range());
+	BOOST_REQUIRE(analysis.leqm());
+	BOOST_CHECK_CLOSE(*analysis.leqm(), 81.5, 0.1);
+	BOOST_CHECK_EQUAL(analysis.loudness_blocks().size(), 2U);
+	BOOST_CHECK_EQUAL(analysis.samples_per_point(), 1000);
+
+	/* Writing it again should give the binary format, with the same contents */
+	analysis.write("build/test/audio_analysis_read_xml_test.bin");
+	AudioAnalysis binary("build/test/audio_analysis_read_xml_test.bin");
+	BOOST_REQUIRE_EQUAL(binary.channels(), 2);
+	BOOST_REQUIRE_EQUAL(binary.points(1), 2);
+	BOOST_CHECK_EQUAL(binary.get_point(1, 1)[AudioPoint::PEAK], analysis.get_point(1, 1)[AudioPoint::PEAK]);
+	BOOST_CHECK_EQUAL(binary.sample_peak()[1].time.get(), 48000);
+	BOOST_CHECK_EQUAL(*binary.integrated_loudness(), *analysis.integrated_loudness());
+	BOOST_CHECK(!binary.loudness_range());
+	BOOST_CHECK_EQUAL(*binary.leqm(), *analysis.leqm());
+	BOOST_CHECK(binary.loudness_blocks() == analysis.loudness_blocks());
+	BOOST_CHECK_EQUAL(binary.samples_per_point(), 1000);
+	BOOST_CHECK_EQUAL(binary.sample_rate(), 48000);
+}
+
+
+/** Check that a corrupt or truncated binary analysis gives a FileError rather than a crash or a huge allocation */
+BOOST_AUTO_TEST_CASE(audio_analysis_read_corrupt_binary_test)
+{
+	boost::filesystem::path const path = "build/test/audio_analysis_read_corrupt_binary_test";
+
+	AudioAnalysis analysis(2);
+	for (int i = 0; i < 1000; ++i) {
+		AudioPoint point;
+		point[AudioPoint::PEAK] = 0.5;
+		point[AudioPoint::RMS] = 0.25;
+		analysis.add_point(0, point);
+		analysis.add_point(1, point);
+	}
+	analysis.set_sample_peak({ AudioAnalysis::PeakTime(0.5, DCPTime()), AudioAnalysis::PeakTime(0.5, DCPTime()) });
+
+	analysis.write(path);
+	{
+		dcp::File file(path, "r+b");
+		BOOST_REQUIRE(file);
+		/* Overwrite the sample peak count, which comes after the magic number, version, samples per point,
+		 * sample rate and the four optionals.
+		 */
+		file.seek(8 + 4 + 8 + 4 + 2 * (1 + 4) + 2 * (1 + 8), SEEK_SET);
+		uint64_t const huge = UINT64_MAX / 2;
+		file.checked_write(&huge, sizeof(huge));
+	}
+	BOOST_CHECK_THROW(AudioAnalysis{path}, FileError);
+
+	analysis.write(path);
+	boost::filesystem::resize_file(path, boost::filesystem::file_size(path) / 2);
+	BOOST_CHECK_THROW(AudioAnalysis{path}, FileError);
+}
+
+
 BOOST_AUTO_TEST_CASE(audio_analysis_test)
 {
 	auto c = make_shared<FFmpegContent>(TestPaths::private_data() / "betty_L.wav");
@@ -285,6 +381,129 @@ BOOST_AUTO_TEST_CASE(analyse_audio_uses_processor_when_analysing_whole_film)
 }
 
 
+/** Analysing the audio in several parts at once should give the same result as doing it in one go */
+BOOST_AUTO_TEST_CASE(analyse_audio_in_parts_test)
+{
+	auto sound = content_factory(TestPaths::private_data() / "betty_stereo_48k.wav")[0];
+	auto film = new_test_film("analyse_audio_in_parts_test", { sound });
+	film->set_audio_channels(6);
+
+	auto analyse = [film](int parts) {
+		auto job = make_shared<AnalyseAudioJob>(film, film->playlist(), true);
+		job->set_parts(parts);
+		JobManager::instance()->add(job);
+		BOOST_REQUIRE(!wait_for_jobs());
+		return AudioAnalysis(job->path());
+	};
+
+	auto const one = analyse(1);
+	auto const three = analyse(3);
+
+	BOOST_REQUIRE_EQUAL(one.channels(), three.channels());
+	for (int c = 0; c < one.channels(); ++c) {
+		BOOST_REQUIRE_EQUAL(one.points(c), three.points(c));
+		for (int p = 0; p < one.points(c); ++p) {
+			BOOST_CHECK_EQUAL(one.get_point(c, p)[AudioPoint::PEAK], three.get_point(c, p)[AudioPoint::PEAK]);
+			BOOST_CHECK_EQUAL(one.get_point(c, p)[AudioPoint::RMS], three.get_point(c, p)[AudioPoint::RMS]);
+		}
+	}
+
+	BOOST_REQUIRE_EQUAL(one.sample_peak().size(), three.sample_peak().size());
+	for (size_t c = 0; c < one.sample_peak().size(); ++c) {
+		BOOST_CHECK_EQUAL(one.sample_peak()[c].peak, three.sample_peak()[c].peak);
+		BOOST_CHECK(one.sample_peak()[c].time == three.sample_peak()[c].time);
+	}
+
+	BOOST_CHECK_CLOSE(one.leqm().get_value_or(0), three.leqm().get_value_or(1), 1e-9);
+
+	if (one.integrated_loudness()) {
+		BOOST_REQUIRE(three.integrated_loudness());
+		BOOST_CHECK_CLOSE(*one.integrated_loudness(), *three.integrated_loudness(), 1e-4);
+		BOOST_CHECK_CLOSE(*one.loudness_range(), *three.loudness_range(), 1e-4);
+	}
+}
+
+
+/** Check that a whole-film analysis re-uses the analyses of pieces of content which have not changed */
+BOOST_AUTO_TEST_CASE(analyse_audio_combines_content_analyses_test)
+{
+	auto A = content_factory("test/data/white.wav")[0];
+	auto B = content_factory("test/data/staircase.wav")[0];
+	auto film = new_test_film("analyse_audio_combines_content_analyses_test", { A, B });
+	B->set_position(film, A->end(film));
+
+	auto analyse = [film]() {
+		auto job = make_shared<AnalyseAudioJob>(film, film->playlist(), true);
+		JobManager::instance()->add(job);
+		BOOST_REQUIRE(!wait_for_jobs());
+		return AudioAnalysis(job->path());
+	};
+
+	auto content_path = [film](shared_ptr<Content> content) {
+		return AnalyseAudioJob::content_analysis_path(film, content);
+	};
+
+	analyse();
+	BOOST_REQUIRE(boost::filesystem::exists(content_path(A)));
+	BOOST_REQUIRE(boost::filesystem::exists(content_path(B)));
+
+	/* Doctor A's analysis so that we can see if it is used */
+	AudioAnalysis doctored(content_path(A));
+	auto peak = doctored.sample_peak();
+	for (auto& p: peak) {
+		p.peak = 4;
+	}
+	doctored.set_sample_peak(peak);
+	doctored.write(content_path(A));
+
+	/* Changing B's gain should not need it to be analysed again */
+	auto const B_path = content_path(B);
+	B->audio->set_gain(-6);
+	BOOST_CHECK(content_path(B) == B_path);
+
+	auto const combined = analyse();
+	BOOST_CHECK_CLOSE(combined.overall_sample_peak().first.peak, 4, 1e-3);
+	BOOST_CHECK(combined.overall_sample_peak().first.time < B->position());
+}
+
+
+/** Check that the whole-film analysis of a film with one piece of audio content is not
+ *  taken for that content's own analysis when a second piece is added.
+ */
+BOOST_AUTO_TEST_CASE(analyse_audio_one_then_two_pieces_test)
+{
+	auto A = content_factory("test/data/white.wav")[0];
+	auto film = new_test_film("analyse_audio_one_then_two_pieces_test", { A });
+	A->set_position(film, DCPTime::from_seconds(60));
+
+	auto analyse = [film]() {
+		auto job = make_shared<AnalyseAudioJob>(film, film->playlist(), true);
+		JobManager::instance()->add(job);
+		BOOST_REQUIRE(!wait_for_jobs());
+		return AudioAnalysis(job->path());
+	};
+
+	auto const one = analyse();
+	BOOST_CHECK(!boost::filesystem::exists(AnalyseAudioJob::content_analysis_path(film, A)));
+	BOOST_CHECK(one.overall_sample_peak().first.time >= A->position());
+	BOOST_CHECK(one.overall_sample_peak().first.time < A->end(film));
+
+	auto B = content_factory("test/data/staircase.wav")[0];
+	film->examine_and_add_content({B});
+	BOOST_REQUIRE(!wait_for_jobs());
+	B->set_position(film, A->end(film));
+	/* Make sure that the peak is in A */
+	B->audio->set_gain(-40);
+
+	auto const two = analyse();
+	BOOST_CHECK(boost::filesystem::exists(AnalyseAudioJob::content_analysis_path(film, A)));
+	BOOST_CHECK_CLOSE(two.overall_sample_peak().first.peak, one.overall_sample_peak().first.peak, 1e-3);
+	BOOST_CHECK(two.overall_sample_peak().first.time >= A->position());
+	BOOST_CHECK(two.overall_sample_peak().first.time < A->end(film));
+	BOOST_CHECK(static_cast<bool>(two.integrated_loudness()) == static_cast<bool>(one.integrated_loudness()));
+}
+
+
 #ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
 BOOST_AUTO_TEST_CASE(ebur128_test)
 {
@@ -311,6 +530,9 @@ BOOST_AUTO_TEST_CASE(ebur128_test)
 	BOOST_CHECK_CLOSE(six.true_peak()[5], 0.317751, 1);
 	BOOST_CHECK_CLOSE(six.overall_true_peak().get(), 0.53398, 1);
 	BOOST_CHECK_CLOSE(six.overall_true_peak().get(), 0.53398, 1);
+	/* These were measured by FFmpeg's ebur128 filter, which weights 5.1 in the same way as LoudnessMeter;
+	 * loudness_meter_matches_ffmpeg_test checks that the two agree.
+	 */
 	BOOST_CHECK_CLOSE(six.integrated_loudness().get(), -18.1432, 1);
 	BOOST_CHECK_CLOSE(six.loudness_range().get(), 6.92, 1);
 }
@@ -385,3 +385,79 @@ BOOST_AUTO_TEST_CASE(audio_buffers_set_channels_higher)
 		}
 	}
 }
+
+
+/** Check that appending after trimming, and growing after shrinking, keep the right data and fill with silence */
+BOOST_AUTO_TEST_CASE(audio_buffers_trim_append_set_frames)
+{
+	auto a = std::make_shared<AudioBuffers>(3, 100);
+	srand(12);
+	random_fill(*a);
+
+	auto b = std::make_shared<AudioBuffers>(3, 50);
+	random_fill(*b);
+
+	a->trim_start(40);
+	for (int i = 0; i < 20; ++i) {
+		a->append(b);
+	}
+	BOOST_REQUIRE_EQUAL(a->frames(), 60 + 50 * 20);
+
+	srand(12);
+	for (int i = 0; i < 40 * 3; ++i) {
+		random_float();
+	}
+	random_check(*a, 0, 60);
+	for (int i = 0; i < 20; ++i) {
+		srand(12);
+		for (int j = 0; j < 100 * 3; ++j) {
+			random_float();
+		}
+		random_check(*a, 60 + i * 50, 50);
+	}
+
+	a->set_frames(10);
+	a->set_frames(2000);
+	for (int c = 0; c < 3; ++c) {
+		for (int i = 10; i < 2000; ++i) {
+			BOOST_CHECK_EQUAL(a->data(c)[i], 0);
+		}
+	}
+}
+
+
+/** Check that all the kernels give exactly the same answers */
+BOOST_AUTO_TEST_CASE(audio_buffers_kernels)
+{
+	AudioBuffers from(16, 4001);
+	srand(99);
+	random_fill(from);
+
+	AudioBuffers reference(16, 4001);
+	random_fill(reference);
+
+	auto run = [&from](AudioBuffers& to) {
+		for (int c = 0; c < 16; ++c) {
+			to.accumulate_channel(&from, (c + 3) % 16, c, 0.3);
+		}
+		to.accumulate_frames(&from, 3997, 3, 1);
+		to.apply_gain(-4.2);
+	};
+
+	AudioBuffers scalar(reference);
+	AudioBuffers::set_kernel(AudioBuffers::Kernel::SCALAR);
+	run(scalar);
+
+	for (auto kernel: AudioBuffers::supported_kernels()) {
+		AudioBuffers test(reference);
+		AudioBuffers::set_kernel(kernel);
+		run(test);
+		for (int c = 0; c < 16; ++c) {
+			for (int i = 0; i < 4001; ++i) {
+				BOOST_REQUIRE_EQUAL(test.data(c)[i], scalar.data(c)[i]);
+			}
+		}
+	}
+
+	AudioBuffers::set_kernel(AudioBuffers::supported_kernels().back());
+}
@@ -32,6 +32,7 @@
 #include "lib/encode_server.h"
 #include "lib/encode_server_description.h"
 #include "lib/encode_server_finder.h"
+#include "lib/ffmpeg_image_proxy.h"
 #include "lib/file_log.h"
 #include "lib/film.h"
 #include "lib/image.h"
@@ -226,6 +227,125 @@ BOOST_AUTO_TEST_CASE (client_server_test_yuv)
 }
 
 
+/** Check that frames still come back correctly when their image data is sent deflated */
+BOOST_AUTO_TEST_CASE(client_server_test_zlib)
+{
+	auto image = make_shared<Image>(AV_PIX_FMT_YUV420P, dcp::Size(1998, 1080), Image::Alignment::PADDED);
+
+	for (int i = 0; i < image->planes(); ++i) {
+		uint8_t* p = image->data()[i];
+		for (int y = 0; y < image->sample_size(i).height; ++y) {
+			for (int x = 0; x < image->line_size()[i]; ++x) {
+				p[x] = (x * y) % 256;
+			}
+			p += image->stride()[i];
+		}
+	}
+
+	LogSwitcher ls(make_shared<FileLog>("build/test/client_server_test_zlib.log"));
+
+	auto pvf = std::make_shared<PlayerVideo>(
+		std::make_shared<RawImageProxy>(image),
+		Crop(),
+		optional<double>(),
+		dcp::Size(1998, 1080),
+		dcp::Size(1998, 1080),
+		Eyes::BOTH,
+		Part::WHOLE,
+		ColourConversion(),
+		VideoRange::FULL,
+		weak_ptr<Content>(),
+		optional<ContentTime>(),
+		false
+		);
+
+	auto frame = make_shared<DCPVideo>(pvf, 0, 24, 200000000, Resolution::TWO_K);
+
+	auto locally_encoded = frame->encode_locally();
+
+	auto server = make_shared<EncodeServer>(true, 2);
+
+	thread server_thread(boost::bind(&EncodeServer::run, server));
+
+	/* Let the server get itself ready */
+	dcpomatic_sleep_seconds(1);
+
+	EncodeServerDescription description("127.0.0.1", 2, SERVER_LINK_VERSION, { TransportEncoding::ZLIB });
+
+	/* A new chooser tries each encoding in turn, starting with the ones the server offered */
+	TransportEncodingChooser chooser(description.transport_encodings());
+	ArrayData remotely_encoded;
+	BOOST_REQUIRE_NO_THROW(remotely_encoded = frame->encode_remotely(description, 1200, &chooser));
+	BOOST_REQUIRE_EQUAL(locally_encoded.size(), remotely_encoded.size());
+	BOOST_CHECK_EQUAL(memcmp(locally_encoded.data(), remotely_encoded.data(), locally_encoded.size()), 0);
+
+	/* ...and then raw */
+	BOOST_REQUIRE_NO_THROW(remotely_encoded = frame->encode_remotely(description, 1200, &chooser));
+	BOOST_REQUIRE_EQUAL(locally_encoded.size(), remotely_encoded.size());
+	BOOST_CHECK_EQUAL(memcmp(locally_encoded.data(), remotely_encoded.data(), locally_encoded.size()), 0);
+
+	/* Images from files are deflated too */
+	auto file_pvf = std::make_shared<PlayerVideo>(
+		std::make_shared<FFmpegImageProxy>("test/data/flat_red.png"),
+		Crop(),
+		optional<double>(),
+		dcp::Size(1998, 1080),
+		dcp::Size(1998, 1080),
+		Eyes::BOTH,
+		Part::WHOLE,
+		ColourConversion(),
+		VideoRange::FULL,
+		weak_ptr<Content>(),
+		optional<ContentTime>(),
+		false
+		);
+
+	auto file_frame = make_shared<DCPVideo>(file_pvf, 0, 24, 200000000, Resolution::TWO_K);
+	auto const file_locally_encoded = file_frame->encode_locally();
+	TransportEncodingChooser file_chooser(description.transport_encodings());
+	BOOST_REQUIRE(file_chooser.choose() == TransportEncoding::ZLIB);
+	BOOST_REQUIRE_NO_THROW(remotely_encoded = file_frame->encode_remotely(description, 1200, &file_chooser));
+	BOOST_REQUIRE_EQUAL(file_locally_encoded.size(), remotely_encoded.size());
+	BOOST_CHECK_EQUAL(memcmp(file_locally_encoded.data(), remotely_encoded.data(), file_locally_encoded.size()), 0);
+
+	server->stop();
+	server_thread.join();
+}
+
+
+BOOST_AUTO_TEST_CASE(transport_encoding_chooser_test)
+{
+	TransportEncodingChooser chooser({ TransportEncoding::ZLIB });
+
+	/* Everything is tried once first */
+	BOOST_CHECK(chooser.choose() == TransportEncoding::ZLIB);
+	chooser.done(TransportEncoding::ZLIB, 0.5);
+	BOOST_CHECK(chooser.choose() == TransportEncoding::NONE);
+	chooser.done(TransportEncoding::NONE, 2);
+
+	BOOST_CHECK(chooser.best() == TransportEncoding::ZLIB);
+
+	/* Mostly we use the best, but sometimes we have another look at the other one */
+	int zlib = 0;
+	int none = 0;
+	for (int i = 0; i < 100; ++i) {
+		if (chooser.choose() == TransportEncoding::ZLIB) {
+			++zlib;
+		} else {
+			++none;
+		}
+	}
+	BOOST_CHECK_EQUAL(zlib, 98);
+	BOOST_CHECK_EQUAL(none, 2);
+
+	/* If the link gets faster, raw will win once the average catches up */
+	for (int i = 0; i < 20; ++i) {
+		chooser.done(TransportEncoding::NONE, 0.1);
+	}
+	BOOST_CHECK(chooser.best() == TransportEncoding::NONE);
+}
+
+
 BOOST_AUTO_TEST_CASE (client_server_test_j2k)
 {
 	auto image = make_shared<Image>(AV_PIX_FMT_YUV420P, dcp::Size (1998, 1080), Image::Alignment::PADDED);
@@ -29,8 +29,10 @@
 #include "lib/dcp_content_type.h"
 #include "lib/film.h"
 #include "lib/image_content.h"
+#include "lib/remembered_asset.h"
 #include "test.h"
 #include <dcp/cpl.h>
+#include <dcp/dcp.h>
 #include <dcp/reel.h>
 #include <dcp/reel_picture_asset.h>
 #include <boost/test/unit_test.hpp>
@@ -96,3 +98,36 @@ BOOST_AUTO_TEST_CASE (digest_test)
 	++i;
 	BOOST_REQUIRE (i == reels.end ());
 }
+
+
+/** Check that picture asset digests are remembered, and that they are correct when a DCP is re-made
+ *  from the same (complete) assets without reading them again.
+ */
+BOOST_AUTO_TEST_CASE(digest_remembered_test)
+{
+	auto r = make_shared<ImageContent>("test/data/flat_red.png");
+	auto g = make_shared<ImageContent>("test/data/flat_green.png");
+	auto film = new_test_film("digest_remembered_test", { r, g });
+	film->set_reel_type(ReelType::BY_VIDEO_CONTENT);
+
+	make_and_verify_dcp(film);
+
+	auto remembered = film->read_remembered_assets();
+	BOOST_REQUIRE_EQUAL(remembered.size(), 2U);
+	for (auto const& asset: remembered) {
+		BOOST_REQUIRE(asset.hash());
+		BOOST_CHECK_EQUAL(*asset.hash(), openssl_hash(film->dir(film->dcp_name()) / asset.filename().filename()));
+	}
+
+	/* Make it again, re-using the picture assets */
+	make_and_verify_dcp(film);
+
+	dcp::DCP dcp(film->dir(film->dcp_name()));
+	dcp.read();
+	BOOST_REQUIRE_EQUAL(dcp.cpls().size(), 1U);
+	for (auto reel: dcp.cpls()[0]->reels()) {
+		BOOST_REQUIRE(reel->main_picture()->hash());
+		BOOST_REQUIRE(reel->main_picture()->asset()->file());
+		BOOST_CHECK_EQUAL(reel->main_picture()->hash().get(), openssl_hash(reel->main_picture()->asset()->file().get()));
+	}
+}
@@ -0,0 +1,93 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/encode_server_statistics_test.cc
+ *  @brief Test EncodeServerStatistics and the sizing of remote encoders' windows.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/encode_server_statistics.h"
+#include "lib/remote_j2k_encoder_thread.h"
+#include <boost/test/unit_test.hpp>
+
+
+BOOST_AUTO_TEST_CASE(encode_server_statistics_test)
+{
+	auto statistics = EncodeServerStatistics::instance();
+	statistics->clear();
+
+	BOOST_CHECK(!statistics->latency("fred"));
+	BOOST_CHECK(!statistics->best_latency());
+
+	statistics->sent("fred");
+	statistics->sent("fred");
+	statistics->sent("sheila");
+	statistics->received("fred", 1);
+	statistics->received("sheila", 4);
+
+	BOOST_REQUIRE(statistics->latency("fred"));
+	BOOST_CHECK_CLOSE(*statistics->latency("fred"), 1, 0.1);
+	BOOST_REQUIRE(statistics->best_latency());
+	BOOST_CHECK_CLOSE(*statistics->best_latency(), 1, 0.1);
+
+	/* Later measurements should be smoothed */
+	statistics->received("fred", 2);
+	BOOST_CHECK_CLOSE(*statistics->latency("fred"), 1 + EncodeServerStatistics::latency_weight, 0.1);
+
+	statistics->sent("sheila");
+	statistics->sent("sheila");
+	statistics->failed("sheila", 2);
+	statistics->redispatched("sheila");
+
+	/* Frames that are abandoned (e.g. because a thread was stopped) are not failures */
+	statistics->sent("fred");
+	statistics->sent("fred");
+	statistics->abandoned("fred", 2);
+
+	auto servers = statistics->servers();
+	BOOST_REQUIRE_EQUAL(servers.size(), 2U);
+	BOOST_CHECK_EQUAL(servers[0].host_name, "fred");
+	BOOST_CHECK_EQUAL(servers[0].in_flight, 0);
+	BOOST_CHECK_EQUAL(servers[0].frames, 2);
+	BOOST_CHECK_EQUAL(servers[0].failures, 0);
+	BOOST_CHECK_EQUAL(servers[1].host_name, "sheila");
+	BOOST_CHECK_EQUAL(servers[1].in_flight, 0);
+	BOOST_CHECK_EQUAL(servers[1].frames, 1);
+	BOOST_CHECK_EQUAL(servers[1].failures, 2);
+	BOOST_CHECK_EQUAL(servers[1].redispatched, 1);
+	/* Not enough frames to know the rate yet */
+	BOOST_CHECK(!servers[0].rate);
+
+	statistics->clear();
+	BOOST_CHECK(statistics->servers().empty());
+}
+
+
+BOOST_AUTO_TEST_CASE(remote_encoder_frames_in_flight_test)
+{
+	BOOST_CHECK_EQUAL(RemoteJ2KEncoderThread::frames_in_flight({}), RemoteJ2KEncoderThread::initial_frames_in_flight);
+	/* A slow server should only be given one frame at a time */
+	BOOST_CHECK_EQUAL(RemoteJ2KEncoderThread::frames_in_flight(0.1f), 1);
+	BOOST_CHECK_EQUAL(RemoteJ2KEncoderThread::frames_in_flight(2.0f), 4);
+	/* and a fast one should not be given too many */
+	BOOST_CHECK_EQUAL(RemoteJ2KEncoderThread::frames_in_flight(1000.0f), RemoteJ2KEncoderThread::maximum_frames_in_flight);
+}
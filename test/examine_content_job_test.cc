@@ -0,0 +1,87 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/examine_content_job_test.cc
+ *  @brief Test ExamineContentJob.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/content_factory.h"
+#include "lib/examine_content_job.h"
+#include "lib/ffmpeg_content.h"
+#include "lib/image_content.h"
+#include "lib/job_manager.h"
+#include "lib/string_text_file_content.h"
+#include "lib/video_content.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
+
+/** Examine some different sorts of content in one job, which will use more than one thread */
+BOOST_AUTO_TEST_CASE(examine_content_job_many_test)
+{
+	auto film = new_test_film("examine_content_job_many_test");
+
+	vector<shared_ptr<Content>> content;
+	for (int i = 0; i < 4; ++i) {
+		content.push_back(make_shared<FFmpegContent>("test/data/test.mp4"));
+		content.push_back(make_shared<ImageContent>("test/data/flat_red.png"));
+		content.push_back(make_shared<StringTextFileContent>("test/data/short.srt"));
+	}
+
+	JobManager::instance()->add(make_shared<ExamineContentJob>(film, content, false));
+	BOOST_REQUIRE(!wait_for_jobs());
+
+	for (auto c: content) {
+		BOOST_CHECK(!c->digest().empty());
+	}
+
+	for (int i = 0; i < 4; ++i) {
+		BOOST_REQUIRE(content[i * 3]->video);
+		BOOST_CHECK_EQUAL(content[i * 3]->video->length(), content[0]->video->length());
+		BOOST_REQUIRE(content[i * 3 + 1]->video);
+		BOOST_CHECK_EQUAL(content[i * 3 + 1]->video->length(), 1);
+	}
+}
+
+
+/** Check that a failure to examine one piece of content out of many fails the job */
+BOOST_AUTO_TEST_CASE(examine_content_job_error_test)
+{
+	auto film = new_test_film("examine_content_job_error_test");
+
+	vector<shared_ptr<Content>> content = {
+		make_shared<FFmpegContent>("test/data/test.mp4"),
+		make_shared<FFmpegContent>("test/data/does_not_exist.mp4"),
+		make_shared<ImageContent>("test/data/flat_red.png")
+	};
+
+	auto job = make_shared<ExamineContentJob>(film, content, false);
+	JobManager::instance()->add(job);
+	BOOST_CHECK(wait_for_jobs());
+	BOOST_CHECK(job->finished_in_error());
+}
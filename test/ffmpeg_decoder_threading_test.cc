@@ -0,0 +1,141 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/ffmpeg_decoder_threading_test.cc
+ *  @brief Check that FFmpegDecoder gives the same results with read-ahead and different numbers of decode threads.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/audio_decoder.h"
+#include "lib/config.h"
+#include "lib/content_audio.h"
+#include "lib/content_text.h"
+#include "lib/content_video.h"
+#include "lib/ffmpeg_content.h"
+#include "lib/ffmpeg_decoder.h"
+#include "lib/film.h"
+#include "lib/text_decoder.h"
+#include "lib/video_decoder.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+
+using std::make_shared;
+using std::string;
+using std::vector;
+using namespace dcpomatic;
+
+
+/** @return A description of everything that a decoder emits, in order, when decoding
+ *  from the start and then after each of some accurate seeks.
+ */
+static
+vector<string>
+decode(boost::filesystem::path path, bool read_ahead, int threads, vector<ContentTime> seeks)
+{
+	Config::instance()->set_ffmpeg_read_ahead(read_ahead);
+	Config::instance()->set_ffmpeg_decode_threads(threads);
+
+	auto content = make_shared<FFmpegContent>(path);
+	auto film = new_test_film("ffmpeg_decoder_threading_test", { content });
+	auto decoder = make_shared<FFmpegDecoder>(film, content, false);
+
+	vector<string> events;
+
+	if (decoder->video) {
+		decoder->video->Data.connect([&events](ContentVideo video) {
+			events.push_back("V " + std::to_string(video.time.get()));
+		});
+	}
+	if (decoder->audio) {
+		decoder->audio->Data.connect([&events](AudioStreamPtr, ContentAudio audio) {
+			events.push_back("A " + std::to_string(audio.frame) + " " + std::to_string(audio.audio->frames()));
+		});
+	}
+	for (auto text: decoder->text) {
+		text->BitmapStart.connect([&events](ContentBitmapText sub) {
+			events.push_back("S " + std::to_string(sub.from().get()));
+		});
+		text->PlainStart.connect([&events](ContentStringText sub) {
+			events.push_back("S " + std::to_string(sub.from().get()));
+		});
+	}
+
+	auto run = [&decoder, &events]() {
+		auto const limit = events.size() + 2000;
+		while (!decoder->pass() && events.size() < limit) {}
+	};
+
+	run();
+	for (auto time: seeks) {
+		events.push_back("seek");
+		decoder->seek(time, true);
+		run();
+	}
+
+	return events;
+}
+
+
+static
+void
+check(boost::filesystem::path file, vector<ContentTime> seeks)
+{
+	ConfigRestorer cr;
+
+	auto path = TestPaths::private_data() / file;
+	BOOST_REQUIRE(boost::filesystem::exists(path));
+
+	auto const reference = decode(path, false, 1, seeks);
+	BOOST_REQUIRE(!reference.empty());
+
+	BOOST_CHECK(decode(path, true, 1, seeks) == reference);
+	BOOST_CHECK(decode(path, false, 0, seeks) == reference);
+	BOOST_CHECK(decode(path, true, 0, seeks) == reference);
+	BOOST_CHECK(decode(path, true, 16, seeks) == reference);
+}
+
+
+/** Video and audio, so this uses PassthroughPacketQueue */
+BOOST_AUTO_TEST_CASE(ffmpeg_decoder_threading_test_passthrough)
+{
+	check(
+		"boon_telly.mkv",
+		{
+			ContentTime::from_frames(42, 29.97),
+			ContentTime::from_frames(999, 29.97),
+			ContentTime::from_frames(0, 29.97),
+		});
+}
+
+
+/** Video and embedded subtitles, so this uses SubtitleSyncPacketQueue */
+BOOST_AUTO_TEST_CASE(ffmpeg_decoder_threading_test_subtitle_sync)
+{
+	check(
+		"clapperboard_with_subs.mkv",
+		{
+			ContentTime::from_seconds(5),
+			ContentTime::from_seconds(1),
+		});
+}
@@ -101,3 +101,35 @@ BOOST_AUTO_TEST_CASE(test_crash_during_examination_with_duplicate_ids)
 	auto examiner = make_shared<FFmpegExaminer>(content);
 }
 
+
+/** An examiner which behaves as if the container did not say how long the content is */
+class NoDurationFFmpegExaminer : public FFmpegExaminer
+{
+public:
+	NoDurationFFmpegExaminer(std::shared_ptr<const FFmpegContent> content, bool fast)
+		: FFmpegExaminer(content, std::shared_ptr<Job>(), fast, true)
+	{}
+};
+
+
+/** Check that finding the length of a file whose container does not give its duration gives the
+ *  same results with the fast path (using the container's index) as by reading the whole file.
+ */
+BOOST_AUTO_TEST_CASE(ffmpeg_examiner_fast_path_test)
+{
+	for (auto file: { "test/data/count300bd24.m2ts", "test/data/test.mp4" }) {
+		auto content = make_shared<FFmpegContent>(file);
+		auto fast = make_shared<NoDurationFFmpegExaminer>(content, true);
+		auto slow = make_shared<NoDurationFFmpegExaminer>(content, false);
+
+		BOOST_CHECK(fast->examined_with_fast_path());
+		BOOST_CHECK(!slow->examined_with_fast_path());
+		BOOST_CHECK(fast->video_length() > 0);
+		BOOST_CHECK_EQUAL(fast->video_length(), slow->video_length());
+		BOOST_REQUIRE_EQUAL(fast->audio_streams().size(), slow->audio_streams().size());
+		for (size_t i = 0; i < fast->audio_streams().size(); ++i) {
+			BOOST_CHECK_EQUAL(fast->audio_streams()[i]->length(), slow->audio_streams()[i]->length());
+		}
+		BOOST_CHECK(fast->first_video() == slow->first_video());
+	}
+}
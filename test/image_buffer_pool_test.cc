@@ -0,0 +1,178 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/image_buffer_pool_test.cc
+ *  @brief Test ImageBufferPool class.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/image.h"
+#include "lib/image_buffer_pool.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <vector>
+
+
+using std::make_shared;
+
+
+BOOST_AUTO_TEST_CASE(image_buffer_pool_reuse_test)
+{
+	auto pool = ImageBufferPool::instance();
+	pool->set_limit(ImageBufferPool::default_limit);
+	pool->clear();
+
+	auto const before = pool->statistics();
+
+	auto a = pool->get(4 * 1024 * 1024);
+	BOOST_REQUIRE(a);
+	pool->put(a, 4 * 1024 * 1024);
+	BOOST_CHECK(pool->statistics().held >= 4 * 1024 * 1024);
+
+	/* A slightly smaller request should come from the same size class and get the same buffer */
+	auto b = pool->get(4 * 1024 * 1024 - 1000);
+	BOOST_CHECK(a == b);
+	pool->put(b, 4 * 1024 * 1024 - 1000);
+
+	auto const after = pool->statistics();
+	BOOST_CHECK_EQUAL(after.misses - before.misses, 1U);
+	BOOST_CHECK_EQUAL(after.hits - before.hits, 1U);
+
+	pool->clear();
+	BOOST_CHECK_EQUAL(pool->statistics().held, 0U);
+}
+
+
+BOOST_AUTO_TEST_CASE(image_buffer_pool_small_test)
+{
+	auto pool = ImageBufferPool::instance();
+	pool->clear();
+
+	/* Small buffers should not be kept */
+	auto a = pool->get(1024);
+	pool->put(a, 1024);
+	BOOST_CHECK_EQUAL(pool->statistics().held, 0U);
+}
+
+
+BOOST_AUTO_TEST_CASE(image_buffer_pool_limit_test)
+{
+	auto pool = ImageBufferPool::instance();
+	pool->clear();
+	pool->set_limit(10 * 1024 * 1024);
+
+	std::vector<uint8_t*> buffers;
+	for (int i = 0; i < 8; ++i) {
+		buffers.push_back(pool->get(2 * 1024 * 1024));
+	}
+	for (auto i: buffers) {
+		pool->put(i, 2 * 1024 * 1024);
+	}
+
+	BOOST_CHECK(pool->statistics().held <= 10 * 1024 * 1024);
+	BOOST_CHECK(pool->statistics().held > 0);
+
+	pool->clear();
+	pool->set_limit(ImageBufferPool::default_limit);
+}
+
+
+/** Check that when many threads are holding buffers in their caches there is still room in
+ *  the shared pool for buffers that other threads can use.
+ */
+BOOST_AUTO_TEST_CASE(image_buffer_pool_many_threads_test)
+{
+	auto pool = ImageBufferPool::instance();
+	pool->clear();
+	pool->set_limit(16 * 1024 * 1024);
+
+	int const threads = 8;
+	size_t const size = 2 * 1024 * 1024;
+
+	boost::mutex mutex;
+	boost::condition condition;
+	int ready = 0;
+	bool finish = false;
+
+	boost::thread_group group;
+	for (int i = 0; i < threads; ++i) {
+		group.create_thread([pool, size, &mutex, &condition, &ready, &finish]() {
+			auto a = pool->get(size);
+			auto b = pool->get(size);
+			pool->put(a, size);
+			pool->put(b, size);
+			/* Keep this thread (and so its cache) alive until the test has finished */
+			boost::mutex::scoped_lock lm(mutex);
+			++ready;
+			condition.notify_all();
+			while (!finish) {
+				condition.wait(lm);
+			}
+		});
+	}
+
+	{
+		boost::mutex::scoped_lock lm(mutex);
+		while (ready < threads) {
+			condition.wait(lm);
+		}
+	}
+
+	auto const before = pool->statistics();
+	BOOST_CHECK(before.held <= 16 * 1024 * 1024);
+	auto c = pool->get(size);
+	BOOST_CHECK_EQUAL(pool->statistics().hits - before.hits, 1U);
+	pool->put(c, size);
+
+	{
+		boost::mutex::scoped_lock lm(mutex);
+		finish = true;
+		condition.notify_all();
+	}
+	group.join_all();
+
+	pool->clear();
+	pool->set_limit(ImageBufferPool::default_limit);
+}
+
+
+/** Check that Images get their planes back from the pool in the steady state */
+BOOST_AUTO_TEST_CASE(image_buffer_pool_image_test)
+{
+	auto pool = ImageBufferPool::instance();
+	pool->clear();
+
+	make_shared<Image>(AV_PIX_FMT_RGB48LE, dcp::Size(1998, 1080), Image::Alignment::PADDED);
+
+	auto const before = pool->statistics();
+	for (int i = 0; i < 10; ++i) {
+		make_shared<Image>(AV_PIX_FMT_RGB48LE, dcp::Size(1998, 1080), Image::Alignment::PADDED);
+	}
+	auto const after = pool->statistics();
+
+	BOOST_CHECK_EQUAL(after.misses, before.misses);
+	BOOST_CHECK_EQUAL(after.hits - before.hits, 10U);
+
+	pool->clear();
+}
@@ -27,11 +27,13 @@
 
 
 #include "lib/image.h"
+#include "lib/image_buffer_pool.h"
 #include "lib/image_content.h"
 #include "lib/image_decoder.h"
 #include "lib/image_jpeg.h"
 #include "lib/image_png.h"
 #include "lib/ffmpeg_image_proxy.h"
+#include "lib/scale_context_cache.h"
 #include "test.h"
 #include <boost/test/unit_test.hpp>
 #include <iostream>
@@ -543,6 +545,169 @@ BOOST_AUTO_TEST_CASE(crop_scale_window_test8)
 }
 
 
+/** Check that crop_scale_window_composite gives the same result as crop_scale_window, alpha_blend and fade */
+BOOST_AUTO_TEST_CASE(crop_scale_window_composite_test)
+{
+	auto proxy = make_shared<FFmpegImageProxy>("test/data/rgb_grey_testcard.png");
+	auto testcard = proxy->image(Image::Alignment::PADDED).image;
+
+	auto text = make_shared<Image>(AV_PIX_FMT_BGRA, dcp::Size(640, 300), Image::Alignment::PADDED);
+	for (int y = 0; y < 300; ++y) {
+		auto p = text->data()[0] + y * text->stride()[0];
+		for (int x = 0; x < 640; ++x) {
+			*p++ = x % 256;
+			*p++ = y % 256;
+			*p++ = (x + y) % 256;
+			*p++ = (x * 2) % 256;
+		}
+	}
+
+	for (auto in_format: { AV_PIX_FMT_YUV420P, AV_PIX_FMT_RGB48LE }) {
+		auto in = testcard->convert_pixel_format(dcp::YUVToRGB::REC709, in_format, Image::Alignment::PADDED, false);
+		for (auto out_format: { AV_PIX_FMT_RGB48LE, AV_PIX_FMT_XYZ12LE }) {
+			/* We can't convert ranges of RGB sources when going to XYZ */
+			auto const video_range = in_format == AV_PIX_FMT_RGB48LE && out_format == AV_PIX_FMT_RGB48LE ? VideoRange::VIDEO : VideoRange::FULL;
+			/* Put the text partly in the black bar at the bottom */
+			PositionImage const position(text, Position<int>(700, 900));
+
+			auto reference = in->crop_scale_window(
+				Crop(6, 8, 10, 12), dcp::Size(1435, 1000), dcp::Size(1998, 1080), dcp::YUVToRGB::REC709, video_range, out_format, VideoRange::FULL, Image::Alignment::COMPACT, false
+				);
+			reference->alpha_blend(position.image, position.position);
+			reference->fade(0.6);
+
+			auto composite = in->crop_scale_window_composite(
+				Crop(6, 8, 10, 12), dcp::Size(1435, 1000), dcp::Size(1998, 1080), dcp::YUVToRGB::REC709, video_range, out_format, VideoRange::FULL, Image::Alignment::COMPACT, false,
+				position, 0.6
+				);
+
+			BOOST_CHECK(*reference == *composite);
+		}
+	}
+}
+
+
+/** Check that crop_scale_window_composite() blacks out all of the bars at the sides when the difference
+ *  between the scaled and output widths is odd, even if the output's buffer is a dirty one from the pool.
+ */
+BOOST_AUTO_TEST_CASE(crop_scale_window_composite_reused_buffer_test)
+{
+	ImageBufferPool::instance()->clear();
+
+	auto in = make_shared<Image>(AV_PIX_FMT_YUV420P, dcp::Size(800, 600), Image::Alignment::PADDED);
+	memset(in->data()[0], 120, in->stride()[0] * 600);
+	memset(in->data()[1], 100, in->stride()[1] * 300);
+	memset(in->data()[2], 140, in->stride()[2] * 300);
+
+	dcp::Size const inter_size(1435, 1080);
+	dcp::Size const out_size(1998, 1080);
+
+	auto reference = in->crop_scale_window(
+		Crop(), inter_size, out_size, dcp::YUVToRGB::REC709, VideoRange::FULL, AV_PIX_FMT_RGB48LE, VideoRange::FULL, Image::Alignment::COMPACT, false
+		);
+
+	/* Give the pool a buffer full of junk, which the composite's output should then get */
+	{
+		auto dirty = make_shared<Image>(AV_PIX_FMT_RGB48LE, out_size, Image::Alignment::COMPACT);
+		memset(dirty->data()[0], 0xff, dirty->stride()[0] * out_size.height);
+	}
+
+	auto composite = in->crop_scale_window_composite(
+		Crop(), inter_size, out_size, dcp::YUVToRGB::REC709, VideoRange::FULL, AV_PIX_FMT_RGB48LE, VideoRange::FULL, Image::Alignment::COMPACT, false,
+		boost::optional<PositionImage>(), boost::optional<double>()
+		);
+
+	for (int y = 0; y < out_size.height; ++y) {
+		auto last = reinterpret_cast<uint16_t*>(composite->data()[0] + y * composite->stride()[0]) + (out_size.width - 1) * 3;
+		BOOST_REQUIRE_EQUAL(last[0], 0);
+		BOOST_REQUIRE_EQUAL(last[1], 0);
+		BOOST_REQUIRE_EQUAL(last[2], 0);
+	}
+
+	BOOST_CHECK(*reference == *composite);
+}
+
+
+/** Check that crop_scale_window() blacks out both bars when the width difference is odd, even if
+ *  its output buffer comes from the pool full of junk.
+ */
+BOOST_AUTO_TEST_CASE(crop_scale_window_reused_buffer_test)
+{
+	ImageBufferPool::instance()->clear();
+
+	auto in = make_shared<Image>(AV_PIX_FMT_YUV420P, dcp::Size(800, 600), Image::Alignment::PADDED);
+	memset(in->data()[0], 120, in->stride()[0] * 600);
+	memset(in->data()[1], 100, in->stride()[1] * 300);
+	memset(in->data()[2], 140, in->stride()[2] * 300);
+
+	dcp::Size const inter_size(1435, 1080);
+	dcp::Size const out_size(1998, 1080);
+
+	/* Give the pool a buffer full of junk, which the scaled image should then get */
+	{
+		auto dirty = make_shared<Image>(AV_PIX_FMT_RGB48LE, out_size, Image::Alignment::COMPACT);
+		memset(dirty->data()[0], 0xff, dirty->stride()[0] * out_size.height);
+	}
+
+	auto scaled = in->crop_scale_window(
+		Crop(), inter_size, out_size, dcp::YUVToRGB::REC709, VideoRange::FULL, AV_PIX_FMT_RGB48LE, VideoRange::FULL, Image::Alignment::COMPACT, false
+		);
+
+	auto const left_pad = (out_size.width - inter_size.width) / 2;
+	auto const right_pad = out_size.width - inter_size.width - left_pad;
+	BOOST_REQUIRE(left_pad != right_pad);
+
+	for (int y = 0; y < out_size.height; ++y) {
+		auto line = reinterpret_cast<uint16_t*>(scaled->data()[0] + y * scaled->stride()[0]);
+		for (int x = 0; x < left_pad; ++x) {
+			BOOST_REQUIRE(line[x * 3] == 0 && line[x * 3 + 1] == 0 && line[x * 3 + 2] == 0);
+		}
+		for (int x = out_size.width - right_pad; x < out_size.width; ++x) {
+			BOOST_REQUIRE(line[x * 3] == 0 && line[x * 3 + 1] == 0 && line[x * 3 + 2] == 0);
+		}
+	}
+}
+
+
+/** Check that repeated scales with the same parameters re-use a cached SwsContext, and that
+ *  the results are the same as those from a freshly-made one.
+ */
+BOOST_AUTO_TEST_CASE(crop_scale_window_context_cache_test)
+{
+	ScaleContextCache::clear();
+
+	auto image = make_shared<Image>(AV_PIX_FMT_YUV420P, dcp::Size(800, 600), Image::Alignment::PADDED);
+	memset(image->data()[0], 41, image->stride()[0] * 600);
+	memset(image->data()[1], 240, image->stride()[1] * 300);
+	memset(image->data()[2], 41, image->stride()[2] * 300);
+
+	auto scale = [image]() {
+		return image->crop_scale_window(
+			Crop(), dcp::Size(1435, 1080), dcp::Size(1998, 1080), dcp::YUVToRGB::REC709, VideoRange::FULL, AV_PIX_FMT_RGB48LE, VideoRange::FULL, Image::Alignment::PADDED, false
+			);
+	};
+
+	auto const misses = ScaleContextCache::misses();
+	auto const hits = ScaleContextCache::hits();
+
+	auto first = scale();
+	BOOST_CHECK_EQUAL(ScaleContextCache::misses(), misses + 1);
+
+	for (int i = 0; i < 4; ++i) {
+		BOOST_CHECK(*scale() == *first);
+	}
+
+	BOOST_CHECK_EQUAL(ScaleContextCache::misses(), misses + 1);
+	BOOST_CHECK_EQUAL(ScaleContextCache::hits(), hits + 4);
+
+	/* A different output range should need a new context */
+	image->crop_scale_window(
+		Crop(), dcp::Size(1435, 1080), dcp::Size(1998, 1080), dcp::YUVToRGB::REC709, VideoRange::FULL, AV_PIX_FMT_RGB48LE, VideoRange::VIDEO, Image::Alignment::PADDED, false
+		);
+	BOOST_CHECK_EQUAL(ScaleContextCache::misses(), misses + 2);
+}
+
+
 BOOST_AUTO_TEST_CASE(as_png_test)
 {
 	auto proxy = make_shared<FFmpegImageProxy>("test/data/3d_test/000001.png");
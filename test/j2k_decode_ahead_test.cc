@@ -0,0 +1,74 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "lib/image.h"
+#include "lib/j2k_decode_ahead.h"
+#include "lib/j2k_image_proxy.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
+
+BOOST_AUTO_TEST_CASE(j2k_decode_ahead_test)
+{
+	auto proxy = []() -> vector<shared_ptr<const J2KImageProxy>> {
+		return { make_shared<J2KImageProxy>(TestPaths::private_data() / "count.j2c", dcp::Size(1998, 1080), AV_PIX_FMT_XYZ12LE) };
+	};
+
+	J2KDecodeAhead ahead(4);
+	/* This should result in a reduction of 1 */
+	ahead.set_target_size(dcp::Size(500, 270));
+
+	for (int i = 0; i < 5; ++i) {
+		ahead.add(i, proxy());
+	}
+
+	/* We should only have kept 4 frames */
+	BOOST_CHECK(ahead.has(3));
+	BOOST_CHECK(!ahead.has(4));
+
+	auto two = ahead.get(2);
+	BOOST_REQUIRE_EQUAL(two.size(), 1U);
+	BOOST_CHECK(!ahead.has(0));
+	BOOST_CHECK(!ahead.has(1));
+	BOOST_CHECK(!ahead.has(2));
+	BOOST_CHECK(ahead.has(3));
+
+	/* Asking for the image with a slightly different target size which needs the same reduction
+	 * should give us what was decoded ahead.
+	 */
+	auto const first = two[0]->image(Image::Alignment::PADDED, dcp::Size(500, 270));
+	auto const second = two[0]->image(Image::Alignment::PADDED, dcp::Size(510, 276));
+	BOOST_CHECK_EQUAL(first.log2_scaling, 1);
+	BOOST_CHECK_EQUAL(second.log2_scaling, 1);
+	BOOST_CHECK(first.image == second.image);
+
+	BOOST_CHECK(ahead.get(4).empty());
+	BOOST_CHECK(!ahead.has(3));
+
+	ahead.add(5, proxy());
+	ahead.clear();
+	BOOST_CHECK(!ahead.has(5));
+}
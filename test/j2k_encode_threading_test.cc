@@ -23,6 +23,7 @@
 #include "lib/content_factory.h"
 #include "lib/dcp_film_encoder.h"
 #include "lib/dcp_transcode_job.h"
+#include "lib/encode_server.h"
 #include "lib/encode_server_description.h"
 #include "lib/film.h"
 #ifdef DCPOMATIC_GROK
@@ -42,6 +43,7 @@
 
 using std::dynamic_pointer_cast;
 using std::list;
+using boost::thread;
 
 
 BOOST_AUTO_TEST_CASE(local_threads_created_and_destroyed)
@@ -120,6 +122,47 @@ BOOST_AUTO_TEST_CASE(frames_not_lost_when_threads_disappear)
 }
 
 
+
+/** Check that remote encoding works with long-lived connections, and also with
+ *  servers which only understand the older one-frame-per-connection protocol.
+ */
+BOOST_AUTO_TEST_CASE(remote_encode_with_old_and_new_link_versions)
+{
+	for (auto version: { OLDEST_SERVER_LINK_VERSION, SERVER_LINK_VERSION }) {
+		auto content = content_factory(TestPaths::private_data() / "clapperboard.mp4");
+		auto film = new_test_film(fmt::format("remote_encode_with_link_version_{}", version), content);
+		film->write_metadata();
+
+		EncodeServer server(false, 2);
+		thread server_thread(boost::bind(&EncodeServer::run, &server));
+		/* Let the server get itself ready */
+		dcpomatic_sleep_seconds(1);
+
+		auto job = make_dcp(film, TranscodeJob::ChangedBehaviour::IGNORE);
+
+		while (JobManager::instance()->work_to_do()) {
+			if (auto encoder = dynamic_cast<J2KEncoder*>(dynamic_pointer_cast<DCPFilmEncoder>(job->_encoder)->_encoder.get())) {
+				/* Use only the server, and tell the encoder that it has the version we want to test */
+				encoder->remake_threads(0, 0, { EncodeServerDescription("127.0.0.1", 2, version) });
+			}
+			dcpomatic_sleep_seconds(1);
+		}
+
+		BOOST_CHECK(!JobManager::instance()->errors());
+
+		server.stop();
+		server_thread.join();
+
+		BOOST_CHECK(server.frames_encoded() > 0);
+
+		dcp::DCP dcp(film->dir(film->dcp_name()));
+		dcp.read();
+		BOOST_REQUIRE_EQUAL(dcp.cpls().size(), 1U);
+		BOOST_REQUIRE_EQUAL(dcp.cpls()[0]->reels().size(), 1U);
+		BOOST_REQUIRE_EQUAL(dcp.cpls()[0]->reels()[0]->main_picture()->intrinsic_duration(), 423U);
+	}
+}
+
 #ifdef DCPOMATIC_GROK
 BOOST_AUTO_TEST_CASE(transcode_stops_when_gpu_enabled_with_no_gpu)
 {
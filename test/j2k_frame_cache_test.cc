@@ -0,0 +1,175 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "lib/dcp_video.h"
+#include "lib/image.h"
+#include "lib/j2k_frame_cache.h"
+#include "lib/player_video.h"
+#include "lib/raw_image_proxy.h"
+#include <dcp/array_data.h>
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::weak_ptr;
+using boost::optional;
+
+
+static
+dcp::ArrayData
+frame(int size, uint8_t value)
+{
+	dcp::ArrayData data(size);
+	memset(data.data(), value, size);
+	return data;
+}
+
+
+BOOST_AUTO_TEST_CASE(j2k_frame_cache_round_trip_test)
+{
+	boost::filesystem::path dir("build/test/j2k_frame_cache_round_trip_test");
+	boost::filesystem::remove_all(dir);
+
+	{
+		J2KFrameCache cache(dir, 1000000);
+		BOOST_CHECK(!cache.get("abcdef"));
+		cache.put("abcdef", frame(1000, 42));
+
+		auto data = cache.get("abcdef");
+		BOOST_REQUIRE(data);
+		BOOST_CHECK(*data == frame(1000, 42));
+
+		auto const statistics = cache.statistics();
+		BOOST_CHECK_EQUAL(statistics.hits, 1U);
+		BOOST_CHECK_EQUAL(statistics.misses, 1U);
+		BOOST_CHECK_EQUAL(statistics.stored, 1U);
+		BOOST_CHECK_EQUAL(statistics.size, 1000U);
+	}
+
+	/* A new cache in the same place should find the frame */
+	J2KFrameCache cache(dir, 1000000);
+	BOOST_CHECK_EQUAL(cache.statistics().size, 1000U);
+	auto data = cache.get("abcdef");
+	BOOST_REQUIRE(data);
+	BOOST_CHECK(*data == frame(1000, 42));
+}
+
+
+BOOST_AUTO_TEST_CASE(j2k_frame_cache_eviction_test)
+{
+	boost::filesystem::path dir("build/test/j2k_frame_cache_eviction_test");
+	boost::filesystem::remove_all(dir);
+
+	J2KFrameCache cache(dir, 3000);
+	cache.put("aa0001", frame(1000, 1));
+	cache.put("bb0002", frame(1000, 2));
+	cache.put("cc0003", frame(1000, 3));
+
+	/* Use the first one so that the second becomes the least-recently used */
+	BOOST_CHECK(cache.get("aa0001"));
+
+	cache.put("dd0004", frame(1000, 4));
+
+	BOOST_CHECK(cache.get("aa0001"));
+	BOOST_CHECK(!cache.get("bb0002"));
+	BOOST_CHECK(cache.get("cc0003"));
+	BOOST_CHECK(cache.get("dd0004"));
+
+	auto const statistics = cache.statistics();
+	BOOST_CHECK_EQUAL(statistics.evicted, 1U);
+	BOOST_CHECK_EQUAL(statistics.size, 3000U);
+	BOOST_CHECK(!boost::filesystem::exists(dir / "bb" / "bb0002.j2c"));
+}
+
+
+/** Check that a cache which is already too big when it is opened (e.g. because its maximum size
+ *  has been reduced) is trimmed straight away.
+ */
+BOOST_AUTO_TEST_CASE(j2k_frame_cache_shrink_test)
+{
+	boost::filesystem::path dir("build/test/j2k_frame_cache_shrink_test");
+	boost::filesystem::remove_all(dir);
+
+	{
+		J2KFrameCache cache(dir, 3000);
+		cache.put("aa0001", frame(1000, 1));
+		cache.put("bb0002", frame(1000, 2));
+		cache.put("cc0003", frame(1000, 3));
+		/* Putting the same frame again changes nothing */
+		cache.put("cc0003", frame(1000, 3));
+		BOOST_CHECK_EQUAL(cache.statistics().stored, 3U);
+		BOOST_CHECK_EQUAL(cache.statistics().size, 3000U);
+	}
+
+	J2KFrameCache cache(dir, 1000);
+	auto const statistics = cache.statistics();
+	BOOST_CHECK_EQUAL(statistics.evicted, 2U);
+	BOOST_CHECK_EQUAL(statistics.size, 1000U);
+	BOOST_CHECK(!boost::filesystem::exists(dir / "aa" / "aa0001.j2c"));
+	BOOST_CHECK(!boost::filesystem::exists(dir / "bb" / "bb0002.j2c"));
+	BOOST_CHECK(cache.get("cc0003"));
+}
+
+
+static
+shared_ptr<PlayerVideo>
+player_video(uint8_t value)
+{
+	auto image = make_shared<Image>(AV_PIX_FMT_RGB24, dcp::Size(64, 32), Image::Alignment::PADDED);
+	for (int y = 0; y < 32; ++y) {
+		memset(image->data()[0] + y * image->stride()[0], value, image->line_size()[0]);
+	}
+
+	return make_shared<PlayerVideo>(
+		make_shared<RawImageProxy>(image),
+		Crop(),
+		optional<double>(),
+		dcp::Size(64, 32),
+		dcp::Size(64, 32),
+		Eyes::BOTH,
+		Part::WHOLE,
+		optional<ColourConversion>(),
+		VideoRange::FULL,
+		weak_ptr<Content>(),
+		optional<dcpomatic::ContentTime>(),
+		false
+		);
+}
+
+
+BOOST_AUTO_TEST_CASE(j2k_frame_cache_key_test)
+{
+	auto key = [](shared_ptr<PlayerVideo> pv, int bit_rate) {
+		return DCPVideo(pv, 0, 24, bit_rate, Resolution::TWO_K).cache_key();
+	};
+
+	/* Same picture in different PlayerVideos at different positions gives the same key */
+	BOOST_CHECK_EQUAL(key(player_video(10), 100000000), DCPVideo(player_video(10), 42, 24, 100000000, Resolution::TWO_K).cache_key());
+	/* Anything which changes the encode changes the key */
+	BOOST_CHECK(key(player_video(10), 100000000) != key(player_video(11), 100000000));
+	BOOST_CHECK(key(player_video(10), 100000000) != key(player_video(10), 150000000));
+}
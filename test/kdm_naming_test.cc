@@ -265,3 +265,77 @@ BOOST_AUTO_TEST_CASE(directory_kdm_naming_test)
 	BOOST_CHECK_MESSAGE (boost::filesystem::exists(base / dir_b / ref), "File " << ref << " not found");
 }
 
+
+
+/** Check that kdms_for_screens makes one decrypted KDM for each validity window, and gives its KDMs in the same order as the screens */
+BOOST_AUTO_TEST_CASE(kdms_for_screens_test)
+{
+	Context context;
+	CinemaList cinemas;
+
+	auto film = new_test_film("kdms_for_screens_test", { content_factory("test/data/flat_black.png")[0] });
+	film->set_encrypt_picture(true);
+	film->set_encrypt_sound(true);
+	make_and_verify_dcp(film);
+	auto cpls = film->cpls();
+	BOOST_REQUIRE(cpls.size() == 1);
+
+	auto sign_cert = Config::instance()->signer_chain()->leaf();
+
+	dcp::LocalTime from(sign_cert.not_before());
+	from.add_months(2);
+	dcp::LocalTime until(sign_cert.not_after());
+	until.add_months(-2);
+
+	vector<pair<CinemaID, ScreenID>> const ids = {
+		{ context.cinema_b, context.cinema_b_screen_z },
+		{ context.cinema_a, context.cinema_a_screen_2 },
+		{ context.cinema_b, context.cinema_b_screen_x },
+		{ context.cinema_a, context.cinema_a_screen_1 },
+		{ context.cinema_b, context.cinema_b_screen_y }
+	};
+
+	vector<ScreenDetails> screens;
+	for (auto const& id: ids) {
+		screens.push_back({id.first, *cinemas.cinema(id.first), *cinemas.screen(id.second)});
+	}
+
+	int calls = 0;
+	auto const cpl = cpls.front().cpl_file;
+	std::function<dcp::DecryptedKDM (dcp::LocalTime, dcp::LocalTime)> make_kdm = [film, cpl, &calls](dcp::LocalTime begin, dcp::LocalTime end) {
+		++calls;
+		return film->make_kdm(cpl, begin, end);
+	};
+
+	vector<int> progress;
+	vector<KDMCertificatePeriod> period_checks;
+	auto kdms = kdms_for_screens(
+		make_kdm,
+		screens,
+		boost::posix_time::time_from_string(from.date() + " " + from.time_of_day(true, false)),
+		boost::posix_time::time_from_string(until.date() + " " + until.time_of_day(true, false)),
+		dcp::Formulation::MODIFIED_TRANSITIONAL_1,
+		false,
+		optional<int>(),
+		period_checks,
+		[&progress](int done, int total) {
+			BOOST_CHECK_EQUAL(total, 5);
+			progress.push_back(done);
+		}
+		);
+
+	/* One for each of the two cinemas' UTC offsets */
+	BOOST_CHECK_EQUAL(calls, 2);
+	BOOST_CHECK_EQUAL(period_checks.size(), 5U);
+	BOOST_REQUIRE(!progress.empty());
+	BOOST_CHECK_EQUAL(progress.back(), 5);
+
+	vector<string> names;
+	for (auto kdm: kdms) {
+		names.push_back(kdm->get('c').get_value_or("") + "/" + kdm->get('s').get_value_or(""));
+	}
+	vector<string> const reference = {
+		"Cinema B/Screen Z", "Cinema A/Screen 2", "Cinema B/Screen X", "Cinema A/Screen 1", "Cinema B/Screen Y"
+	};
+	BOOST_CHECK(names == reference);
+}
@@ -0,0 +1,215 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "lib/audio_buffers.h"
+#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
+#include "lib/audio_filter_graph.h"
+#include "lib/filter.h"
+#endif
+#include "lib/loudness_meter.h"
+#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
+#include <dcp/warnings.h>
+extern "C" {
+LIBDCP_DISABLE_WARNINGS
+#include <libavfilter/f_ebur128.h>
+LIBDCP_ENABLE_WARNINGS
+}
+#endif
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+
+
+using std::make_shared;
+
+
+static
+void
+sine(AudioBuffers& audio, int channel, float amplitude, float frequency, int sample_rate, int from = 0, int to = -1)
+{
+	if (to == -1) {
+		to = audio.frames();
+	}
+
+	for (int i = from; i < to; ++i) {
+		audio.data(channel)[i] = amplitude * sin(2 * M_PI * frequency * i / sample_rate);
+	}
+}
+
+
+static
+float
+db_to_linear(double db)
+{
+	return pow(10, db / 20);
+}
+
+
+/** BS.1770 says that a 0dBFS 1kHz sine wave in one front channel should read -3.01 LKFS */
+BOOST_AUTO_TEST_CASE(loudness_meter_reference_test)
+{
+	int const sample_rate = 48000;
+	AudioBuffers audio(6, sample_rate * 10);
+	audio.make_silent();
+	sine(audio, 0, 1, 997, sample_rate);
+
+	LoudnessMeter meter(sample_rate, 6);
+	meter.process(audio, 0, audio.frames(), true);
+	BOOST_CHECK_CLOSE(meter.integrated(), -3.01, 0.1);
+	BOOST_CHECK_SMALL(meter.range(), 0.01);
+
+	/* LFE should not count */
+	audio.make_silent();
+	sine(audio, 3, 1, 50, sample_rate);
+	LoudnessMeter lfe(sample_rate, 6);
+	lfe.process(audio, 0, audio.frames(), true);
+	BOOST_CHECK_EQUAL(lfe.integrated(), -70);
+}
+
+
+/** EBU Tech 3341 test case 1: a stereo 1kHz sine at -23dBFS in each channel should read -23 LUFS */
+BOOST_AUTO_TEST_CASE(loudness_meter_ebu_3341_test)
+{
+	for (auto sample_rate: { 48000, 96000 }) {
+		AudioBuffers audio(6, sample_rate * 20);
+		audio.make_silent();
+		sine(audio, 0, db_to_linear(-23), 1000, sample_rate);
+		sine(audio, 1, db_to_linear(-23), 1000, sample_rate);
+
+		LoudnessMeter meter(sample_rate, 6);
+		meter.process(audio, 0, audio.frames(), true);
+		BOOST_CHECK_SMALL(meter.integrated() + 23, 0.1);
+	}
+}
+
+
+/** EBU Tech 3342 test case 1: a stereo 1kHz sine at -20dBFS for 20s then -30dBFS for 20s
+ *  should have a loudness range of 10 LU.
+ */
+BOOST_AUTO_TEST_CASE(loudness_meter_ebu_3342_test)
+{
+	int const sample_rate = 48000;
+	AudioBuffers audio(6, sample_rate * 40);
+	audio.make_silent();
+	for (auto channel: { 0, 1 }) {
+		sine(audio, channel, db_to_linear(-20), 1000, sample_rate, 0, sample_rate * 20);
+		sine(audio, channel, db_to_linear(-30), 1000, sample_rate, sample_rate * 20, sample_rate * 40);
+	}
+
+	LoudnessMeter meter(sample_rate, 6);
+	meter.process(audio, 0, audio.frames(), true);
+	BOOST_CHECK_SMALL(meter.range() - 10, 1.0);
+}
+
+
+/** Surrounds should be weighted by 1.41 (about 1.5dB) compared to the front channels */
+BOOST_AUTO_TEST_CASE(loudness_meter_surround_weighting_test)
+{
+	int const sample_rate = 48000;
+
+	auto measure = [](int channel) {
+		AudioBuffers audio(6, sample_rate * 10);
+		audio.make_silent();
+		sine(audio, channel, db_to_linear(-23), 1000, sample_rate);
+		LoudnessMeter meter(sample_rate, 6);
+		meter.process(audio, 0, audio.frames(), true);
+		return meter.integrated();
+	};
+
+	BOOST_CHECK_CLOSE(measure(4) - measure(0), 10 * log10(1.41), 0.1);
+	BOOST_CHECK_CLOSE(measure(5) - measure(1), 10 * log10(1.41), 0.1);
+}
+
+
+/** Two meters measuring consecutive parts of some audio should, when combined, give the same
+ *  result as one meter which measured everything.
+ */
+BOOST_AUTO_TEST_CASE(loudness_meter_append_test)
+{
+	int const sample_rate = 48000;
+	AudioBuffers audio(6, sample_rate * 20);
+	audio.make_silent();
+	sine(audio, 0, 0.8, 997, sample_rate);
+	sine(audio, 4, 0.2, 200, sample_rate);
+	/* Make the second half quieter so that there is some loudness range */
+	for (int c = 0; c < 6; ++c) {
+		for (int i = sample_rate * 10; i < audio.frames(); ++i) {
+			audio.data(c)[i] *= 0.1;
+		}
+	}
+
+	LoudnessMeter whole(sample_rate, 6);
+	/* Pass the audio in pieces that don't line up with the blocks */
+	for (int i = 0; i < audio.frames(); i += 1001) {
+		whole.process(audio, i, std::min(1001, audio.frames() - i), true);
+	}
+
+	int const split = whole.block_frames() * 73;
+
+	LoudnessMeter first(sample_rate, 6);
+	first.process(audio, 0, split, true);
+	LoudnessMeter second(sample_rate, 6);
+	second.process(audio, split - sample_rate * 2, sample_rate * 2, false);
+	second.process(audio, split, audio.frames() - split, true);
+	first.append(second);
+
+	BOOST_CHECK_EQUAL(whole.integrated(), first.integrated());
+	BOOST_CHECK_EQUAL(whole.range(), first.range());
+	BOOST_CHECK(whole.range() > 10);
+}
+
+
+#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
+/** With 5.1 FFmpeg's ebur128 filter weights the channels in the same way as we do, so the two
+ *  should agree to within the 0.1 LU resolution of FFmpeg's histograms.
+ */
+BOOST_AUTO_TEST_CASE(loudness_meter_matches_ffmpeg_test)
+{
+	int const sample_rate = 48000;
+	auto audio = make_shared<AudioBuffers>(6, sample_rate * 40);
+	audio->make_silent();
+	sine(*audio, 0, db_to_linear(-18), 997, sample_rate);
+	sine(*audio, 1, db_to_linear(-21), 440, sample_rate);
+	sine(*audio, 2, db_to_linear(-15), 2500, sample_rate);
+	sine(*audio, 3, db_to_linear(-6), 50, sample_rate);
+	sine(*audio, 4, db_to_linear(-27), 300, sample_rate);
+	sine(*audio, 5, db_to_linear(-30), 5000, sample_rate);
+	/* Fade the last 30s down so that there is some loudness range */
+	for (int c = 0; c < 6; ++c) {
+		for (int i = sample_rate * 10; i < audio->frames(); ++i) {
+			audio->data(c)[i] *= db_to_linear(-20.0 * (i - sample_rate * 10) / (sample_rate * 30));
+		}
+	}
+
+	LoudnessMeter meter(sample_rate, 6);
+	meter.process(*audio, 0, audio->frames(), true);
+
+	AudioFilterGraph graph(sample_rate, 6);
+	graph.setup({ Filter("ebur128", "ebur128", "audio", "ebur128=peak=true") });
+	int const chunk = sample_rate / 10;
+	for (int i = 0; i < audio->frames(); i += chunk) {
+		graph.process(make_shared<AudioBuffers>(audio, std::min(chunk, audio->frames() - i), i));
+	}
+
+	void* eb = graph.get("Parsed_ebur128_0")->priv;
+	BOOST_CHECK_SMALL(meter.integrated() - av_ebur128_get_integrated_loudness(eb), 0.1);
+	BOOST_CHECK_SMALL(meter.range() - av_ebur128_get_loudness_range(eb), 0.2);
+}
+#endif
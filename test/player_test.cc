@@ -41,6 +41,7 @@
 #include "lib/image_content.h"
 #include "lib/image_png.h"
 #include "lib/job_manager.h"
+#include "lib/piece.h"
 #include "lib/player.h"
 #include "lib/ratio.h"
 #include "lib/string_text_file_content.h"
@@ -50,6 +51,7 @@
 #include "test.h"
 #include <boost/test/unit_test.hpp>
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
 #include <iostream>
 
 
@@ -799,3 +801,52 @@ BOOST_AUTO_TEST_CASE(test_fill_audio_at_end_error)
 	film->read_metadata();
 	make_and_verify_dcp(film, {});
 }
+
+
+/** Check that with a long playlist the player only has decoders for the content near the playhead,
+ *  and that it still plays everything.
+ */
+BOOST_AUTO_TEST_CASE(player_lazy_decoders_test)
+{
+	vector<shared_ptr<Content>> content;
+	for (int i = 0; i < 20; ++i) {
+		content.push_back(make_shared<ImageContent>("test/data/simple_testcard_640x480.png"));
+	}
+	auto film = new_test_film("player_lazy_decoders_test", content);
+	for (auto i: content) {
+		i->video->set_length(24);
+	}
+
+	auto open_decoders = [](Player const& player) {
+		return std::count_if(player._pieces.begin(), player._pieces.end(), [](shared_ptr<Piece> piece) { return static_cast<bool>(piece->decoder); });
+	};
+
+	Player player(film, Image::Alignment::COMPACT, false);
+	BOOST_CHECK(open_decoders(player) <= 3);
+
+	vector<DCPTime> times;
+	player.Video.connect([&times](shared_ptr<PlayerVideo>, DCPTime time) { times.push_back(time); });
+
+	long most_decoders = 0;
+	while (!player.pass()) {
+		most_decoders = std::max(most_decoders, static_cast<long>(open_decoders(player)));
+	}
+
+	BOOST_CHECK(most_decoders <= 3);
+	BOOST_REQUIRE_EQUAL(times.size(), 20U * 24);
+	for (size_t i = 0; i < times.size(); ++i) {
+		BOOST_CHECK(times[i] == DCPTime::from_frames(i, 24));
+	}
+
+	/* Seek into the middle and back to the start, then check that we get the right frames */
+	player.seek(DCPTime::from_seconds(10), true);
+	BOOST_CHECK(!player._pieces[0]->decoder);
+	BOOST_CHECK(player._pieces[10]->decoder);
+	BOOST_CHECK(!player._pieces[19]->decoder);
+
+	times.clear();
+	player.seek(DCPTime(), true);
+	while (!player.pass()) {}
+	BOOST_REQUIRE_EQUAL(times.size(), 20U * 24);
+	BOOST_CHECK(times.back() == DCPTime::from_frames(20 * 24 - 1, 24));
+}
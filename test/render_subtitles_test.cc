@@ -29,6 +29,7 @@
 #include "lib/image_png.h"
 #include "lib/render_text.h"
 #include "lib/string_text.h"
+#include "lib/text_raster_cache.h"
 #include "test.h"
 #include <dcp/text_string.h>
 #include <pango/pango-utils.h>
@@ -263,6 +264,73 @@ BOOST_AUTO_TEST_CASE(render_text_with_stretch_test)
 }
 
 
+BOOST_AUTO_TEST_CASE(text_raster_cache_test)
+{
+	auto dcp_string = dcp::TextString(
+		{}, false, false, false, dcp::Colour(255, 255, 255), 42, 1.0,
+		dcp::Time(0, 0, 0, 0, 24), dcp::Time(0, 0, 2, 0, 24),
+		0.5, dcp::HAlign::CENTER,
+		0.5, dcp::VAlign::CENTER,
+		0.0, {},
+		dcp::Direction::LTR,
+		"Hello world",
+		dcp::Effect::NONE, dcp::Colour(0, 0, 0),
+		dcp::Time(0, 0, 0, 12, 24), {},
+		0,
+		{}
+		);
+
+	vector<StringText> st = { StringText(dcp_string, 0, make_shared<dcpomatic::Font>("foo"), dcp::SubtitleStandard::SMPTE_2014) };
+	dcp::Size const size(1998, 1080);
+
+	auto cache = TextRasterCache::instance();
+	cache->clear();
+	auto const before = cache->statistics();
+
+	auto max_alpha = [](shared_ptr<const Image> image) {
+		int alpha = 0;
+		for (int y = 0; y < image->size().height; ++y) {
+			auto p = image->data()[0] + y * image->stride()[0];
+			for (int x = 0; x < image->size().width; ++x) {
+				alpha = std::max(alpha, static_cast<int>(p[x * 4 + 3]));
+			}
+		}
+		return alpha;
+	};
+
+	/* After the fade-in, so this should be rendered and cached */
+	auto full = cache->render(st, size, dcpomatic::DCPTime::from_seconds(1), 24);
+	BOOST_REQUIRE_EQUAL(full.size(), 1U);
+	BOOST_CHECK_EQUAL(cache->statistics().misses, before.misses + 1);
+
+	/* A later frame should get the same image back */
+	auto again = cache->render(st, size, dcpomatic::DCPTime::from_seconds(1.5), 24);
+	BOOST_REQUIRE_EQUAL(again.size(), 1U);
+	BOOST_CHECK(again[0].image == full[0].image);
+	BOOST_CHECK(again[0].position == full[0].position);
+	BOOST_CHECK_EQUAL(cache->statistics().hits, before.hits + 1);
+
+	/* Half-way through the fade-in we should get a half-transparent copy, without rendering again */
+	auto faded = cache->render(st, size, dcpomatic::DCPTime::from_seconds(0.25), 24);
+	BOOST_REQUIRE_EQUAL(faded.size(), 1U);
+	BOOST_CHECK(faded[0].image != full[0].image);
+	BOOST_CHECK(faded[0].image->size() == full[0].image->size());
+	BOOST_CHECK(faded[0].position == full[0].position);
+	BOOST_CHECK_EQUAL(cache->statistics().misses, before.misses + 1);
+	BOOST_CHECK_EQUAL(cache->statistics().hits, before.hits + 2);
+
+	auto const full_alpha = max_alpha(full[0].image);
+	BOOST_CHECK(full_alpha > 200);
+	BOOST_CHECK(std::abs(max_alpha(faded[0].image) - full_alpha / 2) <= 1);
+
+	/* And what we cached should be the same as a direct render */
+	auto direct = render_text(st, size, dcpomatic::DCPTime::from_seconds(1), 24);
+	BOOST_REQUIRE_EQUAL(direct.size(), 1U);
+	BOOST_CHECK(direct[0].image->size() == full[0].image->size());
+	BOOST_CHECK(direct[0].position == full[0].position);
+}
+
+
 #if 0
 
 BOOST_AUTO_TEST_CASE (render_text_test)
@@ -0,0 +1,112 @@
+/*
+    Copyright (C) 2026 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/trace_test.cc
+ *  @brief Test Trace class.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/trace.h"
+#include <dcp/filesystem.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+
+using std::string;
+
+
+static
+int
+count(string const& haystack, string const& needle)
+{
+	int n = 0;
+	for (auto i = haystack.find(needle); i != string::npos; i = haystack.find(needle, i + needle.length())) {
+		++n;
+	}
+	return n;
+}
+
+
+/** Write a trace with more events on one thread than fit in one of Trace's blocks, and with
+ *  names that need escaping, and check the JSON that comes out.
+ */
+BOOST_AUTO_TEST_CASE(trace_write_test)
+{
+	Trace::enable();
+
+	int const spans = Trace::max_events_per_block + 10;
+
+	boost::thread thread([spans]() {
+		Trace::set_thread_name("A \"quoted\" \\ thread");
+		for (int i = 0; i < spans; ++i) {
+			Trace::Span span("trace_write_test \"span\"");
+		}
+	});
+	thread.join();
+
+	boost::filesystem::path const path = "build/test/trace_write_test.json";
+	dcp::filesystem::create_directories(path.parent_path());
+	Trace::write(path);
+
+	BOOST_CHECK(!dcp::filesystem::exists(path.string() + ".tmp"));
+
+	std::ifstream file(path.string());
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	auto const json = buffer.str();
+
+	BOOST_CHECK_EQUAL(json.substr(0, 40), "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	BOOST_CHECK_EQUAL(json.substr(json.length() - 4), "\n]}\n");
+	BOOST_CHECK_EQUAL(count(json, "\"args\":{\"name\":\"A \\\"quoted\\\" \\\\ thread\"}"), 1);
+	BOOST_CHECK_EQUAL(count(json, "{\"name\":\"trace_write_test \\\"span\\\"\",\"ph\":\"X\",\"pid\":1,\"tid\":"), spans);
+	/* Each event is on its own line, with a comma between them */
+	BOOST_CHECK_EQUAL(count(json, "\n"), count(json, ",\n") + 3);
+}
+
+
+/** Check that a thread which records a lot only keeps its most recent events */
+BOOST_AUTO_TEST_CASE(trace_drop_old_events_test)
+{
+	Trace::enable();
+
+	boost::thread thread([]() {
+		for (int i = 0; i < Trace::max_events_per_thread + Trace::max_events_per_block * 2; ++i) {
+			Trace::Span span("trace_drop_old_events_test");
+		}
+	});
+	thread.join();
+
+	boost::filesystem::path const path = "build/test/trace_drop_old_events_test.json";
+	dcp::filesystem::create_directories(path.parent_path());
+	Trace::write(path);
+
+	std::ifstream file(path.string());
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	auto const spans = count(buffer.str(), "\"trace_drop_old_events_test\"");
+
+	BOOST_CHECK(spans <= Trace::max_events_per_thread);
+	BOOST_CHECK(spans > Trace::max_events_per_thread - Trace::max_events_per_block);
+}
@@ -29,8 +29,12 @@
 #include "lib/video_content.h"
 #include "lib/writer.h"
 #include "test.h"
+#include <dcp/cpl.h>
+#include <dcp/dcp.h>
 #include <dcp/openjpeg_image.h>
 #include <dcp/j2k_transcode.h>
+#include <dcp/reel.h>
+#include <dcp/reel_picture_asset.h>
 #include <boost/test/unit_test.hpp>
 #include <memory>
 
@@ -153,3 +157,118 @@ BOOST_AUTO_TEST_CASE(writer_progress_test)
 	encoder.go();
 }
 
+
+
+/** Write all the pictures for the second reel before any of the first, which means that
+ *  both reels' writer threads must be working at once.
+ */
+BOOST_AUTO_TEST_CASE(writer_reels_out_of_order_test)
+{
+	auto picture1 = content_factory("test/data/flat_red.png")[0];
+	auto picture2 = content_factory("test/data/flat_red.png")[0];
+
+	auto film = new_test_film("writer_reels_out_of_order_test", { picture1, picture2 });
+	film->set_reel_type(ReelType::BY_VIDEO_CONTENT);
+	picture1->video->set_length(48);
+	picture2->video->set_length(48);
+	picture2->set_position(film, dcpomatic::DCPTime::from_seconds(2));
+	BOOST_REQUIRE_EQUAL(film->reels().size(), 2U);
+
+	auto size = dcp::Size(1998, 1080);
+	auto image = make_shared<dcp::OpenJPEGImage>(size);
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < (size.width * size.height); ++j) {
+			image->data(i)[j] = rand() % 4095;
+		}
+	}
+
+	auto video = dcp::compress_j2k(image, 100000000, 24, false, false);
+	auto video_ptr = make_shared<dcp::ArrayData>(video.data(), video.size());
+	auto audio = make_shared<AudioBuffers>(6, 48000 / 24);
+	audio->make_silent();
+
+	auto writer = make_shared<Writer>(film, shared_ptr<Job>(), film->dir(film->dcp_name()));
+	/* Keep as few frames as possible in memory */
+	writer->set_encoder_threads(1);
+	writer->start();
+
+	for (int i = 48; i < 96; ++i) {
+		writer->write(video_ptr, i, Eyes::BOTH);
+	}
+	for (int i = 0; i < 48; ++i) {
+		writer->write(video_ptr, i, Eyes::BOTH);
+	}
+	for (int i = 0; i < 96; ++i) {
+		writer->write(audio, dcpomatic::DCPTime::from_frames(i, 24));
+	}
+
+	writer->finish();
+
+	dcp::DCP dcp(film->dir(film->dcp_name()));
+	dcp.read();
+	BOOST_REQUIRE_EQUAL(dcp.cpls().size(), 1U);
+	auto reels = dcp.cpls()[0]->reels();
+	BOOST_REQUIRE_EQUAL(reels.size(), 2U);
+	for (auto reel: reels) {
+		BOOST_REQUIRE(reel->main_picture());
+		BOOST_CHECK_EQUAL(reel->main_picture()->actual_duration(), 48);
+	}
+}
+
+
+/** Give the writer some frames more than once, as J2KEncoder does when it asks a second
+ *  encoder to make a frame that is taking too long, and check that only one copy of each is kept.
+ */
+BOOST_AUTO_TEST_CASE(writer_ignores_duplicate_frames_test)
+{
+	auto picture = content_factory("test/data/flat_red.png")[0];
+	auto film = new_test_film("writer_ignores_duplicate_frames_test", { picture });
+	picture->video->set_length(24);
+
+	auto size = dcp::Size(1998, 1080);
+	auto image = make_shared<dcp::OpenJPEGImage>(size);
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < (size.width * size.height); ++j) {
+			image->data(i)[j] = rand() % 4095;
+		}
+	}
+
+	auto video = dcp::compress_j2k(image, 100000000, 24, false, false);
+	auto video_ptr = make_shared<dcp::ArrayData>(video.data(), video.size());
+	auto audio = make_shared<AudioBuffers>(6, 48000 / 24);
+	audio->make_silent();
+
+	auto writer = make_shared<Writer>(film, shared_ptr<Job>(), film->dir(film->dcp_name()));
+	writer->start();
+
+	/* Frame 0 is missing so the writer should be waiting for it */
+	for (int i = 1; i < 12; ++i) {
+		BOOST_CHECK(writer->write(video_ptr, i, Eyes::BOTH));
+	}
+	BOOST_CHECK(!writer->write(video_ptr, 5, Eyes::BOTH));
+	auto awaited = writer->awaited_frames();
+	BOOST_REQUIRE_EQUAL(awaited.size(), 1U);
+	BOOST_CHECK_EQUAL(awaited[0].first, 0);
+	BOOST_CHECK(awaited[0].second == Eyes::BOTH);
+
+	BOOST_CHECK(writer->write(video_ptr, 0, Eyes::BOTH));
+	BOOST_CHECK(!writer->write(video_ptr, 0, Eyes::BOTH));
+	for (int i = 12; i < 24; ++i) {
+		BOOST_CHECK(writer->write(video_ptr, i, Eyes::BOTH));
+		/* A late copy of a frame which has probably already been written */
+		BOOST_CHECK(!writer->write(video_ptr, i - 6, Eyes::BOTH));
+	}
+	for (int i = 0; i < 24; ++i) {
+		writer->write(audio, dcpomatic::DCPTime::from_frames(i, 24));
+	}
+
+	writer->finish();
+
+	dcp::DCP dcp(film->dir(film->dcp_name()));
+	dcp.read();
+	BOOST_REQUIRE_EQUAL(dcp.cpls().size(), 1U);
+	auto reels = dcp.cpls()[0]->reels();
+	BOOST_REQUIRE_EQUAL(reels.size(), 1U);
+	BOOST_REQUIRE(reels[0]->main_picture());
+	BOOST_CHECK_EQUAL(reels[0]->main_picture()->actual_duration(), 24);
+}